@@ -22,6 +22,12 @@ namespace vks
 	*/
 	VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 	{
+		// Sub-allocated host visible memory is persistently mapped by the allocator
+		if (allocator) {
+			assert(allocation.mapped);
+			mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+			return VK_SUCCESS;
+		}
 		return vkMapMemory(device, memory, offset, size, 0, &mapped);
 	}
 
@@ -34,7 +40,10 @@ namespace vks
 	{
 		if (mapped)
 		{
-			vkUnmapMemory(device, memory);
+			if (!allocator)
+			{
+				vkUnmapMemory(device, memory);
+			}
 			mapped = nullptr;
 		}
 	}
@@ -48,7 +57,7 @@ namespace vks
 	*/
 	VkResult Buffer::bind(VkDeviceSize offset)
 	{
-		return vkBindBufferMemory(device, buffer, memory, offset);
+		return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 	}
 
 	/**
@@ -90,10 +99,14 @@ namespace vks
 	*/
 	VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 	{
+		// Ranges are relative to the buffer, which may only be a part of the memory object
+		if (allocator && (size == VK_WHOLE_SIZE)) {
+			size = allocation.size - offset;
+		}
 		VkMappedMemoryRange mappedRange{
 			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
 			.memory = memory,
-			.offset = offset,
+			.offset = allocation.offset + offset,
 			.size = size
 		};
 		return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
@@ -111,10 +124,14 @@ namespace vks
 	*/
 	VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
+		// Ranges are relative to the buffer, which may only be a part of the memory object
+		if (allocator && (size == VK_WHOLE_SIZE)) {
+			size = allocation.size - offset;
+		}
 		VkMappedMemoryRange mappedRange{
 			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
 			.memory = memory,
-			.offset = offset,
+			.offset = allocation.offset + offset,
 			.size = size
 		};
 		return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
@@ -130,7 +147,14 @@ namespace vks
 			vkDestroyBuffer(device, buffer, nullptr);
 			buffer = VK_NULL_HANDLE;
 		}
-		if (memory)
+		if (allocator)
+		{
+			allocator->free(allocation);
+			allocator = nullptr;
+			memory = VK_NULL_HANDLE;
+			mapped = nullptr;
+		}
+		else if (memory)
 		{
 			vkFreeMemory(device, memory, nullptr);
 			memory = VK_NULL_HANDLE;
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "vulkan/vulkan.h"
+#include "VulkanMemoryAllocator.h"
 #include "VulkanTools.h"
 
 namespace vks
@@ -35,6 +36,9 @@ namespace vks
 		/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
 		VkMemoryPropertyFlags memoryPropertyFlags;
 		uint64_t deviceAddress;
+		/** @brief Range of device memory the buffer is bound to if it has been sub-allocated (memory is the memory object the range is part of) */
+		MemoryAllocation allocation{};
+		MemoryAllocator* allocator{ nullptr };
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void unmap();
 		VkResult bind(VkDeviceSize offset = 0);
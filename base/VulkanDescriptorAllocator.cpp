@@ -0,0 +1,471 @@
+/*
+* Vulkan descriptor allocator
+*
+* Allocates descriptor sets from growing chains of descriptor pools, so descriptor pools don't have to be sized up front
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanDescriptorAllocator.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+#include "VulkanTools.h"
+
+namespace vks
+{
+	// Descriptors per set a pool is created with, relative to its number of sets, types not listed here are only added if a layout requires them
+	static constexpr std::array<VkDescriptorPoolSize, 9> poolRatios = {
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_SAMPLER, 1 },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1 },
+	};
+
+	// Appends the bytes of a value to a cache key, keys are compared as a whole so there are no false hits on hash collisions
+	template<typename T>
+	static void appendKey(std::string& key, const T& value)
+	{
+		key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	/**
+	* Prepare the allocator for use, pools are only created once sets are allocated
+	*
+	* @param device Logical device to create layouts, pools and sets on
+	*/
+	void DescriptorAllocator::create(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	/**
+	* Destroy all pools and layouts, this frees all sets allocated by the allocator
+	*/
+	void DescriptorAllocator::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& [flags, chain] : persistentChains) {
+			destroyChain(chain);
+		}
+		for (auto& chain : transientChains) {
+			destroyChain(chain);
+		}
+		for (auto& [key, layout] : layoutCache) {
+			vkDestroyDescriptorSetLayout(device, layout, nullptr);
+		}
+		persistentChains.clear();
+		transientChains.clear();
+		layoutCache.clear();
+		layouts.clear();
+		setCache.clear();
+		persistentSets.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	void DescriptorAllocator::destroyChain(PoolChain& chain)
+	{
+		for (VkDescriptorPool pool : chain.pools) {
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		chain.pools.clear();
+		chain.reusable.clear();
+		chain.current = 0;
+	}
+
+	/**
+	* Get a descriptor set layout, layouts are cached so identical create infos return the same layout
+	*
+	* @param createInfo Layout create info, the only supported structure in its pNext chain is VkDescriptorSetLayoutBindingFlagsCreateInfo
+	*
+	* @return Layout owned by the allocator
+	*/
+	VkDescriptorSetLayout DescriptorAllocator::getLayout(const VkDescriptorSetLayoutCreateInfo& createInfo)
+	{
+		const VkDescriptorSetLayoutBindingFlagsCreateInfo* bindingFlagsCI = nullptr;
+		for (const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext) {
+			if (next->sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO) {
+				bindingFlagsCI = reinterpret_cast<const VkDescriptorSetLayoutBindingFlagsCreateInfo*>(next);
+			} else {
+				vks::tools::exitFatal("Unsupported structure in the pNext chain of a cached descriptor set layout", VK_ERROR_FEATURE_NOT_PRESENT);
+			}
+		}
+
+		// Binding order doesn't matter for the layout, so bindings are sorted to make the key independent of it
+		std::vector<uint32_t> order(createInfo.bindingCount);
+		for (uint32_t i = 0; i < createInfo.bindingCount; i++) {
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [&createInfo](uint32_t a, uint32_t b) { return createInfo.pBindings[a].binding < createInfo.pBindings[b].binding; });
+
+		std::string key;
+		appendKey(key, createInfo.flags);
+		for (uint32_t i : order) {
+			const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+			appendKey(key, binding.binding);
+			appendKey(key, binding.descriptorType);
+			appendKey(key, binding.descriptorCount);
+			appendKey(key, binding.stageFlags);
+			const bool immutableSamplers = (binding.pImmutableSamplers != nullptr) && ((binding.descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER) || (binding.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER));
+			appendKey(key, immutableSamplers);
+			if (immutableSamplers) {
+				key.append(reinterpret_cast<const char*>(binding.pImmutableSamplers), binding.descriptorCount * sizeof(VkSampler));
+			}
+			const VkDescriptorBindingFlags bindingFlags = (bindingFlagsCI && bindingFlagsCI->bindingCount > 0) ? bindingFlagsCI->pBindingFlags[i] : 0;
+			appendKey(key, bindingFlags);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = layoutCache.find(key);
+		if (cached != layoutCache.end()) {
+			statistics.layoutsDeduplicated++;
+			return cached->second;
+		}
+
+		VkDescriptorSetLayout layout{ VK_NULL_HANDLE };
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &layout));
+		layoutCache[key] = layout;
+		statistics.layoutsCreated++;
+
+		// Sum up the descriptors a single set of this layout needs, so pools can be created large enough for it
+		LayoutInfo& layoutInfo = layouts[layout];
+		for (uint32_t i = 0; i < createInfo.bindingCount; i++) {
+			const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+			const VkDescriptorBindingFlags bindingFlags = (bindingFlagsCI && bindingFlagsCI->bindingCount > 0) ? bindingFlagsCI->pBindingFlags[i] : 0;
+			if (bindingFlags & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT) {
+				layoutInfo.variableCount = true;
+				layoutInfo.variableType = binding.descriptorType;
+				continue;
+			}
+			auto descriptorCount = std::find_if(layoutInfo.descriptorCounts.begin(), layoutInfo.descriptorCounts.end(), [&binding](const VkDescriptorPoolSize& poolSize) { return poolSize.type == binding.descriptorType; });
+			if (descriptorCount != layoutInfo.descriptorCounts.end()) {
+				descriptorCount->descriptorCount += binding.descriptorCount;
+			} else {
+				layoutInfo.descriptorCounts.push_back({ binding.descriptorType, binding.descriptorCount });
+			}
+		}
+		if (createInfo.flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT) {
+			layoutInfo.poolFlags |= VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		}
+		return layout;
+	}
+
+	/** @brief Get a cached descriptor set layout for a list of bindings without any flags */
+	VkDescriptorSetLayout DescriptorAllocator::getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		VkDescriptorSetLayoutCreateInfo createInfo{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindings.size()),
+			.pBindings = bindings.data()
+		};
+		return getLayout(createInfo);
+	}
+
+	/**
+	* Create a new pool for a chain, the pool's descriptor counts are based on the ratios in poolRatios and are large enough for at least one set of the layout that needs it
+	*/
+	VkDescriptorPool DescriptorAllocator::createPool(PoolChain& chain, const LayoutInfo* layoutInfo, uint32_t variableDescriptorCount)
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const VkDescriptorPoolSize& ratio : poolRatios) {
+			poolSizes.push_back({ ratio.type, ratio.descriptorCount * chain.setsPerPool });
+		}
+		auto addRequired = [&poolSizes](VkDescriptorType type, uint32_t count) {
+			auto poolSize = std::find_if(poolSizes.begin(), poolSizes.end(), [type](const VkDescriptorPoolSize& size) { return size.type == type; });
+			if (poolSize != poolSizes.end()) {
+				poolSize->descriptorCount = std::max(poolSize->descriptorCount, count);
+			} else {
+				poolSizes.push_back({ type, count });
+			}
+		};
+		if (layoutInfo) {
+			for (const VkDescriptorPoolSize& descriptorCount : layoutInfo->descriptorCounts) {
+				addRequired(descriptorCount.type, descriptorCount.descriptorCount);
+			}
+			if (layoutInfo->variableCount && (variableDescriptorCount > 0)) {
+				addRequired(layoutInfo->variableType, variableDescriptorCount);
+			}
+		}
+		VkDescriptorPoolCreateInfo descriptorPoolCI{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.flags = chain.flags,
+			.maxSets = chain.setsPerPool,
+			.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+			.pPoolSizes = poolSizes.data()
+		};
+		VkDescriptorPool pool{ VK_NULL_HANDLE };
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &pool));
+		statistics.poolsCreated++;
+		chain.setsPerPool = std::min(chain.setsPerPool * 2, maxSetsPerPool);
+		return pool;
+	}
+
+	/**
+	* Allocate a set from the current pool of a chain, moves on to the next pool if the current pool is out of memory
+	* Once the chain is exhausted, earlier pools that got sets back through free are tried before a new pool is created
+	*/
+	VkDescriptorSet DescriptorAllocator::allocateFromChain(PoolChain& chain, VkDescriptorSetLayout layout, uint32_t variableDescriptorCount, VkDescriptorPool* pool)
+	{
+		auto layoutInfo = layouts.find(layout);
+		const LayoutInfo* info = (layoutInfo != layouts.end()) ? &layoutInfo->second : nullptr;
+		VkDescriptorSetVariableDescriptorCountAllocateInfo variableDescriptorCountAllocInfo{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+			.descriptorSetCount = 1,
+			.pDescriptorCounts = &variableDescriptorCount
+		};
+		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.pNext = (info && info->variableCount) ? &variableDescriptorCountAllocInfo : nullptr,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &layout
+		};
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+		while (true) {
+			// Pools past the current one have been reset and are reused before creating new ones
+			const bool newPool = (chain.current >= chain.pools.size());
+			if (newPool) {
+				// A reusable pool stays in the list until an allocation from it fails
+				while (!chain.reusable.empty()) {
+					const VkDescriptorPool reusablePool = chain.pools[chain.reusable.back()];
+					descriptorSetAllocInfo.descriptorPool = reusablePool;
+					if (vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet) == VK_SUCCESS) {
+						if (pool) {
+							*pool = reusablePool;
+						}
+						return descriptorSet;
+					}
+					chain.reusable.pop_back();
+				}
+				chain.pools.push_back(createPool(chain, info, variableDescriptorCount));
+				chain.current = chain.pools.size() - 1;
+			}
+			descriptorSetAllocInfo.descriptorPool = chain.pools[chain.current];
+			VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet);
+			if (result == VK_SUCCESS) {
+				break;
+			}
+			if (((result != VK_ERROR_OUT_OF_POOL_MEMORY) && (result != VK_ERROR_FRAGMENTED_POOL)) || newPool) {
+				// A new pool is sized for the layout, so running out of memory in it is an error
+				vks::tools::exitFatal("Could not allocate a descriptor set: \n" + vks::tools::errorString(result), result);
+			}
+			chain.current++;
+		}
+		if (pool) {
+			*pool = chain.pools[chain.current];
+		}
+		return descriptorSet;
+	}
+
+	/**
+	* Allocate a persistent descriptor set, it stays valid until it's freed or the allocator is destroyed
+	*
+	* @param layout Layout of the set, should be one returned by getLayout so pools can be sized for it
+	* @param (Optional) variableDescriptorCount Number of descriptors for a binding with a variable descriptor count
+	*/
+	VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, uint32_t variableDescriptorCount)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto layoutInfo = layouts.find(layout);
+		const VkDescriptorPoolCreateFlags poolFlags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT | ((layoutInfo != layouts.end()) ? layoutInfo->second.poolFlags : 0);
+		PoolChain& chain = persistentChains[poolFlags];
+		chain.flags = poolFlags;
+		VkDescriptorPool pool{ VK_NULL_HANDLE };
+		VkDescriptorSet descriptorSet = allocateFromChain(chain, layout, variableDescriptorCount, &pool);
+		persistentSets[descriptorSet] = { pool, {} };
+		statistics.setsAllocated++;
+		return descriptorSet;
+	}
+
+	/**
+	* Allocate a descriptor set that's only used for the current frame, all transient sets of a frame are released at once in beginFrame
+	*
+	* @param layout Layout of the set, layouts that require update after bind pools are not supported
+	* @param (Optional) variableDescriptorCount Number of descriptors for a binding with a variable descriptor count
+	*/
+	VkDescriptorSet DescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout, uint32_t variableDescriptorCount)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		[[maybe_unused]] auto layoutInfo = layouts.find(layout);
+		assert((layoutInfo == layouts.end()) || (layoutInfo->second.poolFlags == 0));
+		if (transientChains.size() <= currentFrame) {
+			transientChains.resize(currentFrame + 1);
+		}
+		VkDescriptorSet descriptorSet = allocateFromChain(transientChains[currentFrame], layout, variableDescriptorCount, nullptr);
+		statistics.transientSetsAllocated++;
+		return descriptorSet;
+	}
+
+	/**
+	* Get a persistent descriptor set with the given bindings, sets are cached so identical layouts and bindings return the same set
+	*
+	* @param layout Layout of the set
+	* @param writes Descriptors to write to the set, dstSet is ignored and set by the allocator
+	* @param (Optional) variableDescriptorCount Number of descriptors for a binding with a variable descriptor count
+	*
+	* @note Each call needs to be matched with a call to free once the set is no longer used, the set is freed once all users have released it
+	*/
+	VkDescriptorSet DescriptorAllocator::getSet(VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet>& writes, uint32_t variableDescriptorCount)
+	{
+		std::string key;
+		appendKey(key, layout);
+		appendKey(key, variableDescriptorCount);
+		for (const VkWriteDescriptorSet& write : writes) {
+			appendKey(key, write.dstBinding);
+			appendKey(key, write.dstArrayElement);
+			appendKey(key, write.descriptorCount);
+			appendKey(key, write.descriptorType);
+			for (uint32_t i = 0; i < write.descriptorCount; i++) {
+				switch (write.descriptorType) {
+				case VK_DESCRIPTOR_TYPE_SAMPLER:
+				case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+				case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+				case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+				case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+					appendKey(key, write.pImageInfo[i].sampler);
+					appendKey(key, write.pImageInfo[i].imageView);
+					appendKey(key, write.pImageInfo[i].imageLayout);
+					break;
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+				case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+				case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+					appendKey(key, write.pBufferInfo[i].buffer);
+					appendKey(key, write.pBufferInfo[i].offset);
+					appendKey(key, write.pBufferInfo[i].range);
+					break;
+				case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+				case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+					appendKey(key, write.pTexelBufferView[i]);
+					break;
+				default:
+					vks::tools::exitFatal("Unsupported descriptor type for a cached descriptor set", VK_ERROR_FEATURE_NOT_PRESENT);
+				}
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto cached = setCache.find(key);
+			if (cached != setCache.end()) {
+				cached->second.references++;
+				statistics.setCacheHits++;
+				return cached->second.descriptorSet;
+			}
+		}
+
+		VkDescriptorSet descriptorSet = allocate(layout, variableDescriptorCount);
+		std::vector<VkWriteDescriptorSet> setWrites = writes;
+		for (VkWriteDescriptorSet& write : setWrites) {
+			write.dstSet = descriptorSet;
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = setCache.find(key);
+		if (cached != setCache.end()) {
+			// Another thread created the same set in the meantime
+			freePersistentSet(descriptorSet, persistentSets[descriptorSet].first);
+			cached->second.references++;
+			statistics.setCacheHits++;
+			return cached->second.descriptorSet;
+		}
+		setCache[key] = { descriptorSet, 1 };
+		persistentSets[descriptorSet].second = key;
+		return descriptorSet;
+	}
+
+	/**
+	* Free a persistent descriptor set returned by allocate or getSet, the device must no longer use it
+	*
+	* @note Cached sets are only freed once all users that got the set from getSet have freed it
+	*/
+	void DescriptorAllocator::free(VkDescriptorSet descriptorSet)
+	{
+		if (descriptorSet == VK_NULL_HANDLE) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		auto persistentSet = persistentSets.find(descriptorSet);
+		assert(persistentSet != persistentSets.end());
+		const std::string& key = persistentSet->second.second;
+		if (!key.empty()) {
+			auto cached = setCache.find(key);
+			if (--cached->second.references > 0) {
+				return;
+			}
+			setCache.erase(cached);
+		}
+		freePersistentSet(descriptorSet, persistentSet->second.first);
+	}
+
+	/**
+	* Return a persistent set to its pool, full pools that get capacity back this way are marked for reuse in their chain
+	*/
+	void DescriptorAllocator::freePersistentSet(VkDescriptorSet descriptorSet, VkDescriptorPool pool)
+	{
+		VK_CHECK_RESULT(vkFreeDescriptorSets(device, pool, 1, &descriptorSet));
+		persistentSets.erase(descriptorSet);
+		statistics.setsFreed++;
+		for (auto& [flags, chain] : persistentChains) {
+			auto poolIt = std::find(chain.pools.begin(), chain.pools.end(), pool);
+			if (poolIt == chain.pools.end()) {
+				continue;
+			}
+			const size_t index = static_cast<size_t>(poolIt - chain.pools.begin());
+			// Pools from current onwards are tried anyway
+			if ((index < chain.current) && (std::find(chain.reusable.begin(), chain.reusable.end(), index) == chain.reusable.end())) {
+				chain.reusable.push_back(index);
+			}
+			break;
+		}
+	}
+
+	/**
+	* Start allocating transient sets for a frame and release all transient sets previously allocated for it
+	*
+	* @param frameIndex Index of the frame in flight, the device must be done with the frame (e.g. its fence has been waited on)
+	*/
+	void DescriptorAllocator::beginFrame(uint32_t frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentFrame = frameIndex;
+		if (frameIndex < transientChains.size()) {
+			PoolChain& chain = transientChains[frameIndex];
+			for (VkDescriptorPool pool : chain.pools) {
+				VK_CHECK_RESULT(vkResetDescriptorPool(device, pool, 0));
+			}
+			chain.current = 0;
+		}
+	}
+
+	/**
+	* Write the number of layouts, pools and sets to a stream
+	*/
+	void DescriptorAllocator::printStatistics(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t persistentPools{ 0 }, transientPools{ 0 };
+		for (auto& [flags, chain] : persistentChains) {
+			persistentPools += chain.pools.size();
+		}
+		for (auto& chain : transientChains) {
+			transientPools += chain.pools.size();
+		}
+		stream << "Descriptor statistics" << "\n";
+		stream << "Descriptor set layouts: " << statistics.layoutsCreated << " created, " << statistics.layoutsDeduplicated << " deduplicated" << "\n";
+		stream << "Descriptor pools: " << persistentPools << " persistent, " << transientPools << " transient (" << statistics.poolsCreated << " created)" << "\n";
+		stream << "Descriptor sets: " << statistics.setsAllocated << " allocated, " << persistentSets.size() << " in use, " << setCache.size() << " cached (" << statistics.setCacheHits << " cache hits), " << statistics.setsFreed << " freed, " << statistics.transientSetsAllocated << " transient" << "\n";
+		stream << std::flush;
+	}
+}
@@ -0,0 +1,104 @@
+/*
+* Vulkan descriptor allocator
+*
+* Allocates descriptor sets from growing chains of descriptor pools, so descriptor pools don't have to be sized up front
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	/**
+	* @brief Descriptor set allocator with a descriptor set layout cache, a cache for persistent descriptor sets and per-frame pools for transient descriptor sets
+	* @note Pools are created on demand with descriptor counts derived from the layouts, a new pool is added to the chain once all pools ran out of memory (persistent pools that got sets back through free are tried again first)
+	* @note Layouts and sets handed out by the allocator are owned by it and must not be destroyed or freed with the Vulkan functions
+	*/
+	class DescriptorAllocator
+	{
+	public:
+		/** @brief Number of sets of the first pool of each chain, following pools double in size up to maxSetsPerPool */
+		static constexpr uint32_t initialSetsPerPool = 64;
+		static constexpr uint32_t maxSetsPerPool = 4096;
+
+		struct Statistics
+		{
+			uint32_t layoutsCreated{ 0 };
+			/** @brief Layout requests that returned an identical layout that already existed */
+			uint32_t layoutsDeduplicated{ 0 };
+			uint32_t poolsCreated{ 0 };
+			uint32_t setsAllocated{ 0 };
+			uint32_t transientSetsAllocated{ 0 };
+			/** @brief Persistent set requests that returned a cached set with identical layout and bindings */
+			uint32_t setCacheHits{ 0 };
+			uint32_t setsFreed{ 0 };
+		} statistics;
+
+		void create(VkDevice device);
+		void destroy();
+		VkDescriptorSetLayout getLayout(const VkDescriptorSetLayoutCreateInfo& createInfo);
+		VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout, uint32_t variableDescriptorCount = 0);
+		VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout, uint32_t variableDescriptorCount = 0);
+		VkDescriptorSet getSet(VkDescriptorSetLayout layout, const std::vector<VkWriteDescriptorSet>& writes, uint32_t variableDescriptorCount = 0);
+		void free(VkDescriptorSet descriptorSet);
+		void beginFrame(uint32_t frameIndex);
+		void printStatistics(std::ostream& stream);
+
+	private:
+		/** @brief Descriptor counts of a layout that a pool needs to provide for a single set */
+		struct LayoutInfo
+		{
+			std::vector<VkDescriptorPoolSize> descriptorCounts;
+			// Type of the binding with VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT, its count is passed at allocation time
+			bool variableCount{ false };
+			VkDescriptorType variableType{ VK_DESCRIPTOR_TYPE_MAX_ENUM };
+			VkDescriptorPoolCreateFlags poolFlags{ 0 };
+		};
+
+		/** @brief Pools that sets are allocated from, pools before current are full (or have been reset and can be reused) */
+		struct PoolChain
+		{
+			VkDescriptorPoolCreateFlags flags{ 0 };
+			std::vector<VkDescriptorPool> pools;
+			size_t current{ 0 };
+			uint32_t setsPerPool{ initialSetsPerPool };
+			// Indices of pools before current that got sets back through free, these are tried again before a new pool is created
+			std::vector<size_t> reusable;
+		};
+
+		struct CachedSet
+		{
+			VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+			uint32_t references{ 0 };
+		};
+
+		VkDevice device{ VK_NULL_HANDLE };
+		std::mutex mutex;
+		std::unordered_map<std::string, VkDescriptorSetLayout> layoutCache;
+		std::unordered_map<VkDescriptorSetLayout, LayoutInfo> layouts;
+		// Persistent chains are keyed by the pool create flags required by the layout (e.g. update after bind)
+		std::unordered_map<VkDescriptorPoolCreateFlags, PoolChain> persistentChains;
+		std::vector<PoolChain> transientChains;
+		uint32_t currentFrame{ 0 };
+		std::unordered_map<std::string, CachedSet> setCache;
+		// Pool and cache key of each persistent set, needed for freeing
+		std::unordered_map<VkDescriptorSet, std::pair<VkDescriptorPool, std::string>> persistentSets;
+
+		VkDescriptorPool createPool(PoolChain& chain, const LayoutInfo* layoutInfo, uint32_t variableDescriptorCount);
+		VkDescriptorSet allocateFromChain(PoolChain& chain, VkDescriptorSetLayout layout, uint32_t variableDescriptorCount, VkDescriptorPool* pool);
+		void freePersistentSet(VkDescriptorSet descriptorSet, VkDescriptorPool pool);
+		void destroyChain(PoolChain& chain);
+	};
+}
@@ -64,6 +64,9 @@ namespace vks
 	*/
 	VulkanDevice::~VulkanDevice()
 	{
+		stagingRing.destroy();
+		memoryAllocator.destroy();
+		descriptorAllocator.destroy();
 		if (commandPool)
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
@@ -304,6 +307,10 @@ namespace vks
 
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
+		// Uploads are batched through a staging ring that submits to queues of the graphics family
+		stagingRing.create(this, queueFamilyIndices.graphics);
+		memoryAllocator.create(logicalDevice, memoryProperties, properties.limits);
+		descriptorAllocator.create(logicalDevice);
 
 		return result;
 	}
@@ -319,6 +326,8 @@ namespace vks
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+	*
+	* @note The memory is allocated separately and owned by the caller, use the vks::Buffer overload to sub-allocate it from the memory allocator
 	*/
 	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data)
 	{
@@ -387,21 +396,14 @@ namespace vks
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		// Buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set need memory that has been allocated with the appropriate flag
+		MemoryAllocator::ResourceType resourceType = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) ? MemoryAllocator::ResourceType::BufferDeviceAddress : MemoryAllocator::ResourceType::Buffer;
+		buffer->allocation = memoryAllocator.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), resourceType);
+		buffer->allocator = &memoryAllocator;
+		buffer->memory = buffer->allocation.memory;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -426,6 +428,23 @@ namespace vks
 		return buffer->bind();
 	}
 
+	/**
+	* Sub-allocate memory for an image and bind it
+	*
+	* @param image Image to allocate the memory for
+	* @param memoryPropertyFlags Memory properties for the image (usually device local)
+	* @param allocation Pointer to the allocation that needs to be passed to the memory allocator once the image has been destroyed
+	*
+	* @return VkResult of the image memory binding
+	*/
+	VkResult VulkanDevice::allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation)
+	{
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+		*allocation = memoryAllocator.allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), MemoryAllocator::ResourceType::Image);
+		return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
+	}
+
 	/**
 	* Copy buffer data from src to dst using VkCmdCopyBuffer
 	* 
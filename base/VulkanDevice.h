@@ -11,6 +11,9 @@
 #pragma once
 
 #include "VulkanBuffer.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanStagingRing.h"
 #include "VulkanTools.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
@@ -39,6 +42,12 @@ struct VulkanDevice
 	std::vector<std::string> supportedExtensions{};
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool{ VK_NULL_HANDLE };;
+	/** @brief Staging ring buffer shared by all uploads on the graphics queue family */
+	StagingRing stagingRing;
+	/** @brief Sub-allocator for the device memory of buffers and images */
+	MemoryAllocator memoryAllocator;
+	/** @brief Descriptor set layout cache and descriptor set allocator with growing pools */
+	DescriptorAllocator descriptorAllocator;
 	/** @brief Contains queue family indices */
 	struct
 	{
@@ -57,6 +66,7 @@ struct VulkanDevice
 	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
 	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::MemoryAllocation *allocation);
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
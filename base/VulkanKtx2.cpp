@@ -0,0 +1,437 @@
+/*
+* KTX2 texture container loading
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanKtx2.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "VulkanTools.h"
+// The implementation is compiled in VulkanglTFModel.cpp, only the zlib decoder is used here
+#include "stb_image.h"
+
+#if defined(VKS_BASISU)
+#include <mutex>
+#include "basisu/transcoder/basisu_transcoder.h"
+#endif
+#if defined(VKS_ZSTD)
+#include "basisu/zstd/zstd.h"
+#endif
+
+namespace vks
+{
+	namespace ktx2
+	{
+		static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+		static const size_t headerSize = 80;
+		static const size_t levelIndexEntrySize = 24;
+		// Khronos data format descriptor values (KHR_DF_TRANSFER_SRGB and channel ids)
+		static const uint32_t transferFunctionSRGB = 2;
+		static const uint32_t channelETC1SAAA = 15;
+		static const uint32_t channelUASTCRGBA = 3;
+		static const uint32_t channelUASTCRRRG = 5;
+
+		template<typename T>
+		static T read(const std::vector<uint8_t>& data, size_t offset)
+		{
+			T value;
+			memcpy(&value, data.data() + offset, sizeof(T));
+			return value;
+		}
+
+		static bool isSrgbFormat(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_SRGB:
+			case VK_FORMAT_B8G8R8A8_SRGB:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			case VK_FORMAT_BC2_SRGB_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+			case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+			case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+			case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		static bool formatSupported(VkPhysicalDevice physicalDevice, VkFormat format)
+		{
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+			return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+		}
+
+		// Runs the function for [0, count) on the job system if there is one, or on the calling thread
+		template<typename F>
+		static void forEach(JobSystem* jobSystem, uint32_t count, F&& function)
+		{
+			if (jobSystem) {
+				jobSystem->parallelFor(count, function, 1);
+			} else {
+				function(0, count);
+			}
+		}
+
+		bool isKtx2File(const std::string& filename)
+		{
+			const size_t pos = filename.find_last_of(".");
+			return (pos != std::string::npos) && (filename.substr(pos + 1) == "ktx2");
+		}
+
+		bool parse(std::vector<uint8_t>&& data, File& file, std::string& error)
+		{
+			if ((data.size() < headerSize) || (memcmp(data.data(), identifier, sizeof(identifier)) != 0)) {
+				error = "not a KTX2 file";
+				return false;
+			}
+
+			file.format = static_cast<VkFormat>(read<uint32_t>(data, 12));
+			file.width = read<uint32_t>(data, 20);
+			file.height = read<uint32_t>(data, 24);
+			file.depth = read<uint32_t>(data, 28);
+			file.layerCount = read<uint32_t>(data, 32);
+			file.faceCount = read<uint32_t>(data, 36);
+			file.levelCount = read<uint32_t>(data, 40);
+			file.supercompressionScheme = read<uint32_t>(data, 44);
+			const uint32_t dfdOffset = read<uint32_t>(data, 48);
+			const uint32_t dfdLength = read<uint32_t>(data, 52);
+			const uint64_t sgdOffset = read<uint64_t>(data, 64);
+			const uint64_t sgdLength = read<uint64_t>(data, 72);
+
+			if ((file.width == 0) || (file.faceCount == 0)) {
+				error = "invalid header";
+				return false;
+			}
+
+			// A level count of zero requests mip generation at load time, the file then only contains the base level
+			const uint32_t levelEntries = std::max(file.levelCount, 1u);
+			if (headerSize + levelEntries * levelIndexEntrySize > data.size()) {
+				error = "truncated level index";
+				return false;
+			}
+			file.levels.resize(levelEntries);
+			for (uint32_t i = 0; i < levelEntries; i++) {
+				const size_t entry = headerSize + i * levelIndexEntrySize;
+				File::Level& level = file.levels[i];
+				level.offset = read<uint64_t>(data, entry);
+				level.size = read<uint64_t>(data, entry + 8);
+				level.uncompressedSize = read<uint64_t>(data, entry + 16);
+				if ((level.offset > data.size()) || (level.size > data.size() - level.offset)) {
+					error = "level " + std::to_string(i) + " is out of bounds";
+					return false;
+				}
+			}
+
+			// The basic descriptor block follows the total size of the data format descriptor
+			if ((dfdLength >= 4 + 24) && (static_cast<size_t>(dfdOffset) + dfdLength <= data.size())) {
+				const size_t block = dfdOffset + 4;
+				const uint32_t blockSize = read<uint32_t>(data, block + 4) >> 16;
+				// The basic descriptor block has a 24 byte header followed by 16 bytes per sample
+				if (blockSize < 24) {
+					error = "invalid data format descriptor";
+					return false;
+				}
+				const uint32_t model = read<uint32_t>(data, block + 8);
+				file.colorModel = model & 0xFF;
+				file.srgb = ((model >> 16) & 0xFF) == transferFunctionSRGB;
+				const uint32_t sampleCount = (std::min(blockSize, dfdLength - 4) - 24) / 16;
+				for (uint32_t i = 0; i < sampleCount; i++) {
+					const uint32_t channel = data[block + 24 + i * 16 + 3] & 0xF;
+					if (file.colorModel == ColorModelETC1S) {
+						file.alpha |= (channel == channelETC1SAAA);
+					}
+					if (file.colorModel == ColorModelUASTC) {
+						file.alpha |= (channel == channelUASTCRGBA) || (channel == channelUASTCRRRG);
+					}
+				}
+			}
+			if (file.format != VK_FORMAT_UNDEFINED) {
+				file.srgb = isSrgbFormat(file.format);
+			}
+
+			if (sgdLength > 0) {
+				if ((sgdOffset > data.size()) || (sgdLength > data.size() - sgdOffset)) {
+					error = "supercompression global data is out of bounds";
+					return false;
+				}
+				file.globalDataOffset = sgdOffset;
+				file.globalDataSize = sgdLength;
+			}
+
+			file.data = std::move(data);
+			return true;
+		}
+
+		bool readFile(const std::string& filename, File& file, std::string& error)
+		{
+			std::vector<uint8_t> data;
+#if defined(__ANDROID__)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+			if (!asset) {
+				error = "could not open " + filename;
+				return false;
+			}
+			data.resize(AAsset_getLength(asset));
+			AAsset_read(asset, data.data(), data.size());
+			AAsset_close(asset);
+#else
+			std::ifstream is(filename, std::ios::binary | std::ios::ate);
+			if (!is.is_open()) {
+				error = "could not open " + filename;
+				return false;
+			}
+			data.resize(static_cast<size_t>(is.tellg()));
+			is.seekg(0, std::ios::beg);
+			is.read(reinterpret_cast<char*>(data.data()), data.size());
+#endif
+			return parse(std::move(data), file, error);
+		}
+
+		VkFormat selectTranscodeTarget(VkPhysicalDevice physicalDevice, bool srgb, bool alpha)
+		{
+			// Pairs of unorm and sRGB formats, BC3 and ETC2 RGBA only pay off over their smaller opaque counterparts if there is alpha
+			const std::vector<std::pair<VkFormat, VkFormat>> withAlpha = {
+				{ VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK },
+				{ VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK },
+				{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK },
+				{ VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK },
+			};
+			const std::vector<std::pair<VkFormat, VkFormat>> opaque = {
+				{ VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK },
+				{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK },
+				{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK },
+				{ VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK },
+			};
+			for (const auto& [unorm, srgbFormat] : (alpha ? withAlpha : opaque)) {
+				const VkFormat format = srgb ? srgbFormat : unorm;
+				if (formatSupported(physicalDevice, format)) {
+					return format;
+				}
+			}
+			return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
+
+#if defined(VKS_BASISU)
+		static basist::transcoder_texture_format transcoderFormat(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFBC7_RGBA;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFBC3_RGBA;
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFBC1_RGB;
+			case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+			case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+			case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+			case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFETC2_RGBA;
+			// ETC1 is a subset of ETC2 RGB
+			case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+			case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+				return basist::transcoder_texture_format::cTFETC1_RGB;
+			default:
+				return basist::transcoder_texture_format::cTFRGBA32;
+			}
+		}
+
+		// Transcodes every image of every level as a separate job, the transcoder takes care of the BasisLZ and zstd supercompression
+		static bool transcodeImages(const File& file, VkFormat targetFormat, JobSystem* jobSystem, std::vector<std::vector<uint8_t>>& transcoded, std::string& error)
+		{
+			static std::once_flag initFlag;
+			std::call_once(initFlag, basist::basisu_transcoder_init);
+
+			// Decodes the header and the BasisLZ codebooks once, the images are then transcoded with a separate state per job
+			basist::ktx2_transcoder transcoder;
+			if (!transcoder.init(file.data.data(), static_cast<uint32_t>(file.data.size())) || !transcoder.start_transcoding()) {
+				error = "invalid Basis Universal payload";
+				return false;
+			}
+
+			const basist::transcoder_texture_format format = transcoderFormat(targetFormat);
+			const bool uncompressed = basist::basis_transcoder_format_is_uncompressed(format);
+			const uint32_t bytesPerBlock = basist::basis_get_bytes_per_block_or_pixel(format);
+			const uint32_t imageCount = file.imageCount();
+			transcoded.resize(file.levels.size() * imageCount);
+			std::vector<uint8_t> imageFailed(transcoded.size(), 0);
+			forEach(jobSystem, static_cast<uint32_t>(transcoded.size()), [&](uint32_t begin, uint32_t end) {
+				basist::ktx2_transcoder_state state;
+				for (uint32_t i = begin; i < end; i++) {
+					const uint32_t level = i / imageCount;
+					const uint32_t image = i % imageCount;
+					const uint32_t width = std::max(1u, file.width >> level);
+					const uint32_t height = std::max(1u, std::max(file.height, 1u) >> level);
+					const uint32_t size = uncompressed ? width * height : ((width + 3) / 4) * ((height + 3) / 4);
+					transcoded[i].resize(static_cast<size_t>(size) * bytesPerBlock);
+					imageFailed[i] = !transcoder.transcode_image_level(level, image / file.faceCount, image % file.faceCount, transcoded[i].data(), size, format, 0, 0, 0, -1, -1, &state);
+				}
+			});
+			for (size_t i = 0; i < imageFailed.size(); i++) {
+				if (imageFailed[i]) {
+					error = "could not transcode level " + std::to_string(i / imageCount) + " image " + std::to_string(i % imageCount);
+					return false;
+				}
+			}
+			return true;
+		}
+#endif
+
+		bool transcoderAvailable()
+		{
+#if defined(VKS_BASISU)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		bool prepareUpload(const File& file, VkPhysicalDevice physicalDevice, JobSystem* jobSystem, UploadData& uploadData, std::string& error)
+		{
+			if (file.depth > 1) {
+				error = "3D textures are not supported";
+				return false;
+			}
+			if ((file.supercompressionScheme != SupercompressionNone) && (file.supercompressionScheme != SupercompressionBasisLZ) && (file.supercompressionScheme != SupercompressionZstd) && (file.supercompressionScheme != SupercompressionZlib)) {
+				error = "unknown supercompression scheme " + std::to_string(file.supercompressionScheme);
+				return false;
+			}
+
+			const bool transcode = file.needsTranscoding();
+			VkFormat targetFormat = file.format;
+			if (transcode) {
+				if (!transcoderAvailable()) {
+					error = "Basis Universal payloads need the transcoder in external/basisu";
+					return false;
+				}
+				targetFormat = selectTranscodeTarget(physicalDevice, file.srgb, file.alpha);
+			} else if (!formatSupported(physicalDevice, targetFormat)) {
+				error = "format " + formatName(targetFormat) + " can't be sampled on this device";
+				return false;
+			}
+#if !defined(VKS_ZSTD)
+			if (file.supercompressionScheme == SupercompressionZstd) {
+				error = "zstd supercompression needs zstd in external/basisu";
+				return false;
+			}
+#endif
+
+			const uint32_t levelCount = static_cast<uint32_t>(file.levels.size());
+			const uint32_t imageCount = file.imageCount();
+
+			// Decompress zlib and zstd supercompressed levels that are uploaded as stored, other levels are used in place
+			std::vector<std::vector<uint8_t>> inflated(levelCount);
+			std::vector<uint8_t> levelFailed(levelCount, 0);
+			if (!transcode && (file.supercompressionScheme != SupercompressionNone)) {
+				forEach(jobSystem, levelCount, [&](uint32_t begin, uint32_t end) {
+					for (uint32_t i = begin; i < end; i++) {
+						const File::Level& level = file.levels[i];
+						inflated[i].resize(level.uncompressedSize);
+						size_t size = 0;
+						if (file.supercompressionScheme == SupercompressionZlib) {
+							const int result = stbi_zlib_decode_buffer(reinterpret_cast<char*>(inflated[i].data()), static_cast<int>(inflated[i].size()), reinterpret_cast<const char*>(file.data.data() + level.offset), static_cast<int>(level.size));
+							size = (result < 0) ? 0 : static_cast<size_t>(result);
+						}
+#if defined(VKS_ZSTD)
+						if (file.supercompressionScheme == SupercompressionZstd) {
+							const size_t result = ZSTD_decompress(inflated[i].data(), inflated[i].size(), file.data.data() + level.offset, static_cast<size_t>(level.size));
+							size = ZSTD_isError(result) ? 0 : result;
+						}
+#endif
+						levelFailed[i] = (size != level.uncompressedSize);
+					}
+				});
+				for (uint32_t i = 0; i < levelCount; i++) {
+					if (levelFailed[i]) {
+						error = "could not decompress level " + std::to_string(i);
+						return false;
+					}
+				}
+			}
+			auto levelData = [&](uint32_t level) -> std::pair<const uint8_t*, size_t> {
+				if (!inflated[level].empty()) {
+					return { inflated[level].data(), inflated[level].size() };
+				}
+				return { file.data.data() + file.levels[level].offset, static_cast<size_t>(file.levels[level].size) };
+			};
+
+			std::vector<std::vector<uint8_t>> transcoded;
+#if defined(VKS_BASISU)
+			if (transcode && !transcodeImages(file, targetFormat, jobSystem, transcoded, error)) {
+				return false;
+			}
+#endif
+
+			// Pack all images into a single buffer, offsets are aligned for block compressed formats
+			uploadData.format = targetFormat;
+			uploadData.sourceFormat = file.format;
+			uploadData.transcoded = transcode;
+			uploadData.width = file.width;
+			uploadData.height = std::max(file.height, 1u);
+			uploadData.mipLevels = levelCount;
+			uploadData.layerCount = imageCount;
+			uploadData.data.clear();
+			uploadData.copyRegions.clear();
+			for (uint32_t level = 0; level < levelCount; level++) {
+				const auto [data, size] = levelData(level);
+				const size_t imageSize = size / imageCount;
+				for (uint32_t image = 0; image < imageCount; image++) {
+					const uint8_t* src = transcode ? transcoded[level * imageCount + image].data() : data + image * imageSize;
+					const size_t srcSize = transcode ? transcoded[level * imageCount + image].size() : imageSize;
+					const size_t offset = (uploadData.data.size() + 15) & ~static_cast<size_t>(15);
+					uploadData.data.resize(offset + srcSize);
+					memcpy(uploadData.data.data() + offset, src, srcSize);
+					VkBufferImageCopy region{};
+					region.bufferOffset = offset;
+					region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					region.imageSubresource.mipLevel = level;
+					region.imageSubresource.baseArrayLayer = image;
+					region.imageSubresource.layerCount = 1;
+					region.imageExtent.width = std::max(1u, uploadData.width >> level);
+					region.imageExtent.height = std::max(1u, uploadData.height >> level);
+					region.imageExtent.depth = 1;
+					uploadData.copyRegions.push_back(region);
+				}
+			}
+			return true;
+		}
+
+		std::string formatName(VkFormat format)
+		{
+			switch (format) {
+			case VK_FORMAT_R8G8B8A8_UNORM: return "RGBA8";
+			case VK_FORMAT_R8G8B8A8_SRGB: return "RGBA8 sRGB";
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return "BC1";
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return "BC1 sRGB";
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return "BC1A";
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return "BC1A sRGB";
+			case VK_FORMAT_BC3_UNORM_BLOCK: return "BC3";
+			case VK_FORMAT_BC3_SRGB_BLOCK: return "BC3 sRGB";
+			case VK_FORMAT_BC4_UNORM_BLOCK: return "BC4";
+			case VK_FORMAT_BC5_UNORM_BLOCK: return "BC5";
+			case VK_FORMAT_BC7_UNORM_BLOCK: return "BC7";
+			case VK_FORMAT_BC7_SRGB_BLOCK: return "BC7 sRGB";
+			case VK_FORMAT_ASTC_4x4_UNORM_BLOCK: return "ASTC 4x4";
+			case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: return "ASTC 4x4 sRGB";
+			case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK: return "ETC2 RGB";
+			case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK: return "ETC2 RGB sRGB";
+			case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK: return "ETC2 RGBA";
+			case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK: return "ETC2 RGBA sRGB";
+			case VK_FORMAT_UNDEFINED: return "Basis";
+			default: return "VkFormat " + std::to_string(static_cast<uint32_t>(format));
+			}
+		}
+	}
+}
@@ -0,0 +1,116 @@
+/*
+* KTX2 texture container loading
+*
+* Reads KTX 2.0 files (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html) into data that can be uploaded with a single buffer to image copy
+* The KTX library in external/ktx only reads KTX 1.1 files, so the container is parsed here
+* Uncompressed and zlib/zstd supercompressed payloads are read directly, Basis Universal payloads (BasisLZ/ETC1S and UASTC) are transcoded to the best format supported by the device
+* Transcoding and zstd supercompression need the Basis Universal transcoder (https://github.com/BinomialLLC/basis_universal) in external/basisu, which is built into the base library if present (see base/CMakeLists.txt)
+* Levels and faces are decompressed and transcoded in parallel if a job system is passed
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "jobsystem.hpp"
+
+namespace vks
+{
+	namespace ktx2
+	{
+		enum SupercompressionScheme {
+			SupercompressionNone = 0,
+			SupercompressionBasisLZ = 1,
+			SupercompressionZstd = 2,
+			SupercompressionZlib = 3
+		};
+
+		/** @brief Color models of the data format descriptor that are used for Basis Universal payloads */
+		enum ColorModel {
+			ColorModelETC1S = 163,
+			ColorModelUASTC = 166
+		};
+
+		/** @brief Parsed KTX2 file, levels are byte ranges in data */
+		struct File {
+			VkFormat format{ VK_FORMAT_UNDEFINED };
+			uint32_t width{ 0 };
+			uint32_t height{ 0 };
+			uint32_t depth{ 0 };
+			uint32_t layerCount{ 0 };
+			uint32_t faceCount{ 1 };
+			uint32_t levelCount{ 0 };
+			uint32_t supercompressionScheme{ SupercompressionNone };
+			/** @brief Color model, transfer function and alpha presence from the basic data format descriptor block */
+			uint32_t colorModel{ 0 };
+			bool srgb{ false };
+			bool alpha{ false };
+			struct Level {
+				uint64_t offset;
+				uint64_t size;
+				uint64_t uncompressedSize;
+			};
+			std::vector<Level> levels;
+			/** @brief Range of the supercompression global data (BasisLZ codebooks) in data, empty for other schemes */
+			uint64_t globalDataOffset{ 0 };
+			uint64_t globalDataSize{ 0 };
+			std::vector<uint8_t> data;
+
+			/** @brief Basis Universal payloads need to be transcoded into a format the device supports */
+			bool needsTranscoding() const { return (supercompressionScheme == SupercompressionBasisLZ) || (colorModel == ColorModelUASTC); }
+			/** @brief Number of images per level (array layers times cube faces) */
+			uint32_t imageCount() const { return std::max(layerCount, 1u) * faceCount; }
+		};
+
+		/** @brief Image data ready to be copied to a VkImage from a single buffer, buffer offsets are relative to the start of data */
+		struct UploadData {
+			VkFormat format{ VK_FORMAT_UNDEFINED };
+			uint32_t width{ 0 };
+			uint32_t height{ 0 };
+			uint32_t mipLevels{ 1 };
+			uint32_t layerCount{ 1 };
+			/** @brief Format of the payload in the file, VK_FORMAT_UNDEFINED for Basis Universal payloads */
+			VkFormat sourceFormat{ VK_FORMAT_UNDEFINED };
+			bool transcoded{ false };
+			std::vector<uint8_t> data;
+			std::vector<VkBufferImageCopy> copyRegions;
+		};
+
+		/** @brief Returns true if the file name has the .ktx2 extension */
+		bool isKtx2File(const std::string& filename);
+		/** @brief Parses a KTX2 file from memory, the data is moved into the file */
+		bool parse(std::vector<uint8_t>&& data, File& file, std::string& error);
+		/** @brief Reads and parses a KTX2 file (from the asset manager on Android) */
+		bool readFile(const std::string& filename, File& file, std::string& error);
+		/**
+		* Picks the best block compressed format the device can sample from for transcoding, in order of preference BC7, BC3/BC1, ASTC 4x4, ETC2 and uncompressed RGBA8 as the last resort
+		*
+		* @param physicalDevice Device to check format support with vkGetPhysicalDeviceFormatProperties
+		* @param srgb Select the sRGB variant of the format
+		* @param alpha The image has an alpha channel, formats without alpha (BC1, ETC2 RGB) are skipped
+		*/
+		VkFormat selectTranscodeTarget(VkPhysicalDevice physicalDevice, bool srgb, bool alpha);
+		/** @brief Returns true if the Basis Universal transcoder has been built in, Basis Universal payloads can't be loaded otherwise */
+		bool transcoderAvailable();
+		/**
+		* Converts a parsed file into upload data, decompressing and transcoding the images as required
+		*
+		* @param file Parsed KTX2 file
+		* @param physicalDevice Device used to select the transcode target and check format support
+		* @param jobSystem (Optional) Job system to process levels and faces in parallel, processed on the calling thread if null
+		* @param uploadData Resulting image data
+		* @param error Error message if false is returned
+		*/
+		bool prepareUpload(const File& file, VkPhysicalDevice physicalDevice, JobSystem* jobSystem, UploadData& uploadData, std::string& error);
+		/** @brief Short name of the formats used by KTX2 textures, for load reports */
+		std::string formatName(VkFormat format);
+	}
+}
@@ -0,0 +1,530 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates buffers and images from large device memory blocks instead of allocating device memory for each resource
+*
+* Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanMemoryAllocator.h"
+#include "VulkanTools.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iomanip>
+
+namespace vks
+{
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	/*
+		Device memory block that is split into ranges
+		Free ranges are kept in segregated lists (two level segregated fit), the first level is the power of two of the range size,
+		the second level splits each power of two into 16 linear steps, bitmasks are used to find a non-empty list in constant time
+	*/
+	struct MemoryBlock
+	{
+		static constexpr uint32_t slLog2 = 4;
+		static constexpr uint32_t slCount = 1 << slLog2;
+		static constexpr uint32_t flCount = 64 - slLog2 + 1;
+		static constexpr uint32_t noRange = UINT32_MAX;
+
+		struct Range
+		{
+			VkDeviceSize offset{ 0 };
+			VkDeviceSize size{ 0 };
+			// Neighbouring ranges in memory
+			uint32_t prevPhysical{ noRange };
+			uint32_t nextPhysical{ noRange };
+			// Neighbouring ranges in the free list this range is stored in
+			uint32_t prevFree{ noRange };
+			uint32_t nextFree{ noRange };
+			bool free{ false };
+		};
+
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		VkDeviceSize size{ 0 };
+		uint8_t* mapped{ nullptr };
+		uint32_t memoryTypeIndex{ 0 };
+		VkDeviceSize usedBytes{ 0 };
+		uint32_t allocationCount{ 0 };
+
+		std::vector<Range> ranges;
+		// Indices of range entries that are no longer in use and can be recycled
+		std::vector<uint32_t> unusedRanges;
+		uint32_t firstRange{ 0 };
+		uint64_t flBitmap{ 0 };
+		std::array<uint32_t, flCount> slBitmap{};
+		std::array<std::array<uint32_t, slCount>, flCount> freeLists;
+
+		MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void* mapped, uint32_t memoryTypeIndex) : memory(memory), size(size), mapped(static_cast<uint8_t*>(mapped)), memoryTypeIndex(memoryTypeIndex)
+		{
+			for (auto& lists : freeLists) {
+				lists.fill(noRange);
+			}
+			ranges.push_back({ .offset = 0, .size = size });
+			insertFree(0);
+		}
+
+		static void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+		{
+			if (size < slCount) {
+				fl = 0;
+				sl = static_cast<uint32_t>(size);
+				return;
+			}
+			const uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+			fl = msb - slLog2 + 1;
+			sl = static_cast<uint32_t>(size >> (msb - slLog2)) - slCount;
+		}
+
+		uint32_t newRange()
+		{
+			if (!unusedRanges.empty()) {
+				uint32_t index = unusedRanges.back();
+				unusedRanges.pop_back();
+				ranges[index] = {};
+				return index;
+			}
+			ranges.push_back({});
+			return static_cast<uint32_t>(ranges.size() - 1);
+		}
+
+		void insertFree(uint32_t index)
+		{
+			uint32_t fl, sl;
+			mapping(ranges[index].size, fl, sl);
+			Range& range = ranges[index];
+			range.free = true;
+			range.prevFree = noRange;
+			range.nextFree = freeLists[fl][sl];
+			if (range.nextFree != noRange) {
+				ranges[range.nextFree].prevFree = index;
+			}
+			freeLists[fl][sl] = index;
+			flBitmap |= 1ull << fl;
+			slBitmap[fl] |= 1u << sl;
+		}
+
+		void removeFree(uint32_t index)
+		{
+			uint32_t fl, sl;
+			mapping(ranges[index].size, fl, sl);
+			Range& range = ranges[index];
+			if (range.prevFree != noRange) {
+				ranges[range.prevFree].nextFree = range.nextFree;
+			} else {
+				freeLists[fl][sl] = range.nextFree;
+			}
+			if (range.nextFree != noRange) {
+				ranges[range.nextFree].prevFree = range.prevFree;
+			}
+			if (freeLists[fl][sl] == noRange) {
+				slBitmap[fl] &= ~(1u << sl);
+				if (slBitmap[fl] == 0) {
+					flBitmap &= ~(1ull << fl);
+				}
+			}
+			range.free = false;
+		}
+
+		// Returns a free range that is at least size bytes large
+		uint32_t findFree(VkDeviceSize size) const
+		{
+			// Round up to the next list, so that every range in the list found is large enough
+			if (size >= slCount) {
+				size += (1ull << (std::bit_width(size) - 1 - slLog2)) - 1;
+			}
+			uint32_t fl, sl;
+			mapping(size, fl, sl);
+			if (fl >= flCount) {
+				return noRange;
+			}
+			uint32_t slMap = slBitmap[fl] & (~0u << sl);
+			if (slMap == 0) {
+				const uint64_t flMap = (fl + 1 < 64) ? (flBitmap & (~0ull << (fl + 1))) : 0;
+				if (flMap == 0) {
+					return noRange;
+				}
+				fl = static_cast<uint32_t>(std::countr_zero(flMap));
+				slMap = slBitmap[fl];
+			}
+			sl = static_cast<uint32_t>(std::countr_zero(slMap));
+			return freeLists[fl][sl];
+		}
+
+		// Split the end of a range off into a new free range
+		void split(uint32_t index, VkDeviceSize size)
+		{
+			uint32_t remainder = newRange();
+			Range& range = ranges[index];
+			ranges[remainder] = {
+				.offset = range.offset + size,
+				.size = range.size - size,
+				.prevPhysical = index,
+				.nextPhysical = range.nextPhysical,
+			};
+			if (range.nextPhysical != noRange) {
+				ranges[range.nextPhysical].prevPhysical = remainder;
+			}
+			range.nextPhysical = remainder;
+			range.size = size;
+			insertFree(remainder);
+		}
+
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& rangeIndex)
+		{
+			uint32_t index = findFree(size + alignment - 1);
+			if (index == noRange) {
+				return false;
+			}
+			removeFree(index);
+			const VkDeviceSize padding = alignUp(ranges[index].offset, alignment) - ranges[index].offset;
+			if (padding > 0) {
+				// Keep the padding in front of the allocation as a free range of its own
+				split(index, padding);
+				uint32_t aligned = ranges[index].nextPhysical;
+				removeFree(aligned);
+				insertFree(index);
+				index = aligned;
+			}
+			if (ranges[index].size > size) {
+				split(index, size);
+			}
+			usedBytes += size;
+			allocationCount++;
+			offset = ranges[index].offset;
+			rangeIndex = index;
+			return true;
+		}
+
+		void free(uint32_t index)
+		{
+			usedBytes -= ranges[index].size;
+			allocationCount--;
+			// Merge with free neighbours
+			uint32_t next = ranges[index].nextPhysical;
+			if ((next != noRange) && ranges[next].free) {
+				removeFree(next);
+				ranges[index].size += ranges[next].size;
+				ranges[index].nextPhysical = ranges[next].nextPhysical;
+				if (ranges[next].nextPhysical != noRange) {
+					ranges[ranges[next].nextPhysical].prevPhysical = index;
+				}
+				unusedRanges.push_back(next);
+			}
+			uint32_t prev = ranges[index].prevPhysical;
+			if ((prev != noRange) && ranges[prev].free) {
+				removeFree(prev);
+				ranges[prev].size += ranges[index].size;
+				ranges[prev].nextPhysical = ranges[index].nextPhysical;
+				if (ranges[index].nextPhysical != noRange) {
+					ranges[ranges[index].nextPhysical].prevPhysical = prev;
+				}
+				unusedRanges.push_back(index);
+				index = prev;
+			}
+			insertFree(index);
+		}
+
+		void getFreeRanges(uint32_t& count, VkDeviceSize& largest) const
+		{
+			for (uint32_t index = firstRange; index != noRange; index = ranges[index].nextPhysical) {
+				if (ranges[index].free) {
+					count++;
+					largest = std::max(largest, ranges[index].size);
+				}
+			}
+		}
+	};
+
+	// Defined here as MemoryBlock is only complete in this file
+	MemoryAllocator::MemoryAllocator() = default;
+	MemoryAllocator::~MemoryAllocator() = default;
+
+	/**
+	* Prepare the allocator for use
+	*
+	* @param device Logical device to allocate memory from
+	* @param memoryProperties Memory types and heaps of the physical device
+	* @param limits Limits of the physical device
+	* @param (Optional) blockSize Size of the memory blocks resources are sub-allocated from
+	*/
+	void MemoryAllocator::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits, VkDeviceSize blockSize)
+	{
+		this->device = device;
+		this->memoryProperties = memoryProperties;
+		this->limits = limits;
+		this->blockSize = blockSize;
+		pools.resize(memoryProperties.memoryTypeCount * resourceTypeCount);
+		dedicatedCount.resize(memoryProperties.memoryTypeCount, 0);
+		dedicatedBytes.resize(memoryProperties.memoryTypeCount, 0);
+	}
+
+	/**
+	* Release all memory blocks and linear pools
+	*
+	* @note Dedicated allocations that have not been freed are not tracked and can't be released here
+	*/
+	void MemoryAllocator::destroy()
+	{
+		for (auto& pool : pools) {
+			for (auto& block : pool) {
+				freeDeviceMemory(block->memory);
+			}
+			pool.clear();
+		}
+		for (auto& linearPool : linearPools) {
+			freeDeviceMemory(linearPool->memory);
+		}
+		linearPools.clear();
+	}
+
+	// Small heaps (e.g. host visible device local memory) use smaller blocks, so a single block doesn't take up a large part of them
+	VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+	{
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		return std::min(blockSize, std::bit_floor(heapSize / 8));
+	}
+
+	VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, ResourceType resourceType, void** mapped)
+	{
+		VkMemoryAllocateInfo memAlloc{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = size,
+			.memoryTypeIndex = memoryTypeIndex
+		};
+		// Buffers with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT need memory allocated with the appropriate flag
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (resourceType == ResourceType::BufferDeviceAddress) {
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+			memAlloc.pNext = &allocFlagsInfo;
+		}
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &memory));
+		deviceMemoryCount++;
+		*mapped = nullptr;
+		// Host visible memory stays mapped for its whole lifetime
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			VK_CHECK_RESULT(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped));
+		}
+		return memory;
+	}
+
+	void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory)
+	{
+		vkFreeMemory(device, memory, nullptr);
+		deviceMemoryCount--;
+	}
+
+	/**
+	* Allocate device memory for a resource
+	*
+	* @param memoryRequirements Memory requirements of the resource
+	* @param memoryTypeIndex Memory type to allocate from
+	* @param resourceType Type of the resource the memory is bound to
+	* @param (Optional) dedicated If true, the resource gets a device memory object of its own (large resources always do)
+	*
+	* @return Memory object and offset the resource needs to be bound at
+	*/
+	MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, ResourceType resourceType, bool dedicated)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		VkDeviceSize size = memoryRequirements.size;
+		VkDeviceSize alignment = memoryRequirements.alignment;
+		// Flushing and invalidating ranges of non-coherent memory works on multiples of the atom size
+		const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			alignment = std::max(alignment, limits.nonCoherentAtomSize);
+			size = alignUp(size, limits.nonCoherentAtomSize);
+		}
+
+		MemoryAllocation allocation{ .size = size, .memoryTypeIndex = memoryTypeIndex };
+
+		const VkDeviceSize poolBlockSize = getBlockSize(memoryTypeIndex);
+		if (dedicated || (size > poolBlockSize / 2)) {
+			allocation.memory = allocateDeviceMemory(size, memoryTypeIndex, resourceType, &allocation.mapped);
+			allocation.dedicated = true;
+			dedicatedCount[memoryTypeIndex]++;
+			dedicatedBytes[memoryTypeIndex] += size;
+			return allocation;
+		}
+
+		auto& pool = pools[memoryTypeIndex * resourceTypeCount + static_cast<uint32_t>(resourceType)];
+		MemoryBlock* block{ nullptr };
+		for (auto& candidate : pool) {
+			if ((candidate->size - candidate->usedBytes >= size) && candidate->allocate(size, alignment, allocation.offset, allocation.range)) {
+				block = candidate.get();
+				break;
+			}
+		}
+		if (!block) {
+			void* mapped{ nullptr };
+			VkDeviceMemory memory = allocateDeviceMemory(poolBlockSize, memoryTypeIndex, resourceType, &mapped);
+			pool.push_back(std::make_unique<MemoryBlock>(memory, poolBlockSize, mapped, memoryTypeIndex));
+			block = pool.back().get();
+			// A fresh block is at least as large as the request, so this can't fail
+			[[maybe_unused]] const bool allocated = block->allocate(size, alignment, allocation.offset, allocation.range);
+			assert(allocated);
+		}
+		allocation.block = block;
+		allocation.memory = block->memory;
+		if (block->mapped) {
+			allocation.mapped = block->mapped + allocation.offset;
+		}
+		return allocation;
+	}
+
+	/**
+	* Return an allocation to the allocator
+	*
+	* @note The resource bound to the allocation must have been destroyed and no longer be in use by the device
+	*/
+	void MemoryAllocator::free(MemoryAllocation& allocation)
+	{
+		if (allocation.memory == VK_NULL_HANDLE) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		if (allocation.dedicated) {
+			freeDeviceMemory(allocation.memory);
+			dedicatedCount[allocation.memoryTypeIndex]--;
+			dedicatedBytes[allocation.memoryTypeIndex] -= allocation.size;
+		} else if (allocation.block) {
+			MemoryBlock* block = allocation.block;
+			block->free(allocation.range);
+			// Release empty blocks, but keep one per pool around to avoid allocating and freeing blocks over and over
+			if (block->allocationCount == 0) {
+				for (auto& pool : pools) {
+					auto it = std::find_if(pool.begin(), pool.end(), [block](const std::unique_ptr<MemoryBlock>& candidate) { return candidate.get() == block; });
+					if (it != pool.end()) {
+						if (pool.size() > 1) {
+							freeDeviceMemory(block->memory);
+							pool.erase(it);
+						}
+						break;
+					}
+				}
+			}
+		}
+		allocation = {};
+	}
+
+	/**
+	* Create a linear pool for transient allocations
+	*
+	* @param memoryTypeIndex Memory type to allocate the pool from
+	* @param size Size of the pool in bytes
+	*/
+	MemoryAllocator::LinearPool* MemoryAllocator::createLinearPool(uint32_t memoryTypeIndex, VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto pool = std::make_unique<LinearPool>();
+		pool->size = size;
+		pool->memoryTypeIndex = memoryTypeIndex;
+		const VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+			pool->minAlignment = limits.nonCoherentAtomSize;
+		}
+		pool->memory = allocateDeviceMemory(size, memoryTypeIndex, ResourceType::Buffer, &pool->mapped);
+		linearPools.push_back(std::move(pool));
+		return linearPools.back().get();
+	}
+
+	void MemoryAllocator::destroyLinearPool(LinearPool* pool)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = std::find_if(linearPools.begin(), linearPools.end(), [pool](const std::unique_ptr<LinearPool>& candidate) { return candidate.get() == pool; });
+		if (it != linearPools.end()) {
+			freeDeviceMemory(pool->memory);
+			linearPools.erase(it);
+		}
+	}
+
+	/**
+	* Allocate from the linear pool
+	*
+	* @return Allocation with a null memory handle if the pool is full
+	*/
+	MemoryAllocation MemoryAllocator::LinearPool::allocate(const VkMemoryRequirements& memoryRequirements)
+	{
+		const VkDeviceSize offset = alignUp(head, std::max(memoryRequirements.alignment, minAlignment));
+		const VkDeviceSize allocationSize = alignUp(memoryRequirements.size, minAlignment);
+		if ((memoryRequirements.memoryTypeBits & (1u << memoryTypeIndex)) == 0 || (offset + allocationSize > size)) {
+			return {};
+		}
+		head = offset + allocationSize;
+		MemoryAllocation allocation{ .memory = memory, .offset = offset, .size = allocationSize, .memoryTypeIndex = memoryTypeIndex };
+		if (mapped) {
+			allocation.mapped = static_cast<uint8_t*>(mapped) + offset;
+		}
+		return allocation;
+	}
+
+	/** @brief Release all allocations of the pool, the device must no longer use any of them */
+	void MemoryAllocator::LinearPool::reset()
+	{
+		head = 0;
+	}
+
+	/**
+	* Write the memory usage per heap and memory type to a stream
+	*/
+	void MemoryAllocator::printStatistics(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const double toMB = 1.0 / (1024.0 * 1024.0);
+		stream << std::fixed << std::setprecision(2);
+		stream << "Device memory statistics" << "\n";
+		stream << "Device memory objects: " << deviceMemoryCount << " of " << limits.maxMemoryAllocationCount << " allowed" << "\n";
+
+		std::vector<VkDeviceSize> heapUsage(memoryProperties.memoryHeapCount, 0);
+		for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++) {
+			uint32_t blockCount{ 0 }, allocationCount{ 0 }, freeRangeCount{ 0 };
+			VkDeviceSize blockBytes{ 0 }, usedBytes{ 0 }, largestFreeRange{ 0 };
+			for (uint32_t resourceType = 0; resourceType < resourceTypeCount; resourceType++) {
+				for (auto& block : pools[type * resourceTypeCount + resourceType]) {
+					blockCount++;
+					blockBytes += block->size;
+					usedBytes += block->usedBytes;
+					allocationCount += block->allocationCount;
+					block->getFreeRanges(freeRangeCount, largestFreeRange);
+				}
+			}
+			uint32_t linearPoolCount{ 0 };
+			VkDeviceSize linearPoolBytes{ 0 };
+			for (auto& linearPool : linearPools) {
+				if (linearPool->memoryTypeIndex == type) {
+					linearPoolCount++;
+					linearPoolBytes += linearPool->size;
+				}
+			}
+			if ((blockCount == 0) && (dedicatedCount[type] == 0) && (linearPoolCount == 0)) {
+				continue;
+			}
+			heapUsage[memoryProperties.memoryTypes[type].heapIndex] += blockBytes + dedicatedBytes[type] + linearPoolBytes;
+			// Fragmentation is the share of free memory that is not part of the largest free range
+			const VkDeviceSize freeBytes = blockBytes - usedBytes;
+			const double fragmentation = (freeBytes > 0) ? 100.0 * (1.0 - (double)largestFreeRange / (double)freeBytes) : 0.0;
+			stream << "Memory type " << type << " (heap " << memoryProperties.memoryTypes[type].heapIndex << "): "
+				<< blockCount << " blocks (" << blockBytes * toMB << " MB), "
+				<< allocationCount << " sub-allocations (" << usedBytes * toMB << " MB), "
+				<< dedicatedCount[type] << " dedicated (" << dedicatedBytes[type] * toMB << " MB), "
+				<< linearPoolCount << " linear pools (" << linearPoolBytes * toMB << " MB), "
+				<< freeRangeCount << " free ranges, largest " << largestFreeRange * toMB << " MB, fragmentation " << fragmentation << " %" << "\n";
+		}
+		for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+			stream << "Heap " << heap << ((memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "") << ": "
+				<< heapUsage[heap] * toMB << " MB of " << memoryProperties.memoryHeaps[heap].size * toMB << " MB" << "\n";
+		}
+		stream << std::flush;
+	}
+}
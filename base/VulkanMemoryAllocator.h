@@ -0,0 +1,101 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates buffers and images from large device memory blocks instead of allocating device memory for each resource
+*
+* Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	struct MemoryBlock;
+
+	/** @brief Range of device memory handed out by the MemoryAllocator */
+	struct MemoryAllocation
+	{
+		/** @brief Device memory object the range is part of (shared with other allocations unless the allocation is dedicated) */
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		/** @brief Offset of the range inside the device memory object, resources need to be bound at this offset */
+		VkDeviceSize offset{ 0 };
+		VkDeviceSize size{ 0 };
+		/** @brief Host pointer to the start of the range, host visible memory is persistently mapped */
+		void* mapped{ nullptr };
+		uint32_t memoryTypeIndex{ 0 };
+		/** @brief Block and range index of sub-allocations, not set for dedicated and linear allocations */
+		MemoryBlock* block{ nullptr };
+		uint32_t range{ 0 };
+		bool dedicated{ false };
+	};
+
+	/**
+	* @brief Device memory allocator with one pool of memory blocks per memory type and resource type
+	* @note Free ranges inside a block are managed with a two level segregated fit (TLSF) free list
+	* @note Buffers and optimally tiled images are kept in separate blocks, so the buffer image granularity doesn't need to be taken into account
+	*/
+	class MemoryAllocator
+	{
+	public:
+		enum class ResourceType { Buffer, BufferDeviceAddress, Image };
+
+		/**
+		* @brief Bump allocator on a single memory object for transient data
+		* @note Allocations can't be freed individually, reset releases all of them at once (e.g. once per frame)
+		*/
+		struct LinearPool
+		{
+			VkDeviceMemory memory{ VK_NULL_HANDLE };
+			VkDeviceSize size{ 0 };
+			VkDeviceSize head{ 0 };
+			void* mapped{ nullptr };
+			uint32_t memoryTypeIndex{ 0 };
+			// Minimum alignment of allocations (non-coherent atom size for host visible, non-coherent memory)
+			VkDeviceSize minAlignment{ 1 };
+			MemoryAllocation allocate(const VkMemoryRequirements& memoryRequirements);
+			void reset();
+		};
+
+		/** @brief Default size of the blocks that resources are sub-allocated from */
+		static constexpr VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+
+		MemoryAllocator();
+		~MemoryAllocator();
+		void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits, VkDeviceSize blockSize = defaultBlockSize);
+		void destroy();
+		MemoryAllocation allocate(const VkMemoryRequirements& memoryRequirements, uint32_t memoryTypeIndex, ResourceType resourceType, bool dedicated = false);
+		void free(MemoryAllocation& allocation);
+		LinearPool* createLinearPool(uint32_t memoryTypeIndex, VkDeviceSize size);
+		void destroyLinearPool(LinearPool* pool);
+		void printStatistics(std::ostream& stream);
+
+	private:
+		static constexpr uint32_t resourceTypeCount = 3;
+
+		VkDevice device{ VK_NULL_HANDLE };
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		VkPhysicalDeviceLimits limits{};
+		VkDeviceSize blockSize{ defaultBlockSize };
+		std::mutex mutex;
+		// One list of blocks per memory type and resource type
+		std::vector<std::vector<std::unique_ptr<MemoryBlock>>> pools;
+		std::vector<std::unique_ptr<LinearPool>> linearPools;
+		// Dedicated allocations per memory type
+		std::vector<uint32_t> dedicatedCount;
+		std::vector<VkDeviceSize> dedicatedBytes;
+		uint32_t deviceMemoryCount{ 0 };
+
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+		VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, ResourceType resourceType, void** mapped);
+		void freeDeviceMemory(VkDeviceMemory memory);
+	};
+}
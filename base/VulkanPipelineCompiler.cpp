@@ -0,0 +1,523 @@
+/*
+* Vulkan pipeline compiler
+*
+* Compiles graphics and compute pipelines on worker threads against a shared pipeline cache and deduplicates identical requests
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanPipelineCompiler.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+#include "VulkanTools.h"
+
+namespace vks
+{
+	// Appends the bytes of a value to a cache key, keys are compared as a whole so there are no false hits on hash collisions
+	template<typename T>
+	static void appendKey(std::string& key, const T& value)
+	{
+		key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static void appendKey(std::string& key, const std::vector<T>& values)
+	{
+		appendKey(key, values.size());
+		key.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	static uint64_t microsecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	/** @brief Copy of a shader stage including its entry point name and specialization constants */
+	struct ShaderStage
+	{
+		VkPipelineShaderStageCreateInfo stage{};
+		std::string name;
+		VkSpecializationInfo specializationInfo{};
+		std::vector<VkSpecializationMapEntry> mapEntries;
+		std::vector<uint8_t> data;
+
+		bool copy(const VkPipelineShaderStageCreateInfo& source)
+		{
+			if (source.pNext != nullptr) {
+				return false;
+			}
+			stage = source;
+			name = source.pName;
+			stage.pName = name.c_str();
+			if (source.pSpecializationInfo) {
+				const VkSpecializationInfo& info = *source.pSpecializationInfo;
+				mapEntries.assign(info.pMapEntries, info.pMapEntries + info.mapEntryCount);
+				data.assign(static_cast<const uint8_t*>(info.pData), static_cast<const uint8_t*>(info.pData) + info.dataSize);
+				specializationInfo = { static_cast<uint32_t>(mapEntries.size()), mapEntries.data(), data.size(), data.data() };
+				stage.pSpecializationInfo = &specializationInfo;
+			}
+			return true;
+		}
+
+		void appendKey(std::string& key) const
+		{
+			vks::appendKey(key, stage.flags);
+			vks::appendKey(key, stage.stage);
+			vks::appendKey(key, stage.module);
+			key.append(name.c_str(), name.size() + 1);
+			for (const VkSpecializationMapEntry& entry : mapEntries) {
+				vks::appendKey(key, entry.constantID);
+				vks::appendKey(key, entry.offset);
+				vks::appendKey(key, entry.size);
+			}
+			vks::appendKey(key, data);
+		}
+	};
+
+	/** @brief Deep copy of a graphics pipeline create info, the create info's pointers point into this structure */
+	struct PipelineCompiler::Entry::GraphicsState
+	{
+		VkGraphicsPipelineCreateInfo createInfo{};
+		std::vector<ShaderStage> shaderStages;
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		VkPipelineVertexInputStateCreateInfo vertexInputState{};
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState{};
+		VkPipelineTessellationStateCreateInfo tessellationState{};
+		VkPipelineViewportStateCreateInfo viewportState{};
+		std::vector<VkViewport> viewports;
+		std::vector<VkRect2D> scissors;
+		VkPipelineRasterizationStateCreateInfo rasterizationState{};
+		VkPipelineMultisampleStateCreateInfo multisampleState{};
+		std::vector<VkSampleMask> sampleMask;
+		VkPipelineDepthStencilStateCreateInfo depthStencilState{};
+		VkPipelineColorBlendStateCreateInfo colorBlendState{};
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		std::vector<VkDynamicState> dynamicStates;
+		VkPipelineRenderingCreateInfo renderingInfo{};
+		std::vector<VkFormat> colorAttachmentFormats;
+
+		/** @brief Copies the create info, returns false if it contains structures that can't be copied */
+		bool copy(const VkGraphicsPipelineCreateInfo& source)
+		{
+			createInfo = source;
+			createInfo.pNext = nullptr;
+			for (const VkBaseInStructure* next = static_cast<const VkBaseInStructure*>(source.pNext); next != nullptr; next = next->pNext) {
+				if (next->sType != VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO) {
+					return false;
+				}
+				renderingInfo = *reinterpret_cast<const VkPipelineRenderingCreateInfo*>(next);
+				renderingInfo.pNext = nullptr;
+				colorAttachmentFormats.assign(renderingInfo.pColorAttachmentFormats, renderingInfo.pColorAttachmentFormats + renderingInfo.colorAttachmentCount);
+				renderingInfo.pColorAttachmentFormats = colorAttachmentFormats.data();
+				createInfo.pNext = &renderingInfo;
+			}
+			shaderStages.resize(source.stageCount);
+			for (uint32_t i = 0; i < source.stageCount; i++) {
+				if (!shaderStages[i].copy(source.pStages[i])) {
+					return false;
+				}
+				stages.push_back(shaderStages[i].stage);
+			}
+			createInfo.pStages = stages.data();
+			if (source.pVertexInputState) {
+				if (source.pVertexInputState->pNext) {
+					return false;
+				}
+				vertexInputState = *source.pVertexInputState;
+				vertexBindings.assign(vertexInputState.pVertexBindingDescriptions, vertexInputState.pVertexBindingDescriptions + vertexInputState.vertexBindingDescriptionCount);
+				vertexAttributes.assign(vertexInputState.pVertexAttributeDescriptions, vertexInputState.pVertexAttributeDescriptions + vertexInputState.vertexAttributeDescriptionCount);
+				vertexInputState.pVertexBindingDescriptions = vertexBindings.data();
+				vertexInputState.pVertexAttributeDescriptions = vertexAttributes.data();
+				createInfo.pVertexInputState = &vertexInputState;
+			}
+			if (source.pInputAssemblyState) {
+				inputAssemblyState = *source.pInputAssemblyState;
+				createInfo.pInputAssemblyState = &inputAssemblyState;
+			}
+			if (source.pTessellationState) {
+				tessellationState = *source.pTessellationState;
+				createInfo.pTessellationState = &tessellationState;
+			}
+			if (source.pViewportState) {
+				viewportState = *source.pViewportState;
+				// Viewports and scissors are ignored if they are dynamic
+				if (viewportState.pViewports) {
+					viewports.assign(viewportState.pViewports, viewportState.pViewports + viewportState.viewportCount);
+					viewportState.pViewports = viewports.data();
+				}
+				if (viewportState.pScissors) {
+					scissors.assign(viewportState.pScissors, viewportState.pScissors + viewportState.scissorCount);
+					viewportState.pScissors = scissors.data();
+				}
+				createInfo.pViewportState = &viewportState;
+			}
+			if (source.pRasterizationState) {
+				rasterizationState = *source.pRasterizationState;
+				createInfo.pRasterizationState = &rasterizationState;
+			}
+			if (source.pMultisampleState) {
+				multisampleState = *source.pMultisampleState;
+				if (multisampleState.pSampleMask) {
+					sampleMask.assign(multisampleState.pSampleMask, multisampleState.pSampleMask + (multisampleState.rasterizationSamples + 31) / 32);
+					multisampleState.pSampleMask = sampleMask.data();
+				}
+				createInfo.pMultisampleState = &multisampleState;
+			}
+			if (source.pDepthStencilState) {
+				depthStencilState = *source.pDepthStencilState;
+				createInfo.pDepthStencilState = &depthStencilState;
+			}
+			if (source.pColorBlendState) {
+				colorBlendState = *source.pColorBlendState;
+				blendAttachments.assign(colorBlendState.pAttachments, colorBlendState.pAttachments + colorBlendState.attachmentCount);
+				colorBlendState.pAttachments = blendAttachments.data();
+				createInfo.pColorBlendState = &colorBlendState;
+			}
+			if (source.pDynamicState) {
+				dynamicState = *source.pDynamicState;
+				dynamicStates.assign(dynamicState.pDynamicStates, dynamicState.pDynamicStates + dynamicState.dynamicStateCount);
+				dynamicState.pDynamicStates = dynamicStates.data();
+				createInfo.pDynamicState = &dynamicState;
+			}
+			// Other structures of the create info state (e.g. rasterization extensions) are not copied
+			for (const void* next : { inputAssemblyState.pNext, tessellationState.pNext, viewportState.pNext, rasterizationState.pNext, multisampleState.pNext, depthStencilState.pNext, colorBlendState.pNext, dynamicState.pNext }) {
+				if (next != nullptr) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/** @brief Builds the cache key field by field, so padding and pointers don't end up in it */
+		std::string key() const
+		{
+			std::string key;
+			appendKey(key, createInfo.flags);
+			appendKey(key, createInfo.layout);
+			appendKey(key, createInfo.renderPass);
+			appendKey(key, createInfo.subpass);
+			appendKey(key, createInfo.basePipelineHandle);
+			appendKey(key, createInfo.basePipelineIndex);
+			appendKey(key, shaderStages.size());
+			for (const ShaderStage& shaderStage : shaderStages) {
+				shaderStage.appendKey(key);
+			}
+			appendKey(key, createInfo.pVertexInputState != nullptr);
+			for (const VkVertexInputBindingDescription& binding : vertexBindings) {
+				appendKey(key, binding.binding);
+				appendKey(key, binding.stride);
+				appendKey(key, binding.inputRate);
+			}
+			for (const VkVertexInputAttributeDescription& attribute : vertexAttributes) {
+				appendKey(key, attribute.location);
+				appendKey(key, attribute.binding);
+				appendKey(key, attribute.format);
+				appendKey(key, attribute.offset);
+			}
+			appendKey(key, createInfo.pInputAssemblyState != nullptr);
+			appendKey(key, inputAssemblyState.topology);
+			appendKey(key, inputAssemblyState.primitiveRestartEnable);
+			appendKey(key, createInfo.pTessellationState != nullptr);
+			appendKey(key, tessellationState.patchControlPoints);
+			appendKey(key, createInfo.pViewportState != nullptr);
+			appendKey(key, viewportState.viewportCount);
+			appendKey(key, viewportState.scissorCount);
+			appendKey(key, viewports);
+			appendKey(key, scissors);
+			appendKey(key, createInfo.pRasterizationState != nullptr);
+			appendKey(key, rasterizationState.depthClampEnable);
+			appendKey(key, rasterizationState.rasterizerDiscardEnable);
+			appendKey(key, rasterizationState.polygonMode);
+			appendKey(key, rasterizationState.cullMode);
+			appendKey(key, rasterizationState.frontFace);
+			appendKey(key, rasterizationState.depthBiasEnable);
+			appendKey(key, rasterizationState.depthBiasConstantFactor);
+			appendKey(key, rasterizationState.depthBiasClamp);
+			appendKey(key, rasterizationState.depthBiasSlopeFactor);
+			appendKey(key, rasterizationState.lineWidth);
+			appendKey(key, createInfo.pMultisampleState != nullptr);
+			appendKey(key, multisampleState.rasterizationSamples);
+			appendKey(key, multisampleState.sampleShadingEnable);
+			appendKey(key, multisampleState.minSampleShading);
+			appendKey(key, sampleMask);
+			appendKey(key, multisampleState.alphaToCoverageEnable);
+			appendKey(key, multisampleState.alphaToOneEnable);
+			appendKey(key, createInfo.pDepthStencilState != nullptr);
+			appendKey(key, depthStencilState.flags);
+			appendKey(key, depthStencilState.depthTestEnable);
+			appendKey(key, depthStencilState.depthWriteEnable);
+			appendKey(key, depthStencilState.depthCompareOp);
+			appendKey(key, depthStencilState.depthBoundsTestEnable);
+			appendKey(key, depthStencilState.stencilTestEnable);
+			// VkStencilOpState only consists of 32 bit members
+			appendKey(key, depthStencilState.front);
+			appendKey(key, depthStencilState.back);
+			appendKey(key, depthStencilState.minDepthBounds);
+			appendKey(key, depthStencilState.maxDepthBounds);
+			appendKey(key, createInfo.pColorBlendState != nullptr);
+			appendKey(key, colorBlendState.flags);
+			appendKey(key, colorBlendState.logicOpEnable);
+			appendKey(key, colorBlendState.logicOp);
+			appendKey(key, colorBlendState.blendConstants);
+			// VkPipelineColorBlendAttachmentState only consists of 32 bit members
+			appendKey(key, blendAttachments);
+			appendKey(key, createInfo.pDynamicState != nullptr);
+			appendKey(key, dynamicStates);
+			appendKey(key, createInfo.pNext != nullptr);
+			appendKey(key, renderingInfo.viewMask);
+			appendKey(key, colorAttachmentFormats);
+			appendKey(key, renderingInfo.depthAttachmentFormat);
+			appendKey(key, renderingInfo.stencilAttachmentFormat);
+			return key;
+		}
+	};
+
+	/** @brief Deep copy of a compute pipeline create info */
+	struct PipelineCompiler::Entry::ComputeState
+	{
+		VkComputePipelineCreateInfo createInfo{};
+		ShaderStage shaderStage;
+
+		bool copy(const VkComputePipelineCreateInfo& source)
+		{
+			if ((source.pNext != nullptr) || !shaderStage.copy(source.stage)) {
+				return false;
+			}
+			createInfo = source;
+			createInfo.stage = shaderStage.stage;
+			return true;
+		}
+
+		std::string key() const
+		{
+			std::string key;
+			appendKey(key, createInfo.flags);
+			appendKey(key, createInfo.layout);
+			appendKey(key, createInfo.basePipelineHandle);
+			appendKey(key, createInfo.basePipelineIndex);
+			shaderStage.appendKey(key);
+			return key;
+		}
+	};
+
+	PipelineCompiler::Entry::~Entry() = default;
+
+	/**
+	* Prepare the compiler for use
+	*
+	* @param device Logical device to create the pipelines on
+	* @param pipelineCache Pipeline cache shared by all compiles (pipeline caches are internally synchronized)
+	* @param (Optional) serial Compile on the calling thread instead of worker threads
+	*/
+	void PipelineCompiler::create(VkDevice device, VkPipelineCache pipelineCache, bool serial)
+	{
+		this->device = device;
+		this->pipelineCache = pipelineCache;
+		this->serial = serial;
+		if (!serial) {
+			jobSystem = std::make_unique<JobSystem>();
+		}
+	}
+
+	/**
+	* Wait for outstanding compiles and destroy all pipelines created by the compiler
+	*/
+	void PipelineCompiler::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		// Destroying the job system runs all jobs that are still queued
+		jobSystem.reset();
+		for (auto& [key, entry] : cache) {
+			vkDestroyPipeline(device, entry->pipeline, nullptr);
+		}
+		for (auto& entry : uncached) {
+			vkDestroyPipeline(device, entry->pipeline, nullptr);
+		}
+		cache.clear();
+		uncached.clear();
+		pendingTargets.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	void PipelineCompiler::build(Entry& entry)
+	{
+		const auto tStart = std::chrono::high_resolution_clock::now();
+		if (entry.graphicsState) {
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &entry.graphicsState->createInfo, nullptr, &entry.pipeline));
+		} else {
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &entry.computeState->createInfo, nullptr, &entry.pipeline));
+		}
+		statistics.compileTimeUs += microsecondsSince(tStart);
+		// The copied state is no longer needed, the key stays in the cache
+		entry.graphicsState.reset();
+		entry.computeState.reset();
+		entry.ready.store(true, std::memory_order_release);
+	}
+
+	/**
+	* Returns the cached entry for the key or queues the entry for compilation
+	*/
+	PipelineCompiler::Handle PipelineCompiler::submit(Handle entry, const std::string& key)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			statistics.requested++;
+			if (!key.empty()) {
+				auto cached = cache.find(key);
+				if (cached != cache.end()) {
+					statistics.deduplicated++;
+					return cached->second;
+				}
+				cache[key] = entry;
+			} else {
+				uncached.push_back(entry);
+			}
+			statistics.compiled++;
+		}
+		if (serial || !jobSystem || key.empty()) {
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			build(*entry);
+			statistics.blockingTimeUs += microsecondsSince(tStart);
+		} else {
+			Entry* target = entry.get();
+			jobSystem->run([this, target] { build(*target); }, &entry->counter);
+		}
+		return entry;
+	}
+
+	/** @brief Keeps track of a pipeline that was compiled from a create info that couldn't be copied */
+	void PipelineCompiler::addUncopyable(Handle entry, uint64_t compileTimeUs)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.requested++;
+		statistics.compiled++;
+		statistics.compileTimeUs += compileTimeUs;
+		statistics.blockingTimeUs += compileTimeUs;
+		entry->ready.store(true, std::memory_order_release);
+		uncached.push_back(entry);
+	}
+
+	/**
+	* Request a graphics pipeline, compilation starts in the background (unless the compiler is serial)
+	*
+	* @param createInfo Create info of the pipeline, deep copied so it can be modified or released after the call
+	*
+	* @return Handle to wait on or to get the pipeline from once it's ready
+	*/
+	PipelineCompiler::Handle PipelineCompiler::compile(const VkGraphicsPipelineCreateInfo& createInfo)
+	{
+		Handle entry = std::make_shared<Entry>();
+		entry->graphicsState = std::make_unique<Entry::GraphicsState>();
+		if (!entry->graphicsState->copy(createInfo)) {
+			// Can't be copied, so it's compiled from the caller's create info right away
+			entry->graphicsState.reset();
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo, nullptr, &entry->pipeline));
+			addUncopyable(entry, microsecondsSince(tStart));
+			return entry;
+		}
+		return submit(entry, entry->graphicsState->key());
+	}
+
+	/** @brief Request a compute pipeline, see the graphics pipeline overload */
+	PipelineCompiler::Handle PipelineCompiler::compile(const VkComputePipelineCreateInfo& createInfo)
+	{
+		Handle entry = std::make_shared<Entry>();
+		entry->computeState = std::make_unique<Entry::ComputeState>();
+		if (!entry->computeState->copy(createInfo)) {
+			entry->computeState.reset();
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &createInfo, nullptr, &entry->pipeline));
+			addUncopyable(entry, microsecondsSince(tStart));
+			return entry;
+		}
+		return submit(entry, entry->computeState->key());
+	}
+
+	/**
+	* Request a graphics pipeline that's written to a variable of the caller by the next call to wait, e.g. for batching all pipelines of preparePipelines
+	*
+	* @param createInfo Create info of the pipeline
+	* @param pipeline Variable that receives the pipeline handle, must stay valid until wait is called
+	*/
+	void PipelineCompiler::compile(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline)
+	{
+		Handle handle = compile(createInfo);
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingTargets.push_back({ handle, pipeline });
+	}
+
+	/** @brief Request a compute pipeline that's written to a variable of the caller by the next call to wait */
+	void PipelineCompiler::compile(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline)
+	{
+		Handle handle = compile(createInfo);
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingTargets.push_back({ handle, pipeline });
+	}
+
+	/**
+	* Wait for all pipelines requested with a target variable and write their handles, the calling thread helps compiling in the meantime
+	*/
+	void PipelineCompiler::wait()
+	{
+		std::vector<std::pair<Handle, VkPipeline*>> targets;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			targets.swap(pendingTargets);
+		}
+		for (auto& [handle, pipeline] : targets) {
+			*pipeline = wait(handle);
+		}
+	}
+
+	/**
+	* Wait for a pipeline to finish compiling, the calling thread helps compiling in the meantime
+	*
+	* @return Pipeline handle
+	*/
+	VkPipeline PipelineCompiler::wait(const Handle& handle)
+	{
+		if (!handle->ready.load(std::memory_order_acquire)) {
+			const auto tStart = std::chrono::high_resolution_clock::now();
+			jobSystem->wait(handle->counter);
+			statistics.blockingTimeUs += microsecondsSince(tStart);
+		}
+		return handle->pipeline;
+	}
+
+	/**
+	* Get a pipeline without waiting for it, e.g. for variants that are compiled in the background while rendering
+	*
+	* @param handle Requested pipeline
+	* @param fallback Pipeline that's returned while the requested one is still compiling
+	*/
+	VkPipeline PipelineCompiler::get(const Handle& handle, VkPipeline fallback) const
+	{
+		return (handle && handle->ready.load(std::memory_order_acquire)) ? handle->pipeline : fallback;
+	}
+
+	/**
+	* Write the number of requested and compiled pipelines and the time spent compiling to a stream
+	*/
+	void PipelineCompiler::printStatistics(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Formatted locally so the precision doesn't stick to the caller's stream
+		std::ostringstream text;
+		text << std::fixed << std::setprecision(2);
+		text << "Pipelines: " << statistics.requested << " requested, " << statistics.compiled << " compiled, " << statistics.deduplicated << " deduplicated, "
+			<< statistics.compileTimeUs / 1000.0 << " ms compile time, " << statistics.blockingTimeUs / 1000.0 << " ms blocking ("
+			<< (serial ? std::string("serial") : std::to_string(jobSystem->workerCount()) + " worker threads") << ")" << "\n";
+		stream << text.str() << std::flush;
+	}
+}
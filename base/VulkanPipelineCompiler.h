@@ -0,0 +1,90 @@
+/*
+* Vulkan pipeline compiler
+*
+* Compiles graphics and compute pipelines on worker threads against a shared pipeline cache and deduplicates identical requests
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "jobsystem.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Pipeline build service that compiles pipelines in parallel on a job system
+	* @note Create infos are deep copied when a pipeline is requested, so the passed structures don't need to outlive the call
+	* @note Requests with identical state (including shader module handles) return the same pipeline, pipelines are owned by the compiler and must not be destroyed by the caller
+	* @note Create infos with structures in pNext chains other than VkPipelineRenderingCreateInfo can't be copied and are compiled on the calling thread without deduplication
+	*/
+	class PipelineCompiler
+	{
+	public:
+		/** @brief A requested pipeline, the handle is valid once ready returns true */
+		struct Entry
+		{
+			VkPipeline pipeline{ VK_NULL_HANDLE };
+			std::atomic<bool> ready{ false };
+			JobCounter counter;
+			struct GraphicsState;
+			struct ComputeState;
+			std::unique_ptr<GraphicsState> graphicsState;
+			std::unique_ptr<ComputeState> computeState;
+			~Entry();
+		};
+		using Handle = std::shared_ptr<Entry>;
+
+		struct Statistics
+		{
+			uint32_t requested{ 0 };
+			uint32_t deduplicated{ 0 };
+			uint32_t compiled{ 0 };
+			/** @brief Time spent in vkCreate*Pipelines summed up across all threads */
+			std::atomic<uint64_t> compileTimeUs{ 0 };
+			/** @brief Time the calling thread was blocked by compilation (inline compiles and waits) */
+			std::atomic<uint64_t> blockingTimeUs{ 0 };
+		} statistics;
+
+		/** @brief Compile pipelines on the calling thread as soon as they are requested, e.g. to compare startup times */
+		bool serial{ false };
+
+		void create(VkDevice device, VkPipelineCache pipelineCache, bool serial = false);
+		void destroy();
+		Handle compile(const VkGraphicsPipelineCreateInfo& createInfo);
+		Handle compile(const VkComputePipelineCreateInfo& createInfo);
+		void compile(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline);
+		void compile(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline);
+		void wait();
+		VkPipeline wait(const Handle& handle);
+		VkPipeline get(const Handle& handle, VkPipeline fallback) const;
+		void printStatistics(std::ostream& stream);
+
+	private:
+		VkDevice device{ VK_NULL_HANDLE };
+		VkPipelineCache pipelineCache{ VK_NULL_HANDLE };
+		std::unique_ptr<JobSystem> jobSystem;
+		std::mutex mutex;
+		std::unordered_map<std::string, Handle> cache;
+		// Entries that could not be deduplicated, kept to destroy their pipelines
+		std::vector<Handle> uncached;
+		// Requests that write their pipeline to a caller's variable once wait is called
+		std::vector<std::pair<Handle, VkPipeline*>> pendingTargets;
+
+		Handle submit(Handle entry, const std::string& key);
+		void addUncopyable(Handle entry, uint64_t compileTimeUs);
+		void build(Entry& entry);
+	};
+}
@@ -0,0 +1,292 @@
+/*
+* Vulkan shader module cache
+*
+* Creates shader modules from per-sample SPIR-V archives or single SPIR-V files and shares modules with identical paths or contents
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanShaderCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+/*
+	Shader archive layout (all values little endian), written by shaders/packshaders.py:
+	- Header (16 bytes): magic "SPVA", version, entry count, reserved
+	- Entry table (24 bytes per entry): FNV-1a hash of the SPIR-V, name offset, name length, data offset, data size
+	- Names (file names of the SPIR-V files without directory)
+	- SPIR-V data, each entry starts at a four byte aligned offset so the mapping can be passed to vkCreateShaderModule as is
+*/
+
+namespace vks
+{
+	static constexpr uint32_t archiveMagic = 0x41565053; // "SPVA"
+	static constexpr uint32_t archiveVersion = 1;
+
+	struct ArchiveHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	struct ArchiveTableEntry
+	{
+		uint64_t hash;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint32_t dataOffset;
+		uint32_t dataSize;
+	};
+	static_assert(sizeof(ArchiveTableEntry) == 24, "Shader archive entries need to be tightly packed");
+
+	// 64 bit FNV-1a, matches the hash stored in the archive by the packing script
+	static uint64_t hashCode(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	static std::string contentKey(uint64_t hash, size_t size)
+	{
+		std::string key;
+		key.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+		key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+		return key;
+	}
+
+	ShaderCache::Archive::~Archive()
+	{
+#if defined(__ANDROID__)
+		if (asset) {
+			AAsset_close(asset);
+		}
+#endif
+	}
+
+	/**
+	* Prepare the cache for use, archives are mapped once a shader from their directory is requested
+	*
+	* @param device Logical device to create the shader modules on
+	* @param useArchives Load shaders from archives if present, otherwise only single files are read
+	*/
+	void ShaderCache::create(VkDevice device, bool useArchives)
+	{
+		this->device = device;
+		this->useArchives = useArchives;
+	}
+
+	/**
+	* Destroy all shader modules and unmap the archives
+	*/
+	void ShaderCache::destroy()
+	{
+		if (device == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& module : modules) {
+			vkDestroyShaderModule(device, module, nullptr);
+		}
+		modules.clear();
+		pathCache.clear();
+		contentCache.clear();
+		archives.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	/**
+	* Get the archive for a shader directory, the archive is mapped and its entry table validated on first use
+	*
+	* @param directory Shader directory that may contain an archive
+	*
+	* @return Pointer to the archive or nullptr if the directory doesn't have a valid archive
+	*/
+	ShaderCache::Archive* ShaderCache::getArchive(const std::string& directory)
+	{
+		auto it = archives.find(directory);
+		if (it != archives.end()) {
+			return it->second.get();
+		}
+		std::unique_ptr<Archive>& slot = archives[directory];
+		auto archive = std::make_unique<Archive>();
+		const std::string fileName = directory + "/" + archiveFileName;
+		const uint8_t* data{ nullptr };
+		size_t size{ 0 };
+#if defined(__ANDROID__)
+		// The asset buffer maps the apk if the archive is stored uncompressed, compressed archives are inflated into memory
+		archive->asset = AAssetManager_open(assetManager, fileName.c_str(), AASSET_MODE_BUFFER);
+		if (!archive->asset) {
+			return nullptr;
+		}
+		data = static_cast<const uint8_t*>(AAsset_getBuffer(archive->asset));
+		size = static_cast<size_t>(AAsset_getLength(archive->asset));
+		if (!data) {
+			return nullptr;
+		}
+#else
+		if (!archive->file.open(fileName)) {
+			return nullptr;
+		}
+		data = archive->file.data;
+		size = archive->file.size;
+#endif
+		statistics.filesOpened++;
+		ArchiveHeader header{};
+		if (size < sizeof(header)) {
+			std::cerr << "Error: Shader archive \"" << fileName << "\" is corrupt" << "\n";
+			return nullptr;
+		}
+		memcpy(&header, data, sizeof(header));
+		if ((header.magic != archiveMagic) || (header.version != archiveVersion) || (sizeof(header) + header.entryCount * sizeof(ArchiveTableEntry) > size)) {
+			std::cerr << "Error: Shader archive \"" << fileName << "\" is corrupt or has an unsupported version" << "\n";
+			return nullptr;
+		}
+		for (uint32_t i = 0; i < header.entryCount; i++) {
+			ArchiveTableEntry tableEntry{};
+			memcpy(&tableEntry, data + sizeof(header) + i * sizeof(ArchiveTableEntry), sizeof(tableEntry));
+			const bool valid = ((uint64_t)tableEntry.nameOffset + tableEntry.nameLength <= size)
+				&& ((uint64_t)tableEntry.dataOffset + tableEntry.dataSize <= size)
+				&& (tableEntry.dataSize > 0) && (tableEntry.dataSize % 4 == 0)
+				&& (reinterpret_cast<uintptr_t>(data + tableEntry.dataOffset) % 4 == 0);
+			if (!valid) {
+				std::cerr << "Error: Shader archive \"" << fileName << "\" is corrupt" << "\n";
+				return nullptr;
+			}
+			const std::string name(reinterpret_cast<const char*>(data + tableEntry.nameOffset), tableEntry.nameLength);
+			archive->entries[name] = { reinterpret_cast<const uint32_t*>(data + tableEntry.dataOffset), tableEntry.dataSize, tableEntry.hash };
+		}
+		statistics.archivesMapped++;
+		statistics.bytesMapped += size;
+		slot = std::move(archive);
+		return slot.get();
+	}
+
+	/**
+	* Read a single SPIR-V file
+	*
+	* @param fileName Path of the SPIR-V file
+	* @param code Receives the SPIR-V, stored as words so it's properly aligned for vkCreateShaderModule
+	*
+	* @return True if the file could be read
+	*/
+	bool ShaderCache::readFile(const std::string& fileName, std::vector<uint32_t>& code)
+	{
+#if defined(__ANDROID__)
+		AAsset* asset = AAssetManager_open(assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			return false;
+		}
+		size_t size = AAsset_getLength(asset);
+		code.resize((size + 3) / 4);
+		AAsset_read(asset, code.data(), size);
+		AAsset_close(asset);
+#else
+		std::ifstream is(fileName, std::ios::binary | std::ios::in | std::ios::ate);
+		if (!is.is_open()) {
+			return false;
+		}
+		size_t size = is.tellg();
+		is.seekg(0, std::ios::beg);
+		code.resize((size + 3) / 4);
+		is.read(reinterpret_cast<char*>(code.data()), size);
+		is.close();
+#endif
+		statistics.filesOpened++;
+		statistics.bytesRead += size;
+		if ((size == 0) || (size % 4 != 0)) {
+			std::cerr << "Error: \"" << fileName << "\" is not a valid SPIR-V file" << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	* Get the shader module for SPIR-V code, creates a new module unless one with the same content exists
+	*/
+	VkShaderModule ShaderCache::createModule(const uint32_t* code, size_t size, uint64_t hash)
+	{
+		const std::string key = contentKey(hash, size);
+		auto it = contentCache.find(key);
+		const bool identical = (it != contentCache.end()) && (memcmp(it->second.code.data(), code, size) == 0);
+		if (identical) {
+			statistics.contentHits++;
+			return it->second.module;
+		}
+		VkShaderModuleCreateInfo moduleCreateInfo{};
+		moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleCreateInfo.codeSize = size;
+		moduleCreateInfo.pCode = code;
+		VkShaderModule shaderModule{ VK_NULL_HANDLE };
+		VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &shaderModule));
+		modules.push_back(shaderModule);
+		// On a hash collision the first module stays cached, the new one is only shared through its path
+		if (it == contentCache.end()) {
+			contentCache[key] = { std::vector<uint32_t>(code, code + size / sizeof(uint32_t)), shaderModule };
+		}
+		statistics.modulesCreated++;
+		return shaderModule;
+	}
+
+	/**
+	* Get the shader module for a SPIR-V file
+	* If the file's directory contains an archive that has the file, the module is created from the mapped archive, otherwise the file is read from disk
+	*
+	* @param fileName Path of the SPIR-V file
+	*
+	* @return Shader module or VK_NULL_HANDLE if the shader could not be found
+	*/
+	VkShaderModule ShaderCache::getModule(const std::string& fileName)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		statistics.requested++;
+		auto it = pathCache.find(fileName);
+		if (it != pathCache.end()) {
+			statistics.pathHits++;
+			return it->second;
+		}
+		auto tStart = std::chrono::high_resolution_clock::now();
+		VkShaderModule shaderModule{ VK_NULL_HANDLE };
+		const size_t separator = fileName.find_last_of("/\\");
+		Archive* archive{ nullptr };
+		if (useArchives && (separator != std::string::npos)) {
+			archive = getArchive(fileName.substr(0, separator));
+		}
+		if (archive) {
+			auto entry = archive->entries.find(fileName.substr(separator + 1));
+			if (entry != archive->entries.end()) {
+				shaderModule = createModule(entry->second.code, entry->second.size, entry->second.hash);
+				statistics.archiveLoads++;
+			}
+		}
+		if (shaderModule == VK_NULL_HANDLE) {
+			std::vector<uint32_t> code;
+			if (!readFile(fileName, code)) {
+				std::cerr << "Error: Could not open shader file \"" << fileName << "\"" << "\n";
+				return VK_NULL_HANDLE;
+			}
+			const size_t size = code.size() * sizeof(uint32_t);
+			shaderModule = createModule(code.data(), size, hashCode(code.data(), size));
+		}
+		pathCache[fileName] = shaderModule;
+		statistics.loadTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - tStart).count();
+		return shaderModule;
+	}
+
+	void ShaderCache::printStatistics(std::ostream& stream)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stream << "Shaders: " << statistics.requested << " requested, " << statistics.modulesCreated << " modules created, " << statistics.pathHits << " path hits, " << statistics.contentHits << " content hits, " << statistics.loadTimeUs / 1000.0 << " ms" << "\n";
+		stream << "Shader I/O: " << statistics.filesOpened << " files opened, " << statistics.bytesRead / 1024 << " KB read, " << statistics.archivesMapped << " archives mapped (" << statistics.bytesMapped / 1024 << " KB, " << statistics.archiveLoads << " shaders loaded from archives)" << "\n";
+		stream << std::flush;
+	}
+}
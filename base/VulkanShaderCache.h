@@ -0,0 +1,104 @@
+/*
+* Vulkan shader module cache
+*
+* Creates shader modules from per-sample SPIR-V archives or single SPIR-V files and shares modules with identical paths or contents
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Shader module cache that loads SPIR-V from memory mapped shader archives with a fallback to single files
+	* @note Archives are named shaders.spva and placed in the shader directory of a sample, they are created with shaders/packshaders.py
+	* @note Shader modules handed out by the cache are owned by it and must not be destroyed by the caller
+	*/
+	class ShaderCache
+	{
+	public:
+		/** @brief File name of the archive inside a shader directory */
+		static constexpr const char* archiveFileName = "shaders.spva";
+
+		struct Statistics
+		{
+			uint32_t requested{ 0 };
+			uint32_t modulesCreated{ 0 };
+			/** @brief Requests for a path that has been loaded before, these don't do any I/O */
+			uint32_t pathHits{ 0 };
+			/** @brief Requests for a new path with the same SPIR-V as an already created module */
+			uint32_t contentHits{ 0 };
+			uint32_t archivesMapped{ 0 };
+			uint32_t archiveLoads{ 0 };
+			/** @brief Files opened for reading, including archives */
+			uint32_t filesOpened{ 0 };
+			/** @brief Bytes read from single SPIR-V files, archives are mapped instead of read */
+			uint64_t bytesRead{ 0 };
+			uint64_t bytesMapped{ 0 };
+			uint64_t loadTimeUs{ 0 };
+		} statistics;
+
+		/** @brief Load SPIR-V from single files only, e.g. to compare startup I/O */
+		bool useArchives{ true };
+#if defined(__ANDROID__)
+		AAssetManager* assetManager{ nullptr };
+#endif
+
+		void create(VkDevice device, bool useArchives = true);
+		void destroy();
+		VkShaderModule getModule(const std::string& fileName);
+		void printStatistics(std::ostream& stream);
+
+	private:
+		struct ArchiveEntry
+		{
+			const uint32_t* code{ nullptr };
+			size_t size{ 0 };
+			uint64_t hash{ 0 };
+		};
+
+		struct ContentEntry
+		{
+			// Copy of the SPIR-V, compared on a hash match so a hash collision can't return the wrong module
+			std::vector<uint32_t> code;
+			VkShaderModule module{ VK_NULL_HANDLE };
+		};
+
+		struct Archive
+		{
+#if defined(__ANDROID__)
+			AAsset* asset{ nullptr };
+#else
+			vks::tools::MappedFile file;
+#endif
+			std::unordered_map<std::string, ArchiveEntry> entries;
+			~Archive();
+		};
+
+		VkDevice device{ VK_NULL_HANDLE };
+		std::mutex mutex;
+		std::unordered_map<std::string, VkShaderModule> pathCache;
+		// Keyed by content hash and size of the SPIR-V
+		std::unordered_map<std::string, ContentEntry> contentCache;
+		// Keyed by shader directory, directories without a (valid) archive store a null pointer so they're only checked once
+		std::unordered_map<std::string, std::unique_ptr<Archive>> archives;
+		std::vector<VkShaderModule> modules;
+
+		Archive* getArchive(const std::string& directory);
+		bool readFile(const std::string& fileName, std::vector<uint32_t>& code);
+		VkShaderModule createModule(const uint32_t* code, size_t size, uint64_t hash);
+	};
+}
@@ -0,0 +1,276 @@
+/*
+* Vulkan staging ring buffer
+*
+* Persistently mapped host visible buffer used as the source for all uploads to device local resources
+*
+* Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanStagingRing.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* Prepare the ring for use, the buffer itself is only allocated once the first upload is done
+	*
+	* @param device Device the ring belongs to
+	* @param queueFamilyIndex Family of the queue(s) the upload batches are submitted to
+	* @param (Optional) size Size of the ring buffer in bytes
+	*/
+	void StagingRing::create(VulkanDevice* device, uint32_t queueFamilyIndex, VkDeviceSize size)
+	{
+		this->device = device;
+		this->queueFamilyIndex = queueFamilyIndex;
+		this->size = size;
+		commandPool = device->createCommandPool(queueFamilyIndex);
+	}
+
+	/**
+	* Wait for all uploads to finish and release all resources
+	*/
+	void StagingRing::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		assert(depth == 0);
+		while (!inFlight.empty()) {
+			retireBatch(true);
+		}
+		for (Batch& batch : freeBatches) {
+			vkDestroyFence(device->logicalDevice, batch.fence, nullptr);
+		}
+		freeBatches.clear();
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		if (buffer) {
+			vkDestroyBuffer(device->logicalDevice, buffer, nullptr);
+			vkFreeMemory(device->logicalDevice, memory, nullptr);
+		}
+		buffer = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+		mapped = nullptr;
+		commandPool = VK_NULL_HANDLE;
+		device = nullptr;
+	}
+
+	void StagingRing::createBuffer()
+	{
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &buffer, &memory));
+		// The ring stays mapped for its whole lifetime
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped));
+	}
+
+	/**
+	* Start (or join) an upload batch, all allocations and commands up to the matching end call are submitted together
+	*
+	* @param queue Queue the batch is submitted to, must be of the queue family the ring has been created for
+	*
+	* @note Calls can be nested, only the outermost end call submits the batch
+	*/
+	void StagingRing::begin(VkQueue queue)
+	{
+		assert(device);
+		assert((depth == 0) || (queue == this->queue));
+		if (depth++ > 0) {
+			return;
+		}
+		this->queue = queue;
+		// Recycle batches the device is done with
+		while (!inFlight.empty() && retireBatch(false));
+		startBatch();
+	}
+
+	/**
+	* Allocate staging memory from the ring
+	*
+	* @param size Size of the allocation in bytes
+	* @param (Optional) alignment Alignment of the offset into the staging buffer (defaults to 16 bytes, the largest texel block size)
+	*
+	* @return Buffer, offset and mapped pointer of the allocation
+	*
+	* @note If the ring is full, this may submit the current batch and start a new one, so commandBuffer() has to be called after allocating
+	*/
+	StagingRing::Allocation StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		assert(recording);
+		assert((this->size % alignment) == 0);
+		statistics.allocations++;
+		statistics.bytesUploaded += size;
+		if (size > this->size) {
+			return allocateDedicated(size);
+		}
+		if (!buffer) {
+			createBuffer();
+		}
+		uint64_t position;
+		for (;;) {
+			position = (head + alignment - 1) & ~(alignment - 1);
+			// Allocations are contiguous, if there is not enough room left at the end of the ring, continue at the start
+			if ((position % this->size) + size > this->size) {
+				position = (position / this->size + 1) * this->size;
+			}
+			if (position + size - tail <= this->size) {
+				break;
+			}
+			if (!inFlight.empty()) {
+				// The ring wrapped onto data of a submitted batch
+				if (vkGetFenceStatus(device->logicalDevice, inFlight.front().fence) != VK_SUCCESS) {
+					statistics.stalls++;
+				}
+				retireBatch(true);
+			} else if (head != tail) {
+				// The batch that is being recorded holds the rest of the ring, so it needs to be submitted first
+				statistics.stalls++;
+				submitBatch();
+				retireBatch(true);
+				startBatch();
+			} else {
+				// Nothing is in use, start over at the beginning of the ring
+				head = tail = (head / this->size + 1) * this->size;
+			}
+		}
+		head = position + size;
+		VkDeviceSize offset = position % this->size;
+		return { .buffer = buffer, .offset = offset, .data = mapped + offset };
+	}
+
+	/**
+	* Allocate staging memory and copy data into it
+	*
+	* @param data Pointer to the data to upload
+	* @param size Size of the data in bytes
+	* @param (Optional) alignment Alignment of the offset into the staging buffer
+	*/
+	StagingRing::Allocation StagingRing::upload(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		Allocation allocation = allocate(size, alignment);
+		memcpy(allocation.data, data, size);
+		return allocation;
+	}
+
+	/** @brief Command buffer of the batch that is currently being recorded */
+	VkCommandBuffer StagingRing::commandBuffer() const
+	{
+		assert(recording);
+		return current.commandBuffer;
+	}
+
+	/**
+	* End an upload batch, submitting it if this is the outermost end call
+	*
+	* @return Ticket that can be passed to isComplete and wait
+	*/
+	uint64_t StagingRing::end()
+	{
+		assert(depth > 0);
+		uint64_t ticket = current.ticket;
+		if (--depth == 0) {
+			submitBatch();
+		}
+		return ticket;
+	}
+
+	/** @brief Returns true if the batch the ticket belongs to has been executed by the device */
+	bool StagingRing::isComplete(uint64_t ticket)
+	{
+		while (!inFlight.empty() && retireBatch(false));
+		return ticket <= completedTicket;
+	}
+
+	/** @brief Wait on the host until the batch the ticket belongs to has been executed by the device */
+	void StagingRing::wait(uint64_t ticket)
+	{
+		// Waiting on a batch that hasn't been submitted yet would never return
+		assert(!recording || (ticket < current.ticket));
+		while ((completedTicket < ticket) && !inFlight.empty()) {
+			retireBatch(true);
+		}
+	}
+
+	/** @brief Wait until all submitted uploads have finished */
+	void StagingRing::flush()
+	{
+		assert(depth == 0);
+		wait(nextTicket - 1);
+	}
+
+	void StagingRing::startBatch()
+	{
+		if (freeBatches.empty()) {
+			current.commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandPool, false);
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+			VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceInfo, nullptr, &current.fence));
+		} else {
+			current.commandBuffer = freeBatches.back().commandBuffer;
+			current.fence = freeBatches.back().fence;
+			freeBatches.pop_back();
+		}
+		current.ticket = nextTicket++;
+		VkCommandBufferBeginInfo beginInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+		VK_CHECK_RESULT(vkBeginCommandBuffer(current.commandBuffer, &beginInfo));
+		recording = true;
+	}
+
+	void StagingRing::submitBatch()
+	{
+		VK_CHECK_RESULT(vkEndCommandBuffer(current.commandBuffer));
+		VkSubmitInfo submitInfo{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &current.commandBuffer
+		};
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, current.fence));
+		statistics.submits++;
+		current.end = head;
+		inFlight.push_back(std::move(current));
+		current = {};
+		recording = false;
+	}
+
+	/**
+	* Retire the oldest submitted batch, making its part of the ring available again
+	*
+	* @param wait If true, wait for the batch to finish, otherwise only retire it if it has already finished
+	*
+	* @return True if the batch has been retired
+	*/
+	bool StagingRing::retireBatch(bool wait)
+	{
+		Batch& batch = inFlight.front();
+		if (wait) {
+			VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+		} else if (vkGetFenceStatus(device->logicalDevice, batch.fence) != VK_SUCCESS) {
+			return false;
+		}
+		tail = batch.end;
+		completedTicket = batch.ticket;
+		releaseBatch(batch);
+		inFlight.pop_front();
+		return true;
+	}
+
+	void StagingRing::releaseBatch(Batch& batch)
+	{
+		for (DedicatedBuffer& dedicated : batch.dedicatedBuffers) {
+			vkDestroyBuffer(device->logicalDevice, dedicated.buffer, nullptr);
+			vkFreeMemory(device->logicalDevice, dedicated.memory, nullptr);
+		}
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+		freeBatches.push_back({ .commandBuffer = batch.commandBuffer, .fence = batch.fence });
+	}
+
+	// Uploads larger than the ring get their own staging buffer that lives until the batch has been executed
+	StagingRing::Allocation StagingRing::allocateDedicated(VkDeviceSize size)
+	{
+		statistics.dedicatedAllocations++;
+		DedicatedBuffer dedicated{};
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size, &dedicated.buffer, &dedicated.memory));
+		void* data{ nullptr };
+		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, dedicated.memory, 0, VK_WHOLE_SIZE, 0, &data));
+		current.dedicatedBuffers.push_back(dedicated);
+		return { .buffer = dedicated.buffer, .offset = 0, .data = data };
+	}
+}
@@ -0,0 +1,111 @@
+/*
+* Vulkan staging ring buffer
+*
+* Persistently mapped host visible buffer used as the source for all uploads to device local resources
+*
+* Copyright (C) 2016-2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* @brief Ring buffer allocator for staging uploads
+	* @note Allocations are grouped into batches that are recorded into a single command buffer and submitted at once
+	* @note Regions of the ring are reused as soon as the fence of the batch that used them has been signaled, so the host only stalls when the ring wraps onto data that is still in flight
+	* @note Not thread safe, the ring must only be used from the thread that submits to the upload queue
+	*/
+	class StagingRing
+	{
+	public:
+		/** @brief Staging memory handed out by allocate, data is written to the mapped pointer and copied from buffer at offset */
+		struct Allocation
+		{
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			VkDeviceSize offset{ 0 };
+			void* data{ nullptr };
+		};
+		/** @brief Counters to measure upload behavior */
+		struct Statistics
+		{
+			uint64_t bytesUploaded{ 0 };
+			uint64_t allocations{ 0 };
+			// Allocations that did not fit into the ring and got a dedicated buffer
+			uint64_t dedicatedAllocations{ 0 };
+			uint64_t submits{ 0 };
+			// Number of times the host had to wait for the device to free up space in the ring
+			uint64_t stalls{ 0 };
+		};
+
+		/** @brief Default size of the ring buffer */
+		static constexpr VkDeviceSize defaultSize = 64 * 1024 * 1024;
+
+		Statistics statistics{};
+
+		void create(VulkanDevice* device, uint32_t queueFamilyIndex, VkDeviceSize size = defaultSize);
+		void destroy();
+		void begin(VkQueue queue);
+		Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+		Allocation upload(const void* data, VkDeviceSize size, VkDeviceSize alignment = 16);
+		VkCommandBuffer commandBuffer() const;
+		uint64_t end();
+		bool isComplete(uint64_t ticket);
+		void wait(uint64_t ticket);
+		void flush();
+
+	private:
+		struct DedicatedBuffer
+		{
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			VkDeviceMemory memory{ VK_NULL_HANDLE };
+		};
+		struct Batch
+		{
+			uint64_t ticket{ 0 };
+			VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+			VkFence fence{ VK_NULL_HANDLE };
+			// Ring position up to which this batch uses the ring
+			uint64_t end{ 0 };
+			std::vector<DedicatedBuffer> dedicatedBuffers;
+		};
+
+		VulkanDevice* device{ nullptr };
+		uint32_t queueFamilyIndex{ 0 };
+		VkDeviceSize size{ 0 };
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		VkDeviceMemory memory{ VK_NULL_HANDLE };
+		uint8_t* mapped{ nullptr };
+		VkCommandPool commandPool{ VK_NULL_HANDLE };
+		// Positions grow monotonically, the offset into the ring is the position modulo the size
+		uint64_t head{ 0 };
+		uint64_t tail{ 0 };
+		uint64_t nextTicket{ 1 };
+		uint64_t completedTicket{ 0 };
+		// Batch that is currently being recorded
+		Batch current{};
+		bool recording{ false };
+		uint32_t depth{ 0 };
+		VkQueue queue{ VK_NULL_HANDLE };
+		// Submitted batches in submission order
+		std::deque<Batch> inFlight;
+		// Command buffers and fences of retired batches that can be reused
+		std::vector<Batch> freeBatches;
+
+		void createBuffer();
+		void startBatch();
+		void submitBatch();
+		bool retireBatch(bool wait);
+		void releaseBatch(Batch& batch);
+		Allocation allocateDedicated(VkDeviceSize size);
+	};
+}
@@ -21,6 +21,7 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTools.h"
+#include "VulkanKtx2.h"
 
 #if defined(__ANDROID__)
 #	include <android/asset_manager.h>
@@ -41,6 +42,10 @@ class Texture
 	uint32_t              layerCount;
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
+	/** @brief Ticket of the staging ring batch that uploads the image data, destroy waits for it */
+	uint64_t              uploadTicket{ 0 };
+	/** @brief Sub-allocated range of deviceMemory the image is bound to (not set if the sample allocated the memory itself) */
+	MemoryAllocation      allocation{};
 
 	void      updateDescriptor();
 	void      destroy();
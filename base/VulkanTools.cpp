@@ -7,6 +7,14 @@
  */
 
 #include "VulkanTools.h"
+#include <filesystem>
+#include <utility>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT))
 // iOS & macOS: getAssetPath() and getShaderBasePath() implemented externally for access to Obj-C++ path utilities
@@ -435,6 +443,131 @@ namespace vks
 			return !f.fail();
 		}
 
+		std::string getCacheDirectory()
+		{
+			// Asset and install directories may be read-only, so files written by the samples go to a per-user directory
+			static const std::string cacheDirectory = [] {
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+				return std::string(androidApp->activity->internalDataPath);
+#else
+				std::filesystem::path directory;
+#if defined(_WIN32)
+				if (const char* localAppData = getenv("LOCALAPPDATA")) {
+					directory = std::filesystem::path(localAppData) / "VulkanExamples";
+				}
+#elif defined(__APPLE__)
+				if (const char* home = getenv("HOME")) {
+					directory = std::filesystem::path(home) / "Library" / "Caches" / "VulkanExamples";
+				}
+#else
+				if (const char* cacheHome = getenv("XDG_CACHE_HOME"); cacheHome && cacheHome[0] != '\0') {
+					directory = std::filesystem::path(cacheHome) / "vulkan-examples";
+				} else if (const char* home = getenv("HOME")) {
+					directory = std::filesystem::path(home) / ".cache" / "vulkan-examples";
+				}
+#endif
+				std::error_code error;
+				if (directory.empty() || (!std::filesystem::create_directories(directory, error) && error)) {
+					return std::string();
+				}
+				return directory.string();
+#endif
+			}();
+			return cacheDirectory;
+		}
+
+		bool MappedFile::open(const std::string& filename)
+		{
+#if defined(_WIN32)
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER fileSize{};
+			if (!GetFileSizeEx(file, &fileSize) || (fileSize.QuadPart == 0)) {
+				close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping) {
+				close();
+				return false;
+			}
+			data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			size = static_cast<size_t>(fileSize.QuadPart);
+#else
+			int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat fileStat {};
+			if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size == 0)) {
+				::close(fd);
+				return false;
+			}
+			void* mapped = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			// The mapping stays valid after closing the descriptor
+			::close(fd);
+			if (mapped == MAP_FAILED) {
+				return false;
+			}
+			data = static_cast<const uint8_t*>(mapped);
+			size = static_cast<size_t>(fileStat.st_size);
+#endif
+			if (!data) {
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void MappedFile::close()
+		{
+#if defined(_WIN32)
+			if (data) {
+				UnmapViewOfFile(data);
+			}
+			if (mapping) {
+				CloseHandle(mapping);
+				mapping = nullptr;
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (data) {
+				munmap(const_cast<uint8_t*>(data), size);
+			}
+#endif
+			data = nullptr;
+			size = 0;
+		}
+
+		MappedFile::MappedFile(MappedFile&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+		{
+			if (this != &other) {
+				close();
+				data = std::exchange(other.data, nullptr);
+				size = std::exchange(other.size, 0);
+#if defined(_WIN32)
+				file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+				mapping = std::exchange(other.mapping, nullptr);
+#endif
+			}
+			return *this;
+		}
+
+		MappedFile::~MappedFile()
+		{
+			close();
+		}
+
 		uint32_t alignedSize(uint32_t value, uint32_t alignment)
         {
 	        return (value + alignment - 1) & ~(alignment - 1);
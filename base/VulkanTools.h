@@ -23,6 +23,7 @@
 #include <stdexcept>
 #include <fstream>
 #include <algorithm>
+#include <cstdint>
 #if defined(_WIN32)
 #include <windows.h>
 #include <fcntl.h>
@@ -135,6 +136,31 @@ namespace vks
 		/** @brief Checks if a file exists */
 		bool fileExists(const std::string &filename);
 
+		/** @brief Per-user writable directory for files cached across runs (pipeline, mesh and texture caches), created on first use, empty if there is none */
+		std::string getCacheDirectory();
+
+		/** @brief Read only memory mapping of a file, so file contents can be used without copying them (e.g. for staging or shader module creation) */
+		class MappedFile
+		{
+		public:
+			const uint8_t* data{ nullptr };
+			size_t size{ 0 };
+			MappedFile() = default;
+			// The mapping is owned by a single object, so it can only be moved
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			MappedFile(MappedFile&& other) noexcept;
+			MappedFile& operator=(MappedFile&& other) noexcept;
+			bool open(const std::string& filename);
+			void close();
+			~MappedFile();
+		private:
+#if defined(_WIN32)
+			HANDLE file{ INVALID_HANDLE_VALUE };
+			HANDLE mapping{ nullptr };
+#endif
+		};
+
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
 		VkDeviceSize alignedVkSize(VkDeviceSize value, VkDeviceSize alignment);
 	}
@@ -0,0 +1,156 @@
+/*
+* Vulkan transient uniform allocator
+*
+* Per-frame linear allocator for uniform data that is written by the host every frame
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "VulkanUniformAllocator.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* Prepare the allocator for use, the buffers are only created once they are first used
+	*
+	* @param device Device the allocator belongs to
+	* @param frameCount Number of frames in flight, one buffer is created per frame
+	* @param (Optional) size Size of the buffer for each frame in bytes
+	*/
+	void UniformAllocator::create(VulkanDevice* device, uint32_t frameCount, VkDeviceSize size)
+	{
+		this->device = device;
+		this->frameCount = frameCount;
+		this->size = size;
+		alignment = std::max(device->properties.limits.minUniformBufferOffsetAlignment, VkDeviceSize(1));
+	}
+
+	/**
+	* Release all resources, the device must no longer use any of the allocations
+	*/
+	void UniformAllocator::destroy()
+	{
+		if (!device) {
+			return;
+		}
+		for (Frame& frame : frames) {
+			vkDestroyBuffer(device->logicalDevice, frame.buffer, nullptr);
+			device->memoryAllocator.destroyLinearPool(frame.pool);
+		}
+		frames.clear();
+		device = nullptr;
+	}
+
+	void UniformAllocator::createBuffers()
+	{
+		assert(device);
+		frames.resize(frameCount);
+		for (Frame& frame : frames) {
+			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, size);
+			VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &frame.buffer));
+			VkMemoryRequirements memoryRequirements;
+			vkGetBufferMemoryRequirements(device->logicalDevice, frame.buffer, &memoryRequirements);
+			const uint32_t memoryTypeIndex = device->getMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			coherent = (device->memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+			// The buffer covers the whole pool, so offsets into the pool are also offsets into the buffer
+			frame.pool = device->memoryAllocator.createLinearPool(memoryTypeIndex, memoryRequirements.size);
+			VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, frame.buffer, frame.pool->memory, 0));
+		}
+	}
+
+	/**
+	* Start allocating for a frame and release all allocations previously made for it
+	*
+	* @param frameIndex Index of the frame in flight, the device must be done with the frame (e.g. its fence has been waited on)
+	*/
+	void UniformAllocator::beginFrame(uint32_t frameIndex)
+	{
+		assert(frameIndex < frameCount);
+		currentFrame = frameIndex;
+		if (!frames.empty()) {
+			frames[frameIndex].pool->reset();
+			frames[frameIndex].flushed = 0;
+		}
+	}
+
+	/**
+	* Allocate uniform data for the current frame
+	*
+	* @param size Size of the allocation in bytes
+	*
+	* @return Buffer, (dynamic) offset and mapped pointer of the allocation
+	*/
+	UniformAllocator::Allocation UniformAllocator::allocate(VkDeviceSize size)
+	{
+		if (frames.empty()) {
+			createBuffers();
+		}
+		Frame& frame = frames[currentFrame];
+		const VkMemoryRequirements memoryRequirements{ .size = size, .alignment = alignment, .memoryTypeBits = 1u << frame.pool->memoryTypeIndex };
+		const MemoryAllocation memoryAllocation = frame.pool->allocate(memoryRequirements);
+		if (memoryAllocation.memory == VK_NULL_HANDLE) {
+			vks::tools::exitFatal("The transient uniform allocator is out of memory, increase its size", VK_ERROR_OUT_OF_DEVICE_MEMORY);
+		}
+		peakSize = std::max(peakSize, frame.pool->head);
+		return { frame.buffer, static_cast<uint32_t>(memoryAllocation.offset), memoryAllocation.mapped };
+	}
+
+	/**
+	* Allocate uniform data for the current frame and copy data into it
+	*
+	* @param data Pointer to the data to copy
+	* @param size Size of the data in bytes
+	*/
+	UniformAllocator::Allocation UniformAllocator::upload(const void* data, VkDeviceSize size)
+	{
+		Allocation allocation = allocate(size);
+		memcpy(allocation.data, data, size);
+		return allocation;
+	}
+
+	/**
+	* Make the data written for the current frame visible to the device, needs to be called before the frame's command buffers are submitted
+	*
+	* @note Only required for non-coherent memory, everything written since the last flush is flushed as a single range
+	*/
+	void UniformAllocator::flush()
+	{
+		if (coherent || frames.empty()) {
+			return;
+		}
+		Frame& frame = frames[currentFrame];
+		if (frame.pool->head == frame.flushed) {
+			return;
+		}
+		// Allocations are aligned to the non-coherent atom size by the pool, so the range doesn't need to be adjusted
+		VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+		mappedRange.memory = frame.pool->memory;
+		mappedRange.offset = frame.flushed;
+		mappedRange.size = frame.pool->head - frame.flushed;
+		VK_CHECK_RESULT(vkFlushMappedMemoryRanges(device->logicalDevice, 1, &mappedRange));
+		frame.flushed = frame.pool->head;
+	}
+
+	/** @brief Buffer the allocations of a frame are made from, e.g. for writing descriptors */
+	VkBuffer UniformAllocator::buffer(uint32_t frameIndex)
+	{
+		if (frames.empty()) {
+			createBuffers();
+		}
+		return frames[frameIndex].buffer;
+	}
+
+	/**
+	* Get a descriptor for a frame's buffer to be used with VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, the offset is passed at bind time
+	*
+	* @param frameIndex Index of the frame in flight
+	* @param range Size of the uniform block the descriptor is used for
+	*/
+	VkDescriptorBufferInfo UniformAllocator::descriptor(uint32_t frameIndex, VkDeviceSize range)
+	{
+		return { buffer(frameIndex), 0, range };
+	}
+}
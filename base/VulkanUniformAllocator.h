@@ -0,0 +1,79 @@
+/*
+* Vulkan transient uniform allocator
+*
+* Per-frame linear allocator for uniform data that is written by the host every frame
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanMemoryAllocator.h"
+
+namespace vks
+{
+	struct VulkanDevice;
+
+	/**
+	* @brief Linear allocator for transient uniform data with one persistently mapped buffer per frame in flight
+	* @note Allocations are only valid for the frame they were made in, all allocations of a frame are released at once by beginFrame once the frame's fence has been signaled
+	* @note Offsets are aligned to minUniformBufferOffsetAlignment, so they can be passed as dynamic offsets for VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptors
+	* @note Not thread safe
+	*/
+	class UniformAllocator
+	{
+	public:
+		/** @brief Uniform data handed out by allocate, data is written to the mapped pointer and read by the device from buffer at offset */
+		struct Allocation
+		{
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			uint32_t offset{ 0 };
+			void* data{ nullptr };
+		};
+
+		/** @brief Default size of the buffer for each frame in flight */
+		static constexpr VkDeviceSize defaultSize = 4 * 1024 * 1024;
+
+		/** @brief Highest number of bytes allocated in a single frame */
+		VkDeviceSize peakSize{ 0 };
+
+		void create(VulkanDevice* device, uint32_t frameCount, VkDeviceSize size = defaultSize);
+		void destroy();
+		void beginFrame(uint32_t frameIndex);
+		Allocation allocate(VkDeviceSize size);
+		Allocation upload(const void* data, VkDeviceSize size);
+		/** @brief Allocates and copies a uniform block */
+		template<typename T>
+		Allocation upload(const T& data)
+		{
+			return upload(&data, sizeof(T));
+		}
+		void flush();
+		VkBuffer buffer(uint32_t frameIndex);
+		VkDescriptorBufferInfo descriptor(uint32_t frameIndex, VkDeviceSize range);
+
+	private:
+		struct Frame
+		{
+			VkBuffer buffer{ VK_NULL_HANDLE };
+			MemoryAllocator::LinearPool* pool{ nullptr };
+			// Start of the range that has not been flushed yet
+			VkDeviceSize flushed{ 0 };
+		};
+
+		VulkanDevice* device{ nullptr };
+		VkDeviceSize size{ 0 };
+		VkDeviceSize alignment{ 1 };
+		bool coherent{ true };
+		uint32_t frameCount{ 0 };
+		uint32_t currentFrame{ 0 };
+		std::vector<Frame> frames;
+
+		void createBuffers();
+	};
+}
@@ -18,22 +18,48 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "jobsystem.hpp"
+#include "bcencoder.hpp"
+
+#include <future>
+#include <chrono>
+#include <filesystem>
+#include <unordered_map>
+#include <type_traits>
+// Animation channels are interpolated with SIMD instructions if available
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_ANIMATION_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define VKS_ANIMATION_NEON
+#endif
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
+VkDescriptorSetLayout vkglTF::descriptorSetLayoutMaterials = VK_NULL_HANDLE;
+uint32_t vkglTF::maxBindlessTextures = 1024;
 VkMemoryPropertyFlags vkglTF::memoryPropertyFlags = 0;
 uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageBaseColor;
+bool vkglTF::meshCacheEnabled = false;
+bool vkglTF::compactVertices = false;
+bool vkglTF::optimizeMeshes = false;
+bool vkglTF::textureReport = false;
+vkglTF::TextureCompression vkglTF::textureCompression = vkglTF::TextureCompression::None;
+
+static bool isKtxFile(const std::string& uri)
+{
+	return (uri.find_last_of(".") != std::string::npos) && (uri.substr(uri.find_last_of(".") + 1) == "ktx" || vks::ktx2::isKtx2File(uri));
+}
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
 */
 bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
-	// KTX files will be handled by our own code
-	if (image->uri.find_last_of(".") != std::string::npos) {
-		if (image->uri.substr(image->uri.find_last_of(".") + 1) == "ktx") {
-			return true;
-		}
+	// KTX and KTX2 files will be handled by our own code
+	if (isKtxFile(image->uri)) {
+		return true;
 	}
 
 	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
@@ -45,6 +71,22 @@ bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::s
 	return true;
 }
 
+bool loadImageDataFuncDeferred(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
+{
+	// KTX and KTX2 files will be handled by our own code
+	if (isKtxFile(image->uri)) {
+		return true;
+	}
+
+	// Only keep the encoded data, so images can be decoded in parallel once the file has been parsed
+	std::vector<std::vector<unsigned char>>* encodedImages = static_cast<std::vector<std::vector<unsigned char>>*>(userData);
+	if (encodedImages->size() <= static_cast<size_t>(imageIndex)) {
+		encodedImages->resize(imageIndex + 1);
+	}
+	(*encodedImages)[imageIndex].assign(bytes, bytes + size);
+	return true;
+}
+
 
 /*
 	glTF texture loading class
@@ -61,111 +103,492 @@ void vkglTF::Texture::destroy()
 {
 	if (device)
 	{
+		if (uploadTicket) {
+			device->stagingRing.wait(uploadTicket);
+			uploadTicket = 0;
+		}
 		vkDestroyImageView(device->logicalDevice, view, nullptr);
 		vkDestroyImage(device->logicalDevice, image, nullptr);
-		vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+		device->memoryAllocator.free(allocation);
 		vkDestroySampler(device->logicalDevice, sampler, nullptr);
 	}
 }
 
-void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+/*
+	CPU side image data, images are decoded (and KTX files are read) on worker threads and uploaded later on in a single batch
+*/
+struct vkglTF::ImageData {
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	uint32_t mipLevels{ 1 };
+	// glTF uses jpg and png, so the mip chain of these needs to be generated after the upload
+	bool generateMipmaps{ false };
+	std::vector<unsigned char> data;
+	// Buffer offsets are relative to the start of the data
+	std::vector<VkBufferImageCopy> copyRegions;
+	// Source of the image for the texture report (see vkglTF::textureReport)
+	vkglTF::Texture::LoadInfo loadInfo;
+};
+
+/*
+	State of a model that is being loaded, see Model::loadFromFileAsync
+*/
+struct vkglTF::Model::AsyncLoad {
+	enum class State { Processing, Uploading };
+	State state{ State::Processing };
+	std::string filename;
+	VkQueue transferQueue{ VK_NULL_HANDLE };
+	uint32_t fileLoadingFlags{ 0 };
+	float scale{ 1.0f };
+	std::future<void> cpuStages;
+	std::string error;
+	tinygltf::Model gltfModel;
+	std::vector<std::vector<unsigned char>> encodedImages;
+	std::vector<ImageData> images;
+	std::vector<uint32_t> indexBuffer;
+	std::vector<Vertex> vertexBuffer;
+	// Vertices converted to the compact layout, if enabled
+	std::vector<uint8_t> packedVertices;
+	// Final vertex and index data to be uploaded, points either into the buffers above or into the mapped mesh cache
+	size_t vertexStride{ sizeof(Vertex) };
+	const void* vertexData{ nullptr };
+	size_t vertexCount{ 0 };
+	const void* indexData{ nullptr };
+	size_t indexCount{ 0 };
+	// Flattened primitives for FileLoadingFlags::PrepareIndirectDraws
+	std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
+	std::vector<vkglTF::IndirectDrawData> indirectDrawData;
+	vks::tools::MappedFile meshCache;
+	// All uploads are done in a single batch of the device's staging ring
+	uint64_t uploadTicket{ 0 };
+	std::chrono::high_resolution_clock::time_point uploadStart;
+};
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
 {
-	this->device = device;
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static uint64_t hashData(const uint8_t* data, size_t size, uint64_t hash);
+
+/*
+	Texture compression cache (vkglTF::textureCompression)
+
+	Uncompressed images are encoded to BC7 (or BC1 if opaque and requested) with a full mip chain on first load and stored as KTX files in the per-user cache directory (vks::tools::getCacheDirectory)
+	Cache files are named after a hash of the encoded source image and the compression settings, so a changed image gets a new cache file instead of overwriting the old one
+*/
+
+// Needs to be increased whenever the encoder output changes
+static const uint32_t textureCacheVersion = 1;
+static const char* textureCachePsnrKey = "vks.psnr";
+// glInternalformat values of the KTX 1.1 header for the encoded formats
+static const ktx_uint32_t glCompressedRGBABptcUnorm = 0x8E8C;
+static const ktx_uint32_t glCompressedRGBS3tcDxt1 = 0x83F0;
+
+/*
+	Cache files are named after a hash of the encoded source image and the settings, so all models share the per-user cache directory
+	Returns an empty string if there is no cache directory, images are then encoded in memory on every load
+*/
+static std::string textureCacheFile(const std::vector<unsigned char>& encoded)
+{
+	const std::string cacheDirectory = vks::tools::getCacheDirectory();
+	if (cacheDirectory.empty()) {
+		return std::string();
+	}
+	const uint32_t settings[2] = { textureCacheVersion, static_cast<uint32_t>(vkglTF::textureCompression) };
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = hashData(encoded.data(), encoded.size(), hash);
+	hash = hashData(reinterpret_cast<const uint8_t*>(settings), sizeof(settings), hash);
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+	return cacheDirectory + "/" + name + ".texturecache.ktx";
+}
+
+// Size of the RGBA8 mip chain the compressed image replaces
+static size_t uncompressedChainSize(uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	size_t size = 0;
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		size += static_cast<size_t>(std::max(1u, width >> i)) * std::max(1u, height >> i) * 4;
+	}
+	return size;
+}
+
+/*
+	Replaces the decoded RGBA8 image data with the block compressed mip chain and writes it to the cache (if a cache file is passed)
+	The mip chain is generated on the CPU with a box filter, so it doesn't need to be blitted after the upload
+	Failing to write the cache is not an error, the image is encoded again on the next load
+*/
+static void compressImage(vkglTF::ImageData& imageData, int imageIndex, vks::JobSystem* jobSystem, const std::string& cacheFile)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	bool opaque = true;
+	for (size_t i = 3; i < imageData.data.size() && opaque; i += 4) {
+		opaque = (imageData.data[i] == 255);
+	}
+	const vks::bc::Format format = ((vkglTF::textureCompression == vkglTF::TextureCompression::BC1) && opaque) ? vks::bc::Format::BC1 : vks::bc::Format::BC7;
+
+	std::vector<uint8_t> level = std::move(imageData.data);
+	std::vector<uint8_t> nextLevel;
+	std::vector<std::vector<uint8_t>> encodedLevels(imageData.mipLevels);
+	vks::bc::Statistics statistics;
+	uint32_t width = imageData.width;
+	uint32_t height = imageData.height;
+	for (uint32_t i = 0; i < imageData.mipLevels; i++) {
+		encodedLevels[i].resize(vks::bc::encodedSize(format, width, height));
+		vks::bc::encodeImage(format, level.data(), width, height, encodedLevels[i].data(), jobSystem, &statistics);
+		if (i + 1 < imageData.mipLevels) {
+			vks::bc::downsample(level.data(), width, height, nextLevel);
+			std::swap(level, nextLevel);
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+	}
+
+	imageData.format = (format == vks::bc::Format::BC7) ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	imageData.generateMipmaps = false;
+	imageData.data.clear();
+	imageData.copyRegions.clear();
+	for (uint32_t i = 0; i < imageData.mipLevels; i++) {
+		VkBufferImageCopy bufferCopyRegion{
+			.bufferOffset = imageData.data.size(),
+			.imageSubresource = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = i,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			},
+			.imageExtent = {
+				.width = std::max(1u, imageData.width >> i),
+				.height = std::max(1u, imageData.height >> i),
+				.depth = 1
+			}
+		};
+		imageData.copyRegions.push_back(bufferCopyRegion);
+		imageData.data.insert(imageData.data.end(), encodedLevels[i].begin(), encodedLevels[i].end());
+	}
+	imageData.loadInfo.sourceSize = uncompressedChainSize(imageData.width, imageData.height, imageData.mipLevels);
+	imageData.loadInfo.psnr = statistics.psnr();
+	imageData.loadInfo.encodeTime = millisecondsSince(tStart);
+
+	if (cacheFile.empty()) {
+		return;
+	}
+	ktxTextureCreateInfo createInfo{
+		.glInternalformat = (format == vks::bc::Format::BC7) ? glCompressedRGBABptcUnorm : glCompressedRGBS3tcDxt1,
+		.baseWidth = imageData.width,
+		.baseHeight = imageData.height,
+		.baseDepth = 1,
+		.numDimensions = 2,
+		.numLevels = imageData.mipLevels,
+		.numLayers = 1,
+		.numFaces = 1,
+		.isArray = KTX_FALSE,
+		.generateMipmaps = KTX_FALSE
+	};
+	ktxTexture* ktxTexture;
+	if (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &ktxTexture) != KTX_SUCCESS) {
+		return;
+	}
+	for (uint32_t i = 0; i < imageData.mipLevels; i++) {
+		ktxTexture_SetImageFromMemory(ktxTexture, i, 0, 0, encodedLevels[i].data(), encodedLevels[i].size());
+	}
+	const std::string psnr = std::to_string(imageData.loadInfo.psnr);
+	ktxHashList_AddKVPair(&ktxTexture->kvDataHead, textureCachePsnrKey, static_cast<unsigned int>(psnr.size() + 1), psnr.c_str());
+	// An image can be referenced more than once, so every job writes to a file of its own that's then renamed to the cache file
+	const std::string tempFile = cacheFile + "." + std::to_string(imageIndex) + ".tmp";
+	std::error_code errorCode;
+	if (ktxTexture_WriteToNamedFile(ktxTexture, tempFile.c_str()) == KTX_SUCCESS) {
+		std::filesystem::rename(tempFile, cacheFile, errorCode);
+	}
+	std::filesystem::remove(tempFile, errorCode);
+	ktxTexture_Destroy(ktxTexture);
+}
+
+/*
+	Reads a KTX file into image data, used for external KTX images and the texture compression cache
+	If psnr is passed, the quality stored with cached images is read from the key/value data of the file
+*/
+static bool readKtxImage(const std::string& filename, vkglTF::ImageData& imageData, double* psnr = nullptr)
+{
+	ktxTexture* ktxTexture;
+
+	ktxResult result = KTX_SUCCESS;
+#if defined(__ANDROID__)
+	AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+	if (!asset) {
+		std::cerr << "Could not load texture from " << filename << std::endl;
+		return false;
+	}
+	size_t size = AAsset_getLength(asset);
+	assert(size > 0);
+	ktx_uint8_t* textureData = new ktx_uint8_t[size];
+	AAsset_read(asset, textureData, size);
+	AAsset_close(asset);
+	result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+	delete[] textureData;
+#else
+	if (!vks::tools::fileExists(filename)) {
+		std::cerr << "Could not load texture from " << filename << std::endl;
+		return false;
+	}
+	result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif
+	if (result != KTX_SUCCESS) {
+		std::cerr << "Could not load texture from " << filename << std::endl;
+		return false;
+	}
+
+	imageData.width = ktxTexture->baseWidth;
+	imageData.height = ktxTexture->baseHeight;
+	imageData.mipLevels = ktxTexture->numLevels;
+	imageData.format = ktxTexture_GetVkFormat(ktxTexture);
+	imageData.generateMipmaps = false;
+
+	ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
+	ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
+	imageData.data.assign(ktxTextureData, ktxTextureData + ktxTextureSize);
+
+	for (uint32_t i = 0; i < imageData.mipLevels; i++)
+	{
+		ktx_size_t offset;
+		KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
+		assert(result == KTX_SUCCESS);
+		VkBufferImageCopy bufferCopyRegion{
+			.bufferOffset = offset,
+			.imageSubresource = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = i,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			},
+			.imageExtent = {
+				.width = std::max(1u, ktxTexture->baseWidth >> i),
+				.height = std::max(1u, ktxTexture->baseHeight >> i),
+				.depth = 1
+			}
+		};
+		imageData.copyRegions.push_back(bufferCopyRegion);
+	}
+
+	if (psnr) {
+		unsigned int valueSize;
+		void* value;
+		if (ktxHashList_FindValue(&ktxTexture->kvDataHead, textureCachePsnrKey, &valueSize, &value) == KTX_SUCCESS) {
+			*psnr = atof(static_cast<const char*>(value));
+		}
+	}
+
+	ktxTexture_Destroy(ktxTexture);
+	return true;
+}
 
-	bool isKtx = false;
-	// Image points to an external ktx file
-	if (gltfimage.uri.find_last_of(".") != std::string::npos) {
-		if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
-			isKtx = true;
+/*
+	Decodes a glTF image into the data to be uploaded
+	If encoded data is passed, the image has not been decoded by tinyglTF yet and is decoded here
+*/
+static bool decodeImage(tinygltf::Image& gltfimage, int imageIndex, const std::vector<unsigned char>* encoded, const std::string& path, vks::VulkanDevice* device, vks::JobSystem* jobSystem, vkglTF::ImageData& imageData)
+{
+	auto tStart = std::chrono::high_resolution_clock::now();
+	imageData.loadInfo.source = gltfimage.uri.empty() ? ("image " + std::to_string(imageIndex)) : gltfimage.uri;
+
+	if (vks::ktx2::isKtx2File(gltfimage.uri)) {
+		// Texture is stored in an external KTX2 file, Basis Universal payloads are transcoded to a format supported by the device
+		// glTF only references 2D textures, so only the first layer/face of the file is used
+		std::string error;
+		vks::ktx2::File file;
+		vks::ktx2::UploadData uploadData;
+		if (!vks::ktx2::readFile(path + "/" + gltfimage.uri, file, error)) {
+			std::cerr << "Could not load texture from " << path + "/" + gltfimage.uri << ": " << error << std::endl;
+			return false;
+		}
+		if (!vks::ktx2::prepareUpload(file, device->physicalDevice, jobSystem, uploadData, error)) {
+			if (!file.needsTranscoding()) {
+				std::cerr << "Could not load texture from " << path + "/" + gltfimage.uri << ": " << error << std::endl;
+				return false;
+			}
+			// Images that are only referenced by KHR_texture_basisu are not used by materials that have a fallback if there is no transcoder (see textureSource), so a placeholder keeps the texture indices intact
+			std::cerr << "Warning: Could not transcode " << gltfimage.uri << " (" << error << "), using a placeholder" << std::endl;
+			imageData.format = VK_FORMAT_R8G8B8A8_UNORM;
+			imageData.width = imageData.height = imageData.mipLevels = 1;
+			imageData.data = { 255, 255, 255, 255 };
+			imageData.copyRegions.push_back({ .imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1 }, .imageExtent = { .width = 1, .height = 1, .depth = 1 } });
+			imageData.loadInfo.sourceFormat = (file.colorModel == vks::ktx2::ColorModelUASTC) ? "UASTC" : "ETC1S";
+			imageData.loadInfo.transcodeError = error;
+			imageData.loadInfo.time = millisecondsSince(tStart);
+			return true;
+		}
+		imageData.format = uploadData.format;
+		imageData.width = uploadData.width;
+		imageData.height = uploadData.height;
+		imageData.mipLevels = uploadData.mipLevels;
+		imageData.generateMipmaps = false;
+		imageData.data = std::move(uploadData.data);
+		for (const VkBufferImageCopy& region : uploadData.copyRegions) {
+			if (region.imageSubresource.baseArrayLayer == 0) {
+				imageData.copyRegions.push_back(region);
+			}
 		}
+		imageData.loadInfo.sourceFormat = uploadData.transcoded ? (file.colorModel == vks::ktx2::ColorModelUASTC ? "UASTC" : "ETC1S") : vks::ktx2::formatName(uploadData.sourceFormat);
+		imageData.loadInfo.time = millisecondsSince(tStart);
+		return true;
 	}
 
-	VkFormat format;
+	bool isKtx = isKtxFile(gltfimage.uri);
 
 	if (!isKtx) {
-		// Texture was loaded using STB_Image
+		const bool compressTexture = (vkglTF::textureCompression != vkglTF::TextureCompression::None) && device->enabledFeatures.textureCompressionBC && encoded && !encoded->empty();
+		std::string cacheFile;
+#if !defined(__ANDROID__)
+		// KTX files are read through the asset manager on Android, so the cache can't be read back there
+		if (compressTexture) {
+			cacheFile = textureCacheFile(*encoded);
+		}
+#endif
+		if (!cacheFile.empty() && vks::tools::fileExists(cacheFile) && readKtxImage(cacheFile, imageData, &imageData.loadInfo.psnr)) {
+			imageData.loadInfo.sourceFormat = "RGBA8";
+			imageData.loadInfo.sourceSize = uncompressedChainSize(imageData.width, imageData.height, imageData.mipLevels);
+			imageData.loadInfo.cacheHit = true;
+			imageData.loadInfo.time = millisecondsSince(tStart);
+			return true;
+		}
+
+		if (encoded && !encoded->empty()) {
+			std::string error, warning;
+			if (!tinygltf::LoadImageData(&gltfimage, imageIndex, &error, &warning, 0, 0, encoded->data(), static_cast<int>(encoded->size()), nullptr)) {
+				std::cerr << "Could not decode image " << imageIndex << ": " << error << std::endl;
+				return false;
+			}
+		}
+		assert(!gltfimage.image.empty());
+
+		imageData.format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageData.width = gltfimage.width;
+		imageData.height = gltfimage.height;
+		imageData.mipLevels = static_cast<uint32_t>(floor(log2(std::max(imageData.width, imageData.height))) + 1.0);
+		imageData.generateMipmaps = true;
 
-		unsigned char* buffer = nullptr;
-		VkDeviceSize bufferSize = 0;
-		bool deleteBuffer = false;
 		if (gltfimage.component == 3) {
 			// Most devices don't support RGB only on Vulkan so convert if necessary
 			// TODO: Check actual format support and transform only if required
-			bufferSize = gltfimage.width * gltfimage.height * 4;
-			buffer = new unsigned char[bufferSize];
-			unsigned char* rgba = buffer;
-			unsigned char* rgb = &gltfimage.image[0];
-			for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
+			imageData.data.resize(static_cast<size_t>(gltfimage.width) * gltfimage.height * 4);
+			unsigned char* rgba = imageData.data.data();
+			const unsigned char* rgb = &gltfimage.image[0];
+			for (size_t i = 0; i < static_cast<size_t>(gltfimage.width) * gltfimage.height; ++i) {
 				for (int32_t j = 0; j < 3; ++j) {
 					rgba[j] = rgb[j];
 				}
+				rgba[3] = 255;
 				rgba += 4;
 				rgb += 3;
 			}
-			deleteBuffer = true;
 		}
 		else {
-			buffer = &gltfimage.image[0];
-			bufferSize = gltfimage.image.size();
+			imageData.data = std::move(gltfimage.image);
+		}
+		// The decoded pixels have been moved into the image data, so release what's left
+		gltfimage.image.clear();
+		gltfimage.image.shrink_to_fit();
+
+		VkBufferImageCopy bufferCopyRegion{
+			.imageSubresource = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = 0,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			},
+			.imageExtent = {
+				.width = imageData.width,
+				.height = imageData.height,
+				.depth = 1
+			}
+		};
+		imageData.copyRegions.push_back(bufferCopyRegion);
+
+		if (compressTexture) {
+			compressImage(imageData, imageIndex, jobSystem, cacheFile);
+		}
+	}
+	else {
+		// Texture is stored in an external ktx file
+		if (!readKtxImage(path + "/" + gltfimage.uri, imageData)) {
+			return false;
 		}
-		assert(buffer);
+	}
+	imageData.loadInfo.sourceFormat = isKtx ? vks::ktx2::formatName(imageData.format) : "RGBA8";
+	imageData.loadInfo.time = millisecondsSince(tStart);
+	return true;
+}
 
-		format = VK_FORMAT_R8G8B8A8_UNORM;
+void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path, vks::VulkanDevice *device, VkQueue copyQueue)
+{
+	ImageData imageData{};
+	if (!decodeImage(gltfimage, -1, nullptr, path, device, nullptr, imageData)) {
+		vks::tools::exitFatal("Could not load texture \"" + gltfimage.uri + "\"\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+		return;
+	}
 
-		width = gltfimage.width;
-		height = gltfimage.height;
-		mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
+	device->stagingRing.begin(copyQueue);
+	vks::StagingRing::Allocation staging = device->stagingRing.upload(imageData.data.data(), imageData.data.size());
+	fromImageData(imageData, device, device->stagingRing.commandBuffer(), staging.buffer, staging.offset);
+	uploadTicket = device->stagingRing.end();
+}
 
+void vkglTF::Texture::fromImageData(const ImageData& imageData, vks::VulkanDevice* device, VkCommandBuffer copyCmd, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
+{
+	this->device = device;
+	width = imageData.width;
+	height = imageData.height;
+	mipLevels = imageData.mipLevels;
+	layerCount = 1;
+	loadInfo = imageData.loadInfo;
+	loadInfo.format = imageData.format;
+	loadInfo.dataSize = imageData.data.size();
+	const VkFormat format = imageData.format;
+
+	if (imageData.generateMipmaps) {
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+	}
+
+	VkImageCreateInfo imageCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent = { .width = width, .height = height, .depth = 1 },
+		.mipLevels = mipLevels,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+	};
+	if (imageData.generateMipmaps) {
+		imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
+	VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+	deviceMemory = allocation.memory;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
+	std::vector<VkBufferImageCopy> bufferCopyRegions = imageData.copyRegions;
+	for (auto& bufferCopyRegion : bufferCopyRegions) {
+		bufferCopyRegion.bufferOffset += stagingOffset;
+	}
 
-		VkBufferCreateInfo bufferCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-			.size = bufferSize,
-			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-		};
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-		VkMemoryRequirements memReqs{};
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		VkMemoryAllocateInfo memAllocInfo{
-			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-			.allocationSize = memReqs.size,
-			.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-		};
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data{nullptr};
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, buffer, bufferSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		VkImageCreateInfo imageCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-			.imageType = VK_IMAGE_TYPE_2D,
-			.format = format,
-			.extent = { .width = width, .height = height, .depth = 1 },
-			.mipLevels = mipLevels,
-			.arrayLayers = 1,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.tiling = VK_IMAGE_TILING_OPTIMAL,
-			.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		};
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	if (!imageData.generateMipmaps) {
+		VkImageSubresourceRange subresourceRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = mipLevels, .layerCount = 1 };
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
+		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+	}
+	else {
 		VkImageSubresourceRange subresourceRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 };
 		{
 			VkImageMemoryBarrier imageMemoryBarrier{
@@ -179,20 +602,7 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			};
 			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
-		VkBufferImageCopy bufferCopyRegion{
-			.imageSubresource = {
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = 0,
-				.baseArrayLayer = 0,
-				.layerCount = 1
-			},
-			.imageExtent = {
-				.width = width,
-				.height = height,
-				.depth = 1
-			}
-		};
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
+		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
 		{
 			VkImageMemoryBarrier imageMemoryBarrier{
 				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -205,13 +615,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 			};
 			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
-		device->flushCommandBuffer(copyCmd, copyQueue, true);
 
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-
-		// Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-		VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		// Generate the mip chain, recorded into the same command buffer as the upload so no additional submission is required
 		for (uint32_t i = 1; i < mipLevels; i++) {
 			VkImageBlit imageBlit{};
 			imageBlit.srcSubresource = {
@@ -246,9 +651,9 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 					.image = image,
 					.subresourceRange = mipSubRange
 				};
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
-			vkCmdBlitImage(blitCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
+			vkCmdBlitImage(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
 			{
 				VkImageMemoryBarrier imageMemoryBarrier{
 					.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -259,12 +664,11 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 					.image = image,
 					.subresourceRange = mipSubRange
 				};
-				vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 			}
 		}
 
 		subresourceRange.levelCount = mipLevels;
-		imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		{
 			VkImageMemoryBarrier imageMemoryBarrier{
 				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -275,137 +679,8 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 				.image = image,
 				.subresourceRange = subresourceRange
 			};
-			vkCmdPipelineBarrier(blitCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-		}
-        if (deleteBuffer) {
-            delete[] buffer;
-        }
-
-		device->flushCommandBuffer(blitCmd, copyQueue, true);
-	}
-	else {
-		// Texture is stored in an external ktx file
-		std::string filename = path + "/" + gltfimage.uri;
-
-		ktxTexture* ktxTexture;
-
-		ktxResult result = KTX_SUCCESS;
-#if defined(__ANDROID__)
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-		if (!asset) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
-		}
-		size_t size = AAsset_getLength(asset);
-		assert(size > 0);
-		ktx_uint8_t* textureData = new ktx_uint8_t[size];
-		AAsset_read(asset, textureData, size);
-		AAsset_close(asset);
-		result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-		delete[] textureData;
-#else
-		if (!vks::tools::fileExists(filename)) {
-			vks::tools::exitFatal("Could not load texture from " + filename + "\n\nMake sure the assets submodule has been checked out and is up-to-date.", -1);
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
 		}
-		result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif		
-		assert(result == KTX_SUCCESS);
-
-		this->device = device;
-		width = ktxTexture->baseWidth;
-		height = ktxTexture->baseHeight;
-		mipLevels = ktxTexture->numLevels;
-
-		ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-		ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-		format = ktxTexture_GetVkFormat(ktxTexture);
-
-		// Get device properties for the requested texture format
-		VkFormatProperties formatProperties;
-		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, format, &formatProperties);
-
-		VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		VkBufferCreateInfo bufferCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-			.size = ktxTextureSize,
-			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			.sharingMode = VK_SHARING_MODE_EXCLUSIVE
-		};
-		VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		VkMemoryRequirements memReqs;
-		vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-		VkMemoryAllocateInfo memAllocInfo{
-			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-			.allocationSize = memReqs.size,
-			.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-		};
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-		uint8_t* data{ nullptr };
-		VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-		memcpy(data, ktxTextureData, ktxTextureSize);
-		vkUnmapMemory(device->logicalDevice, stagingMemory);
-
-		std::vector<VkBufferImageCopy> bufferCopyRegions;
-		for (uint32_t i = 0; i < mipLevels; i++)
-		{
-			ktx_size_t offset;
-			KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-			assert(result == KTX_SUCCESS);
-			VkBufferImageCopy bufferCopyRegion{
-				.bufferOffset = offset,
-				.imageSubresource = {
-					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-					.mipLevel = i,
-					.baseArrayLayer = 0,
-					.layerCount = 1
-				},
-				.imageExtent = {
-					.width = std::max(1u, ktxTexture->baseWidth >> i),
-					.height = std::max(1u, ktxTexture->baseHeight >> i),
-					.depth = 1
-				}
-			};
-			bufferCopyRegions.push_back(bufferCopyRegion);
-		}
-
-		// Create optimal tiled target image
-		VkImageCreateInfo imageCreateInfo{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-			.imageType = VK_IMAGE_TYPE_2D,
-			.format = format,
-			.extent = { .width = width, .height = height, .depth = 1 },
-			.mipLevels = mipLevels,
-			.arrayLayers = 1,
-			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.tiling = VK_IMAGE_TILING_OPTIMAL,
-			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		};
-		VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
-
-		vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-		VkImageSubresourceRange subresourceRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = mipLevels, .layerCount = 1 };
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-		vkCmdCopyBufferToImage(copyCmd, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-		vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-		device->flushCommandBuffer(copyCmd, copyQueue);
-		this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-		vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-
-		ktxTexture_Destroy(ktxTexture);
 	}
 
 	VkSamplerCreateInfo samplerInfo{
@@ -441,22 +716,12 @@ void vkglTF::Texture::fromglTfImage(tinygltf::Image &gltfimage, std::string path
 /*
 	glTF material
 */
-void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
+void vkglTF::Material::createDescriptorSet(VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags)
 {
-	VkDescriptorSetAllocateInfo descriptorSetAllocInfo{
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-		.descriptorPool = descriptorPool,
-		.descriptorSetCount = 1,
-		.pSetLayouts = &descriptorSetLayout,
-	};
-	VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &descriptorSet));
-	std::vector<VkDescriptorImageInfo> imageDescriptors{};
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
 	if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-		imageDescriptors.push_back(baseColorTexture->descriptor);
 		VkWriteDescriptorSet writeDescriptorSet{
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = descriptorSet,
 			.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size()),
 			.descriptorCount = 1,
 			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -465,10 +730,8 @@ void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDe
 		writeDescriptorSets.push_back(writeDescriptorSet);
 	}
 	if (normalTexture && descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-		imageDescriptors.push_back(normalTexture->descriptor);
 		VkWriteDescriptorSet writeDescriptorSet{
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = descriptorSet,
 			.dstBinding = static_cast<uint32_t>(writeDescriptorSets.size()),
 			.descriptorCount = 1,
 			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -476,7 +739,7 @@ void vkglTF::Material::createDescriptorSet(VkDescriptorPool descriptorPool, VkDe
 		};
 		writeDescriptorSets.push_back(writeDescriptorSet);
 	}
-	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	descriptorSet = device->descriptorAllocator.getSet(descriptorSetLayout, writeDescriptorSets);
 }
 
 
@@ -494,23 +757,7 @@ void vkglTF::Primitive::setDimensions(glm::vec3 min, glm::vec3 max) {
 /*
 	glTF mesh
 */
-vkglTF::Mesh::Mesh(vks::VulkanDevice *device, glm::mat4 matrix) {
-	this->device = device;
-	this->uniformBlock.matrix = matrix;
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		sizeof(uniformBlock),
-		&uniformBuffer.buffer,
-		&uniformBuffer.memory,
-		&uniformBlock));
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-	uniformBuffer.descriptor = { uniformBuffer.buffer, 0, sizeof(uniformBlock) };
-};
-
 vkglTF::Mesh::~Mesh() {
-	vkDestroyBuffer(device->logicalDevice, uniformBuffer.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, uniformBuffer.memory, nullptr);
     for(auto primitive : primitives)
     {
         delete primitive;
@@ -525,6 +772,9 @@ glm::mat4 vkglTF::Node::localMatrix() {
 }
 
 glm::mat4 vkglTF::Node::getMatrix() {
+	if (hierarchy) {
+		return hierarchy->worldMatrices[hierarchyIndex];
+	}
 	glm::mat4 m = localMatrix();
 	vkglTF::Node *p = parent;
 	while (p) {
@@ -534,26 +784,27 @@ glm::mat4 vkglTF::Node::getMatrix() {
 	return m;
 }
 
-void vkglTF::Node::update() {
-	if (mesh) {
-		glm::mat4 m = getMatrix();
-		if (skin) {
-			mesh->uniformBlock.matrix = m;
-			// Update join matrices
-			glm::mat4 inverseTransform = glm::inverse(m);
-			for (size_t i = 0; i < skin->joints.size(); i++) {
-				vkglTF::Node *jointNode = skin->joints[i];
-				glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-				jointMat = inverseTransform * jointMat;
-				mesh->uniformBlock.jointMatrix[i] = jointMat;
-			}
-			mesh->uniformBlock.jointcount = (float)skin->joints.size();
-			memcpy(mesh->uniformBuffer.mapped, &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-		} else {
-			memcpy(mesh->uniformBuffer.mapped, &m, sizeof(glm::mat4));
+void vkglTF::Node::markDirty() {
+	if (hierarchy) {
+		hierarchy->dirty[hierarchyIndex] = 1;
+	}
+}
+
+void vkglTF::Node::updateMesh() {
+	// The node's own matrix is written by Model::updateNodeMatrices, only skinned meshes have additional matrices
+	if (mesh && skin && hierarchy) {
+		glm::mat4 inverseTransform = glm::inverse(getMatrix());
+		glm::mat4* jointMatrices = &hierarchy->bufferMatrices[mesh->jointMatrixIndex];
+		for (size_t i = 0; i < mesh->jointCount; i++) {
+			vkglTF::Node *jointNode = skin->joints[i];
+			glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
+			jointMatrices[i] = inverseTransform * jointMat;
 		}
 	}
+}
 
+void vkglTF::Node::update() {
+	updateMesh();
 	for (auto& child : children) {
 		child->update();
 	}
@@ -569,24 +820,218 @@ vkglTF::Node::~Node() {
 }
 
 /*
-	glTF default vertex layout with easy Vulkan mapping functions
+	glTF animation sampler
 */
+uint32_t vkglTF::AnimationSampler::findKeyframe(float time, uint32_t& cursor) const
+{
+	if (inputs.size() < 2) {
+		cursor = 0;
+		return 0;
+	}
+	const uint32_t last = static_cast<uint32_t>(inputs.size()) - 2;
+	cursor = std::min(cursor, last);
+	if ((time >= inputs[cursor]) && (time < inputs[cursor + 1])) {
+		return cursor;
+	}
+	// During playback, time usually only advances into the next interval
+	if ((cursor < last) && (time >= inputs[cursor + 1]) && (time < inputs[cursor + 2])) {
+		return ++cursor;
+	}
+	const auto upper = std::upper_bound(inputs.begin(), inputs.end(), time);
+	cursor = static_cast<uint32_t>(std::clamp<std::ptrdiff_t>(std::distance(inputs.begin(), upper) - 1, 0, last));
+	return cursor;
+}
 
-VkVertexInputBindingDescription vkglTF::Vertex::vertexInputBindingDescription;
-std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttributeDescriptions;
-VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
-
-VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding) {
-	return VkVertexInputBindingDescription({ binding, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX });
+bool vkglTF::AnimationSampler::valid() const
+{
+	const size_t outputsPerKeyframe = (interpolation == CUBICSPLINE) ? 3 : 1;
+	return !inputs.empty() && (outputsVec4.size() >= inputs.size() * outputsPerKeyframe);
 }
 
-VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) {
-	switch (component) {
-		case VertexComponent::Position: 
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) });
-		case VertexComponent::Normal:
-			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
-		case VertexComponent::UV:
+/*
+	Sampled animation channels in structure of arrays layout
+	Each entry interpolates between a and b by u, the results are written back to a
+	Translations and scales are interpolated linearly, rotations use normalized linear interpolation (nlerp) along the shorter arc
+	Groups of four entries are interpolated with SIMD instructions, the remainder is interpolated one by one
+*/
+struct AnimationBatch {
+	std::vector<float> ax, ay, az, aw;
+	std::vector<float> bx, by, bz, bw;
+	std::vector<float> u;
+	// Node and path the result is blended into, along with the weight of its layer
+	std::vector<uint32_t> slots;
+	std::vector<float> weights;
+
+	size_t size() const
+	{
+		return u.size();
+	}
+
+	void clear()
+	{
+		for (std::vector<float>* values : { &ax, &ay, &az, &aw, &bx, &by, &bz, &bw, &u, &weights }) {
+			values->clear();
+		}
+		slots.clear();
+	}
+
+	void add(const glm::vec4& a, const glm::vec4& b, float factor, uint32_t slot, float weight)
+	{
+		ax.push_back(a.x);
+		ay.push_back(a.y);
+		az.push_back(a.z);
+		aw.push_back(a.w);
+		bx.push_back(b.x);
+		by.push_back(b.y);
+		bz.push_back(b.z);
+		bw.push_back(b.w);
+		u.push_back(factor);
+		slots.push_back(slot);
+		weights.push_back(weight);
+	}
+
+	glm::vec4 result(size_t i) const
+	{
+		return glm::vec4(ax[i], ay[i], az[i], aw[i]);
+	}
+
+	void lerp()
+	{
+		size_t i = 0;
+#if defined(VKS_ANIMATION_SSE2) || defined(VKS_ANIMATION_NEON)
+		const std::pair<std::vector<float>*, std::vector<float>*> components[4] = { { &ax, &bx }, { &ay, &by }, { &az, &bz }, { &aw, &bw } };
+#endif
+#if defined(VKS_ANIMATION_SSE2)
+		for (; i + 4 <= size(); i += 4) {
+			const __m128 factor = _mm_loadu_ps(&u[i]);
+			for (size_t c = 0; c < 4; c++) {
+				const __m128 a = _mm_loadu_ps(&(*components[c].first)[i]);
+				const __m128 b = _mm_loadu_ps(&(*components[c].second)[i]);
+				_mm_storeu_ps(&(*components[c].first)[i], _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), factor)));
+			}
+		}
+#elif defined(VKS_ANIMATION_NEON)
+		for (; i + 4 <= size(); i += 4) {
+			const float32x4_t factor = vld1q_f32(&u[i]);
+			for (size_t c = 0; c < 4; c++) {
+				const float32x4_t a = vld1q_f32(&(*components[c].first)[i]);
+				const float32x4_t b = vld1q_f32(&(*components[c].second)[i]);
+				vst1q_f32(&(*components[c].first)[i], vmlaq_f32(a, vsubq_f32(b, a), factor));
+			}
+		}
+#endif
+		for (; i < size(); i++) {
+			ax[i] += (bx[i] - ax[i]) * u[i];
+			ay[i] += (by[i] - ay[i]) * u[i];
+			az[i] += (bz[i] - az[i]) * u[i];
+			aw[i] += (bw[i] - aw[i]) * u[i];
+		}
+	}
+
+	void nlerp()
+	{
+		size_t i = 0;
+#if defined(VKS_ANIMATION_SSE2)
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (; i + 4 <= size(); i += 4) {
+			const __m128 x0 = _mm_loadu_ps(&ax[i]), y0 = _mm_loadu_ps(&ay[i]), z0 = _mm_loadu_ps(&az[i]), w0 = _mm_loadu_ps(&aw[i]);
+			__m128 x1 = _mm_loadu_ps(&bx[i]), y1 = _mm_loadu_ps(&by[i]), z1 = _mm_loadu_ps(&bz[i]), w1 = _mm_loadu_ps(&bw[i]);
+			// Flip b to the hemisphere of a by copying the sign of the dot product
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)), _mm_add_ps(_mm_mul_ps(z0, z1), _mm_mul_ps(w0, w1)));
+			const __m128 sign = _mm_and_ps(dot, signMask);
+			x1 = _mm_xor_ps(x1, sign);
+			y1 = _mm_xor_ps(y1, sign);
+			z1 = _mm_xor_ps(z1, sign);
+			w1 = _mm_xor_ps(w1, sign);
+			const __m128 factor = _mm_loadu_ps(&u[i]);
+			const __m128 x = _mm_add_ps(x0, _mm_mul_ps(_mm_sub_ps(x1, x0), factor));
+			const __m128 y = _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(y1, y0), factor));
+			const __m128 z = _mm_add_ps(z0, _mm_mul_ps(_mm_sub_ps(z1, z0), factor));
+			const __m128 w = _mm_add_ps(w0, _mm_mul_ps(_mm_sub_ps(w1, w0), factor));
+			const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+			_mm_storeu_ps(&ax[i], _mm_div_ps(x, length));
+			_mm_storeu_ps(&ay[i], _mm_div_ps(y, length));
+			_mm_storeu_ps(&az[i], _mm_div_ps(z, length));
+			_mm_storeu_ps(&aw[i], _mm_div_ps(w, length));
+		}
+#elif defined(VKS_ANIMATION_NEON)
+		for (; i + 4 <= size(); i += 4) {
+			const float32x4_t x0 = vld1q_f32(&ax[i]), y0 = vld1q_f32(&ay[i]), z0 = vld1q_f32(&az[i]), w0 = vld1q_f32(&aw[i]);
+			float32x4_t x1 = vld1q_f32(&bx[i]), y1 = vld1q_f32(&by[i]), z1 = vld1q_f32(&bz[i]), w1 = vld1q_f32(&bw[i]);
+			// Flip b to the hemisphere of a by copying the sign of the dot product
+			const float32x4_t dot = vmlaq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(x0, x1), y0, y1), z0, z1), w0, w1);
+			const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(dot), vdupq_n_u32(0x80000000));
+			x1 = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(x1), sign));
+			y1 = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(y1), sign));
+			z1 = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(z1), sign));
+			w1 = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(w1), sign));
+			const float32x4_t factor = vld1q_f32(&u[i]);
+			const float32x4_t x = vmlaq_f32(x0, vsubq_f32(x1, x0), factor);
+			const float32x4_t y = vmlaq_f32(y0, vsubq_f32(y1, y0), factor);
+			const float32x4_t z = vmlaq_f32(z0, vsubq_f32(z1, z0), factor);
+			const float32x4_t w = vmlaq_f32(w0, vsubq_f32(w1, w0), factor);
+			const float32x4_t length = vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(x, x), y, y), z, z), w, w));
+			vst1q_f32(&ax[i], vdivq_f32(x, length));
+			vst1q_f32(&ay[i], vdivq_f32(y, length));
+			vst1q_f32(&az[i], vdivq_f32(z, length));
+			vst1q_f32(&aw[i], vdivq_f32(w, length));
+		}
+#endif
+		for (; i < size(); i++) {
+			const float dot = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i];
+			const float sign = dot < 0.0f ? -1.0f : 1.0f;
+			const float x = ax[i] + (bx[i] * sign - ax[i]) * u[i];
+			const float y = ay[i] + (by[i] * sign - ay[i]) * u[i];
+			const float z = az[i] + (bz[i] * sign - az[i]) * u[i];
+			const float w = aw[i] + (bw[i] * sign - aw[i]) * u[i];
+			const float length = sqrtf(x * x + y * y + z * z + w * w);
+			ax[i] = x / length;
+			ay[i] = y / length;
+			az[i] = z / length;
+			aw[i] = w / length;
+		}
+	}
+};
+
+/*
+	glTF default vertex layout with easy Vulkan mapping functions
+*/
+
+VkVertexInputBindingDescription vkglTF::Vertex::vertexInputBindingDescription;
+std::vector<VkVertexInputAttributeDescription> vkglTF::Vertex::vertexInputAttributeDescriptions;
+VkPipelineVertexInputStateCreateInfo vkglTF::Vertex::pipelineVertexInputStateCreateInfo;
+
+VkVertexInputBindingDescription vkglTF::Vertex::inputBindingDescription(uint32_t binding) {
+	return VkVertexInputBindingDescription({ binding, static_cast<uint32_t>(useCompactLayout() ? sizeof(CompactVertex) : sizeof(Vertex)), VK_VERTEX_INPUT_RATE_VERTEX });
+}
+
+VkVertexInputAttributeDescription vkglTF::Vertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) {
+	if (useCompactLayout()) {
+		switch (component) {
+			case VertexComponent::Position:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(CompactVertex, pos) });
+			case VertexComponent::Normal:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16B16A16_SNORM, offsetof(CompactVertex, normal) });
+			case VertexComponent::UV:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv) });
+			case VertexComponent::Color:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color) });
+			case VertexComponent::Tangent:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16B16A16_SNORM, offsetof(CompactVertex, tangent) });
+			case VertexComponent::Joint0:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16B16A16_SFLOAT, offsetof(CompactVertex, joint0) });
+			case VertexComponent::Weight0:
+				return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, weight0) });
+			default:
+				return VkVertexInputAttributeDescription({});
+		}
+	}
+	switch (component) {
+		case VertexComponent::Position: 
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos) });
+		case VertexComponent::Normal:
+			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
+		case VertexComponent::UV:
 			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
 		case VertexComponent::Color:
 			return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Vertex, color) });
@@ -623,6 +1068,97 @@ VkPipelineVertexInputStateCreateInfo* vkglTF::Vertex::getPipelineVertexInputStat
 	return &pipelineVertexInputStateCreateInfo;
 }
 
+bool vkglTF::Vertex::useCompactLayout() {
+	// Shaders that read vertex buffers directly expect the Vertex layout
+	const VkBufferUsageFlags shaderAccess = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+	return compactVertices && !(memoryPropertyFlags & shaderAccess);
+}
+
+// Rounds to the nearest half float, values too large for halfs become infinity
+static uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const uint32_t absBits = bits & 0x7fffffff;
+	if (absBits > 0x7f800000) {
+		return sign | 0x7e00;
+	}
+	if (absBits >= 0x47800000) {
+		return sign | 0x7c00;
+	}
+	uint32_t half, remainder, halfway;
+	if (absBits >= 0x38800000) {
+		// Normal range, rebias the exponent
+		half = (absBits - 0x38000000) >> 13;
+		remainder = absBits & 0x1fff;
+		halfway = 0x1000;
+	} else {
+		// Denormals
+		if (absBits < 0x33000000) {
+			return sign;
+		}
+		const uint32_t shift = 126 - (absBits >> 23);
+		const uint32_t mantissa = (absBits & 0x7fffff) | 0x800000;
+		half = mantissa >> shift;
+		remainder = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	if ((remainder > halfway) || ((remainder == halfway) && (half & 1))) {
+		half++;
+	}
+	return sign | static_cast<uint16_t>(half);
+}
+
+static int16_t floatToSnorm16(float value)
+{
+	return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint8_t floatToUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+std::vector<uint8_t> vkglTF::Vertex::pack(const Vertex* vertices, size_t count) {
+	if (!useCompactLayout()) {
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(vertices);
+		return std::vector<uint8_t>(data, data + count * sizeof(Vertex));
+	}
+	std::vector<uint8_t> result(count * sizeof(CompactVertex));
+	CompactVertex* compactVertices = reinterpret_cast<CompactVertex*>(result.data());
+	for (size_t i = 0; i < count; i++) {
+		const Vertex& vertex = vertices[i];
+		CompactVertex& compact = compactVertices[i];
+		compact.pos = vertex.pos;
+		for (int c = 0; c < 3; c++) {
+			compact.normal[c] = floatToSnorm16(vertex.normal[c]);
+		}
+		compact.normal[3] = 0;
+		for (int c = 0; c < 2; c++) {
+			compact.uv[c] = floatToHalf(vertex.uv[c]);
+		}
+		for (int c = 0; c < 4; c++) {
+			compact.color[c] = floatToUnorm8(vertex.color[c]);
+			compact.joint0[c] = floatToHalf(vertex.joint0[c]);
+			compact.tangent[c] = floatToSnorm16(vertex.tangent[c]);
+		}
+		// Rounding each weight on its own may change their sum, so the error is added to the largest weight
+		const float weightSum = vertex.weight0.x + vertex.weight0.y + vertex.weight0.z + vertex.weight0.w;
+		int32_t quantizedSum = 0;
+		int32_t largest = 0;
+		for (int c = 0; c < 4; c++) {
+			compact.weight0[c] = weightSum > 0.0f ? floatToUnorm8(vertex.weight0[c] / weightSum) : 0;
+			quantizedSum += compact.weight0[c];
+			largest = compact.weight0[c] > compact.weight0[largest] ? c : largest;
+		}
+		if (weightSum > 0.0f) {
+			compact.weight0[largest] = static_cast<uint8_t>(compact.weight0[largest] + (255 - quantizedSum));
+		}
+	}
+	return result;
+}
+
 vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 {
 
@@ -632,43 +1168,15 @@ vkglTF::Texture* vkglTF::Model::getTexture(uint32_t index)
 	return nullptr;
 }
 
-void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
+void vkglTF::Model::createEmptyTexture(VkCommandBuffer copyCmd, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
 {
+	// The (zeroed) texel data is expected to be in the staging buffer at stagingOffset
 	emptyTexture.device = device;
 	emptyTexture.width = 1;
 	emptyTexture.height = 1;
 	emptyTexture.layerCount = 1;
 	emptyTexture.mipLevels = 1;
 
-	size_t bufferSize = emptyTexture.width * emptyTexture.height * 4;
-	unsigned char* buffer = new unsigned char[bufferSize];
-	memset(buffer, 0, bufferSize);
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingMemory;
-	VkBufferCreateInfo bufferCreateInfo{
-		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.size = bufferSize,
-		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	};
-	VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-	VkMemoryRequirements memReqs;
-	vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-	VkMemoryAllocateInfo memAllocInfo{
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = memReqs.size,
-		.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-	};
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-	VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-	// Copy texture data into staging buffer
-	uint8_t* data{ nullptr };
-	VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void**)&data));
-	memcpy(data, buffer, bufferSize);
-	vkUnmapMemory(device->logicalDevice, stagingMemory);
-
 	// Create optimal tiled target image
 	VkImageCreateInfo imageCreateInfo{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -685,28 +1193,20 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 	};
 	VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &emptyTexture.image));
 
-	vkGetImageMemoryRequirements(device->logicalDevice, emptyTexture.image, &memReqs);
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &emptyTexture.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, emptyTexture.image, emptyTexture.deviceMemory, 0));
+	VK_CHECK_RESULT(device->allocateImageMemory(emptyTexture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &emptyTexture.allocation));
+	emptyTexture.deviceMemory = emptyTexture.allocation.memory;
 
 	VkBufferImageCopy bufferCopyRegion{
+		.bufferOffset = stagingOffset,
 		.imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
 		.imageExtent = {.width = emptyTexture.width, .height = emptyTexture.height, .depth = 1 }
 	};
 	VkImageSubresourceRange subresourceRange{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .layerCount = 1 };
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
 	vkCmdCopyBufferToImage(copyCmd, stagingBuffer, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
 	vks::tools::setImageLayout(copyCmd, emptyTexture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-	device->flushCommandBuffer(copyCmd, transferQueue);
 	emptyTexture.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	// Clean up staging resources
-	vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-
 	VkSamplerCreateInfo samplerCreateInfo{
 		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
 		.magFilter = VK_FILTER_LINEAR,
@@ -739,10 +1239,46 @@ void vkglTF::Model::createEmptyTexture(VkQueue transferQueue)
 */
 vkglTF::Model::~Model()
 {
+	// Don't leave a pending load behind
+	// The future of the CPU stages has already been consumed by updateLoading once the upload has been submitted, so only the upload is finished in that state
+	if (asyncLoad) {
+		switch (asyncLoad->state) {
+		case AsyncLoad::State::Processing:
+			if (asyncLoad->cpuStages.valid()) {
+				asyncLoad->cpuStages.wait();
+				if (asyncLoad->error.empty()) {
+					updateLoading(true);
+				}
+			}
+			break;
+		case AsyncLoad::State::Uploading:
+			updateLoading(true);
+			break;
+		}
+		asyncLoad.reset();
+	}
 	vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
 	vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
 	vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+	nodeMatrices.buffer.destroy();
+	bindless.buffer.destroy();
+	skinning.jobs.destroy();
+	skinning.vertices.destroy();
+	if (skinning.pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(device->logicalDevice, skinning.pipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, skinning.pipelineLayout, nullptr);
+		device->descriptorAllocator.free(skinning.descriptorSet);
+	}
+	indirect.commands.destroy();
+	indirect.drawData.destroy();
+	indirect.culledCommands.destroy();
+	indirect.drawCounts.destroy();
+	if (indirect.cullPipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(device->logicalDevice, indirect.cullPipeline, nullptr);
+		vkDestroyPipelineLayout(device->logicalDevice, indirect.cullPipelineLayout, nullptr);
+		device->descriptorAllocator.free(indirect.cullDescriptorSet);
+	}
 	for (auto& texture : textures) {
 		texture.destroy();
 	}
@@ -752,15 +1288,15 @@ vkglTF::Model::~Model()
     for (auto& skin : skins) {
         delete skin;
     }
-	if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutUbo, nullptr);
-		descriptorSetLayoutUbo = VK_NULL_HANDLE;
-	}
-	if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
-		vkDestroyDescriptorSetLayout(device->logicalDevice, descriptorSetLayoutImage, nullptr);
-		descriptorSetLayoutImage = VK_NULL_HANDLE;
+	// Layouts are owned by the device's descriptor allocator, loading another model gets the same layouts from its cache
+	descriptorSetLayoutUbo = VK_NULL_HANDLE;
+	descriptorSetLayoutImage = VK_NULL_HANDLE;
+	descriptorSetLayoutMaterials = VK_NULL_HANDLE;
+	device->descriptorAllocator.free(nodeMatrices.descriptorSet);
+	device->descriptorAllocator.free(bindless.descriptorSet);
+	for (auto& material : materials) {
+		device->descriptorAllocator.free(material.descriptorSet);
 	}
-	vkDestroyDescriptorPool(device->logicalDevice, descriptorPool, nullptr);
 	emptyTexture.destroy();
 }
 
@@ -806,7 +1342,7 @@ void vkglTF::Model::loadNode(vkglTF::Node *parent, const tinygltf::Node &node, u
 	// Node contains mesh data
 	if (node.mesh > -1) {
 		const tinygltf::Mesh mesh = model.meshes[node.mesh];
-		Mesh *newMesh = new Mesh(device, newNode->matrix);
+		Mesh *newMesh = new Mesh();
 		newMesh->name = mesh.name;
 		for (size_t j = 0; j < mesh.primitives.size(); j++) {
 			const tinygltf::Primitive &primitive = mesh.primitives[j];
@@ -999,16 +1535,18 @@ void vkglTF::Model::loadSkins(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadImages(tinygltf::Model &gltfModel, vks::VulkanDevice *device, VkQueue transferQueue)
+/*
+	Image index of a texture, textures using KHR_texture_basisu reference a KTX2 image in the extension and optionally a fallback image in source
+	The KTX2 image is only used if the Basis Universal transcoder has been built in or there is no valid fallback
+*/
+static int textureSource(const tinygltf::Model& gltfModel, const tinygltf::Texture& texture)
 {
-	for (tinygltf::Image &image : gltfModel.images) {
-		vkglTF::Texture texture;
-		texture.fromglTfImage(image, path, device, transferQueue);
-		texture.index = static_cast<uint32_t>(textures.size());
-		textures.push_back(texture);
+	auto extension = texture.extensions.find("KHR_texture_basisu");
+	const bool validFallback = (texture.source >= 0) && (static_cast<size_t>(texture.source) < gltfModel.images.size());
+	if ((extension != texture.extensions.end()) && extension->second.Has("source") && (vks::ktx2::transcoderAvailable() || !validFallback)) {
+		return extension->second.Get("source").GetNumberAsInt();
 	}
-	// Create an empty texture to be used for empty material images
-	createEmptyTexture(transferQueue);
+	return texture.source;
 }
 
 void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
@@ -1016,11 +1554,11 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 	for (tinygltf::Material &mat : gltfModel.materials) {
 		vkglTF::Material material(device);
 		if (mat.values.find("baseColorTexture") != mat.values.end()) {
-			material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
+			material.baseColorTexture = getTexture(textureSource(gltfModel, gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()]));
 		}
 		// Metallic roughness workflow
 		if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-			material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
+			material.metallicRoughnessTexture = getTexture(textureSource(gltfModel, gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()]));
 		}
 		if (mat.values.find("roughnessFactor") != mat.values.end()) {
 			material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
@@ -1032,15 +1570,15 @@ void vkglTF::Model::loadMaterials(tinygltf::Model &gltfModel)
 			material.baseColorFactor = glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
 		}				
 		if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
-			material.normalTexture = getTexture(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()].source);
+			material.normalTexture = getTexture(textureSource(gltfModel, gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()]));
 		} else {
 			material.normalTexture = &emptyTexture;
 		}
 		if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
-			material.emissiveTexture = getTexture(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()].source);
+			material.emissiveTexture = getTexture(textureSource(gltfModel, gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()]));
 		}
 		if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
-			material.occlusionTexture = getTexture(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()].source);
+			material.occlusionTexture = getTexture(textureSource(gltfModel, gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()]));
 		}
 		if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
 			tinygltf::Parameter param = mat.additionalValues["alphaMode"];
@@ -1175,249 +1713,1525 @@ void vkglTF::Model::loadAnimations(tinygltf::Model &gltfModel)
 	}
 }
 
-void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+/*
+	Model loading
+
+	Loading is split into stages:
+	- Parse: The glTF file is parsed by tinyglTF, images are not decoded at this point
+	- Decode: Images are decoded (or read from KTX files) in parallel
+	- Convert: Materials, nodes, vertices and animations are converted while images are decoded
+	- Upload: All images and buffers are uploaded with a single submission
+	The first three stages run on a background thread and worker threads, the upload is done on the thread that owns the transfer queue
+	If the mesh cache is enabled and up-to-date, parsing and converting are replaced by reading the cache (see below)
+*/
+
+// Shared by all model loads and node updates, so loading or animating multiple models at once doesn't oversubscribe the CPU
+static vks::JobSystem& modelJobSystem()
 {
-	tinygltf::Model gltfModel;
-	tinygltf::TinyGLTF gltfContext;
-	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
-		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
-	} else {
-		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
-	}
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	size_t pos = filename.find_last_of('/');
-	path = filename.substr(0, pos);
+	static vks::JobSystem jobSystem;
+	return jobSystem;
+}
 
-	std::string error, warning;
+bool vkglTF::LoadHandle::ready()
+{
+	return model ? model->updateLoading(false) : false;
+}
 
-	this->device = device;
+void vkglTF::LoadHandle::wait()
+{
+	if (model) {
+		model->updateLoading(true);
+	}
+}
 
-#if defined(__ANDROID__)
-	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
-	// We let tinygltf handle this, by passing the asset manager of our app
-	tinygltf::asset_manager = androidApp->activity->assetManager;
-#endif
-	bool fileLoaded = gltfContext.LoadASCIIFromFile(&gltfModel, &error, &warning, filename);
+/*
+	Mesh cache
 
-	std::vector<uint32_t> indexBuffer;
-	std::vector<Vertex> vertexBuffer;
+	A cooked version of the converted model that's written to the per-user cache directory (see meshCacheFile)
+	It contains the final vertex and index data (with the file loading flags applied), materials, the node hierarchy, skins and animations
+	The file is memory mapped on load, so the vertex and index data are copied to the staging buffer directly from the mapping
+	The cache is keyed by a hash of the glTF file and all buffer files it references along with the file loading flags and the scale, a stale cache is overwritten
+	Images are not part of the cache and are still decoded from their source files, so models with embedded images are not cached
+*/
 
-	if (fileLoaded) {
-		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-			loadImages(gltfModel, device, transferQueue);
-		}
-		loadMaterials(gltfModel);
-		const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
-		for (size_t i = 0; i < scene.nodes.size(); i++) {
-			const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
-			loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
-		}
-		if (gltfModel.animations.size() > 0) {
-			loadAnimations(gltfModel);
-		}
-		loadSkins(gltfModel);
+static const uint32_t meshCacheMagic = 0x434d4b56;
+// Needs to be increased whenever the layout of the cache or the cached data changes
+static const uint32_t meshCacheVersion = 3;
+
+struct MeshCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t fileLoadingFlags;
+	float scale;
+	uint32_t vertexSize;
+	// Model::lodSettings, these change the generated index data
+	uint32_t lodLevelCount;
+	float lodReduction;
+	float lodMaxError;
+	// Offsets are relative to the start of the file
+	uint64_t dependenciesOffset;
+	uint64_t dependenciesSize;
+	uint64_t sceneOffset;
+	uint64_t sceneSize;
+	uint64_t vertexOffset;
+	uint64_t vertexCount;
+	uint64_t indexOffset;
+	uint64_t indexCount;
+};
 
-		for (auto node : linearNodes) {
-			// Assign skins
-			if (node->skinIndex > -1) {
-				node->skin = skins[node->skinIndex];
-			}
-			// Initial pose
-			if (node->mesh) {
-				node->update();
-			}
-		}
+// 64 bit FNV-1a that consumes eight bytes at a time, only used to detect changes to the source files
+static uint64_t hashData(const uint8_t* data, size_t size, uint64_t hash)
+{
+	const uint64_t prime = 0x100000001b3ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * prime;
 	}
-	else {
-		vks::tools::exitFatal("Could not load glTF file \"" + filename + "\": " + error, -1);
-		return;
+	for (; i < size; i++) {
+		hash = (hash ^ data[i]) * prime;
 	}
+	return hash;
+}
 
-	// Pre-Calculations for requested features
-	if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
-		const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
-		const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
-		const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
-		for (Node* node : linearNodes) {
-			if (node->mesh) {
-				const glm::mat4 localMatrix = node->getMatrix();
-				for (Primitive* primitive : node->mesh->primitives) {
-					for (uint32_t i = 0; i < primitive->vertexCount; i++) {
-						Vertex& vertex = vertexBuffer[primitive->firstVertex + i];
-						// Pre-transform vertex positions by node-hierarchy
-						if (preTransform) {
-							vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
-							vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
-						}
-						// Flip Y-Axis of vertex positions
-						if (flipY) {
-							vertex.pos.y *= -1.0f;
-							vertex.normal.y *= -1.0f;
-						}
-						// Pre-Multiply vertex colors with material base color
-						if (preMultiplyColor) {
-							vertex.color = primitive->material.baseColorFactor * vertex.color;
-						}
-					}
-				}
-			}
-		}
+static bool hashFile(const std::string& filename, uint64_t& hash)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
 	}
+	// Chunk size is a multiple of eight, so the hash doesn't depend on how the file is split up
+	std::vector<uint8_t> chunk(1 << 20);
+	uint64_t fileSize = 0;
+	while (file) {
+		file.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+		size_t count = static_cast<size_t>(file.gcount());
+		hash = hashData(chunk.data(), count, hash);
+		fileSize += count;
+	}
+	hash = hashData(reinterpret_cast<const uint8_t*>(&fileSize), sizeof(fileSize), hash);
+	return true;
+}
 
-	for (auto& extension : gltfModel.extensionsUsed) {
-		if (extension == "KHR_materials_pbrSpecularGlossiness") {
-			std::cout << "Required extension: " << extension;
-			metallicRoughnessWorkflow = false;
+// Hash over the glTF file and the external files it depends on
+static bool hashSources(const std::string& filename, const std::string& path, const std::vector<std::string>& dependencies, uint64_t& hash)
+{
+	hash = 0xcbf29ce484222325ull;
+	if (!hashFile(filename, hash)) {
+		return false;
+	}
+	for (auto& dependency : dependencies) {
+		if (!hashFile(path + "/" + dependency, hash)) {
+			return false;
 		}
 	}
+	return true;
+}
 
-	size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-	size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-	indices.count = static_cast<uint32_t>(indexBuffer.size());
-	vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+static bool isDataUri(const std::string& uri)
+{
+	return uri.rfind("data:", 0) == 0;
+}
 
-	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+// Reads the encoded data of an image file, KTX and KTX2 files are read by decodeImage instead
+static bool readEncodedImage(const tinygltf::Image& image, const std::string& path, std::vector<unsigned char>& encoded)
+{
+	if (isKtxFile(image.uri)) {
+		return true;
+	}
+	std::ifstream file(path + "/" + image.uri, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		std::cerr << "Could not load texture from " << path + "/" + image.uri << std::endl;
+		return false;
+	}
+	encoded.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(encoded.data()), encoded.size());
+	return file.good();
+}
 
-	struct StagingBuffer {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} vertexStaging{}, indexStaging{};
+/*
+	Helpers to serialize the scene data of the mesh cache
+	The reader fails on reads past the end of the data, so a truncated or corrupt cache is detected instead of crashing
+*/
+class CacheWriter {
+public:
+	std::vector<uint8_t> data;
 
-	// Create staging buffers
-	// Vertex data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		vertexBufferSize,
-		&vertexStaging.buffer,
-		&vertexStaging.memory,
-		vertexBuffer.data()));
-	// Index data
-	VK_CHECK_RESULT(device->createBuffer(
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		indexBufferSize,
-		&indexStaging.buffer,
-		&indexStaging.memory,
-		indexBuffer.data()));
+	template<typename T> void write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+	}
 
-	// Create device local buffers
-	// Vertex buffer
-	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		vertexBufferSize,
-		&vertices.buffer,
-		&vertices.memory));
-	// Index buffer
-	VK_CHECK_RESULT(device->createBuffer(
-	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		indexBufferSize,
-		&indices.buffer,
-		&indices.memory));
+	void writeString(const std::string& value)
+	{
+		write(static_cast<uint32_t>(value.size()));
+		data.insert(data.end(), value.begin(), value.end());
+	}
+
+	template<typename T> void writeVector(const std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		write(static_cast<uint32_t>(values.size()));
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+		data.insert(data.end(), bytes, bytes + values.size() * sizeof(T));
+	}
+};
 
-	// Copy from staging buffers
-	VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+class CacheReader {
+private:
+	const uint8_t* pos;
+	const uint8_t* end;
+	bool available(size_t size)
+	{
+		valid = valid && (static_cast<size_t>(end - pos) >= size);
+		return valid;
+	}
+public:
+	bool valid{ true };
 
-	VkBufferCopy copyRegion = {};
+	CacheReader(const uint8_t* data, size_t size) : pos(data), end(data + size) {};
 
-	copyRegion.size = vertexBufferSize;
-	vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
+	template<typename T> T read()
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		T value{};
+		if (available(sizeof(T))) {
+			memcpy(&value, pos, sizeof(T));
+			pos += sizeof(T);
+		}
+		return value;
+	}
 
-	copyRegion.size = indexBufferSize;
-	vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
+	// Element counts can't exceed the remaining data, this guards against huge allocations for corrupt counts
+	uint32_t readCount()
+	{
+		uint32_t count = read<uint32_t>();
+		return available(count) ? count : 0;
+	}
 
-	device->flushCommandBuffer(copyCmd, transferQueue, true);
+	std::string readString()
+	{
+		uint32_t size = read<uint32_t>();
+		if (!available(size)) {
+			return {};
+		}
+		std::string value(reinterpret_cast<const char*>(pos), size);
+		pos += size;
+		return value;
+	}
 
-	vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-	vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-	vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+	template<typename T> std::vector<T> readVector()
+	{
+		uint32_t count = read<uint32_t>();
+		if (!available(static_cast<size_t>(count) * sizeof(T))) {
+			return {};
+		}
+		std::vector<T> values(count);
+		memcpy(values.data(), pos, static_cast<size_t>(count) * sizeof(T));
+		pos += static_cast<size_t>(count) * sizeof(T);
+		return values;
+	}
+};
 
-	getSceneDimensions();
+/*
+	Reads the scene from a mesh cache
+	Returns false if the cache doesn't exist, doesn't match the source files or the loading parameters, or is corrupt
+*/
+/*
+	Mesh caches are named after the model file and a hash of its absolute path, so models with the same file name don't share a cache
+	Returns an empty string if there is no cache directory, models are then always loaded from their source files
+*/
+static std::string meshCacheFile(const std::string& filename)
+{
+	const std::string cacheDirectory = vks::tools::getCacheDirectory();
+	if (cacheDirectory.empty()) {
+		return std::string();
+	}
+	std::error_code error;
+	const std::filesystem::path absolutePath = std::filesystem::absolute(filename, error);
+	const std::string key = error ? filename : absolutePath.lexically_normal().string();
+	const uint64_t hash = hashData(reinterpret_cast<const uint8_t*>(key.data()), key.size(), 0xcbf29ce484222325ull);
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+	return cacheDirectory + "/" + std::filesystem::path(filename).filename().string() + "." + name + ".meshcache";
+}
 
-	// Setup descriptors
-	uint32_t uboCount{ 0 };
-	uint32_t imageCount{ 0 };
-	for (auto& node : linearNodes) {
-		if (node->mesh) {
-			uboCount++;
+bool vkglTF::Model::readMeshCache(const std::string& cacheFile)
+{
+	AsyncLoad& load = *asyncLoad;
+	vks::tools::MappedFile& file = load.meshCache;
+	if (!file.open(cacheFile)) {
+		return false;
+	}
+	if (file.size < sizeof(MeshCacheHeader)) {
+		file.close();
+		return false;
+	}
+	MeshCacheHeader header;
+	memcpy(&header, file.data, sizeof(header));
+	auto validRange = [&](uint64_t offset, uint64_t size) {
+		return (offset <= file.size) && (size <= file.size - offset);
+	};
+	bool valid = (header.magic == meshCacheMagic) && (header.version == meshCacheVersion) && (header.vertexSize == load.vertexStride)
+		&& (header.fileLoadingFlags == load.fileLoadingFlags) && (header.scale == load.scale)
+		&& (header.lodLevelCount == lodSettings.levelCount) && (header.lodReduction == lodSettings.reduction) && (header.lodMaxError == lodSettings.maxError)
+		&& validRange(header.dependenciesOffset, header.dependenciesSize) && validRange(header.sceneOffset, header.sceneSize)
+		&& (header.vertexCount <= file.size / load.vertexStride) && validRange(header.vertexOffset, header.vertexCount * load.vertexStride)
+		&& (header.indexCount <= file.size / sizeof(uint32_t)) && validRange(header.indexOffset, header.indexCount * sizeof(uint32_t));
+	if (valid) {
+		// Check if the source files have changed since the cache has been written
+		CacheReader dependencyReader(file.data + header.dependenciesOffset, header.dependenciesSize);
+		std::vector<std::string> dependencies(dependencyReader.readCount());
+		for (auto& dependency : dependencies) {
+			dependency = dependencyReader.readString();
 		}
+		uint64_t sourceHash;
+		valid = dependencyReader.valid && hashSources(load.filename, path, dependencies, sourceHash) && (sourceHash == header.sourceHash);
 	}
-	for (auto& material : materials) {
-		if (material.baseColorTexture != nullptr) {
-			imageCount++;
+	if (!valid) {
+		std::cout << "Mesh cache \"" << cacheFile << "\" is out of date and will be rewritten" << std::endl;
+		file.close();
+		return false;
+	}
+
+	CacheReader reader(file.data + header.sceneOffset, header.sceneSize);
+	const bool loadImages = !(load.fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+
+	metallicRoughnessWorkflow = reader.read<uint8_t>() != 0;
+
+	// Images are only referenced by file name, decoding uses the same path as a regular load
+	uint32_t imageCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < imageCount && reader.valid; i++) {
+		tinygltf::Image image{};
+		image.uri = reader.readString();
+		load.gltfModel.images.push_back(image);
+	}
+	if (loadImages) {
+		textures.resize(load.gltfModel.images.size());
+		for (size_t i = 0; i < textures.size(); i++) {
+			textures[i].index = static_cast<uint32_t>(i);
 		}
 	}
-	std::vector<VkDescriptorPoolSize> poolSizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+
+	// Materials
+	auto textureFromRef = [&](int32_t ref) -> Texture* {
+		if (ref == -2) {
+			return &emptyTexture;
+		}
+		return ((ref >= 0) && (static_cast<size_t>(ref) < textures.size())) ? &textures[ref] : nullptr;
 	};
-	if (imageCount > 0) {
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
+	uint32_t materialCount = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < materialCount && reader.valid; i++) {
+		Material material(device);
+		material.alphaMode = static_cast<Material::AlphaMode>(reader.read<uint32_t>());
+		material.alphaCutoff = reader.read<float>();
+		material.metallicFactor = reader.read<float>();
+		material.roughnessFactor = reader.read<float>();
+		material.baseColorFactor = reader.read<glm::vec4>();
+		material.baseColorTexture = textureFromRef(reader.read<int32_t>());
+		material.metallicRoughnessTexture = textureFromRef(reader.read<int32_t>());
+		material.normalTexture = textureFromRef(reader.read<int32_t>());
+		material.occlusionTexture = textureFromRef(reader.read<int32_t>());
+		material.emissiveTexture = textureFromRef(reader.read<int32_t>());
+		materials.push_back(material);
+	}
+	// Primitives reference materials, so there always has to be at least the default material
+	valid = reader.valid && !materials.empty();
+
+	// Nodes are stored in the order of linearNodes, children come before their parents so all nodes are created before they are linked
+	std::vector<Node*> loadedNodes(valid ? reader.readCount() : 0);
+	std::vector<int32_t> parents(loadedNodes.size());
+	for (size_t i = 0; i < loadedNodes.size(); i++) {
+		Node* node = new Node{};
+		loadedNodes[i] = node;
+		parents[i] = reader.read<int32_t>();
+		node->index = reader.read<uint32_t>();
+		node->name = reader.readString();
+		node->skinIndex = reader.read<int32_t>();
+		node->matrix = reader.read<glm::mat4>();
+		node->translation = reader.read<glm::vec3>();
+		node->rotation = reader.read<glm::quat>();
+		node->scale = reader.read<glm::vec3>();
+		if (reader.read<uint8_t>() != 0) {
+			node->mesh = new Mesh();
+			node->mesh->name = reader.readString();
+			node->mesh->authoredVertexCache = reader.read<vks::meshopt::VertexCacheStatistics>();
+			node->mesh->optimizedVertexCache = reader.read<vks::meshopt::VertexCacheStatistics>();
+			uint32_t primitiveCount = reader.read<uint32_t>();
+			for (uint32_t j = 0; j < primitiveCount && reader.valid; j++) {
+				uint32_t firstIndex = reader.read<uint32_t>();
+				uint32_t indexCount = reader.read<uint32_t>();
+				uint32_t firstVertex = reader.read<uint32_t>();
+				uint32_t vertexCount = reader.read<uint32_t>();
+				uint32_t materialIndex = reader.read<uint32_t>();
+				glm::vec3 min = reader.read<glm::vec3>();
+				glm::vec3 max = reader.read<glm::vec3>();
+				Primitive* primitive = new Primitive(firstIndex, indexCount, materials[std::min(materialIndex, static_cast<uint32_t>(materials.size() - 1))]);
+				primitive->firstVertex = firstVertex;
+				primitive->vertexCount = vertexCount;
+				primitive->setDimensions(min, max);
+				primitive->lods.resize(reader.readCount());
+				for (auto& lod : primitive->lods) {
+					lod = reader.read<Primitive::Lod>();
+				}
+				node->mesh->primitives.push_back(primitive);
+			}
 		}
-		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-			poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount });
+		if (!reader.valid || (parents[i] >= static_cast<int32_t>(loadedNodes.size())) || (parents[i] >= 0 && parents[i] <= static_cast<int32_t>(i))) {
+			valid = false;
+			loadedNodes.resize(i + 1);
+			break;
 		}
 	}
-	VkDescriptorPoolCreateInfo descriptorPoolCI{
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-		.maxSets = uboCount + imageCount,
-		.poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
-		.pPoolSizes = poolSizes.data()
+	auto nodeFromRef = [&](int32_t ref) -> Node* {
+		if ((ref < 0) || (static_cast<size_t>(ref) >= loadedNodes.size())) {
+			valid = valid && (ref == -1);
+			return nullptr;
+		}
+		return loadedNodes[ref];
 	};
-	VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolCI, nullptr, &descriptorPool));
 
-	// Descriptors for per-node uniform buffers
-	{
-		// Layout is global, so only create if it hasn't already been created before
-		if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
-			VkDescriptorSetLayoutBinding setLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT };		
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, .bindingCount = 1, .pBindings = &setLayoutBinding };
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutUbo));
+	// Skins
+	uint32_t skinCount = valid ? reader.read<uint32_t>() : 0;
+	for (uint32_t i = 0; i < skinCount && reader.valid; i++) {
+		Skin* skin = new Skin{};
+		skin->name = reader.readString();
+		skin->skeletonRoot = nodeFromRef(reader.read<int32_t>());
+		for (int32_t joint : reader.readVector<int32_t>()) {
+			skin->joints.push_back(nodeFromRef(joint));
+		}
+		skin->inverseBindMatrices = reader.readVector<glm::mat4>();
+		skins.push_back(skin);
+	}
+
+	// Animations
+	uint32_t animationCount = valid ? reader.read<uint32_t>() : 0;
+	for (uint32_t i = 0; i < animationCount && reader.valid; i++) {
+		Animation animation{};
+		animation.name = reader.readString();
+		animation.start = reader.read<float>();
+		animation.end = reader.read<float>();
+		animation.samplers.resize(reader.readCount());
+		for (auto& sampler : animation.samplers) {
+			sampler.interpolation = static_cast<AnimationSampler::InterpolationType>(reader.read<uint32_t>());
+			sampler.inputs = reader.readVector<float>();
+			sampler.outputsVec4 = reader.readVector<glm::vec4>();
 		}
-		for (auto node : nodes) {
-			prepareNodeDescriptor(node, descriptorSetLayoutUbo);
+		animation.channels.resize(reader.readCount());
+		for (auto& channel : animation.channels) {
+			channel.path = static_cast<AnimationChannel::PathType>(reader.read<uint32_t>());
+			channel.node = nodeFromRef(reader.read<int32_t>());
+			channel.samplerIndex = reader.read<uint32_t>();
+			valid = valid && channel.node && (channel.samplerIndex < animation.samplers.size());
 		}
+		animations.push_back(animation);
 	}
 
-	// Descriptors for per-material images
-	{
-		// Layout is global, so only create if it hasn't already been created before
-		if (descriptorSetLayoutImage == VK_NULL_HANDLE) {
-			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
-			if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
-				setLayoutBindings.push_back({ .binding = static_cast<uint32_t>(setLayoutBindings.size()), .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT });
-			}
-			if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
-				setLayoutBindings.push_back({ .binding = static_cast<uint32_t>(setLayoutBindings.size()), .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT });
-			}
-			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-				.bindingCount = static_cast<uint32_t>(setLayoutBindings.size()),
-				.pBindings = setLayoutBindings.data(),
-			};
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayoutImage));
+	valid = valid && reader.valid;
+	for (Skin* skin : skins) {
+		for (Node* joint : skin->joints) {
+			valid = valid && (joint != nullptr);
 		}
-		for (auto& material : materials) {
-			if (material.baseColorTexture != nullptr) {
-				material.createDescriptorSet(descriptorPool, vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
-			}
+	}
+	if (!valid) {
+		// Nodes haven't been linked yet, so each one is deleted on its own
+		for (Node* node : loadedNodes) {
+			delete node;
+		}
+		for (Skin* skin : skins) {
+			delete skin;
 		}
+		skins.clear();
+		animations.clear();
+		materials.clear();
+		textures.clear();
+		load.gltfModel.images.clear();
+		file.close();
+		std::cout << "Mesh cache \"" << cacheFile << "\" is corrupt and will be rewritten" << std::endl;
+		return false;
 	}
-}
 
-void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
-{
-	const VkDeviceSize offsets[1] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-	buffersBound = true;
+	for (size_t i = 0; i < loadedNodes.size(); i++) {
+		Node* node = loadedNodes[i];
+		if (parents[i] >= 0) {
+			node->parent = loadedNodes[parents[i]];
+			node->parent->children.push_back(node);
+		} else {
+			nodes.push_back(node);
+		}
+		linearNodes.push_back(node);
+	}
+
+	load.vertexData = file.data + header.vertexOffset;
+	load.vertexCount = static_cast<size_t>(header.vertexCount);
+	load.indexData = file.data + header.indexOffset;
+	load.indexCount = static_cast<size_t>(header.indexCount);
+	return true;
+}
+
+/*
+	Writes the converted scene to a mesh cache, this is skipped for models that can't be cached (e.g. with embedded images)
+	The cache is written to a temporary file that's renamed at the end, so other instances never see a partially written cache
+*/
+void vkglTF::Model::writeMeshCache(const std::string& cacheFile)
+{
+	AsyncLoad& load = *asyncLoad;
+	const tinygltf::Model& gltfModel = load.gltfModel;
+	const bool loadImages = !(load.fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+
+	for (auto& image : gltfModel.images) {
+		if (loadImages && ((image.bufferView > -1) || image.uri.empty() || isDataUri(image.uri))) {
+			return;
+		}
+	}
+	std::vector<std::string> dependencies;
+	for (auto& buffer : gltfModel.buffers) {
+		if (!buffer.uri.empty() && !isDataUri(buffer.uri)) {
+			dependencies.push_back(buffer.uri);
+		}
+	}
+	MeshCacheHeader header{};
+	if (!hashSources(load.filename, path, dependencies, header.sourceHash)) {
+		return;
+	}
+
+	CacheWriter dependencyWriter;
+	dependencyWriter.write(static_cast<uint32_t>(dependencies.size()));
+	for (auto& dependency : dependencies) {
+		dependencyWriter.writeString(dependency);
+	}
+
+	CacheWriter writer;
+	writer.write<uint8_t>(metallicRoughnessWorkflow ? 1 : 0);
+
+	writer.write(static_cast<uint32_t>(gltfModel.images.size()));
+	for (auto& image : gltfModel.images) {
+		writer.writeString(image.uri);
+	}
+
+	// Texture references are stored as image indices, with -1 for no texture and -2 for the empty texture
+	auto textureRef = [&](const Texture* texture) -> int32_t {
+		if (!texture) {
+			return -1;
+		}
+		if (texture == &emptyTexture) {
+			return -2;
+		}
+		return static_cast<int32_t>(texture - textures.data());
+	};
+	writer.write(static_cast<uint32_t>(materials.size()));
+	for (auto& material : materials) {
+		writer.write(static_cast<uint32_t>(material.alphaMode));
+		writer.write(material.alphaCutoff);
+		writer.write(material.metallicFactor);
+		writer.write(material.roughnessFactor);
+		writer.write(material.baseColorFactor);
+		writer.write(textureRef(material.baseColorTexture));
+		writer.write(textureRef(material.metallicRoughnessTexture));
+		writer.write(textureRef(material.normalTexture));
+		writer.write(textureRef(material.occlusionTexture));
+		writer.write(textureRef(material.emissiveTexture));
+	}
+
+	std::unordered_map<const Node*, int32_t> nodeRefs;
+	for (size_t i = 0; i < linearNodes.size(); i++) {
+		nodeRefs[linearNodes[i]] = static_cast<int32_t>(i);
+	}
+	auto nodeRef = [&](const Node* node) -> int32_t {
+		return node ? nodeRefs[node] : -1;
+	};
+	writer.write(static_cast<uint32_t>(linearNodes.size()));
+	for (Node* node : linearNodes) {
+		writer.write(nodeRef(node->parent));
+		writer.write(node->index);
+		writer.writeString(node->name);
+		writer.write(node->skinIndex);
+		writer.write(node->matrix);
+		writer.write(node->translation);
+		writer.write(node->rotation);
+		writer.write(node->scale);
+		writer.write<uint8_t>(node->mesh ? 1 : 0);
+		if (node->mesh) {
+			writer.writeString(node->mesh->name);
+			writer.write(node->mesh->authoredVertexCache);
+			writer.write(node->mesh->optimizedVertexCache);
+			writer.write(static_cast<uint32_t>(node->mesh->primitives.size()));
+			for (Primitive* primitive : node->mesh->primitives) {
+				writer.write(primitive->firstIndex);
+				writer.write(primitive->indexCount);
+				writer.write(primitive->firstVertex);
+				writer.write(primitive->vertexCount);
+				writer.write(static_cast<uint32_t>(&primitive->material - materials.data()));
+				writer.write(primitive->dimensions.min);
+				writer.write(primitive->dimensions.max);
+				writer.write(static_cast<uint32_t>(primitive->lods.size()));
+				for (auto& lod : primitive->lods) {
+					writer.write(lod);
+				}
+			}
+		}
+	}
+
+	writer.write(static_cast<uint32_t>(skins.size()));
+	for (Skin* skin : skins) {
+		writer.writeString(skin->name);
+		writer.write(nodeRef(skin->skeletonRoot));
+		std::vector<int32_t> joints;
+		for (Node* joint : skin->joints) {
+			joints.push_back(nodeRef(joint));
+		}
+		writer.writeVector(joints);
+		writer.writeVector(skin->inverseBindMatrices);
+	}
+
+	writer.write(static_cast<uint32_t>(animations.size()));
+	for (auto& animation : animations) {
+		writer.writeString(animation.name);
+		writer.write(animation.start);
+		writer.write(animation.end);
+		writer.write(static_cast<uint32_t>(animation.samplers.size()));
+		for (auto& sampler : animation.samplers) {
+			writer.write(static_cast<uint32_t>(sampler.interpolation));
+			writer.writeVector(sampler.inputs);
+			writer.writeVector(sampler.outputsVec4);
+		}
+		writer.write(static_cast<uint32_t>(animation.channels.size()));
+		for (auto& channel : animation.channels) {
+			writer.write(static_cast<uint32_t>(channel.path));
+			writer.write(nodeRef(channel.node));
+			writer.write(channel.samplerIndex);
+		}
+	}
+
+	// Vertex and index data are aligned, so they can be used straight from the mapping
+	auto align = [](uint64_t offset) { return (offset + 15) & ~uint64_t(15); };
+	header.magic = meshCacheMagic;
+	header.version = meshCacheVersion;
+	header.fileLoadingFlags = load.fileLoadingFlags;
+	header.scale = load.scale;
+	header.vertexSize = static_cast<uint32_t>(load.vertexStride);
+	header.lodLevelCount = lodSettings.levelCount;
+	header.lodReduction = lodSettings.reduction;
+	header.lodMaxError = lodSettings.maxError;
+	header.dependenciesOffset = sizeof(MeshCacheHeader);
+	header.dependenciesSize = dependencyWriter.data.size();
+	header.sceneOffset = header.dependenciesOffset + header.dependenciesSize;
+	header.sceneSize = writer.data.size();
+	header.vertexOffset = align(header.sceneOffset + header.sceneSize);
+	header.vertexCount = load.vertexCount;
+	header.indexOffset = align(header.vertexOffset + header.vertexCount * load.vertexStride);
+	header.indexCount = load.indexBuffer.size();
+
+	// Failing to write the cache is treated like a cache miss, the model is loaded from its source files again next time
+	const std::string tempFile = cacheFile + ".tmp";
+	{
+		std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+		if (!stream.is_open()) {
+			return;
+		}
+		const char padding[16]{};
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(dependencyWriter.data.data()), dependencyWriter.data.size());
+		stream.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size());
+		stream.write(padding, header.vertexOffset - (header.sceneOffset + header.sceneSize));
+		stream.write(reinterpret_cast<const char*>(load.vertexData), header.vertexCount * load.vertexStride);
+		stream.write(padding, header.indexOffset - (header.vertexOffset + header.vertexCount * load.vertexStride));
+		stream.write(reinterpret_cast<const char*>(load.indexBuffer.data()), header.indexCount * sizeof(uint32_t));
+		if (!stream.good()) {
+			stream.close();
+			std::error_code error;
+			std::filesystem::remove(tempFile, error);
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempFile, cacheFile, error);
+	if (error) {
+		std::filesystem::remove(tempFile, error);
+	}
+}
+
+/*
+	Mesh optimization
+
+	With FileLoadingFlags::OptimizeMeshes, the vertices and indices of each primitive are optimized after conversion:
+	- Vertices with identical contents are merged
+	- Triangles are reordered for the post-transform vertex cache and clusters of triangles are sorted to reduce overdraw
+	- Vertices are reordered by their first use and unreferenced vertices are dropped, so vertex fetches are mostly linear
+	None of these change what is rendered: Triangles keep their vertex order (winding and provoking vertex), and primitives with blended materials keep their triangle order as blending depends on it
+	Primitives are independent of each other, so they are optimized in parallel
+	The optimized data is stored in the mesh cache (the loading flags are part of the cache key)
+*/
+
+void vkglTF::Model::optimizeMeshes(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer)
+{
+	struct OptimizedPrimitive {
+		Primitive* primitive;
+		Mesh* mesh;
+		std::vector<Vertex> vertices;
+		vks::meshopt::VertexCacheStatistics authored;
+		vks::meshopt::VertexCacheStatistics optimized;
+	};
+	std::vector<OptimizedPrimitive> optimizedPrimitives;
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			node->mesh->authoredVertexCache = {};
+			node->mesh->optimizedVertexCache = {};
+			for (Primitive* primitive : node->mesh->primitives) {
+				optimizedPrimitives.push_back({ primitive, node->mesh });
+			}
+		}
+	}
+	// Keep the order of the primitives in the vertex buffer
+	std::sort(optimizedPrimitives.begin(), optimizedPrimitives.end(), [](const OptimizedPrimitive& a, const OptimizedPrimitive& b) { return a.primitive->firstVertex < b.primitive->firstVertex; });
+
+	// Indices are rebased to the primitive's first vertex while optimizing, the primitive's index range is updated in place
+	modelJobSystem().parallelFor(static_cast<uint32_t>(optimizedPrimitives.size()), [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			OptimizedPrimitive& optimizedPrimitive = optimizedPrimitives[i];
+			Primitive* primitive = optimizedPrimitive.primitive;
+			uint32_t* indices = indexBuffer.data() + primitive->firstIndex;
+			const size_t indexCount = primitive->indexCount;
+			const Vertex* vertices = vertexBuffer.data() + primitive->firstVertex;
+			size_t vertexCount = primitive->vertexCount;
+			bool validIndices = true;
+			for (size_t j = 0; j < indexCount; j++) {
+				indices[j] -= primitive->firstVertex;
+				validIndices &= (indices[j] < vertexCount);
+			}
+			optimizedPrimitive.authored = vks::meshopt::analyzeVertexCache(indices, indexCount, vertexCount);
+			if (!validIndices) {
+				// Indices outside of the primitive's vertices can't be remapped, leave the primitive as it is
+				optimizedPrimitive.vertices.assign(vertices, vertices + vertexCount);
+				optimizedPrimitive.optimized = optimizedPrimitive.authored;
+				continue;
+			}
+
+			std::vector<uint32_t> remap;
+			vertexCount = vks::meshopt::generateVertexRemap(remap, indices, indexCount, vertices, vertexCount, sizeof(Vertex));
+			vks::meshopt::remapIndexBuffer(indices, indices, indexCount, remap);
+			std::vector<Vertex> uniqueVertices = vks::meshopt::remapVertexBuffer(vertices, primitive->vertexCount, vertexCount, remap);
+
+			if ((primitive->material.alphaMode != Material::ALPHAMODE_BLEND) && (indexCount > 0) && (indexCount % 3 == 0)) {
+				std::vector<uint32_t> reordered(indexCount);
+				std::vector<uint32_t> clusters;
+				vks::meshopt::optimizeVertexCache(reordered.data(), indices, indexCount, vertexCount, &clusters);
+				vks::meshopt::optimizeOverdraw(indices, reordered.data(), indexCount, &uniqueVertices[0].pos.x, vertexCount, sizeof(Vertex), clusters);
+			}
+
+			vertexCount = vks::meshopt::generateVertexFetchRemap(remap, indices, indexCount, vertexCount);
+			vks::meshopt::remapIndexBuffer(indices, indices, indexCount, remap);
+			optimizedPrimitive.vertices = vks::meshopt::remapVertexBuffer(uniqueVertices.data(), uniqueVertices.size(), vertexCount, remap);
+			optimizedPrimitive.optimized = vks::meshopt::analyzeVertexCache(indices, indexCount, vertexCount);
+		}
+	}, 1);
+
+	// Primitives may have lost vertices, so the vertex buffer is rebuilt and the indices are rebased to the new first vertex
+	std::vector<Vertex> optimizedVertices;
+	optimizedVertices.reserve(vertexBuffer.size());
+	for (OptimizedPrimitive& optimizedPrimitive : optimizedPrimitives) {
+		Primitive* primitive = optimizedPrimitive.primitive;
+		primitive->firstVertex = static_cast<uint32_t>(optimizedVertices.size());
+		primitive->vertexCount = static_cast<uint32_t>(optimizedPrimitive.vertices.size());
+		for (uint32_t i = 0; i < primitive->indexCount; i++) {
+			indexBuffer[primitive->firstIndex + i] += primitive->firstVertex;
+		}
+		optimizedVertices.insert(optimizedVertices.end(), optimizedPrimitive.vertices.begin(), optimizedPrimitive.vertices.end());
+		optimizedPrimitive.mesh->authoredVertexCache += optimizedPrimitive.authored;
+		optimizedPrimitive.mesh->optimizedVertexCache += optimizedPrimitive.optimized;
+	}
+	vertexBuffer.swap(optimizedVertices);
+}
+
+/*
+	Level of detail generation
+
+	With FileLoadingFlags::GenerateLods, a chain of simplified versions is generated for each primitive after conversion (and optimization)
+	Each level is simplified from the previous one to lodSettings.reduction of its index count, the error of a level is the sum of the errors of all simplification steps up to it
+	The chain ends once the error would exceed lodSettings.maxError times the primitive's radius or if simplification doesn't remove enough triangles
+	The levels only reference the primitive's existing vertices and their indices are appended to the shared index buffer, so they're stored in the mesh cache along with the other data
+*/
+
+void vkglTF::Model::generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+{
+	std::vector<Primitive*> primitives;
+	for (Node* node : linearNodes) {
+		if (node->mesh) {
+			primitives.insert(primitives.end(), node->mesh->primitives.begin(), node->mesh->primitives.end());
+		}
+	}
+	// Indices of all levels of a primitive relative to its first vertex, Lod::firstIndex is relative to the start of these until they are appended to the index buffer
+	std::vector<std::vector<uint32_t>> lodIndices(primitives.size());
+
+	modelJobSystem().parallelFor(static_cast<uint32_t>(primitives.size()), [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			Primitive* primitive = primitives[i];
+			primitive->lods = { { primitive->firstIndex, primitive->indexCount, 0.0f } };
+			if ((primitive->indexCount < 3) || (primitive->indexCount % 3 != 0)) {
+				continue;
+			}
+			const Vertex* vertices = vertexBuffer.data() + primitive->firstVertex;
+			const size_t vertexCount = primitive->vertexCount;
+			std::vector<uint32_t> indices(indexBuffer.begin() + primitive->firstIndex, indexBuffer.begin() + primitive->firstIndex + primitive->indexCount);
+			bool validIndices = true;
+			for (uint32_t& index : indices) {
+				index -= primitive->firstVertex;
+				validIndices &= (index < vertexCount);
+			}
+			if (!validIndices) {
+				continue;
+			}
+
+			// The simplifier takes the connectivity from the indices, so identical vertices are referenced by the index of their first occurrence
+			std::vector<uint32_t> remap;
+			const size_t uniqueCount = vks::meshopt::generateVertexRemap(remap, indices.data(), indices.size(), vertices, vertexCount, sizeof(Vertex));
+			std::vector<uint32_t> firstOccurrence(uniqueCount);
+			for (size_t v = vertexCount; v-- > 0;) {
+				if (remap[v] != vks::meshopt::invalidIndex) {
+					firstOccurrence[remap[v]] = static_cast<uint32_t>(v);
+				}
+			}
+			for (uint32_t& index : indices) {
+				index = firstOccurrence[remap[index]];
+			}
+
+			const float maxError = lodSettings.maxError * primitive->dimensions.radius;
+			float error = 0.0f;
+			std::vector<uint32_t> simplified(indices.size());
+			for (uint32_t level = 1; level < lodSettings.levelCount; level++) {
+				const size_t targetIndexCount = static_cast<size_t>(indices.size() * lodSettings.reduction) / 3 * 3;
+				float levelError = 0.0f;
+				const size_t indexCount = vks::meshopt::simplify(simplified.data(), indices.data(), indices.size(), &vertices[0].pos.x, vertexCount, sizeof(Vertex), targetIndexCount, maxError - error, &levelError);
+				// Levels that barely reduce the triangle count aren't worth the memory
+				if ((indexCount == 0) || (indexCount * 10 > indices.size() * 9)) {
+					break;
+				}
+				error += levelError;
+				indices.resize(indexCount);
+				vks::meshopt::optimizeVertexCache(indices.data(), simplified.data(), indexCount, vertexCount);
+				primitive->lods.push_back({ static_cast<uint32_t>(lodIndices[i].size()), static_cast<uint32_t>(indexCount), error });
+				lodIndices[i].insert(lodIndices[i].end(), indices.begin(), indices.end());
+			}
+		}
+	}, 1);
+
+	for (size_t i = 0; i < primitives.size(); i++) {
+		const uint32_t lodStart = static_cast<uint32_t>(indexBuffer.size());
+		for (uint32_t index : lodIndices[i]) {
+			indexBuffer.push_back(index + primitives[i]->firstVertex);
+		}
+		for (size_t level = 1; level < primitives[i]->lods.size(); level++) {
+			primitives[i]->lods[level].firstIndex += lodStart;
+		}
+	}
+}
+
+/*
+	Flattens all primitives into one indirect command each for the GPU-driven draw path
+	Commands are grouped by alpha mode, so each mode can be drawn (and compacted) as one contiguous range
+*/
+void vkglTF::Model::flattenDraws()
+{
+	AsyncLoad& load = *asyncLoad;
+	const bool preTransform = load.fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+	const bool flipY = load.fileLoadingFlags & FileLoadingFlags::FlipY;
+
+	std::array<std::vector<std::pair<Node*, Primitive*>>, 3> rangePrimitives;
+	for (Node* node : nodeHierarchy.nodes) {
+		if (node->mesh) {
+			for (Primitive* primitive : node->mesh->primitives) {
+				if (primitive->indexCount > 0) {
+					rangePrimitives[primitive->material.alphaMode].push_back({ node, primitive });
+				}
+			}
+		}
+	}
+
+	load.indirectCommands.clear();
+	load.indirectDrawData.clear();
+	for (uint32_t range = 0; range < static_cast<uint32_t>(rangePrimitives.size()); range++) {
+		const uint32_t rangeFirst = static_cast<uint32_t>(load.indirectCommands.size());
+		indirect.ranges[range] = { .first = rangeFirst, .count = static_cast<uint32_t>(rangePrimitives[range].size()) };
+		for (auto& [node, primitive] : rangePrimitives[range]) {
+			// The draw index is passed as the first instance, so shaders can fetch their per-draw data
+			load.indirectCommands.push_back({
+				.indexCount = primitive->indexCount,
+				.instanceCount = 1,
+				.firstIndex = primitive->firstIndex,
+				.vertexOffset = 0,
+				.firstInstance = static_cast<uint32_t>(load.indirectCommands.size())
+			});
+			// Bounds need to be in the same space as the vertices, which have the pre-calculations applied
+			glm::vec3 center = primitive->dimensions.center;
+			float radius = primitive->dimensions.radius;
+			if (preTransform) {
+				const glm::mat4 matrix = node->getMatrix();
+				center = glm::vec3(matrix * glm::vec4(center, 1.0f));
+				radius *= std::max({ glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])) });
+			}
+			if (flipY) {
+				center.y *= -1.0f;
+			}
+			load.indirectDrawData.push_back({
+				.boundingSphere = glm::vec4(center, radius),
+				.transformIndex = node->hierarchyIndex * nodeHierarchy.matrixStride,
+				.materialIndex = static_cast<uint32_t>(&primitive->material - materials.data()),
+				.range = range,
+				.rangeFirst = rangeFirst
+			});
+		}
+	}
+	indirect.drawCount = static_cast<uint32_t>(load.indirectCommands.size());
+}
+
+/*
+	Creates the buffers of the indirect draw path, the uploads are recorded into the current batch of the staging ring
+*/
+void vkglTF::Model::createIndirectBuffers()
+{
+	AsyncLoad& load = *asyncLoad;
+	if (indirect.drawCount == 0) {
+		return;
+	}
+	const VkDeviceSize commandsSize = load.indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+	const VkDeviceSize drawDataSize = load.indirectDrawData.size() * sizeof(IndirectDrawData);
+	const VkDeviceSize drawCountsSize = indirect.ranges.size() * sizeof(uint32_t);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirect.commands, commandsSize));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirect.culledCommands, commandsSize));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirect.drawData, drawDataSize));
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indirect.drawCounts, drawCountsSize));
+
+	// Until the first culling pass, the culled commands draw everything
+	std::array<uint32_t, 3> drawCounts{};
+	for (size_t i = 0; i < indirect.ranges.size(); i++) {
+		drawCounts[i] = indirect.ranges[i].count;
+	}
+	vks::StagingRing& stagingRing = device->stagingRing;
+	vks::StagingRing::Allocation staging = stagingRing.upload(load.indirectCommands.data(), commandsSize);
+	VkBufferCopy copyRegion{ .srcOffset = staging.offset, .dstOffset = 0, .size = commandsSize };
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, indirect.commands.buffer, 1, &copyRegion);
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, indirect.culledCommands.buffer, 1, &copyRegion);
+	staging = stagingRing.upload(load.indirectDrawData.data(), drawDataSize);
+	copyRegion = { .srcOffset = staging.offset, .dstOffset = 0, .size = drawDataSize };
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, indirect.drawData.buffer, 1, &copyRegion);
+	staging = stagingRing.upload(drawCounts.data(), drawCountsSize);
+	copyRegion = { .srcOffset = staging.offset, .dstOffset = 0, .size = drawCountsSize };
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, indirect.drawCounts.buffer, 1, &copyRegion);
+}
+
+/*
+	Creates the node matrix buffer with all frame slices set to the initial pose, the buffer is host visible so no upload is required
+*/
+void vkglTF::Model::createNodeMatrixBuffer()
+{
+	// Slices are bound with dynamic offsets for both uniform and storage buffer descriptors
+	const VkPhysicalDeviceLimits& limits = device->properties.limits;
+	const VkDeviceSize alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+	const VkDeviceSize matricesSize = nodeHierarchy.bufferMatrices.size() * sizeof(glm::mat4);
+	nodeMatrices.frameSize = (matricesSize + alignment - 1) & ~(alignment - 1);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &nodeMatrices.buffer, nodeMatrices.frameSize * framesInFlight));
+	VK_CHECK_RESULT(nodeMatrices.buffer.map());
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		memcpy(static_cast<uint8_t*>(nodeMatrices.buffer.mapped) + nodeMatrices.frameOffset(i), nodeHierarchy.bufferMatrices.data(), matricesSize);
+		nodeMatrices.frameVersions[i] = nodeHierarchy.version;
+	}
+}
+
+/*
+	Creates the buffers of the compute skinning pass, the job upload is recorded into the current batch of the staging ring
+*/
+void vkglTF::Model::createSkinningBuffers()
+{
+	// The compute shader reads the vertex buffer with the default layout
+	if (!(memoryPropertyFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)) {
+		std::cerr << "GPU skinning requires vkglTF::memoryPropertyFlags to contain VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshes are not skinned" << std::endl;
+		return;
+	}
+	std::vector<SkinningJob> jobs;
+	for (uint32_t nodeIndex : nodeHierarchy.meshNodes) {
+		Node* node = nodeHierarchy.nodes[nodeIndex];
+		Mesh* mesh = node->mesh;
+		if (!node->skin || (mesh->jointCount == 0)) {
+			continue;
+		}
+		// The vertices of all primitives of a mesh are stored next to each other
+		uint32_t firstVertex = UINT32_MAX;
+		uint32_t lastVertex = 0;
+		for (Primitive* primitive : mesh->primitives) {
+			if (primitive->vertexCount > 0) {
+				firstVertex = std::min(firstVertex, primitive->firstVertex);
+				lastVertex = std::max(lastVertex, primitive->firstVertex + primitive->vertexCount);
+			}
+		}
+		if (firstVertex >= lastVertex) {
+			continue;
+		}
+		const SkinningJob job{ .firstVertex = firstVertex, .vertexCount = lastVertex - firstVertex, .outputFirstVertex = skinning.vertexCount, .jointMatrixIndex = mesh->jointMatrixIndex };
+		mesh->gpuSkinned = true;
+		mesh->skinnedVertexOffset = static_cast<int32_t>(job.outputFirstVertex) - static_cast<int32_t>(job.firstVertex);
+		skinning.vertexCount += job.vertexCount;
+		skinning.maxJobVertexCount = std::max(skinning.maxJobVertexCount, job.vertexCount);
+		jobs.push_back(job);
+	}
+	skinning.jobCount = static_cast<uint32_t>(jobs.size());
+	if (skinning.jobCount == 0) {
+		return;
+	}
+
+	const VkDeviceSize alignment = device->properties.limits.minStorageBufferOffsetAlignment;
+	skinning.frameSize = (skinning.vertexCount * sizeof(Vertex) + alignment - 1) & ~(alignment - 1);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &skinning.vertices, skinning.frameSize * framesInFlight));
+	const VkDeviceSize jobsSize = jobs.size() * sizeof(SkinningJob);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &skinning.jobs, jobsSize));
+	vks::StagingRing& stagingRing = device->stagingRing;
+	vks::StagingRing::Allocation staging = stagingRing.upload(jobs.data(), jobsSize);
+	VkBufferCopy copyRegion{ .srcOffset = staging.offset, .dstOffset = 0, .size = jobsSize };
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, skinning.jobs.buffer, 1, &copyRegion);
+}
+
+static_assert(sizeof(vkglTF::MaterialData) == 64, "MaterialData doesn't match the std430 layout of the bindless material shaders");
+
+/*
+	Creates the buffer with the parameters of all materials for the bindless material set
+	The empty texture is appended to the model's textures, so materials without a texture can still be sampled like the per-material sets do
+*/
+void vkglTF::Model::createMaterialBuffer()
+{
+	if (asyncLoad->fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
+		std::cerr << "Bindless materials require images to be loaded, materials can only be bound per draw" << std::endl;
+		return;
+	}
+	bindless.textureCount = static_cast<uint32_t>(textures.size()) + 1;
+	if (bindless.textureCount > maxBindlessTextures) {
+		std::cerr << "Model has " << bindless.textureCount << " textures, which exceeds the bindless texture limit of " << maxBindlessTextures << ", materials can only be bound per draw" << std::endl;
+		bindless.textureCount = 0;
+		return;
+	}
+	const uint32_t emptyTextureIndex = bindless.textureCount - 1;
+	auto textureIndex = [&](const Texture* texture) -> uint32_t {
+		return ((texture == nullptr) || (texture == &emptyTexture)) ? emptyTextureIndex : texture->index;
+	};
+	std::vector<MaterialData> materialData(materials.size());
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material& material = materials[i];
+		materialData[i] = {
+			.baseColorFactor = material.baseColorFactor,
+			.baseColorTextureIndex = textureIndex(material.baseColorTexture),
+			.normalTextureIndex = textureIndex(material.normalTexture),
+			.metallicRoughnessTextureIndex = textureIndex(material.metallicRoughnessTexture),
+			.occlusionTextureIndex = textureIndex(material.occlusionTexture),
+			.emissiveTextureIndex = textureIndex(material.emissiveTexture),
+			.metallicFactor = material.metallicFactor,
+			.roughnessFactor = material.roughnessFactor,
+			.alphaCutoff = material.alphaCutoff,
+			.alphaMode = static_cast<uint32_t>(material.alphaMode),
+		};
+	}
+	const VkDeviceSize materialDataSize = materialData.size() * sizeof(MaterialData);
+	VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &bindless.buffer, materialDataSize));
+	vks::StagingRing& stagingRing = device->stagingRing;
+	vks::StagingRing::Allocation staging = stagingRing.upload(materialData.data(), materialDataSize);
+	VkBufferCopy copyRegion{ .srcOffset = staging.offset, .dstOffset = 0, .size = materialDataSize };
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, bindless.buffer.buffer, 1, &copyRegion);
+}
+
+void vkglTF::Model::runCpuStages()
+{
+	AsyncLoad& load = *asyncLoad;
+	const bool loadImages = !(load.fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+#if defined(__ANDROID__)
+	// Model files are read through the asset manager on Android, so a cache can't be checked against them
+	const std::string cacheFile;
+#else
+	const std::string cacheFile = meshCacheEnabled ? meshCacheFile(load.filename) : std::string();
+#endif
+	const bool useMeshCache = !cacheFile.empty();
+	load.vertexStride = Vertex::useCompactLayout() ? sizeof(CompactVertex) : sizeof(Vertex);
+
+	auto tStart = std::chrono::high_resolution_clock::now();
+	loadTimings.meshCacheHit = useMeshCache && readMeshCache(cacheFile);
+	if (!loadTimings.meshCacheHit) {
+		tinygltf::TinyGLTF gltfContext;
+		if (loadImages) {
+			gltfContext.SetImageLoader(loadImageDataFuncDeferred, &load.encodedImages);
+		} else {
+			gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
+		}
+#if defined(__ANDROID__)
+		// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
+		// We let tinygltf handle this, by passing the asset manager of our app
+		tinygltf::asset_manager = androidApp->activity->assetManager;
+#endif
+		std::string error, warning;
+		bool fileLoaded = gltfContext.LoadASCIIFromFile(&load.gltfModel, &error, &warning, load.filename);
+		if (!fileLoaded) {
+			load.error = "Could not load glTF file \"" + load.filename + "\": " + error;
+			return;
+		}
+	}
+	loadTimings.parse = millisecondsSince(tStart);
+
+	tinygltf::Model& gltfModel = load.gltfModel;
+
+	// Materials reference textures, so these need to exist before the conversion starts
+	if (loadImages) {
+		textures.resize(gltfModel.images.size());
+		for (size_t i = 0; i < textures.size(); i++) {
+			textures[i].index = static_cast<uint32_t>(i);
+		}
+		load.images.resize(gltfModel.images.size());
+		load.encodedImages.resize(gltfModel.images.size());
+	}
+
+	vks::JobSystem& jobSystem = modelJobSystem();
+
+	// The scene data is converted in a single job that runs next to the image decoding
+	vks::JobCounter convertCounter;
+	jobSystem.run([this, &load] {
+		auto tStart = std::chrono::high_resolution_clock::now();
+		tinygltf::Model& gltfModel = load.gltfModel;
+		// The mesh cache already contains the converted scene
+		if (!loadTimings.meshCacheHit) {
+			loadMaterials(gltfModel);
+			const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+			for (size_t i = 0; i < scene.nodes.size(); i++) {
+				const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
+				loadNode(nullptr, node, scene.nodes[i], gltfModel, load.indexBuffer, load.vertexBuffer, load.scale);
+			}
+			if (gltfModel.animations.size() > 0) {
+				loadAnimations(gltfModel);
+			}
+			loadSkins(gltfModel);
+		}
+
+		// Assign skins
+		for (auto node : linearNodes) {
+			if (node->skinIndex > -1) {
+				node->skin = skins[node->skinIndex];
+			}
+		}
+		// Initial pose, all nodes start out dirty
+		buildNodeHierarchy();
+		nodeHierarchy.preTransformed = load.fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+		updateNodeMatrices();
+
+		// Pre-Calculations for requested features, cached vertices already have these applied
+		const uint32_t fileLoadingFlags = load.fileLoadingFlags;
+		if (!loadTimings.meshCacheHit && ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY))) {
+			const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
+			const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
+			const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
+			for (Node* node : linearNodes) {
+				if (node->mesh) {
+					const glm::mat4 localMatrix = node->getMatrix();
+					for (Primitive* primitive : node->mesh->primitives) {
+						for (uint32_t i = 0; i < primitive->vertexCount; i++) {
+							Vertex& vertex = load.vertexBuffer[primitive->firstVertex + i];
+							// Pre-transform vertex positions by node-hierarchy
+							if (preTransform) {
+								vertex.pos = glm::vec3(localMatrix * glm::vec4(vertex.pos, 1.0f));
+								vertex.normal = glm::normalize(glm::mat3(localMatrix) * vertex.normal);
+							}
+							// Flip Y-Axis of vertex positions
+							if (flipY) {
+								vertex.pos.y *= -1.0f;
+								vertex.normal.y *= -1.0f;
+							}
+							// Pre-Multiply vertex colors with material base color
+							if (preMultiplyColor) {
+								vertex.color = primitive->material.baseColorFactor * vertex.color;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		if (!loadTimings.meshCacheHit && (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes)) {
+			auto tOptimizeStart = std::chrono::high_resolution_clock::now();
+			optimizeMeshes(load.indexBuffer, load.vertexBuffer);
+			loadTimings.optimize = millisecondsSince(tOptimizeStart);
+		}
+		if (!loadTimings.meshCacheHit && (fileLoadingFlags & FileLoadingFlags::GenerateLods)) {
+			auto tLodStart = std::chrono::high_resolution_clock::now();
+			generateLods(load.indexBuffer, load.vertexBuffer);
+			loadTimings.lods = millisecondsSince(tLodStart);
+		}
+
+		if (fileLoadingFlags & FileLoadingFlags::PrepareIndirectDraws) {
+			flattenDraws();
+		}
+
+		for (auto& extension : gltfModel.extensionsUsed) {
+			if (extension == "KHR_materials_pbrSpecularGlossiness") {
+				std::cout << "Required extension: " << extension;
+				metallicRoughnessWorkflow = false;
+			}
+		}
+		loadTimings.convert = millisecondsSince(tStart);
+	}, &convertCounter);
+
+	if (loadImages) {
+		auto tDecodeStart = std::chrono::high_resolution_clock::now();
+		std::atomic<bool> decodeFailed{ false };
+		// Decoding a single image is expensive enough to be a job of its own
+		jobSystem.parallelFor(static_cast<uint32_t>(gltfModel.images.size()), [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				// Images are not part of the mesh cache, so their encoded data needs to be read from the source files
+				if (loadTimings.meshCacheHit && !readEncodedImage(gltfModel.images[i], path, load.encodedImages[i])) {
+					decodeFailed = true;
+					continue;
+				}
+				if (!decodeImage(gltfModel.images[i], static_cast<int>(i), &load.encodedImages[i], path, device, &jobSystem, load.images[i])) {
+					decodeFailed = true;
+				}
+				load.encodedImages[i] = {};
+			}
+		}, 1);
+		loadTimings.decode = millisecondsSince(tDecodeStart);
+		if (decodeFailed) {
+			load.error = "Could not load the images of glTF file \"" + load.filename + "\"\n\nMake sure the assets submodule has been checked out and is up-to-date.";
+		}
+	}
+
+	jobSystem.wait(convertCounter);
+
+	if (!loadTimings.meshCacheHit) {
+		if (Vertex::useCompactLayout()) {
+			load.packedVertices = Vertex::pack(load.vertexBuffer.data(), load.vertexBuffer.size());
+			load.vertexData = load.packedVertices.data();
+		} else {
+			load.vertexData = load.vertexBuffer.data();
+		}
+		load.vertexCount = load.vertexBuffer.size();
+		load.indexData = load.indexBuffer.data();
+		load.indexCount = load.indexBuffer.size();
+		if (useMeshCache && load.error.empty()) {
+			writeMeshCache(cacheFile);
+		}
+	}
+}
+
+void vkglTF::Model::submitUpload()
+{
+	AsyncLoad& load = *asyncLoad;
+	load.uploadStart = std::chrono::high_resolution_clock::now();
+	const bool loadImages = !(load.fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+
+	size_t vertexBufferSize = load.vertexCount * load.vertexStride;
+	size_t indexBufferSize = load.indexCount * sizeof(uint32_t);
+	indices.count = static_cast<uint32_t>(load.indexCount);
+	vertices.count = static_cast<uint32_t>(load.vertexCount);
+
+	assert((vertexBufferSize > 0) && (indexBufferSize > 0));
+
+	// Create device local buffers
+	// Vertex buffer
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		vertexBufferSize,
+		&vertices.buffer,
+		&vertices.memory));
+	// Index buffer
+	VK_CHECK_RESULT(device->createBuffer(
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		indexBufferSize,
+		&indices.buffer,
+		&indices.memory));
+
+	// Record all copies into one batch of the staging ring
+	// Allocations may submit the batch if the ring is full, so the command buffer is fetched after each allocation
+	vks::StagingRing& stagingRing = device->stagingRing;
+	stagingRing.begin(load.transferQueue);
+
+	for (size_t i = 0; i < load.images.size(); i++) {
+		vks::StagingRing::Allocation staging = stagingRing.upload(load.images[i].data.data(), load.images[i].data.size());
+		textures[i].fromImageData(load.images[i], device, stagingRing.commandBuffer(), staging.buffer, staging.offset);
+	}
+	if (loadImages) {
+		// Create an empty texture to be used for empty material images
+		vks::StagingRing::Allocation staging = stagingRing.allocate(4);
+		memset(staging.data, 0, 4);
+		createEmptyTexture(stagingRing.commandBuffer(), staging.buffer, staging.offset);
+	}
+
+	vks::StagingRing::Allocation staging = stagingRing.upload(load.vertexData, vertexBufferSize);
+	VkBufferCopy copyRegion{ .srcOffset = staging.offset, .dstOffset = 0, .size = vertexBufferSize };
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, vertices.buffer, 1, &copyRegion);
+	staging = stagingRing.upload(load.indexData, indexBufferSize);
+	copyRegion = { .srcOffset = staging.offset, .dstOffset = 0, .size = indexBufferSize };
+	vkCmdCopyBuffer(stagingRing.commandBuffer(), staging.buffer, indices.buffer, 1, &copyRegion);
+
+	createNodeMatrixBuffer();
+	if (load.fileLoadingFlags & FileLoadingFlags::PrepareIndirectDraws) {
+		createIndirectBuffers();
+	}
+	if (load.fileLoadingFlags & FileLoadingFlags::PrepareGpuSkinning) {
+		createSkinningBuffers();
+	}
+	if (load.fileLoadingFlags & FileLoadingFlags::PrepareBindlessMaterials) {
+		createMaterialBuffer();
+	}
+
+	// Submit without waiting, completion is checked with the ticket
+	load.uploadTicket = stagingRing.end();
+
+	// The CPU side copies are no longer required
+	load.images.clear();
+	load.vertexBuffer.clear();
+	load.indexBuffer.clear();
+	load.packedVertices.clear();
+	load.indirectCommands.clear();
+	load.indirectDrawData.clear();
+	load.meshCache.close();
+
+	load.state = AsyncLoad::State::Uploading;
+}
+
+void vkglTF::Model::finishLoading()
+{
+	AsyncLoad& load = *asyncLoad;
+	loadTimings.upload = millisecondsSince(load.uploadStart);
+
+	getSceneDimensions();
+	setupDescriptors();
+
+	std::cout << "Loaded \"" << load.filename << "\"" << (loadTimings.meshCacheHit ? " from mesh cache" : "") << " (parse: " << loadTimings.parse << " ms, decode: " << loadTimings.decode << " ms, convert: " << loadTimings.convert << " ms, upload: " << loadTimings.upload << " ms)" << std::endl;
+	if (load.vertexStride != sizeof(Vertex)) {
+		const size_t vertexCount = static_cast<size_t>(vertices.count);
+		std::cout << "Compact vertex buffer: " << vertexCount * load.vertexStride / 1024 << " KB, saved " << vertexCount * (sizeof(Vertex) - load.vertexStride) / 1024 << " KB" << std::endl;
+	}
+	if (load.fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) {
+		// ACMR and ATVR with a simulated FIFO cache of vks::meshopt::vertexCacheSize entries, as authored -> optimized
+		vks::meshopt::VertexCacheStatistics authored{}, optimized{};
+		for (Node* node : linearNodes) {
+			if (node->mesh) {
+				std::cout << "Mesh \"" << node->mesh->name << "\": ACMR " << node->mesh->authoredVertexCache.acmr() << " -> " << node->mesh->optimizedVertexCache.acmr() << ", ATVR " << node->mesh->authoredVertexCache.atvr() << " -> " << node->mesh->optimizedVertexCache.atvr() << ", vertices " << node->mesh->authoredVertexCache.vertexCount << " -> " << node->mesh->optimizedVertexCache.vertexCount << std::endl;
+				authored += node->mesh->authoredVertexCache;
+				optimized += node->mesh->optimizedVertexCache;
+			}
+		}
+		std::cout << "Mesh optimization" << (loadTimings.meshCacheHit ? " (cached)" : " (" + std::to_string(loadTimings.optimize) + " ms)") << ": ACMR " << authored.acmr() << " -> " << optimized.acmr() << ", ATVR " << authored.atvr() << " -> " << optimized.atvr() << std::endl;
+	}
+	if (load.fileLoadingFlags & FileLoadingFlags::GenerateLods) {
+		size_t primitiveCount = 0;
+		size_t lodCount = 0;
+		size_t lodIndexCount = 0;
+		for (Node* node : linearNodes) {
+			if (node->mesh) {
+				for (Primitive* primitive : node->mesh->primitives) {
+					primitiveCount++;
+					for (size_t i = 1; i < primitive->lods.size(); i++) {
+						lodCount++;
+						lodIndexCount += primitive->lods[i].indexCount;
+					}
+				}
+			}
+		}
+		std::cout << "Generated " << lodCount << " LODs for " << primitiveCount << " primitives" << (loadTimings.meshCacheHit ? " (cached)" : " (" + std::to_string(loadTimings.lods) + " ms)") << ", " << lodIndexCount * sizeof(uint32_t) / 1024 << " KB of indices" << std::endl;
+	}
+	if (textureReport && !textures.empty()) {
+		// Times are per image and measured on the worker threads, so they add up to more than the decode stage
+		VkDeviceSize totalSize = 0;
+		for (const Texture& texture : textures) {
+			if (!texture.loadInfo.transcodeError.empty()) {
+				std::cout << "Texture \"" << texture.loadInfo.source << "\": " << texture.loadInfo.sourceFormat << ", not transcoded (" << texture.loadInfo.transcodeError << "), placeholder" << std::endl;
+				totalSize += texture.allocation.size;
+				continue;
+			}
+			std::cout << "Texture \"" << texture.loadInfo.source << "\": " << texture.loadInfo.sourceFormat << " -> " << vks::ktx2::formatName(texture.loadInfo.format) << ", " << texture.width << "x" << texture.height << ", " << texture.mipLevels << " mips, " << texture.allocation.size / 1024 << " KB, " << texture.loadInfo.time << " ms";
+			if (texture.loadInfo.sourceSize > 0) {
+				std::cout << ", ratio " << static_cast<double>(texture.loadInfo.sourceSize) / static_cast<double>(texture.loadInfo.dataSize) << ":1, PSNR " << texture.loadInfo.psnr << " dB" << (texture.loadInfo.cacheHit ? " (cached)" : ", encoded in " + std::to_string(texture.loadInfo.encodeTime) + " ms");
+			}
+			std::cout << std::endl;
+			totalSize += texture.allocation.size;
+		}
+		std::cout << textures.size() << " textures, " << totalSize / (1024 * 1024) << " MB of video memory" << std::endl;
+	}
+	const size_t notTranscodedCount = std::count_if(textures.begin(), textures.end(), [](const Texture& texture) { return !texture.loadInfo.transcodeError.empty(); });
+	if (notTranscodedCount > 0) {
+		std::cerr << "Warning: " << notTranscodedCount << " Basis Universal " << (notTranscodedCount == 1 ? "texture was" : "textures were") << " not transcoded and " << (notTranscodedCount == 1 ? "is" : "are") << " rendered with a placeholder" << std::endl;
+	}
+	if (textureCompression != TextureCompression::None) {
+		uint32_t encodedCount = 0;
+		uint32_t cachedCount = 0;
+		size_t sourceSize = 0;
+		size_t dataSize = 0;
+		double encodeTime = 0.0;
+		double psnr = 0.0;
+		for (const Texture& texture : textures) {
+			if (texture.loadInfo.sourceSize > 0) {
+				texture.loadInfo.cacheHit ? cachedCount++ : encodedCount++;
+				sourceSize += texture.loadInfo.sourceSize;
+				dataSize += texture.loadInfo.dataSize;
+				encodeTime += texture.loadInfo.encodeTime;
+				psnr += texture.loadInfo.psnr;
+			}
+		}
+		if (encodedCount + cachedCount > 0) {
+			std::cout << "Texture compression: " << encodedCount << " images encoded (" << encodeTime << " ms summed over images), " << cachedCount << " read from cache, " << sourceSize / (1024 * 1024) << " MB -> " << dataSize / (1024 * 1024) << " MB (" << static_cast<double>(sourceSize) / static_cast<double>(dataSize) << ":1), average PSNR " << psnr / (encodedCount + cachedCount) << " dB" << std::endl;
+		}
+	}
+
+	asyncLoad.reset();
+}
+
+bool vkglTF::Model::updateLoading(bool wait)
+{
+	if (!asyncLoad) {
+		return true;
+	}
+	AsyncLoad& load = *asyncLoad;
+	if (load.state == AsyncLoad::State::Processing) {
+		if (!wait && (load.cpuStages.wait_for(std::chrono::seconds(0)) != std::future_status::ready)) {
+			return false;
+		}
+		load.cpuStages.get();
+		if (!load.error.empty()) {
+			vks::tools::exitFatal(load.error, -1);
+			return false;
+		}
+		submitUpload();
+	}
+	if (wait) {
+		device->stagingRing.wait(load.uploadTicket);
+	} else if (!device->stagingRing.isComplete(load.uploadTicket)) {
+		return false;
+	}
+	finishLoading();
+	return true;
+}
+
+vkglTF::LoadHandle vkglTF::Model::loadFromFileAsync(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+{
+	assert(!asyncLoad);
+	this->device = device;
+	size_t pos = filename.find_last_of('/');
+	path = filename.substr(0, pos);
+	loadTimings = {};
+
+	// Layouts don't depend on the model, so they are created up front to allow creating pipelines while the model is still loading
+	createDescriptorSetLayouts(fileLoadingFlags);
+
+	asyncLoad = std::make_shared<AsyncLoad>();
+	asyncLoad->filename = filename;
+	asyncLoad->transferQueue = transferQueue;
+	asyncLoad->fileLoadingFlags = vkglTF::optimizeMeshes ? (fileLoadingFlags | FileLoadingFlags::OptimizeMeshes) : fileLoadingFlags;
+	asyncLoad->scale = scale;
+	asyncLoad->cpuStages = std::async(std::launch::async, [this] { runCpuStages(); });
+	return LoadHandle(this);
+}
+
+void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
+{
+	loadFromFileAsync(filename, device, transferQueue, fileLoadingFlags, scale);
+	updateLoading(true);
+}
+
+void vkglTF::Model::createDescriptorSetLayouts(uint32_t fileLoadingFlags)
+{
+	// Layouts are global, so only create if they haven't already been created before
+	// They are taken from the device's layout cache, so samples creating identical layouts share them
+	if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
+		// Binding 0: World matrix of a single node, binding 1: All node and joint matrices of a frame
+		std::array<VkDescriptorSetLayoutBinding, 2> setLayoutBindings = {
+			VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT },
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, .bindingCount = static_cast<uint32_t>(setLayoutBindings.size()), .pBindings = setLayoutBindings.data() };
+		descriptorSetLayoutUbo = device->descriptorAllocator.getLayout(descriptorLayoutCI);
+	}
+	if (descriptorSetLayoutImage == VK_NULL_HANDLE) {
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+		if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+			setLayoutBindings.push_back({ .binding = static_cast<uint32_t>(setLayoutBindings.size()), .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT });
+		}
+		if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+			setLayoutBindings.push_back({ .binding = static_cast<uint32_t>(setLayoutBindings.size()), .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT });
+		}
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(setLayoutBindings.size()),
+			.pBindings = setLayoutBindings.data(),
+		};
+		descriptorSetLayoutImage = device->descriptorAllocator.getLayout(descriptorLayoutCI);
+	}
+	if ((descriptorSetLayoutMaterials == VK_NULL_HANDLE) && (fileLoadingFlags & FileLoadingFlags::PrepareBindlessMaterials)) {
+		// The texture array is sized per model at allocation time, the layout only sets the upper bound
+		const VkPhysicalDeviceLimits& limits = device->properties.limits;
+		maxBindlessTextures = std::min({ maxBindlessTextures, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+		std::array<VkDescriptorSetLayoutBinding, 2> setLayoutBindings = {
+			VkDescriptorSetLayoutBinding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = maxBindlessTextures, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT },
+		};
+		const std::array<VkDescriptorBindingFlags, 2> bindingFlags = { 0, VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+			.bindingCount = static_cast<uint32_t>(bindingFlags.size()),
+			.pBindingFlags = bindingFlags.data()
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.pNext = &bindingFlagsCI,
+			.bindingCount = static_cast<uint32_t>(setLayoutBindings.size()),
+			.pBindings = setLayoutBindings.data(),
+		};
+		descriptorSetLayoutMaterials = device->descriptorAllocator.getLayout(descriptorLayoutCI);
+	}
+}
+
+void vkglTF::Model::setupDescriptors()
+{
+	// Sets are allocated from the device's descriptor allocator, so there is no need to count descriptors for a pool up front
+	const bool bindlessMaterials = (bindless.buffer.buffer != VK_NULL_HANDLE);
+
+	// Descriptor for the node matrices, the frame and node are selected with dynamic offsets
+	nodeMatrices.descriptorSet = device->descriptorAllocator.allocate(descriptorSetLayoutUbo);
+	const VkDescriptorBufferInfo nodeMatrixDescriptor{ nodeMatrices.buffer.buffer, 0, sizeof(glm::mat4) };
+	const VkDescriptorBufferInfo frameMatricesDescriptor{ nodeMatrices.buffer.buffer, 0, nodeMatrices.frameSize };
+	std::array<VkWriteDescriptorSet, 2> writeDescriptorSets = {
+		VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = nodeMatrices.descriptorSet, .dstBinding = 0, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .pBufferInfo = &nodeMatrixDescriptor },
+		VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = nodeMatrices.descriptorSet, .dstBinding = 1, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, .pBufferInfo = &frameMatricesDescriptor },
+	};
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	// Descriptors for per-material images
+	for (auto& material : materials) {
+		if (material.baseColorTexture != nullptr) {
+			material.createDescriptorSet(vkglTF::descriptorSetLayoutImage, descriptorBindingFlags);
+		}
+	}
+
+	if (bindlessMaterials) {
+		// Descriptor for all materials and textures, the texture array is sized to the model's textures plus the empty texture
+		bindless.descriptorSet = device->descriptorAllocator.allocate(descriptorSetLayoutMaterials, bindless.textureCount);
+		std::vector<VkDescriptorImageInfo> textureDescriptors;
+		textureDescriptors.reserve(bindless.textureCount);
+		for (auto& texture : textures) {
+			textureDescriptors.push_back(texture.descriptor);
+		}
+		textureDescriptors.push_back(emptyTexture.descriptor);
+		std::array<VkWriteDescriptorSet, 2> materialDescriptorWrites = {
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = bindless.descriptorSet, .dstBinding = 0, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .pBufferInfo = &bindless.buffer.descriptor },
+			VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = bindless.descriptorSet, .dstBinding = 1, .descriptorCount = bindless.textureCount, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .pImageInfo = textureDescriptors.data() },
+		};
+		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(materialDescriptorWrites.size()), materialDescriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void vkglTF::Model::bindBuffers(VkCommandBuffer commandBuffer)
+{
+	const VkDeviceSize offsets[1] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	buffersBound = true;
 }
 
 void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
@@ -1439,6 +3253,10 @@ void vkglTF::Model::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t
 				if (renderFlags & RenderFlags::BindImages) {
 					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
 				}
+				if (renderFlags & RenderFlags::PushMaterialIndex) {
+					const uint32_t materialIndex = static_cast<uint32_t>(&material - materials.data());
+					vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &materialIndex);
+				}
 				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
 			}
 		}
@@ -1460,6 +3278,223 @@ void vkglTF::Model::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, Vk
 	}
 }
 
+// Push constant block of the indirect draw culling shader
+struct IndirectCullPushConstants {
+	std::array<glm::vec4, 6> frustumPlanes;
+	uint32_t drawCount;
+};
+
+void vkglTF::Model::prepareIndirectCulling(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache, bool drawIndirectCount)
+{
+	assert((indirect.drawCount > 0) && (indirect.cullPipeline == VK_NULL_HANDLE));
+	if (drawIndirectCount) {
+		// Core with Vulkan 1.2, the extension's entry point is used with older api versions
+		indirect.vkCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCount"));
+		if (!indirect.vkCmdDrawIndexedIndirectCount) {
+			indirect.vkCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
+	}
+	indirect.compact = (indirect.vkCmdDrawIndexedIndirectCount != nullptr);
+
+	// Binding 0: Per-draw data, binding 1: Node matrices, binding 2: Commands, binding 3: Culled commands, binding 4: Draw counts
+	// The node matrices are bound with the frame's slice as a dynamic offset
+	const VkDescriptorBufferInfo frameMatricesDescriptor{ nodeMatrices.buffer.buffer, 0, nodeMatrices.frameSize };
+	const std::array<const VkDescriptorBufferInfo*, 5> bufferDescriptors = { &indirect.drawData.descriptor, &frameMatricesDescriptor, &indirect.commands.descriptor, &indirect.culledCommands.descriptor, &indirect.drawCounts.descriptor };
+	std::array<VkDescriptorSetLayoutBinding, 5> setLayoutBindings{};
+	for (uint32_t i = 0; i < static_cast<uint32_t>(setLayoutBindings.size()); i++) {
+		setLayoutBindings[i] = { .binding = i, .descriptorType = (i == 1) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	}
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(setLayoutBindings.size()),
+		.pBindings = setLayoutBindings.data()
+	};
+	indirect.cullDescriptorSetLayout = device->descriptorAllocator.getLayout(descriptorLayoutCI);
+	indirect.cullDescriptorSet = device->descriptorAllocator.allocate(indirect.cullDescriptorSetLayout);
+	std::array<VkWriteDescriptorSet, 5> writeDescriptorSets{};
+	for (uint32_t i = 0; i < static_cast<uint32_t>(writeDescriptorSets.size()); i++) {
+		writeDescriptorSets[i] = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = indirect.cullDescriptorSet,
+			.dstBinding = i,
+			.descriptorCount = 1,
+			.descriptorType = setLayoutBindings[i].descriptorType,
+			.pBufferInfo = bufferDescriptors[i]
+		};
+	}
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	VkPushConstantRange pushConstantRange{ .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .offset = 0, .size = sizeof(IndirectCullPushConstants) };
+	VkPipelineLayoutCreateInfo pipelineLayoutCI{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &indirect.cullDescriptorSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange
+	};
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &indirect.cullPipelineLayout));
+
+	// Specialization constant 0 selects between compacting the visible draws and zeroing the instance count of culled draws
+	VkBool32 compact = indirect.compact ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry specializationMapEntry{ .constantID = 0, .offset = 0, .size = sizeof(VkBool32) };
+	VkSpecializationInfo specializationInfo{ .mapEntryCount = 1, .pMapEntries = &specializationMapEntry, .dataSize = sizeof(VkBool32), .pData = &compact };
+	shaderStage.pSpecializationInfo = &specializationInfo;
+	VkComputePipelineCreateInfo computePipelineCI{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = shaderStage,
+		.layout = indirect.cullPipelineLayout
+	};
+	VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &indirect.cullPipeline));
+}
+
+void vkglTF::Model::cullIndirectDraws(VkCommandBuffer commandBuffer, const std::array<glm::vec4, 6>& frustumPlanes, uint32_t frameIndex)
+{
+	assert(indirect.cullPipeline != VK_NULL_HANDLE);
+	// Draws of earlier frames may still read the output of the last pass
+	VkMemoryBarrier memoryBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	vkCmdFillBuffer(commandBuffer, indirect.drawCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	const IndirectCullPushConstants pushConstants{ .frustumPlanes = frustumPlanes, .drawCount = indirect.drawCount };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.cullPipeline);
+	const uint32_t frameOffset = static_cast<uint32_t>(nodeMatrices.frameOffset(frameIndex));
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.cullPipelineLayout, 0, 1, &indirect.cullDescriptorSet, 1, &frameOffset);
+	vkCmdPushConstants(commandBuffer, indirect.cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(IndirectCullPushConstants), &pushConstants);
+	// The shader uses a work group size of 64
+	vkCmdDispatch(commandBuffer, (indirect.drawCount + 63) / 64, 1, 1);
+
+	// Make the culled commands and counts visible to the indirect draws
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void vkglTF::Model::drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags, bool culled)
+{
+	assert(indirect.drawCount > 0);
+	if (!buffersBound) {
+		const VkDeviceSize offsets[1] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+	// Without any of the alpha mode flags, all ranges are drawn
+	const std::array<uint32_t, 3> rangeFlags = { RenderFlags::RenderOpaqueNodes, RenderFlags::RenderAlphaMaskedNodes, RenderFlags::RenderAlphaBlendedNodes };
+	const uint32_t alphaModeFlags = renderFlags & (RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes);
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	VkBuffer commandsBuffer = culled ? indirect.culledCommands.buffer : indirect.commands.buffer;
+	for (uint32_t range = 0; range < static_cast<uint32_t>(indirect.ranges.size()); range++) {
+		const IndirectDraws::Range& commandRange = indirect.ranges[range];
+		if ((commandRange.count == 0) || ((alphaModeFlags != 0) && !(alphaModeFlags & rangeFlags[range]))) {
+			continue;
+		}
+		const VkDeviceSize offset = commandRange.first * stride;
+		if (culled && indirect.compact) {
+			// The culling pass wrote the number of visible draws of each range
+			indirect.vkCmdDrawIndexedIndirectCount(commandBuffer, commandsBuffer, offset, indirect.drawCounts.buffer, range * sizeof(uint32_t), commandRange.count, stride);
+		} else if (device->enabledFeatures.multiDrawIndirect) {
+			vkCmdDrawIndexedIndirect(commandBuffer, commandsBuffer, offset, commandRange.count, stride);
+		} else {
+			// Without multi draw indirect, each command needs to be issued on its own
+			for (uint32_t i = 0; i < commandRange.count; i++) {
+				vkCmdDrawIndexedIndirect(commandBuffer, commandsBuffer, offset + i * stride, 1, stride);
+			}
+		}
+	}
+}
+
+// The skinning shader reads and writes vertices as arrays of floats
+static_assert(sizeof(vkglTF::Vertex) == 24 * sizeof(float), "Vertex layout doesn't match the skinning shader");
+
+void vkglTF::Model::prepareSkinning(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache)
+{
+	assert((skinning.jobCount > 0) && (skinning.pipeline == VK_NULL_HANDLE));
+	// Binding 0: Source vertices, binding 1: Skinned vertices, binding 2: Node matrices, binding 3: Jobs
+	// Skinned vertices and node matrices are bound with the frame's slices as dynamic offsets
+	const VkDescriptorBufferInfo sourceDescriptor{ vertices.buffer, 0, VK_WHOLE_SIZE };
+	const VkDescriptorBufferInfo outputDescriptor{ skinning.vertices.buffer, 0, skinning.frameSize };
+	const VkDescriptorBufferInfo frameMatricesDescriptor{ nodeMatrices.buffer.buffer, 0, nodeMatrices.frameSize };
+	const std::array<const VkDescriptorBufferInfo*, 4> bufferDescriptors = { &sourceDescriptor, &outputDescriptor, &frameMatricesDescriptor, &skinning.jobs.descriptor };
+	const std::array<VkDescriptorType, 4> descriptorTypes = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	std::array<VkDescriptorSetLayoutBinding, 4> setLayoutBindings{};
+	for (uint32_t i = 0; i < static_cast<uint32_t>(setLayoutBindings.size()); i++) {
+		setLayoutBindings[i] = { .binding = i, .descriptorType = descriptorTypes[i], .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT };
+	}
+	VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(setLayoutBindings.size()),
+		.pBindings = setLayoutBindings.data()
+	};
+	skinning.descriptorSetLayout = device->descriptorAllocator.getLayout(descriptorLayoutCI);
+	skinning.descriptorSet = device->descriptorAllocator.allocate(skinning.descriptorSetLayout);
+	std::array<VkWriteDescriptorSet, 4> writeDescriptorSets{};
+	for (uint32_t i = 0; i < static_cast<uint32_t>(writeDescriptorSets.size()); i++) {
+		writeDescriptorSets[i] = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = skinning.descriptorSet,
+			.dstBinding = i,
+			.descriptorCount = 1,
+			.descriptorType = descriptorTypes[i],
+			.pBufferInfo = bufferDescriptors[i]
+		};
+	}
+	vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCI{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &skinning.descriptorSetLayout
+	};
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &skinning.pipelineLayout));
+	VkComputePipelineCreateInfo computePipelineCI{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = shaderStage,
+		.layout = skinning.pipelineLayout
+	};
+	VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &computePipelineCI, nullptr, &skinning.pipeline));
+}
+
+void vkglTF::Model::skinVertices(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	assert(skinning.pipeline != VK_NULL_HANDLE);
+	// The frame's slice may still be read by the draws of the last frame that used it
+	VkMemoryBarrier memoryBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	const std::array<uint32_t, 2> dynamicOffsets = { static_cast<uint32_t>(skinning.frameOffset(frameIndex)), static_cast<uint32_t>(nodeMatrices.frameOffset(frameIndex)) };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinning.pipelineLayout, 0, 1, &skinning.descriptorSet, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+	// One row of work groups per job, the shader uses a work group size of 64
+	vkCmdDispatch(commandBuffer, (skinning.maxJobVertexCount + 63) / 64, skinning.jobCount, 1);
+
+	// Make the skinned vertices visible to the vertex input of all following passes
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void vkglTF::Model::bindMaterials(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set)
+{
+	assert(bindless.descriptorSet != VK_NULL_HANDLE);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &bindless.descriptorSet, 0, nullptr);
+}
+
+void vkglTF::Model::bindSkinnedVertices(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	const VkDeviceSize offset = skinning.frameOffset(frameIndex);
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &skinning.vertices.buffer, &offset);
+}
+
 void vkglTF::Model::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
 {
 	if (node->mesh) {
@@ -1497,55 +3532,306 @@ void vkglTF::Model::updateAnimation(uint32_t index, float time)
 		std::cout << "No animation with index " << index << std::endl;
 		return;
 	}
-	Animation &animation = animations[index];
+	blendAnimations({ { index, time, 1.0f } });
+}
+
+void vkglTF::Model::blendAnimations(const std::vector<AnimationLayer>& layers)
+{
+	if ((animationState.cursors.size() != animations.size()) || (animationState.translations.size() != nodeHierarchy.nodes.size())) {
+		initAnimationState(animationState);
+	}
+	animationState.layers = layers;
+	sampleAnimationLayers(animationState);
 
 	bool updated = false;
-	for (auto& channel : animation.channels) {
-		vkglTF::AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-		if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+	for (size_t i = 0; i < nodeHierarchy.nodes.size(); i++) {
+		if (animationState.animated[i]) {
+			Node* node = nodeHierarchy.nodes[i];
+			node->translation = animationState.translations[i];
+			node->rotation = animationState.rotations[i];
+			node->scale = animationState.scales[i];
+			node->markDirty();
+			updated = true;
+		}
+	}
+	if (updated) {
+		updateNodeMatrices();
+	}
+}
+
+void vkglTF::Model::initAnimationState(AnimationState& state) const
+{
+	const size_t nodeCount = nodeHierarchy.nodes.size();
+	state.translations.resize(nodeCount);
+	state.rotations.resize(nodeCount);
+	state.scales.resize(nodeCount);
+	for (size_t i = 0; i < nodeCount; i++) {
+		const Node* node = nodeHierarchy.nodes[i];
+		state.translations[i] = node->translation;
+		state.rotations[i] = node->rotation;
+		state.scales[i] = node->scale;
+	}
+	state.animated.assign(nodeCount, 0);
+	state.worldMatrices = nodeHierarchy.worldMatrices;
+	state.cursors.resize(animations.size());
+	for (size_t i = 0; i < animations.size(); i++) {
+		state.cursors[i].assign(animations[i].samplers.size(), 0);
+	}
+}
+
+/*
+	Samples all channels of the state's layers and blends the results into the state's local transforms
+	The samples are gathered into batches, so the interpolation runs over all channels at once, see AnimationBatch
+	Layers are blended with weighted averages, rotations are summed up on the same hemisphere and normalized
+*/
+void vkglTF::Model::sampleAnimationLayers(AnimationState& state) const
+{
+	// Scratch space is kept per thread, so evaluating many states in parallel doesn't allocate
+	thread_local AnimationBatch linearBatch;
+	thread_local AnimationBatch rotationBatch;
+	thread_local std::vector<glm::vec4> accumulated;
+	thread_local std::vector<float> weights;
+	linearBatch.clear();
+	rotationBatch.clear();
+
+	for (const AnimationLayer& layer : state.layers) {
+		if ((layer.animation >= animations.size()) || (layer.weight <= 0.0f)) {
 			continue;
 		}
+		const Animation& animation = animations[layer.animation];
+		if (animation.start > animation.end) {
+			continue;
+		}
+		std::vector<uint32_t>& cursors = state.cursors[layer.animation];
+		const float time = std::clamp(layer.time, animation.start, animation.end);
+		for (const AnimationChannel& channel : animation.channels) {
+			const AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+			if (!sampler.valid() || !channel.node->hierarchy) {
+				continue;
+			}
+			glm::vec4 a, b;
+			float u = 0.0f;
+			const uint32_t key = sampler.findKeyframe(time, cursors[channel.samplerIndex]);
+			if (sampler.inputs.size() == 1) {
+				a = b = sampler.outputsVec4[sampler.interpolation == AnimationSampler::CUBICSPLINE ? 1 : 0];
+			} else {
+				const float duration = sampler.inputs[key + 1] - sampler.inputs[key];
+				u = duration > 0.0f ? std::clamp((time - sampler.inputs[key]) / duration, 0.0f, 1.0f) : 0.0f;
+				switch (sampler.interpolation) {
+				case AnimationSampler::LINEAR:
+					a = sampler.outputsVec4[key];
+					b = sampler.outputsVec4[key + 1];
+					break;
+				case AnimationSampler::STEP:
+					a = b = sampler.outputsVec4[u >= 1.0f ? key + 1 : key];
+					break;
+				case AnimationSampler::CUBICSPLINE: {
+					// Hermite spline, tangents are scaled by the keyframe interval (see the glTF spec, appendix C)
+					const glm::vec4& p0 = sampler.outputsVec4[key * 3 + 1];
+					const glm::vec4 m0 = duration * sampler.outputsVec4[key * 3 + 2];
+					const glm::vec4& p1 = sampler.outputsVec4[(key + 1) * 3 + 1];
+					const glm::vec4 m1 = duration * sampler.outputsVec4[(key + 1) * 3];
+					const float u2 = u * u;
+					const float u3 = u2 * u;
+					// The spline is evaluated here, the batch only needs to normalize rotations
+					a = b = (2.0f * u3 - 3.0f * u2 + 1.0f) * p0 + (u3 - 2.0f * u2 + u) * m0 + (-2.0f * u3 + 3.0f * u2) * p1 + (u3 - u2) * m1;
+					u = 0.0f;
+					break;
+				}
+				}
+			}
+			AnimationBatch& batch = (channel.path == AnimationChannel::ROTATION) ? rotationBatch : linearBatch;
+			batch.add(a, b, u, channel.node->hierarchyIndex * 3 + static_cast<uint32_t>(channel.path), layer.weight);
+		}
+	}
 
-		for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-			if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-				float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-				if (u <= 1.0f) {
-					switch (channel.path) {
-					case vkglTF::AnimationChannel::PathType::TRANSLATION: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->translation = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::SCALE: {
-						glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-						channel.node->scale = glm::vec3(trans);
-						break;
-					}
-					case vkglTF::AnimationChannel::PathType::ROTATION: {
-						glm::quat q1;
-						q1.x = sampler.outputsVec4[i].x;
-						q1.y = sampler.outputsVec4[i].y;
-						q1.z = sampler.outputsVec4[i].z;
-						q1.w = sampler.outputsVec4[i].w;
-						glm::quat q2;
-						q2.x = sampler.outputsVec4[i + 1].x;
-						q2.y = sampler.outputsVec4[i + 1].y;
-						q2.z = sampler.outputsVec4[i + 1].z;
-						q2.w = sampler.outputsVec4[i + 1].w;
-						channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-						break;
-					}
+	linearBatch.lerp();
+	rotationBatch.nlerp();
+
+	// Blend the samples of all layers, slots are indexed by node and path
+	const size_t nodeCount = nodeHierarchy.nodes.size();
+	accumulated.assign(nodeCount * 3, glm::vec4(0.0f));
+	weights.assign(nodeCount * 3, 0.0f);
+	for (size_t i = 0; i < linearBatch.size(); i++) {
+		const uint32_t slot = linearBatch.slots[i];
+		accumulated[slot] += linearBatch.result(i) * linearBatch.weights[i];
+		weights[slot] += linearBatch.weights[i];
+	}
+	for (size_t i = 0; i < rotationBatch.size(); i++) {
+		const uint32_t slot = rotationBatch.slots[i];
+		glm::vec4 q = rotationBatch.result(i);
+		if (glm::dot(accumulated[slot], q) < 0.0f) {
+			q = -q;
+		}
+		accumulated[slot] += q * rotationBatch.weights[i];
+		weights[slot] += rotationBatch.weights[i];
+	}
+
+	for (size_t i = 0; i < nodeCount; i++) {
+		const uint32_t slot = static_cast<uint32_t>(i) * 3;
+		state.animated[i] = 0;
+		if (weights[slot + AnimationChannel::TRANSLATION] > 0.0f) {
+			state.translations[i] = glm::vec3(accumulated[slot + AnimationChannel::TRANSLATION] / weights[slot + AnimationChannel::TRANSLATION]);
+			state.animated[i] = 1;
+		}
+		if (weights[slot + AnimationChannel::ROTATION] > 0.0f) {
+			const glm::vec4& q = accumulated[slot + AnimationChannel::ROTATION];
+			state.rotations[i] = glm::normalize(glm::quat(q.w, q.x, q.y, q.z));
+			state.animated[i] = 1;
+		}
+		if (weights[slot + AnimationChannel::SCALE] > 0.0f) {
+			state.scales[i] = glm::vec3(accumulated[slot + AnimationChannel::SCALE] / weights[slot + AnimationChannel::SCALE]);
+			state.animated[i] = 1;
+		}
+	}
+}
+
+void vkglTF::Model::evaluateAnimation(AnimationState& state) const
+{
+	sampleAnimationLayers(state);
+	// Parents are stored before their children, so world matrices are computed in a single forward pass
+	for (size_t i = 0; i < nodeHierarchy.nodes.size(); i++) {
+		const glm::mat4 localMatrix = glm::translate(glm::mat4(1.0f), state.translations[i]) * glm::mat4(state.rotations[i]) * glm::scale(glm::mat4(1.0f), state.scales[i]) * nodeHierarchy.nodes[i]->matrix;
+		const int32_t parent = nodeHierarchy.parents[i];
+		state.worldMatrices[i] = parent >= 0 ? state.worldMatrices[parent] * localMatrix : localMatrix;
+	}
+}
+
+void vkglTF::Model::evaluateAnimations(std::vector<AnimationState>& states) const
+{
+	// States are independent of each other, a single state is too small to be a job of its own
+	modelJobSystem().parallelFor(static_cast<uint32_t>(states.size()), [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			evaluateAnimation(states[i]);
+		}
+	}, 16);
+}
+
+void vkglTF::Model::buildNodeHierarchy()
+{
+	nodeHierarchy = {};
+	std::vector<Node*>& sorted = nodeHierarchy.nodes;
+	// Breadth first traversal, each pass over the previous level appends the next one
+	sorted = nodes;
+	uint32_t levelBegin = 0;
+	while (levelBegin < sorted.size()) {
+		const uint32_t levelEnd = static_cast<uint32_t>(sorted.size());
+		nodeHierarchy.levelOffsets.push_back(levelBegin);
+		for (uint32_t i = levelBegin; i < levelEnd; i++) {
+			sorted.insert(sorted.end(), sorted[i]->children.begin(), sorted[i]->children.end());
+		}
+		levelBegin = levelEnd;
+	}
+	nodeHierarchy.levelOffsets.push_back(static_cast<uint32_t>(sorted.size()));
+	nodeHierarchy.parents.resize(sorted.size());
+	nodeHierarchy.worldMatrices.resize(sorted.size(), glm::mat4(1.0f));
+	nodeHierarchy.dirty.resize(sorted.size(), 1);
+	for (uint32_t i = 0; i < sorted.size(); i++) {
+		Node* node = sorted[i];
+		node->hierarchy = &nodeHierarchy;
+		node->hierarchyIndex = i;
+		// Parents have been visited before their children, so their index is already set
+		nodeHierarchy.parents[i] = node->parent ? static_cast<int32_t>(node->parent->hierarchyIndex) : -1;
+		if (node->mesh) {
+			nodeHierarchy.meshNodes.push_back(i);
+		}
+	}
+
+	// World matrices are spaced so that each one starts at a valid dynamic uniform buffer offset
+	const VkDeviceSize uniformAlignment = device->properties.limits.minUniformBufferOffsetAlignment;
+	nodeHierarchy.matrixStride = static_cast<uint32_t>(std::max<VkDeviceSize>((uniformAlignment + sizeof(glm::mat4) - 1) / sizeof(glm::mat4), 1));
+	uint32_t matrixCount = static_cast<uint32_t>(sorted.size()) * nodeHierarchy.matrixStride;
+	for (uint32_t nodeIndex : nodeHierarchy.meshNodes) {
+		Node* node = sorted[nodeIndex];
+		if (node->skin) {
+			node->mesh->jointMatrixIndex = matrixCount;
+			node->mesh->jointCount = static_cast<uint32_t>(node->skin->joints.size());
+			matrixCount += node->mesh->jointCount;
+		}
+	}
+	nodeHierarchy.bufferMatrices.resize(std::max(matrixCount, 1u), glm::mat4(1.0f));
+}
+
+void vkglTF::Model::updateNodeMatrices()
+{
+	// Below these counts, distributing the work costs more than it saves
+	const uint32_t parallelNodeThreshold = 512;
+	const uint32_t parallelMeshThreshold = 32;
+
+	NodeHierarchy& hierarchy = nodeHierarchy;
+	vks::JobSystem& jobSystem = modelJobSystem();
+	// The node matrix buffer keeps identity matrices for nodes that have been baked into the vertices
+	glm::mat4* bufferMatrices = hierarchy.preTransformed ? nullptr : hierarchy.bufferMatrices.data();
+	const uint32_t matrixStride = hierarchy.matrixStride;
+	const bool anyDirty = std::any_of(hierarchy.dirty.begin(), hierarchy.dirty.end(), [](uint8_t dirty) { return dirty != 0; });
+	if (!anyDirty) {
+		return;
+	}
+	// Forward pass over all depth levels, a node is recomputed if it or one of its ancestors changed
+	for (size_t level = 0; level + 1 < hierarchy.levelOffsets.size(); level++) {
+		const uint32_t levelBegin = hierarchy.levelOffsets[level];
+		const uint32_t levelCount = hierarchy.levelOffsets[level + 1] - levelBegin;
+		auto updateNodes = [&hierarchy, levelBegin, bufferMatrices, matrixStride](uint32_t begin, uint32_t end) {
+			for (uint32_t i = levelBegin + begin; i < levelBegin + end; i++) {
+				const int32_t parent = hierarchy.parents[i];
+				if ((parent >= 0) && hierarchy.dirty[parent]) {
+					hierarchy.dirty[i] = 1;
+				}
+				if (hierarchy.dirty[i]) {
+					const glm::mat4 local = hierarchy.nodes[i]->localMatrix();
+					hierarchy.worldMatrices[i] = (parent >= 0) ? hierarchy.worldMatrices[parent] * local : local;
+					if (bufferMatrices) {
+						bufferMatrices[i * matrixStride] = hierarchy.worldMatrices[i];
 					}
-					updated = true;
 				}
 			}
+		};
+		if (levelCount >= parallelNodeThreshold) {
+			jobSystem.parallelFor(levelCount, updateNodes);
+		} else {
+			updateNodes(0, levelCount);
 		}
 	}
-	if (updated) {
-		for (auto &node : nodes) {
-			node->update();
+	// A mesh needs to be updated if its node or one of its skin's joints moved
+	auto updateMeshes = [&hierarchy](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			const uint32_t nodeIndex = hierarchy.meshNodes[i];
+			Node* node = hierarchy.nodes[nodeIndex];
+			bool changed = hierarchy.dirty[nodeIndex];
+			if (!changed && node->skin) {
+				changed = std::any_of(node->skin->joints.begin(), node->skin->joints.end(), [&hierarchy](Node* joint) { return hierarchy.dirty[joint->hierarchyIndex] != 0; });
+			}
+			if (changed) {
+				node->updateMesh();
+			}
 		}
+	};
+	const uint32_t meshCount = static_cast<uint32_t>(hierarchy.meshNodes.size());
+	if (meshCount >= parallelMeshThreshold) {
+		jobSystem.parallelFor(meshCount, updateMeshes);
+	} else {
+		updateMeshes(0, meshCount);
+	}
+	std::fill(hierarchy.dirty.begin(), hierarchy.dirty.end(), 0);
+	hierarchy.version++;
+}
+
+void vkglTF::Model::updateNodeBuffer(uint32_t frameIndex)
+{
+	assert(frameIndex < framesInFlight);
+	if (nodeMatrices.frameVersions[frameIndex] == nodeHierarchy.version) {
+		return;
 	}
+	// All matrices are written in one pass, so the slice is consistent even if only some nodes changed since it was last written
+	memcpy(static_cast<uint8_t*>(nodeMatrices.buffer.mapped) + nodeMatrices.frameOffset(frameIndex), nodeHierarchy.bufferMatrices.data(), nodeHierarchy.bufferMatrices.size() * sizeof(glm::mat4));
+	nodeMatrices.frameVersions[frameIndex] = nodeHierarchy.version;
+}
+
+void vkglTF::Model::bindNodeMatrices(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, const Node* node, uint32_t frameIndex)
+{
+	const uint32_t frameOffset = static_cast<uint32_t>(nodeMatrices.frameOffset(frameIndex));
+	const std::array<uint32_t, 2> dynamicOffsets = { frameOffset + node->hierarchyIndex * nodeHierarchy.matrixStride * static_cast<uint32_t>(sizeof(glm::mat4)), frameOffset };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &nodeMatrices.descriptorSet, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
 }
 
 /*
@@ -1575,27 +3861,3 @@ vkglTF::Node* vkglTF::Model::nodeFromIndex(uint32_t index) {
 	}
 	return nodeFound;
 }
-
-void vkglTF::Model::prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout) {
-	if (node->mesh) {
-		VkDescriptorSetAllocateInfo descriptorSetAllocInfo{
-			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-			.descriptorPool = descriptorPool,
-			.descriptorSetCount = 1,
-			.pSetLayouts = &descriptorSetLayout
-		};
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
-		VkWriteDescriptorSet writeDescriptorSet{
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = node->mesh->uniformBuffer.descriptorSet,
-			.dstBinding = 0,
-			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			.pBufferInfo = &node->mesh->uniformBuffer.descriptor
-		};
-		vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
-	}
-	for (auto& child : node->children) {
-		prepareNodeDescriptor(child, descriptorSetLayout);
-	}
-}
@@ -16,12 +16,16 @@
 #pragma once
 
 #include <stdlib.h>
+#include <array>
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
+#include "meshoptimizer.hpp"
+#include "VulkanKtx2.h"
 
 #include <ktx.h>
 #include <ktxvulkan.h>
@@ -51,10 +55,35 @@ namespace vkglTF
 
 	extern VkDescriptorSetLayout descriptorSetLayoutImage;
 	extern VkDescriptorSetLayout descriptorSetLayoutUbo;
+	/** @brief Layout of the bindless material set (FileLoadingFlags::PrepareBindlessMaterials): MaterialData for all materials at binding 0 (storage buffer) and all textures of the model at binding 1 (variable sized combined image sampler array) */
+	extern VkDescriptorSetLayout descriptorSetLayoutMaterials;
+	/** @brief Upper bound for the texture array of descriptorSetLayoutMaterials, clamped to the device's sampler limits when the layout is created */
+	extern uint32_t maxBindlessTextures;
 	extern VkMemoryPropertyFlags memoryPropertyFlags;
 	extern uint32_t descriptorBindingFlags;
+	/** @brief Store the vertices of loaded models in the quantized CompactVertex layout, ignored for models whose vertex buffers are accessed by shaders (storage, device address or acceleration structure build usage in memoryPropertyFlags) */
+	extern bool compactVertices;
+	/** @brief Load models from (and write) cooked mesh caches stored in the per-user cache directory, see Model::loadFromFileAsync */
+	extern bool meshCacheEnabled;
+	/** @brief Adds FileLoadingFlags::OptimizeMeshes to all model loads */
+	extern bool optimizeMeshes;
+	/** @brief Print the source format, device format, size, video memory and load time of all textures once a model has been loaded */
+	extern bool textureReport;
+	enum class TextureCompression {
+		None,
+		/** @brief Encode all images to BC7 */
+		BC7,
+		/** @brief Encode opaque images to BC1 and images with alpha to BC7 */
+		BC1
+	};
+	/** @brief Block compress uncompressed (png/jpg) images with a full mip chain on first load, the result is cached as KTX in the per-user cache directory and uploaded directly on later loads. Requires the textureCompressionBC feature to be enabled */
+	extern TextureCompression textureCompression;
+	/** @brief Number of frames in flight the node matrix buffer has a slice for, needs to match maxConcurrentFrames of the example base class */
+	constexpr uint32_t framesInFlight = 2;
 
 	struct Node;
+	struct NodeHierarchy;
+	struct ImageData;
 
 	/*
 		glTF texture loading class
@@ -71,9 +100,32 @@ namespace vkglTF
 		VkDescriptorImageInfo descriptor;
 		VkSampler sampler;
 		uint32_t index;
+		/** @brief Ticket of the staging ring batch that uploads the image data, destroy waits for it */
+		uint64_t uploadTicket{ 0 };
+		/** @brief Sub-allocated range of deviceMemory the image is bound to */
+		vks::MemoryAllocation allocation{};
+		/** @brief Where the image data came from and how long it took to read, decode or transcode it, see vkglTF::textureReport */
+		struct LoadInfo {
+			std::string source;
+			std::string sourceFormat;
+			VkFormat format{ VK_FORMAT_UNDEFINED };
+			double time{ 0.0 };
+			/** @brief Size of the uploaded data */
+			size_t dataSize{ 0 };
+			/** @brief Size of the RGBA8 mip chain the data replaces if the image was compressed by vkglTF::textureCompression, zero otherwise */
+			size_t sourceSize{ 0 };
+			/** @brief Quality of the compressed image and time spent encoding it (zero if read from the cache) */
+			double psnr{ 0.0 };
+			double encodeTime{ 0.0 };
+			bool cacheHit{ false };
+			/** @brief Why a Basis Universal image could not be transcoded, the texture is a placeholder if this is set */
+			std::string transcodeError;
+		} loadInfo;
 		void updateDescriptor();
 		void destroy();
 		void fromglTfImage(tinygltf::Image& gltfimage, std::string path, vks::VulkanDevice* device, VkQueue copyQueue);
+		/** @brief Creates the image from decoded image data and records the upload (and mip chain generation) into a command buffer, the data must already be in the staging buffer at stagingOffset */
+		void fromImageData(const ImageData& imageData, vks::VulkanDevice* device, VkCommandBuffer copyCmd, VkBuffer stagingBuffer, VkDeviceSize stagingOffset);
 	};
 
 	/*
@@ -99,7 +151,8 @@ namespace vkglTF
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
 		Material(vks::VulkanDevice* device) : device(device) {};
-		void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+		/** @brief Get the material's image descriptor set from the device's descriptor allocator, materials with the same textures share a set */
+		void createDescriptorSet(VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
 	};
 
 	/*
@@ -120,6 +173,15 @@ namespace vkglTF
 			float radius;
 		} dimensions;
 
+		/** @brief Range of the shared index buffer with a simplified version of the primitive, error is the geometric deviation from the original in vertex space */
+		struct Lod {
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			float error;
+		};
+		/** @brief Level of detail chain generated with FileLoadingFlags::GenerateLods, starting with the primitive itself (error 0). Empty if no LODs have been generated */
+		std::vector<Lod> lods;
+
 		void setDimensions(glm::vec3 min, glm::vec3 max);
 		Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), material(material) {};
 	};
@@ -128,26 +190,20 @@ namespace vkglTF
 		glTF mesh
 	*/
 	struct Mesh {
-		vks::VulkanDevice* device;
-
 		std::vector<Primitive*> primitives;
 		std::string name;
 
-		struct UniformBuffer {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-			VkDescriptorBufferInfo descriptor;
-			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-			void* mapped;
-		} uniformBuffer;
-
-		struct UniformBlock {
-			glm::mat4 matrix;
-			glm::mat4 jointMatrix[64]{};
-			float jointcount{ 0 };
-		} uniformBlock;
-
-		Mesh(vks::VulkanDevice* device, glm::mat4 matrix);
+		/** @brief Post-transform vertex cache statistics of all primitives as authored and after optimization, only set if the model was loaded with FileLoadingFlags::OptimizeMeshes */
+		vks::meshopt::VertexCacheStatistics authoredVertexCache;
+		vks::meshopt::VertexCacheStatistics optimizedVertexCache;
+
+		/** @brief Index of the first joint matrix of the node's skin in a frame's slice of Model::nodeMatrices, joint matrices are relative to the node */
+		uint32_t jointMatrixIndex{ 0 };
+		uint32_t jointCount{ 0 };
+		/** @brief Set if the mesh is skinned by Model::skinVertices, its primitives are then drawn from Model::skinning.vertices with skinnedVertexOffset as the vertex offset */
+		bool gpuSkinned{ false };
+		int32_t skinnedVertexOffset{ 0 };
+
 		~Mesh();
 	};
 
@@ -176,12 +232,46 @@ namespace vkglTF
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.0f };
 		glm::quat rotation{};
+		/** @brief Flattened hierarchy of the model this node belongs to, caches the node's world matrix */
+		NodeHierarchy* hierarchy{ nullptr };
+		uint32_t hierarchyIndex{ 0 };
 		glm::mat4 localMatrix();
+		/** @brief Returns the node's world matrix, for nodes of a loaded model this is the matrix cached by the last Model::updateNodeMatrices call */
 		glm::mat4 getMatrix();
+		/** @brief Flags the local transform as changed, so the node and its subtree are recomputed by the next Model::updateNodeMatrices call */
+		void markDirty();
+		/** @brief Computes the joint matrices of a skinned mesh into NodeHierarchy::bufferMatrices */
+		void updateMesh();
 		void update();
 		~Node();
 	};
 
+	/*
+		Flattened node hierarchy
+		Nodes are sorted breadth first, so parents are stored before their children and all nodes of the same depth are stored next to each other
+		World matrices are updated in a single forward pass, nodes of the same depth don't depend on each other and are updated in parallel for large hierarchies
+	*/
+	struct NodeHierarchy {
+		std::vector<Node*> nodes;
+		// Index of the parent node in the sorted arrays, -1 for root nodes
+		std::vector<int32_t> parents;
+		std::vector<glm::mat4> worldMatrices;
+		// Set for nodes whose local transform changed since the last update
+		std::vector<uint8_t> dirty;
+		// Start of each depth level in the sorted arrays, the last element is the node count
+		std::vector<uint32_t> levelOffsets;
+		// Indices of the nodes with a mesh in the sorted arrays
+		std::vector<uint32_t> meshNodes;
+		// Contents of a frame's slice of Model::nodeMatrices
+		// The world matrix of each node is stored matrixStride matrices apart so it can be bound with a dynamic uniform buffer offset, the joint matrices of all skinned meshes are packed after them
+		std::vector<glm::mat4> bufferMatrices;
+		uint32_t matrixStride{ 1 };
+		// Set if the world matrices are baked into the vertices, the buffer keeps identity matrices for the nodes then
+		bool preTransformed{ false };
+		// Incremented whenever bufferMatrices changes
+		uint64_t version{ 0 };
+	};
+
 	/*
 		glTF animation channel
 	*/
@@ -199,7 +289,12 @@ namespace vkglTF
 		enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
 		InterpolationType interpolation;
 		std::vector<float> inputs;
+		// Cubic splines store three outputs per keyframe: in-tangent, value and out-tangent
 		std::vector<glm::vec4> outputsVec4;
+		/** @brief Returns the keyframe that starts the interval containing time. Starts at the cursor from the last call and only does a binary search if time jumped (e.g. on seeks or loops) */
+		uint32_t findKeyframe(float time, uint32_t& cursor) const;
+		/** @brief Returns false if there are not enough outputs for the inputs and interpolation type */
+		bool valid() const;
 	};
 
 	/*
@@ -213,6 +308,33 @@ namespace vkglTF
 		float end = std::numeric_limits<float>::min();
 	};
 
+	/*
+		Animation played by an AnimationState, the results of all layers are blended by their weights
+	*/
+	struct AnimationLayer {
+		uint32_t animation{ 0 };
+		float time{ 0.0f };
+		float weight{ 1.0f };
+	};
+
+	/*
+		Playback state of a model's animations
+		The state only references the model's animations and nodes, so many animated instances can share a single model
+		Transforms and world matrices are stored in the order of the model's node hierarchy
+	*/
+	struct AnimationState {
+		std::vector<AnimationLayer> layers;
+		// Local transforms, nodes not animated by any layer keep their rest pose
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		// Set for nodes animated by at least one layer in the last evaluation
+		std::vector<uint8_t> animated;
+		std::vector<glm::mat4> worldMatrices;
+		// Keyframe cursor for each sampler of each animation
+		std::vector<std::vector<uint32_t>> cursors;
+	};
+
 	/*
 		glTF default vertex layout with easy Vulkan mapping functions
 	*/
@@ -234,6 +356,30 @@ namespace vkglTF
 		static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components);
 		/** @brief Returns the default pipeline vertex input state create info structure for the requested vertex components */
 		static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+		/** @brief Returns true if vertex buffers use the CompactVertex layout, the input descriptions above match the layout in use */
+		static bool useCompactLayout();
+		/** @brief Converts vertices to the layout used for vertex buffers */
+		static std::vector<uint8_t> pack(const Vertex* vertices, size_t count);
+	};
+
+	/*
+		Quantized vertex layout, used for vertex buffers if compactVertices is enabled (half the size of Vertex)
+		All formats are converted to floats by the vertex input stage, so shaders written for Vertex work unchanged
+	*/
+	struct CompactVertex {
+		glm::vec3 pos;
+		// VK_FORMAT_R16G16B16A16_SNORM
+		int16_t normal[4];
+		// VK_FORMAT_R16G16_SFLOAT
+		uint16_t uv[2];
+		// VK_FORMAT_R8G8B8A8_UNORM
+		uint8_t color[4];
+		// VK_FORMAT_R16G16B16A16_SFLOAT, exact for joint indices below 2048
+		uint16_t joint0[4];
+		// VK_FORMAT_R8G8B8A8_UNORM, rounded so the weights still sum up to one
+		uint8_t weight0[4];
+		// VK_FORMAT_R16G16B16A16_SNORM
+		int16_t tangent[4];
 	};
 
 	enum FileLoadingFlags {
@@ -241,14 +387,106 @@ namespace vkglTF
 		PreTransformVertices = 0x00000001,
 		PreMultiplyVertexColors = 0x00000002,
 		FlipY = 0x00000004,
-		DontLoadImages = 0x00000008
+		DontLoadImages = 0x00000008,
+		OptimizeMeshes = 0x00000010,
+		GenerateLods = 0x00000020,
+		PrepareIndirectDraws = 0x00000040,
+		PrepareGpuSkinning = 0x00000080,
+		PrepareBindlessMaterials = 0x00000100
 	};
 
 	enum RenderFlags {
 		BindImages = 0x00000001,
 		RenderOpaqueNodes = 0x00000002,
 		RenderAlphaMaskedNodes = 0x00000004,
-		RenderAlphaBlendedNodes = 0x00000008
+		RenderAlphaBlendedNodes = 0x00000008,
+		/** @brief Push the index of each primitive's material as a uint32_t at offset 0 of the fragment stage's push constant range, for use with the bindless material set */
+		PushMaterialIndex = 0x00000010
+	};
+
+	/*
+		Wall clock time in milliseconds spent in the different stages of loading a model
+		Images are decoded while vertices are converted, so the decode and convert stages overlap
+	*/
+	struct LoadTimings {
+		double parse{ 0.0 };
+		double decode{ 0.0 };
+		double convert{ 0.0 };
+		double upload{ 0.0 };
+		/** @brief Part of convert spent on FileLoadingFlags::OptimizeMeshes */
+		double optimize{ 0.0 };
+		/** @brief Part of convert spent on FileLoadingFlags::GenerateLods */
+		double lods{ 0.0 };
+		/** @brief True if the scene and vertex data have been read from the mesh cache, parse then contains the time spent reading the cache */
+		bool meshCacheHit{ false };
+	};
+
+	/*
+		Range of vertices skinned by the compute skinning pass, one entry per skinned mesh
+		Matches the std430 layout of the shaders that read it
+	*/
+	struct SkinningJob {
+		/** @brief Range of the mesh's vertices in the model's vertex buffer */
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		/** @brief Start of the skinned vertices in a frame's slice of the output buffer */
+		uint32_t outputFirstVertex;
+		/** @brief Index of the first joint matrix in a frame's slice of Model::nodeMatrices */
+		uint32_t jointMatrixIndex;
+	};
+
+	/*
+		Material parameters of the bindless material set, one entry per Model::materials
+		Texture indices point into the set's texture array, missing textures point to the empty texture at the end of the array
+		Matches the std430 layout of the shaders that read it
+	*/
+	struct MaterialData {
+		glm::vec4 baseColorFactor;
+		uint32_t baseColorTextureIndex;
+		uint32_t normalTextureIndex;
+		uint32_t metallicRoughnessTextureIndex;
+		uint32_t occlusionTextureIndex;
+		uint32_t emissiveTextureIndex;
+		float metallicFactor;
+		float roughnessFactor;
+		float alphaCutoff;
+		/** @brief Material::AlphaMode */
+		uint32_t alphaMode;
+		uint32_t padding[3];
+	};
+
+	/*
+		Per-draw data of the indirect draw path, one entry per flattened primitive in the same order as the indirect commands
+		Matches the std430 layout of the shaders that read it
+	*/
+	struct IndirectDrawData {
+		/** @brief Bounding sphere in the space of the vertex data (xyz = center, w = radius) */
+		glm::vec4 boundingSphere;
+		/** @brief Index of the node's world matrix in a frame's slice of Model::nodeMatrices */
+		uint32_t transformIndex;
+		/** @brief Index into Model::materials (and MaterialData of the bindless material set) */
+		uint32_t materialIndex;
+		/** @brief Command range (Material::AlphaMode) the draw belongs to and the first command of that range */
+		uint32_t range;
+		uint32_t rangeFirst;
+	};
+
+	class Model;
+
+	/*
+		Handle for a model that is loaded asynchronously with Model::loadFromFileAsync
+	*/
+	class LoadHandle {
+	private:
+		Model* model{ nullptr };
+	public:
+		LoadHandle() {};
+		LoadHandle(Model* model) : model(model) {};
+		/** @brief Advances the load without blocking and returns true once the model can be used. Must be called from the thread that owns the transfer queue passed at load time */
+		bool ready();
+		/** @brief Blocks until the model has been loaded */
+		void wait();
+		bool valid() const { return model != nullptr; };
 	};
 
 	/*
@@ -256,12 +494,31 @@ namespace vkglTF
 	*/
 	class Model {
 	private:
+		struct AsyncLoad;
+		std::shared_ptr<AsyncLoad> asyncLoad;
 		vkglTF::Texture* getTexture(uint32_t index);
 		vkglTF::Texture emptyTexture;
-		void createEmptyTexture(VkQueue transferQueue);
+		void createEmptyTexture(VkCommandBuffer copyCmd, VkBuffer stagingBuffer, VkDeviceSize stagingOffset);
+		void createDescriptorSetLayouts(uint32_t fileLoadingFlags);
+		void setupDescriptors();
+		void runCpuStages();
+		void submitUpload();
+		void finishLoading();
+		void buildNodeHierarchy();
+		// State used to apply animations to the model's own nodes
+		AnimationState animationState;
+		void sampleAnimationLayers(AnimationState& state) const;
+		bool readMeshCache(const std::string& cacheFile);
+		void writeMeshCache(const std::string& cacheFile);
+		void optimizeMeshes(std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer);
+		void generateLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
+		void flattenDraws();
+		void createIndirectBuffers();
+		void createNodeMatrixBuffer();
+		void createSkinningBuffers();
+		void createMaterialBuffer();
 	public:
 		vks::VulkanDevice* device;
-		VkDescriptorPool descriptorPool;
 
 		struct Vertices {
 			int count;
@@ -276,6 +533,7 @@ namespace vkglTF
 
 		std::vector<Node*> nodes;
 		std::vector<Node*> linearNodes;
+		NodeHierarchy nodeHierarchy;
 
 		std::vector<Skin*> skins;
 
@@ -295,22 +553,146 @@ namespace vkglTF
 		bool buffersBound = false;
 		std::string path;
 
+		LoadTimings loadTimings{};
+
+		/** @brief Parameters for FileLoadingFlags::GenerateLods, need to be set before loading the model */
+		struct LodSettings {
+			/** @brief Maximum number of levels per primitive including the original, the chain ends early if a primitive can't be simplified any further */
+			uint32_t levelCount{ 5 };
+			/** @brief Target index count of each level relative to the previous one */
+			float reduction{ 0.5f };
+			/** @brief Maximum error of the last level relative to the primitive's bounding radius */
+			float maxError{ 0.1f };
+		} lodSettings;
+
+		/*
+			GPU-driven draw path, set up if the model is loaded with FileLoadingFlags::PrepareIndirectDraws
+			All primitives are flattened into one indirect command each, grouped into ranges by alpha mode
+			The draw index is passed as firstInstance, so shaders look up their IndirectDrawData with gl_InstanceIndex (requires the drawIndirectFirstInstance feature)
+		*/
+		struct IndirectDraws {
+			struct Range {
+				uint32_t first{ 0 };
+				uint32_t count{ 0 };
+			};
+			/** @brief Command range for each Material::AlphaMode */
+			std::array<Range, 3> ranges{};
+			uint32_t drawCount{ 0 };
+			/** @brief VkDrawIndexedIndirectCommand for each primitive */
+			vks::Buffer commands;
+			/** @brief IndirectDrawData for each primitive */
+			vks::Buffer drawData;
+			/** @brief Output of the culling pass, visible draws are compacted into their range if draw indirect count is used, otherwise culled draws get an instance count of zero */
+			vks::Buffer culledCommands;
+			/** @brief Number of visible draws in each range, written by the culling pass */
+			vks::Buffer drawCounts;
+			// Culling pass, created by prepareIndirectCulling
+			bool compact{ false };
+			VkPipeline cullPipeline{ VK_NULL_HANDLE };
+			VkPipelineLayout cullPipelineLayout{ VK_NULL_HANDLE };
+			VkDescriptorSetLayout cullDescriptorSetLayout{ VK_NULL_HANDLE };
+			VkDescriptorSet cullDescriptorSet{ VK_NULL_HANDLE };
+			PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCount{ nullptr };
+		} indirect;
+
+		/*
+			Node and joint matrices of the whole model in one host visible buffer, with a slice for each frame in flight
+			Written with updateNodeBuffer, so matrices can be changed while earlier frames are still being rendered
+			The descriptor set (descriptorSetLayoutUbo) has the world matrix of a single node at binding 0 (dynamic uniform buffer, selected with bindNodeMatrices) and all matrices of a frame at binding 1 (dynamic storage buffer), shaders index the latter with IndirectDrawData::transformIndex or Mesh::jointMatrixIndex
+		*/
+		struct NodeMatrices {
+			vks::Buffer buffer;
+			/** @brief Size of a frame's slice, aligned for use as a dynamic offset */
+			VkDeviceSize frameSize{ 0 };
+			VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+			/** @brief NodeHierarchy::version last written to each frame's slice */
+			std::array<uint64_t, framesInFlight> frameVersions{};
+			VkDeviceSize frameOffset(uint32_t frameIndex) const { return frameIndex * frameSize; }
+		} nodeMatrices;
+
+		/*
+			Bindless materials, set up if the model is loaded with FileLoadingFlags::PrepareBindlessMaterials (requires images to be loaded)
+			All materials and textures are in a single descriptor set (descriptorSetLayoutMaterials) that's bound once with bindMaterials, draws select their material by index instead of binding a set per material
+			Shaders index the texture array with values that may differ between invocations, so the device needs the runtimeDescriptorArray, shaderSampledImageArrayNonUniformIndexing and descriptorBindingVariableDescriptorCount features of descriptor indexing
+			The per-material descriptor sets are still created, so the model can be drawn both ways
+		*/
+		struct BindlessMaterials {
+			/** @brief MaterialData for each material */
+			vks::Buffer buffer;
+			/** @brief Size of the texture array, all textures of the model followed by the empty texture */
+			uint32_t textureCount{ 0 };
+			VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+		} bindless;
+
+		/*
+			Compute skinning, set up if the model is loaded with FileLoadingFlags::PrepareGpuSkinning
+			A compute pass skins the vertices of all skinned meshes once per frame into an output buffer with the same vertex layout, so all passes drawing the model read pre-skinned vertices with the same shaders as static meshes
+			The compute shader reads the model's vertex buffer, so it needs to be created with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT in memoryPropertyFlags (which also keeps the default vertex layout)
+		*/
+		struct GpuSkinning {
+			uint32_t jobCount{ 0 };
+			/** @brief Largest vertex count of a single job, determines the dispatch size */
+			uint32_t maxJobVertexCount{ 0 };
+			uint32_t vertexCount{ 0 };
+			/** @brief SkinningJob for each skinned mesh */
+			vks::Buffer jobs;
+			/** @brief Skinned vertices with a slice for each frame in flight */
+			vks::Buffer vertices;
+			VkDeviceSize frameSize{ 0 };
+			// Skinning pass, created by prepareSkinning
+			VkPipeline pipeline{ VK_NULL_HANDLE };
+			VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+			VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+			VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+			VkDeviceSize frameOffset(uint32_t frameIndex) const { return frameIndex * frameSize; }
+		} skinning;
+
 		Model() {};
 		~Model();
 		void loadNode(vkglTF::Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
 		void loadSkins(tinygltf::Model& gltfModel);
-		void loadImages(tinygltf::Model& gltfModel, vks::VulkanDevice* device, VkQueue transferQueue);
 		void loadMaterials(tinygltf::Model& gltfModel);
 		void loadAnimations(tinygltf::Model& gltfModel);
 		void loadFromFile(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		/** @brief Starts loading the model in the background, parsing, image decoding and vertex conversion run on worker threads and the upload is batched into a single submission. With meshCacheEnabled, the converted data is cached in filename + ".meshcache" */
+		LoadHandle loadFromFileAsync(std::string filename, vks::VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = vkglTF::FileLoadingFlags::None, float scale = 1.0f);
+		/** @brief Advances an asynchronous load, returns true once the model is ready to be used. If wait is true, this blocks until loading has finished */
+		bool updateLoading(bool wait = false);
 		void bindBuffers(VkCommandBuffer commandBuffer);
 		void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
 		void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+		/** @brief Creates the compute pipeline that culls and compacts the indirect draws. The shader stage is owned by the caller, drawIndirectCount selects compaction with vkCmdDrawIndexedIndirectCount (core or VK_KHR_draw_indirect_count) */
+		void prepareIndirectCulling(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache, bool drawIndirectCount);
+		/** @brief Records the culling pass against frustum planes in the space the node matrices map to, reading the node matrices of the given frame. Needs to be recorded outside of a render pass */
+		void cullIndirectDraws(VkCommandBuffer commandBuffer, const std::array<glm::vec4, 6>& frustumPlanes, uint32_t frameIndex);
+		/** @brief Draws all primitives with a few indirect draws, using the output of the last culling pass if culled is set. Materials aren't bound, shaders fetch them through the per-draw data */
+		void drawIndirect(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, bool culled = true);
+		/** @brief Binds the bindless material set, materials are then selected with RenderFlags::PushMaterialIndex or IndirectDrawData::materialIndex */
+		void bindMaterials(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set);
+		/** @brief Creates the compute pipeline that skins the vertices of all skinned meshes, the shader stage is owned by the caller */
+		void prepareSkinning(VkPipelineShaderStageCreateInfo shaderStage, VkPipelineCache pipelineCache);
+		/** @brief Records the skinning pass with the joint matrices of the given frame's slice of nodeMatrices into the frame's slice of skinned vertices, needs to be recorded outside of a render pass */
+		void skinVertices(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		/** @brief Binds the frame's skinned vertices as the vertex buffer, primitives of meshes with Mesh::gpuSkinned set are then drawn with Mesh::skinnedVertexOffset */
+		void bindSkinnedVertices(VkCommandBuffer commandBuffer, uint32_t frameIndex);
 		void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
 		void getSceneDimensions();
 		void updateAnimation(uint32_t index, float time);
+		/** @brief Blends several animations and applies the result to the model's nodes */
+		void blendAnimations(const std::vector<AnimationLayer>& layers);
+		/** @brief Sets up an animation state for this model with all nodes in their rest pose */
+		void initAnimationState(AnimationState& state) const;
+		/** @brief Samples and blends the state's layers into its local transforms and computes its world matrices, doesn't touch the model's nodes */
+		void evaluateAnimation(AnimationState& state) const;
+		/** @brief Evaluates many animation states of this model in parallel */
+		void evaluateAnimations(std::vector<AnimationState>& states) const;
+		/** @brief Recomputes the world matrices of all nodes flagged with markDirty and their subtrees, and updates the joint matrices of the affected meshes */
+		void updateNodeMatrices();
+		/** @brief Copies the node and joint matrices to the frame's slice of the node matrix buffer if they changed since it was last written, call before recording a frame that reads them */
+		void updateNodeBuffer(uint32_t frameIndex);
+		/** @brief Binds the node matrix descriptor set with the dynamic offsets for the node's world matrix in the given frame's slice */
+		void bindNodeMatrices(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, const Node* node, uint32_t frameIndex);
 		Node* findNode(Node* parent, uint32_t index);
 		Node* nodeFromIndex(uint32_t index);
-		void prepareNodeDescriptor(vkglTF::Node* node, VkDescriptorSetLayout descriptorSetLayout);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,546 @@
+/*
+* Block compression encoder for RGBA8 images
+*
+* Encodes images to BC1 (opaque RGB, 4 bits per pixel) and BC7 (RGBA, 8 bits per pixel) on the CPU
+* Endpoints are fitted along the principal axis of the block's colors and refined with a least squares fit for the chosen indices
+* BC7 blocks are always encoded in mode 6 (single subset, 7 bit RGBA endpoints with a shared bit each and 4 bit indices), the mode that's best for smooth and alpha content
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include "jobsystem.hpp"
+
+namespace vks
+{
+	namespace bc
+	{
+		enum class Format {
+			BC1,
+			BC7
+		};
+
+		/** @brief Size of a 4x4 block in bytes */
+		inline size_t blockSize(Format format)
+		{
+			return (format == Format::BC1) ? 8 : 16;
+		}
+
+		/** @brief Size of an encoded image in bytes, partial blocks at the right and bottom edge are padded */
+		inline size_t encodedSize(Format format, uint32_t width, uint32_t height)
+		{
+			return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+		}
+
+		/** @brief Squared error of an encoded image against its source, these can be summed up for several images (e.g. a mip chain) */
+		struct Statistics
+		{
+			double squaredError{ 0.0 };
+			uint64_t sampleCount{ 0 };
+
+			/** @brief Peak signal to noise ratio in dB, higher is better (around 40 dB is visually lossless for most content) */
+			double psnr() const
+			{
+				if (sampleCount == 0 || squaredError == 0.0) {
+					return 99.0;
+				}
+				return 10.0 * std::log10(255.0 * 255.0 / (squaredError / static_cast<double>(sampleCount)));
+			}
+
+			Statistics& operator+=(const Statistics& other)
+			{
+				squaredError += other.squaredError;
+				sampleCount += other.sampleCount;
+				return *this;
+			}
+		};
+
+		namespace detail
+		{
+			// Bits are stored starting at the least significant bit of the first byte
+			struct BitWriter
+			{
+				uint8_t* data;
+				uint32_t position{ 0 };
+				void write(uint32_t value, uint32_t count)
+				{
+					for (uint32_t i = 0; i < count; i++, position++) {
+						if ((value >> i) & 1) {
+							data[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+						}
+					}
+				}
+			};
+
+			struct BitReader
+			{
+				const uint8_t* data;
+				uint32_t position{ 0 };
+				uint32_t read(uint32_t count)
+				{
+					uint32_t value = 0;
+					for (uint32_t i = 0; i < count; i++, position++) {
+						value |= ((data[position >> 3] >> (position & 7)) & 1) << i;
+					}
+					return value;
+				}
+			};
+
+			/*
+				Mean and principal axis of the block's colors, the axis is found by power iteration on the covariance matrix
+				Returns the range of the colors projected onto the axis relative to the mean
+			*/
+			inline void principalAxis(const float pixels[16][4], uint32_t channels, float mean[4], float axis[4], float& minT, float& maxT)
+			{
+				for (uint32_t c = 0; c < 4; c++) {
+					mean[c] = 0.0f;
+					axis[c] = 0.0f;
+				}
+				for (uint32_t i = 0; i < 16; i++) {
+					for (uint32_t c = 0; c < channels; c++) {
+						mean[c] += pixels[i][c] / 16.0f;
+					}
+				}
+				float covariance[4][4]{};
+				for (uint32_t i = 0; i < 16; i++) {
+					for (uint32_t a = 0; a < channels; a++) {
+						for (uint32_t b = 0; b < channels; b++) {
+							covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+						}
+					}
+				}
+				for (uint32_t c = 0; c < channels; c++) {
+					axis[c] = 1.0f;
+				}
+				for (uint32_t iteration = 0; iteration < 8; iteration++) {
+					float next[4]{};
+					float length = 0.0f;
+					for (uint32_t a = 0; a < channels; a++) {
+						for (uint32_t b = 0; b < channels; b++) {
+							next[a] += covariance[a][b] * axis[b];
+						}
+						length = std::max(length, std::abs(next[a]));
+					}
+					if (length < 1e-6f) {
+						break;
+					}
+					for (uint32_t c = 0; c < channels; c++) {
+						axis[c] = next[c] / length;
+					}
+				}
+				float length = 0.0f;
+				for (uint32_t c = 0; c < channels; c++) {
+					length += axis[c] * axis[c];
+				}
+				length = std::sqrt(length);
+				for (uint32_t c = 0; c < channels; c++) {
+					axis[c] /= length;
+				}
+				minT = maxT = 0.0f;
+				for (uint32_t i = 0; i < 16; i++) {
+					float t = 0.0f;
+					for (uint32_t c = 0; c < channels; c++) {
+						t += (pixels[i][c] - mean[c]) * axis[c];
+					}
+					minT = std::min(minT, t);
+					maxT = std::max(maxT, t);
+				}
+			}
+
+			/*
+				Least squares fit of both endpoints for the given interpolation weights (0 = first endpoint, 1 = second endpoint) of each pixel
+				Returns false if all pixels use the same weight, as the endpoints are then underdetermined
+			*/
+			inline bool refineEndpoints(const float pixels[16][4], uint32_t channels, const float weights[16], float e0[4], float e1[4])
+			{
+				float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+				float ax[4]{}, bx[4]{};
+				for (uint32_t i = 0; i < 16; i++) {
+					const float b = weights[i];
+					const float a = 1.0f - b;
+					aa += a * a;
+					ab += a * b;
+					bb += b * b;
+					for (uint32_t c = 0; c < channels; c++) {
+						ax[c] += a * pixels[i][c];
+						bx[c] += b * pixels[i][c];
+					}
+				}
+				const float determinant = aa * bb - ab * ab;
+				if (std::abs(determinant) < 1e-6f) {
+					return false;
+				}
+				for (uint32_t c = 0; c < channels; c++) {
+					e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+					e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+				}
+				return true;
+			}
+
+			inline uint32_t selectIndex(const float pixel[4], const int palette[][4], uint32_t paletteSize, uint32_t channels, float& error)
+			{
+				uint32_t best = 0;
+				error = 1e30f;
+				for (uint32_t p = 0; p < paletteSize; p++) {
+					float distance = 0.0f;
+					for (uint32_t c = 0; c < channels; c++) {
+						const float d = pixel[c] - static_cast<float>(palette[p][c]);
+						distance += d * d;
+					}
+					if (distance < error) {
+						error = distance;
+						best = p;
+					}
+				}
+				return best;
+			}
+
+			inline uint16_t packRGB565(const float color[4])
+			{
+				const uint32_t r = static_cast<uint32_t>(std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+				const uint32_t g = static_cast<uint32_t>(std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+				const uint32_t b = static_cast<uint32_t>(std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+				return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+			}
+
+			inline void unpackRGB565(uint16_t value, int color[4])
+			{
+				const int r = (value >> 11) & 31;
+				const int g = (value >> 5) & 63;
+				const int b = value & 31;
+				color[0] = (r << 3) | (r >> 2);
+				color[1] = (g << 2) | (g >> 4);
+				color[2] = (b << 3) | (b >> 2);
+				color[3] = 255;
+			}
+
+			inline void paletteBC1(uint16_t color0, uint16_t color1, int palette[4][4])
+			{
+				unpackRGB565(color0, palette[0]);
+				unpackRGB565(color1, palette[1]);
+				for (uint32_t c = 0; c < 4; c++) {
+					if (color0 > color1) {
+						palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+						palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+					} else {
+						palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+						palette[3][c] = 0;
+					}
+				}
+			}
+
+			// Quantizes the endpoints and selects the indices, returns the squared error of the block
+			inline float fitBC1(const float pixels[16][4], const float e0[4], const float e1[4], uint16_t& color0, uint16_t& color1, uint32_t indices[16])
+			{
+				color0 = packRGB565(e0);
+				color1 = packRGB565(e1);
+				// Four color mode requires color0 > color1, equal endpoints only need the first color
+				if (color0 < color1) {
+					std::swap(color0, color1);
+				}
+				int palette[4][4];
+				paletteBC1(color0, color1, palette);
+				const uint32_t paletteSize = (color0 == color1) ? 1 : 4;
+				float error = 0.0f;
+				for (uint32_t i = 0; i < 16; i++) {
+					float pixelError;
+					indices[i] = selectIndex(pixels[i], palette, paletteSize, 3, pixelError);
+					error += pixelError;
+				}
+				return error;
+			}
+
+			// Interpolation weights of BC7 4 bit indices in 1/64th
+			const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+			struct BC7Mode6 {
+				uint32_t endpoints[2][4];
+				uint32_t pbits[2];
+				uint32_t indices[16];
+			};
+
+			inline void paletteBC7(const BC7Mode6& mode, int palette[16][4])
+			{
+				for (uint32_t p = 0; p < 16; p++) {
+					for (uint32_t c = 0; c < 4; c++) {
+						const int v0 = static_cast<int>((mode.endpoints[0][c] << 1) | mode.pbits[0]);
+						const int v1 = static_cast<int>((mode.endpoints[1][c] << 1) | mode.pbits[1]);
+						palette[p][c] = ((64 - bc7Weights[p]) * v0 + bc7Weights[p] * v1 + 32) >> 6;
+					}
+				}
+			}
+
+			// Quantizes the endpoints with all four shared bit combinations and keeps the best, returns the squared error of the block
+			inline float fitBC7(const float pixels[16][4], const float e0[4], const float e1[4], BC7Mode6& best)
+			{
+				float bestError = 1e30f;
+				for (uint32_t p = 0; p < 4; p++) {
+					BC7Mode6 mode{};
+					mode.pbits[0] = p & 1;
+					mode.pbits[1] = p >> 1;
+					for (uint32_t c = 0; c < 4; c++) {
+						mode.endpoints[0][c] = static_cast<uint32_t>(std::clamp(std::lround((e0[c] - mode.pbits[0]) / 2.0f), 0l, 127l));
+						mode.endpoints[1][c] = static_cast<uint32_t>(std::clamp(std::lround((e1[c] - mode.pbits[1]) / 2.0f), 0l, 127l));
+					}
+					int palette[16][4];
+					paletteBC7(mode, palette);
+					float error = 0.0f;
+					for (uint32_t i = 0; i < 16; i++) {
+						float pixelError;
+						mode.indices[i] = selectIndex(pixels[i], palette, 16, 4, pixelError);
+						error += pixelError;
+					}
+					if (error < bestError) {
+						bestError = error;
+						best = mode;
+					}
+				}
+				return bestError;
+			}
+		}
+
+		/** @brief Encodes a block of 4x4 RGBA8 pixels (row by row) to BC1, alpha is ignored */
+		inline void encodeBlockBC1(const uint8_t* rgba, uint8_t* block)
+		{
+			float pixels[16][4];
+			for (uint32_t i = 0; i < 16; i++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					pixels[i][c] = static_cast<float>(rgba[i * 4 + c]);
+				}
+			}
+			float mean[4], axis[4], minT, maxT;
+			detail::principalAxis(pixels, 3, mean, axis, minT, maxT);
+			float e0[4], e1[4];
+			for (uint32_t c = 0; c < 4; c++) {
+				e0[c] = mean[c] + axis[c] * maxT;
+				e1[c] = mean[c] + axis[c] * minT;
+			}
+			uint16_t color0, color1;
+			uint32_t indices[16];
+			float error = detail::fitBC1(pixels, e0, e1, color0, color1, indices);
+			// Palette entries as weights of the second endpoint
+			const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			for (uint32_t iteration = 0; iteration < 2 && color0 != color1; iteration++) {
+				float pixelWeights[16];
+				for (uint32_t i = 0; i < 16; i++) {
+					pixelWeights[i] = weights[indices[i]];
+				}
+				if (!detail::refineEndpoints(pixels, 3, pixelWeights, e0, e1)) {
+					break;
+				}
+				uint16_t refined0, refined1;
+				uint32_t refinedIndices[16];
+				const float refinedError = detail::fitBC1(pixels, e0, e1, refined0, refined1, refinedIndices);
+				if (refinedError >= error) {
+					break;
+				}
+				error = refinedError;
+				color0 = refined0;
+				color1 = refined1;
+				memcpy(indices, refinedIndices, sizeof(indices));
+			}
+			uint32_t packedIndices = 0;
+			for (uint32_t i = 0; i < 16; i++) {
+				packedIndices |= indices[i] << (i * 2);
+			}
+			memcpy(block, &color0, 2);
+			memcpy(block + 2, &color1, 2);
+			memcpy(block + 4, &packedIndices, 4);
+		}
+
+		/** @brief Decodes a BC1 block to 4x4 RGBA8 pixels */
+		inline void decodeBlockBC1(const uint8_t* block, uint8_t* rgba)
+		{
+			uint16_t color0, color1;
+			uint32_t packedIndices;
+			memcpy(&color0, block, 2);
+			memcpy(&color1, block + 2, 2);
+			memcpy(&packedIndices, block + 4, 4);
+			int palette[4][4];
+			detail::paletteBC1(color0, color1, palette);
+			for (uint32_t i = 0; i < 16; i++) {
+				const uint32_t index = (packedIndices >> (i * 2)) & 3;
+				for (uint32_t c = 0; c < 4; c++) {
+					rgba[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+				}
+			}
+		}
+
+		/** @brief Encodes a block of 4x4 RGBA8 pixels (row by row) to BC7 mode 6 */
+		inline void encodeBlockBC7(const uint8_t* rgba, uint8_t* block)
+		{
+			float pixels[16][4];
+			for (uint32_t i = 0; i < 16; i++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					pixels[i][c] = static_cast<float>(rgba[i * 4 + c]);
+				}
+			}
+			float mean[4], axis[4], minT, maxT;
+			detail::principalAxis(pixels, 4, mean, axis, minT, maxT);
+			float e0[4], e1[4];
+			for (uint32_t c = 0; c < 4; c++) {
+				e0[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+				e1[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+			}
+			detail::BC7Mode6 mode;
+			float error = detail::fitBC7(pixels, e0, e1, mode);
+			for (uint32_t iteration = 0; iteration < 2 && error > 0.0f; iteration++) {
+				float weights[16];
+				for (uint32_t i = 0; i < 16; i++) {
+					weights[i] = detail::bc7Weights[mode.indices[i]] / 64.0f;
+				}
+				if (!detail::refineEndpoints(pixels, 4, weights, e0, e1)) {
+					break;
+				}
+				detail::BC7Mode6 refined;
+				const float refinedError = detail::fitBC7(pixels, e0, e1, refined);
+				if (refinedError >= error) {
+					break;
+				}
+				error = refinedError;
+				mode = refined;
+			}
+			// The most significant bit of the first pixel's index is implicitly zero, so the endpoints are swapped if it's set
+			if (mode.indices[0] & 8) {
+				for (uint32_t c = 0; c < 4; c++) {
+					std::swap(mode.endpoints[0][c], mode.endpoints[1][c]);
+				}
+				std::swap(mode.pbits[0], mode.pbits[1]);
+				for (uint32_t i = 0; i < 16; i++) {
+					mode.indices[i] = 15 - mode.indices[i];
+				}
+			}
+			memset(block, 0, 16);
+			detail::BitWriter writer{ block };
+			writer.write(1 << 6, 7);
+			for (uint32_t c = 0; c < 4; c++) {
+				writer.write(mode.endpoints[0][c], 7);
+				writer.write(mode.endpoints[1][c], 7);
+			}
+			writer.write(mode.pbits[0], 1);
+			writer.write(mode.pbits[1], 1);
+			for (uint32_t i = 0; i < 16; i++) {
+				writer.write(mode.indices[i], (i == 0) ? 3 : 4);
+			}
+		}
+
+		/** @brief Decodes a BC7 block that has been encoded with encodeBlockBC7 (mode 6 only) to 4x4 RGBA8 pixels */
+		inline void decodeBlockBC7(const uint8_t* block, uint8_t* rgba)
+		{
+			detail::BitReader reader{ block };
+			detail::BC7Mode6 mode{};
+			if (reader.read(7) != (1 << 6)) {
+				memset(rgba, 0, 64);
+				return;
+			}
+			for (uint32_t c = 0; c < 4; c++) {
+				mode.endpoints[0][c] = reader.read(7);
+				mode.endpoints[1][c] = reader.read(7);
+			}
+			mode.pbits[0] = reader.read(1);
+			mode.pbits[1] = reader.read(1);
+			int palette[16][4];
+			detail::paletteBC7(mode, palette);
+			for (uint32_t i = 0; i < 16; i++) {
+				const uint32_t index = reader.read((i == 0) ? 3 : 4);
+				for (uint32_t c = 0; c < 4; c++) {
+					rgba[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+				}
+			}
+		}
+
+		/**
+		* Encodes an RGBA8 image, rows of blocks are encoded in parallel if a job system is passed
+		*
+		* @param format Target format
+		* @param rgba Tightly packed source pixels
+		* @param width, height Size of the image in pixels
+		* @param output Encoded blocks, needs to be encodedSize() bytes
+		* @param jobSystem (Optional) Job system to encode rows of blocks on, encoded on the calling thread if null
+		* @param statistics (Optional) Receives the squared error of the decoded blocks against the source (alpha is not counted for BC1)
+		*/
+		inline void encodeImage(Format format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output, JobSystem* jobSystem = nullptr, Statistics* statistics = nullptr)
+		{
+			const uint32_t blocksX = (width + 3) / 4;
+			const uint32_t blocksY = (height + 3) / 4;
+			const uint32_t channels = (format == Format::BC1) ? 3 : 4;
+			std::vector<Statistics> rowStatistics(blocksY);
+			auto encodeRows = [&](uint32_t begin, uint32_t end) {
+				uint8_t source[64], decoded[64];
+				for (uint32_t by = begin; by < end; by++) {
+					for (uint32_t bx = 0; bx < blocksX; bx++) {
+						// Pixels outside of the image are filled by clamping to the edge, so they don't skew the endpoints
+						for (uint32_t y = 0; y < 4; y++) {
+							for (uint32_t x = 0; x < 4; x++) {
+								const uint32_t sx = std::min(bx * 4 + x, width - 1);
+								const uint32_t sy = std::min(by * 4 + y, height - 1);
+								memcpy(&source[(y * 4 + x) * 4], &rgba[(static_cast<size_t>(sy) * width + sx) * 4], 4);
+							}
+						}
+						uint8_t* block = output + (static_cast<size_t>(by) * blocksX + bx) * blockSize(format);
+						if (format == Format::BC1) {
+							encodeBlockBC1(source, block);
+						} else {
+							encodeBlockBC7(source, block);
+						}
+						if (statistics) {
+							if (format == Format::BC1) {
+								decodeBlockBC1(block, decoded);
+							} else {
+								decodeBlockBC7(block, decoded);
+							}
+							for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+								for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+									for (uint32_t c = 0; c < channels; c++) {
+										const double d = static_cast<double>(source[(y * 4 + x) * 4 + c]) - static_cast<double>(decoded[(y * 4 + x) * 4 + c]);
+										rowStatistics[by].squaredError += d * d;
+										rowStatistics[by].sampleCount++;
+									}
+								}
+							}
+						}
+					}
+				}
+			};
+			if (jobSystem) {
+				jobSystem->parallelFor(blocksY, encodeRows);
+			} else {
+				encodeRows(0, blocksY);
+			}
+			if (statistics) {
+				for (const Statistics& row : rowStatistics) {
+					*statistics += row;
+				}
+			}
+		}
+
+		/** @brief Halves an RGBA8 image with a box filter, odd edges are clamped */
+		inline void downsample(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+		{
+			const uint32_t mipWidth = std::max(width / 2, 1u);
+			const uint32_t mipHeight = std::max(height / 2, 1u);
+			output.resize(static_cast<size_t>(mipWidth) * mipHeight * 4);
+			for (uint32_t y = 0; y < mipHeight; y++) {
+				const uint32_t y0 = std::min(y * 2, height - 1);
+				const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+				for (uint32_t x = 0; x < mipWidth; x++) {
+					const uint32_t x0 = std::min(x * 2, width - 1);
+					const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+					for (uint32_t c = 0; c < 4; c++) {
+						const uint32_t sum = rgba[(static_cast<size_t>(y0) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y0) * width + x1) * 4 + c] + rgba[(static_cast<size_t>(y1) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+						output[(static_cast<size_t>(y) * mipWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+}
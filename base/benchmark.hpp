@@ -13,24 +13,158 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <cmath>
 
 namespace vks
 {
 	class Benchmark {
+	public:
+		/** @brief Summary of a series of frame times */
+		struct Statistics {
+			size_t count{ 0 };
+			double min{ 0.0 };
+			double max{ 0.0 };
+			double mean{ 0.0 };
+			double stdDev{ 0.0 };
+			double p50{ 0.0 };
+			double p90{ 0.0 };
+			double p99{ 0.0 };
+			double p999{ 0.0 };
+			// Number of samples with a modified z-score (based on the median absolute deviation) above 3.5
+			size_t outliers{ 0 };
+		};
+
+		/** @brief Calculates percentiles, mean, standard deviation and outliers for a series of samples */
+		static Statistics computeStatistics(const std::vector<double>& samples) {
+			Statistics stats{};
+			if (samples.empty()) {
+				return stats;
+			}
+			std::vector<double> sorted(samples);
+			std::sort(sorted.begin(), sorted.end());
+			// Percentiles are linearly interpolated between the closest ranks
+			auto percentile = [](const std::vector<double>& values, double p) {
+				const double rank = p * (double)(values.size() - 1);
+				const size_t lower = (size_t)rank;
+				const size_t upper = std::min(lower + 1, values.size() - 1);
+				return values[lower] + (values[upper] - values[lower]) * (rank - (double)lower);
+			};
+			stats.count = sorted.size();
+			stats.min = sorted.front();
+			stats.max = sorted.back();
+			stats.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double)sorted.size();
+			double variance = 0.0;
+			for (double value : sorted) {
+				variance += (value - stats.mean) * (value - stats.mean);
+			}
+			stats.stdDev = sorted.size() > 1 ? std::sqrt(variance / (double)(sorted.size() - 1)) : 0.0;
+			stats.p50 = percentile(sorted, 0.5);
+			stats.p90 = percentile(sorted, 0.9);
+			stats.p99 = percentile(sorted, 0.99);
+			stats.p999 = percentile(sorted, 0.999);
+			// Outliers are detected with the median absolute deviation, which unlike the standard deviation isn't skewed by the outliers themselves
+			std::vector<double> deviations(sorted.size());
+			std::transform(sorted.begin(), sorted.end(), deviations.begin(), [&](double value) { return std::abs(value - stats.p50); });
+			std::sort(deviations.begin(), deviations.end());
+			const double mad = percentile(deviations, 0.5);
+			if (mad > 0.0) {
+				stats.outliers = std::count_if(sorted.begin(), sorted.end(), [&](double value) { return 0.6745 * std::abs(value - stats.p50) / mad > 3.5; });
+			}
+			return stats;
+		}
+
 	private:
 		FILE* stream{ nullptr };
 		VkPhysicalDeviceProperties deviceProps{};
+		bool measuring{ false };
+		// CPU time of the current frame spent waiting for the frame's fence and the next swapchain image
+		double frameWaitTime{ 0.0 };
+		// CPU time of the current frame spent submitting the command buffer and presenting
+		double frameSubmitTime{ 0.0 };
+
+		static std::string jsonEscape(const std::string& text) {
+			std::string escaped;
+			for (char c : text) {
+				if ((c == '"') || (c == '\\')) {
+					escaped += '\\';
+				}
+				escaped += c;
+			}
+			return escaped;
+		}
+
+		static std::string versionString(uint32_t version) {
+			return std::to_string(VK_API_VERSION_MAJOR(version)) + "." + std::to_string(VK_API_VERSION_MINOR(version)) + "." + std::to_string(VK_API_VERSION_PATCH(version));
+		}
+
+		static void writeStatistics(std::ostream& out, const std::string& key, const Statistics& stats, bool last = false) {
+			out << "\t\t\"" << key << "\": { \"count\": " << stats.count << ", \"min\": " << stats.min << ", \"max\": " << stats.max << ", \"mean\": " << stats.mean << ", \"stddev\": " << stats.stdDev
+				<< ", \"p50\": " << stats.p50 << ", \"p90\": " << stats.p90 << ", \"p99\": " << stats.p99 << ", \"p99.9\": " << stats.p999 << ", \"outliers\": " << stats.outliers << " }" << (last ? "\n" : ",\n");
+		}
+
+		static void writeSamples(std::ostream& out, const std::string& key, const std::vector<double>& samples, bool last = false) {
+			out << "\t\t\"" << key << "\": [";
+			for (size_t i = 0; i < samples.size(); i++) {
+				out << (i > 0 ? ", " : "") << samples[i];
+			}
+			out << "]" << (last ? "\n" : ",\n");
+		}
+
+		static void printStatistics(const std::string& label, const Statistics& stats) {
+			std::cout << label << "p50 " << stats.p50 << " / p90 " << stats.p90 << " / p99 " << stats.p99 << " / p99.9 " << stats.p999 << " ms (mean " << stats.mean << ", stddev " << stats.stdDev << ", " << stats.outliers << " outliers)" << "\n";
+		}
+
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
 		int outputFrames = -1; // -1 means no frames limit
 		uint32_t warmup = 1;   // Default to 1 sec of warm-up
 		uint32_t duration = 10;
+		// CPU time of each frame, split into recording (everything not spent in the other two), submission/presentation and waiting
 		std::vector<double> frameTimes;
+		std::vector<double> recordTimes;
+		std::vector<double> submitTimes;
+		std::vector<double> waitTimes;
+		// GPU execution time of the frame's draw command buffer measured with timestamp queries (empty if not supported by the queue)
+		std::vector<double> gpuFrameTimes;
+		// Results are written as JSON if the file name ends with ".json", as CSV otherwise
 		std::string filename = "";
+		std::string sampleName = "";
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
+		// Time spent preparing the sample before rendering started (asset loading, pipeline creation, etc.)
+		double prepareTime = 0.0;
+		// State of the pipeline cache at startup ("cold" or "warm" if persisted to disk, "disabled" otherwise)
+		std::string pipelineCacheState = "disabled";
+		// Pipeline compiler mode ("parallel" or "serial") and the time the main thread was blocked by it while preparing
+		std::string pipelineCompilation = "parallel";
+		double pipelineBlockingTime = 0.0;
+		// Shader I/O while preparing, archives are mapped so their contents don't count as read
+		uint32_t shaderFilesOpened = 0;
+		double shaderKilobytesRead = 0.0;
+		uint32_t shaderArchivesMapped = 0;
+		// Uploads done through the device's staging ring up to the start of the benchmark
+		double uploadMegabytes = 0.0;
+		uint64_t uploadSubmits = 0;
+		uint64_t uploadStalls = 0;
+
+		/** @brief Called by the frame loop with the time spent waiting for the frame fence and swapchain image acquisition */
+		void addFrameWaitTime(double ms) {
+			frameWaitTime += ms;
+		}
+
+		/** @brief Called by the frame loop with the time spent submitting the frame and presenting it */
+		void addFrameSubmitTime(double ms) {
+			frameSubmitTime += ms;
+		}
+
+		/** @brief Called by the frame loop once the timestamps of a frame have been read back from the device */
+		void addGpuFrameTime(double ms) {
+			if (measuring) {
+				gpuFrameTimes.push_back(ms);
+			}
+		}
 
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
@@ -58,21 +192,38 @@ namespace vks
 
 			// Benchmark phase
 			{
+				measuring = true;
 				while (runtime < (duration * 1000.0)) {
+					frameWaitTime = 0.0;
+					frameSubmitTime = 0.0;
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					waitTimes.push_back(frameWaitTime);
+					submitTimes.push_back(frameSubmitTime);
+					recordTimes.push_back(std::max(tDiff - frameWaitTime - frameSubmitTime, 0.0));
 					frameCount++;
 					if (outputFrames != -1 && outputFrames == frameCount) break;
 				};
+				measuring = false;
 				std::cout << std::fixed << std::setprecision(3);
 				std::cout << "Benchmark finished\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				std::cout << "prepare: " << prepareTime << " ms (pipeline cache: " << pipelineCacheState << ", pipeline compilation: " << pipelineCompilation << ", " << pipelineBlockingTime << " ms blocking)" << "\n";
+				std::cout << "shaders: " << shaderFilesOpened << " files opened, " << shaderKilobytesRead << " KB read, " << shaderArchivesMapped << " archives mapped" << "\n";
+				std::cout << "uploads: " << uploadMegabytes << " MB (" << uploadSubmits << " submits, " << uploadStalls << " stalls)" << "\n";
+				printStatistics("cpu    : ", computeStatistics(frameTimes));
+				printStatistics("record : ", computeStatistics(recordTimes));
+				printStatistics("submit : ", computeStatistics(submitTimes));
+				printStatistics("wait   : ", computeStatistics(waitTimes));
+				if (!gpuFrameTimes.empty()) {
+					printStatistics("gpu    : ", computeStatistics(gpuFrameTimes));
+				}
 			}
 		}
 
@@ -81,20 +232,54 @@ namespace vks
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				const bool json = (filename.size() >= 5) && (filename.compare(filename.size() - 5, 5, ".json") == 0);
+				if (json) {
+					result << "{\n";
+					result << "\t\"sample\": \"" << jsonEscape(sampleName) << "\",\n";
+					result << "\t\"device\": { \"name\": \"" << jsonEscape(deviceProps.deviceName) << "\", \"vendorID\": " << deviceProps.vendorID << ", \"deviceID\": " << deviceProps.deviceID
+						<< ", \"driverVersion\": " << deviceProps.driverVersion << ", \"apiVersion\": \"" << versionString(deviceProps.apiVersion) << "\" },\n";
+					result << "\t\"settings\": { \"warmup\": " << warmup << ", \"duration\": " << duration << ", \"frameLimit\": " << outputFrames << " },\n";
+					result << "\t\"runtime\": " << runtime << ",\n";
+					result << "\t\"frames\": " << frameCount << ",\n";
+					result << "\t\"fps\": " << frameCount / (runtime / 1000.0) << ",\n";
+					result << "\t\"prepare\": " << prepareTime << ",\n";
+					result << "\t\"pipelineCache\": \"" << pipelineCacheState << "\",\n";
+					result << "\t\"pipelineCompilation\": { \"mode\": \"" << pipelineCompilation << "\", \"blocking\": " << pipelineBlockingTime << " },\n";
+					result << "\t\"shaderIO\": { \"filesOpened\": " << shaderFilesOpened << ", \"kilobytesRead\": " << shaderKilobytesRead << ", \"archivesMapped\": " << shaderArchivesMapped << " },\n";
+					result << "\t\"uploads\": { \"megabytes\": " << uploadMegabytes << ", \"submits\": " << uploadSubmits << ", \"stalls\": " << uploadStalls << " },\n";
+					result << "\t\"statistics\": {\n";
+					writeStatistics(result, "cpu", computeStatistics(frameTimes));
+					writeStatistics(result, "record", computeStatistics(recordTimes));
+					writeStatistics(result, "submit", computeStatistics(submitTimes));
+					writeStatistics(result, "wait", computeStatistics(waitTimes));
+					writeStatistics(result, "gpu", computeStatistics(gpuFrameTimes), true);
+					result << "\t},\n";
+					// Raw samples are always written, as they are required to test differences between runs for significance
+					result << "\t\"frameTimes\": {\n";
+					writeSamples(result, "cpu", frameTimes);
+					writeSamples(result, "record", recordTimes);
+					writeSamples(result, "submit", submitTimes);
+					writeSamples(result, "wait", waitTimes);
+					writeSamples(result, "gpu", gpuFrameTimes, true);
+					result << "\t}\n";
+					result << "}\n";
+				} else {
+					result << "device,driverversion,duration (ms),frames,fps,prepare (ms),pipelinecache,pipeline compilation,pipeline blocking (ms),shader files opened,shader reads (KB),shader archives,uploads (MB),upload submits,upload stalls" << "\n";
+					result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "," << prepareTime << "," << pipelineCacheState << "," << pipelineCompilation << "," << pipelineBlockingTime << "," << shaderFilesOpened << "," << shaderKilobytesRead << "," << shaderArchivesMapped << "," << uploadMegabytes << "," << uploadSubmits << "," << uploadStalls << "\n";
 
-				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
-					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
+					if (outputFrameTimes) {
+						result << "\n" << "frame,ms,record (ms),submit (ms),wait (ms)" << "\n";
+						for (size_t i = 0; i < frameTimes.size(); i++) {
+							result << i << "," << frameTimes[i] << "," << recordTimes[i] << "," << submitTimes[i] << "," << waitTimes[i] << "\n";
+						}
 					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << "\n";
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << "\n";
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << "\n";
+				}
+
+				if (outputFrameTimes) {
+					const Statistics stats = computeStatistics(frameTimes);
+					std::cout << "best   : " << (1000.0 / stats.min) << " fps (" << stats.min << " ms)" << "\n";
+					std::cout << "worst  : " << (1000.0 / stats.max) << " fps (" << stats.max << " ms)" << "\n";
+					std::cout << "avg    : " << (1000.0 / stats.mean) << " fps (" << stats.mean << " ms)" << "\n";
 					std::cout << "\n";
 				}
 
@@ -105,4 +290,4 @@ namespace vks
 			}
 		}
 	};
-}
\ No newline at end of file
+}
@@ -7,9 +7,23 @@
 */
 
 #include <array>
+#include <bit>
+#include <vector>
 #include <math.h>
 #include <glm/glm.hpp>
 
+// The batched culling functions use the widest instruction set enabled at compile time, with a scalar fallback
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VKS_FRUSTUM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_FRUSTUM_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VKS_FRUSTUM_NEON
+#endif
+
 namespace vks
 {
 	class Frustum
@@ -18,6 +32,40 @@ namespace vks
 		enum side { LEFT = 0, RIGHT = 1, TOP = 2, BOTTOM = 3, BACK = 4, FRONT = 5 };
 		std::array<glm::vec4, 6> planes;
 
+		/** @brief Bounding spheres stored as a structure of arrays, so the batched tests can load several spheres at once */
+		struct SphereList
+		{
+			std::vector<float> x, y, z, radius;
+
+			size_t size() const { return x.size(); }
+			void clear() { x.clear(); y.clear(); z.clear(); radius.clear(); }
+			void add(const glm::vec3& center, float r)
+			{
+				x.push_back(center.x);
+				y.push_back(center.y);
+				z.push_back(center.z);
+				radius.push_back(r);
+			}
+		};
+
+		/** @brief Axis aligned bounding boxes stored as a structure of arrays */
+		struct AABBList
+		{
+			std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+			size_t size() const { return minX.size(); }
+			void clear() { minX.clear(); minY.clear(); minZ.clear(); maxX.clear(); maxY.clear(); maxZ.clear(); }
+			void add(const glm::vec3& min, const glm::vec3& max)
+			{
+				minX.push_back(min.x);
+				minY.push_back(min.y);
+				minZ.push_back(min.z);
+				maxX.push_back(max.x);
+				maxY.push_back(max.y);
+				maxZ.push_back(max.z);
+			}
+		};
+
 		void update(glm::mat4 matrix)
 		{
 			planes[LEFT].x = matrix[0].w + matrix[0].x;
@@ -56,7 +104,7 @@ namespace vks
 				planes[i] /= length;
 			}
 		}
-		
+
 		bool checkSphere(glm::vec3 pos, float radius)
 		{
 			for (auto i = 0; i < planes.size(); i++)
@@ -68,5 +116,251 @@ namespace vks
 			}
 			return true;
 		}
+
+		bool checkAABB(glm::vec3 min, glm::vec3 max)
+		{
+			for (auto i = 0; i < planes.size(); i++)
+			{
+				// Only the corner furthest along the plane normal needs to be tested
+				const glm::vec3 corner = glm::vec3(planes[i].x >= 0.0f ? max.x : min.x, planes[i].y >= 0.0f ? max.y : min.y, planes[i].z >= 0.0f ? max.z : min.z);
+				if ((planes[i].x * corner.x) + (planes[i].y * corner.y) + (planes[i].z * corner.z) + planes[i].w <= 0.0f)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		* Test a list of spheres against the frustum
+		*
+		* @param spheres Spheres to test
+		* @param visibility Receives one bit per sphere (bit i % 32 of element i / 32), set if the sphere is (partially) inside the frustum
+		*/
+		void checkSpheres(const SphereList& spheres, std::vector<uint32_t>& visibility) const
+		{
+			const size_t count = spheres.size();
+			visibility.assign((count + 31) / 32, 0);
+			size_t i = 0;
+			for (; i + laneCount <= count; i += laneCount) {
+				visibility[i / 32] |= sphereLanes(spheres, i) << (i % 32);
+			}
+			for (; i < count; i++) {
+				visibility[i / 32] |= sphereVisible(spheres, i) << (i % 32);
+			}
+		}
+
+		/**
+		* Test a list of axis aligned bounding boxes against the frustum
+		*
+		* @param boxes Boxes to test
+		* @param visibility Receives one bit per box (bit i % 32 of element i / 32), set if the box is (partially) inside the frustum
+		*/
+		void checkAABBs(const AABBList& boxes, std::vector<uint32_t>& visibility) const
+		{
+			const size_t count = boxes.size();
+			visibility.assign((count + 31) / 32, 0);
+			const BoxCorners corners = selectCorners(boxes);
+			size_t i = 0;
+			for (; i + laneCount <= count; i += laneCount) {
+				visibility[i / 32] |= boxLanes(corners, i) << (i % 32);
+			}
+			for (; i < count; i++) {
+				visibility[i / 32] |= boxVisible(corners, i) << (i % 32);
+			}
+		}
+
+		/** @brief Test a list of spheres against the frustum and write the indices of the visible ones to visibleIndices */
+		void cullSpheres(const SphereList& spheres, std::vector<uint32_t>& visibleIndices) const
+		{
+			std::vector<uint32_t> visibility;
+			checkSpheres(spheres, visibility);
+			compact(visibility, visibleIndices);
+		}
+
+		/** @brief Test a list of axis aligned bounding boxes against the frustum and write the indices of the visible ones to visibleIndices */
+		void cullAABBs(const AABBList& boxes, std::vector<uint32_t>& visibleIndices) const
+		{
+			std::vector<uint32_t> visibility;
+			checkAABBs(boxes, visibility);
+			compact(visibility, visibleIndices);
+		}
+
+		/** @brief Converts a visibility bit mask into a list of the indices of the set bits */
+		static void compact(const std::vector<uint32_t>& visibility, std::vector<uint32_t>& visibleIndices)
+		{
+			visibleIndices.clear();
+			for (size_t word = 0; word < visibility.size(); word++) {
+				for (uint32_t bits = visibility[word]; bits != 0; bits &= bits - 1) {
+					visibleIndices.push_back(static_cast<uint32_t>(word * 32 + std::countr_zero(bits)));
+				}
+			}
+		}
+
+		/** @brief Name of the instruction set used by the batched tests */
+		static const char* instructionSet()
+		{
+#if defined(VKS_FRUSTUM_AVX2)
+			return "AVX2";
+#elif defined(VKS_FRUSTUM_SSE2)
+			return "SSE2";
+#elif defined(VKS_FRUSTUM_NEON)
+			return "NEON";
+#else
+			return "Scalar";
+#endif
+		}
+
+	private:
+		// For boxes, the corner to test against each plane only depends on the signs of the plane normal, so it's selected once per batch
+		struct BoxCorners
+		{
+			std::array<const float*, 6> x, y, z;
+		};
+
+#if defined(VKS_FRUSTUM_AVX2)
+		static constexpr size_t laneCount = 8;
+#elif defined(VKS_FRUSTUM_SSE2) || defined(VKS_FRUSTUM_NEON)
+		static constexpr size_t laneCount = 4;
+#else
+		static constexpr size_t laneCount = 1;
+#endif
+
+		BoxCorners selectCorners(const AABBList& boxes) const
+		{
+			BoxCorners corners{};
+			for (size_t p = 0; p < planes.size(); p++) {
+				corners.x[p] = planes[p].x >= 0.0f ? boxes.maxX.data() : boxes.minX.data();
+				corners.y[p] = planes[p].y >= 0.0f ? boxes.maxY.data() : boxes.minY.data();
+				corners.z[p] = planes[p].z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+			}
+			return corners;
+		}
+
+		uint32_t sphereVisible(const SphereList& spheres, size_t i) const
+		{
+			for (size_t p = 0; p < planes.size(); p++) {
+				if ((planes[p].x * spheres.x[i]) + (planes[p].y * spheres.y[i]) + (planes[p].z * spheres.z[i]) + planes[p].w <= -spheres.radius[i]) {
+					return 0;
+				}
+			}
+			return 1;
+		}
+
+		uint32_t boxVisible(const BoxCorners& corners, size_t i) const
+		{
+			for (size_t p = 0; p < planes.size(); p++) {
+				if ((planes[p].x * corners.x[p][i]) + (planes[p].y * corners.y[p][i]) + (planes[p].z * corners.z[p][i]) + planes[p].w <= 0.0f) {
+					return 0;
+				}
+			}
+			return 1;
+		}
+
+		// The lane functions test laneCount objects starting at i and return one bit per object
+#if defined(VKS_FRUSTUM_AVX2)
+		uint32_t sphereLanes(const SphereList& spheres, size_t i) const
+		{
+			const __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+			const __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+			const __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+			const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+			__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (size_t p = 0; p < planes.size(); p++) {
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].x), x), _mm256_set1_ps(planes[p].w));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[p].y), y));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[p].z), z));
+				visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+			}
+			return static_cast<uint32_t>(_mm256_movemask_ps(visible));
+		}
+
+		uint32_t boxLanes(const BoxCorners& corners, size_t i) const
+		{
+			__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (size_t p = 0; p < planes.size(); p++) {
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].x), _mm256_loadu_ps(&corners.x[p][i])), _mm256_set1_ps(planes[p].w));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[p].y), _mm256_loadu_ps(&corners.y[p][i])));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[p].z), _mm256_loadu_ps(&corners.z[p][i])));
+				visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GT_OQ));
+			}
+			return static_cast<uint32_t>(_mm256_movemask_ps(visible));
+		}
+#elif defined(VKS_FRUSTUM_SSE2)
+		uint32_t sphereLanes(const SphereList& spheres, size_t i) const
+		{
+			const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+			const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+			const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+			const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+			__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (size_t p = 0; p < planes.size(); p++) {
+				__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), x), _mm_set1_ps(planes[p].w));
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes[p].y), y));
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes[p].z), z));
+				visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, negRadius));
+			}
+			return static_cast<uint32_t>(_mm_movemask_ps(visible));
+		}
+
+		uint32_t boxLanes(const BoxCorners& corners, size_t i) const
+		{
+			__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (size_t p = 0; p < planes.size(); p++) {
+				__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), _mm_loadu_ps(&corners.x[p][i])), _mm_set1_ps(planes[p].w));
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes[p].y), _mm_loadu_ps(&corners.y[p][i])));
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes[p].z), _mm_loadu_ps(&corners.z[p][i])));
+				visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, _mm_setzero_ps()));
+			}
+			return static_cast<uint32_t>(_mm_movemask_ps(visible));
+		}
+#elif defined(VKS_FRUSTUM_NEON)
+		// NEON has no movemask, so the lane results are weighted with their bit and summed up
+		static uint32_t laneMask(uint32x4_t visible)
+		{
+			const uint32_t weights[4] = { 1, 2, 4, 8 };
+			const uint32x4_t bits = vandq_u32(visible, vld1q_u32(weights));
+			const uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+			return vget_lane_u32(vpadd_u32(sum, sum), 0);
+		}
+
+		uint32_t sphereLanes(const SphereList& spheres, size_t i) const
+		{
+			const float32x4_t x = vld1q_f32(&spheres.x[i]);
+			const float32x4_t y = vld1q_f32(&spheres.y[i]);
+			const float32x4_t z = vld1q_f32(&spheres.z[i]);
+			const float32x4_t negRadius = vnegq_f32(vld1q_f32(&spheres.radius[i]));
+			uint32x4_t visible = vdupq_n_u32(0xFFFFFFFF);
+			for (size_t p = 0; p < planes.size(); p++) {
+				float32x4_t distance = vmlaq_n_f32(vdupq_n_f32(planes[p].w), x, planes[p].x);
+				distance = vmlaq_n_f32(distance, y, planes[p].y);
+				distance = vmlaq_n_f32(distance, z, planes[p].z);
+				visible = vandq_u32(visible, vcgtq_f32(distance, negRadius));
+			}
+			return laneMask(visible);
+		}
+
+		uint32_t boxLanes(const BoxCorners& corners, size_t i) const
+		{
+			uint32x4_t visible = vdupq_n_u32(0xFFFFFFFF);
+			for (size_t p = 0; p < planes.size(); p++) {
+				float32x4_t distance = vmlaq_n_f32(vdupq_n_f32(planes[p].w), vld1q_f32(&corners.x[p][i]), planes[p].x);
+				distance = vmlaq_n_f32(distance, vld1q_f32(&corners.y[p][i]), planes[p].y);
+				distance = vmlaq_n_f32(distance, vld1q_f32(&corners.z[p][i]), planes[p].z);
+				visible = vandq_u32(visible, vcgtq_f32(distance, vdupq_n_f32(0.0f)));
+			}
+			return laneMask(visible);
+		}
+#else
+		uint32_t sphereLanes(const SphereList& spheres, size_t i) const
+		{
+			return sphereVisible(spheres, i);
+		}
+
+		uint32_t boxLanes(const BoxCorners& corners, size_t i) const
+		{
+			return boxVisible(corners, i);
+		}
+#endif
 	};
 }
@@ -0,0 +1,471 @@
+/*
+* Work stealing job system
+*
+* Each worker thread owns a Chase-Lev deque it pushes to and pops from at the bottom, idle workers steal from the top of other deques
+* Jobs are stored in fixed size per-thread pools with inline storage for the callable, so submitting a job does not allocate
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+namespace vks
+{
+	/** @brief Type erased callable with inline storage, replaces std::function to avoid heap allocations for captured state */
+	class Task
+	{
+	public:
+		static constexpr size_t storageSize = 96;
+
+		Task() = default;
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+		~Task()
+		{
+			reset();
+		}
+
+		template<typename F>
+		void set(F&& function)
+		{
+			using Fn = std::decay_t<F>;
+			static_assert(sizeof(Fn) <= storageSize, "Job captures too much state for the inline task storage, capture by reference or pointer instead");
+			static_assert(alignof(Fn) <= alignof(std::max_align_t), "Job capture alignment exceeds the inline task storage alignment");
+			reset();
+			new (storage) Fn(std::forward<F>(function));
+			invokeFn = [](void* data) { (*static_cast<Fn*>(data))(); };
+			destroyFn = [](void* data) { static_cast<Fn*>(data)->~Fn(); };
+		}
+
+		void operator()()
+		{
+			invokeFn(storage);
+		}
+
+		void reset()
+		{
+			if (destroyFn) {
+				destroyFn(storage);
+				destroyFn = nullptr;
+				invokeFn = nullptr;
+			}
+		}
+
+	private:
+		alignas(std::max_align_t) unsigned char storage[storageSize];
+		void (*invokeFn)(void*) { nullptr };
+		void (*destroyFn)(void*) { nullptr };
+	};
+
+	/** @brief Bounded single owner, multiple thief work stealing deque (Chase-Lev, using the C11 memory model formulation by Le et al.) */
+	template<typename T>
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(int64_t capacity) : capacity(capacity), mask(capacity - 1), buffer(new std::atomic<T*>[capacity])
+		{
+			// Capacity must be a power of two
+			assert((capacity & mask) == 0);
+		}
+
+		/** @brief Owner only: Adds an item at the bottom, returns false if the deque is full */
+		bool push(T* item)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= capacity) {
+				return false;
+			}
+			buffer[b & mask].store(item, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/** @brief Owner only: Removes the most recently pushed item */
+		T* pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			T* item = nullptr;
+			if (t <= b) {
+				item = buffer[b & mask].load(std::memory_order_relaxed);
+				if (t == b) {
+					// Last item, race against thieves
+					if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+						item = nullptr;
+					}
+					bottom.store(b + 1, std::memory_order_relaxed);
+				}
+			} else {
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return item;
+		}
+
+		/** @brief Any thread: Removes the oldest item, may spuriously return nullptr if another thread won the race for it */
+		T* steal()
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+			if (t < b) {
+				T* item = buffer[t & mask].load(std::memory_order_relaxed);
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+					return nullptr;
+				}
+				return item;
+			}
+			return nullptr;
+		}
+
+	private:
+		const int64_t capacity;
+		const int64_t mask;
+		std::unique_ptr<std::atomic<T*>[]> buffer;
+		alignas(64) std::atomic<int64_t> top{ 0 };
+		alignas(64) std::atomic<int64_t> bottom{ 0 };
+	};
+
+	class JobCounter;
+
+	/** @brief Pooled job slot, owned by the thread that allocated it until the job has been executed */
+	struct Job
+	{
+		Task task;
+		JobCounter* counter{ nullptr };
+		std::atomic<bool> inUse{ false };
+	};
+
+	/** @brief Counts outstanding jobs, can be waited on and passed as a dependency to jobs that must not start before it reaches zero */
+	class JobCounter
+	{
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool done() const
+		{
+			// A job that just decremented the counter may still be scheduling dependents, so the counter is only done (and safe to destroy) once that finished
+			return (value.load() == 0) && (finishing.load() == 0);
+		}
+
+		uint32_t pending() const
+		{
+			return value.load();
+		}
+
+	private:
+		friend class JobSystem;
+		std::atomic<uint32_t> value{ 0 };
+		std::atomic<uint32_t> finishing{ 0 };
+		std::mutex dependentsMutex;
+		std::vector<Job*> dependents;
+	};
+
+	class JobSystem
+	{
+	public:
+		/** @brief Size of the per-thread job pools, submitting more unfinished jobs from a single thread than this runs them in place */
+		static constexpr uint32_t jobPoolSize = 1024;
+		static constexpr int64_t dequeCapacity = 2048;
+
+		/**
+		* Creates the job system and starts the worker threads
+		*
+		* @param workerCount Number of worker threads, defaults to one less than the number of hardware threads as the thread waiting on jobs helps executing them
+		*/
+		explicit JobSystem(uint32_t workerCount = defaultWorkerCount())
+		{
+			workerCount = std::max(workerCount, 1u);
+			// The last slot is shared by all threads that are not owned by the job system (e.g. the main thread)
+			for (uint32_t i = 0; i < workerCount + 1; i++) {
+				workers.push_back(std::make_unique<Worker>());
+			}
+			for (uint32_t i = 0; i < workerCount; i++) {
+				workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+			}
+		}
+
+		~JobSystem()
+		{
+			// Run anything that's still queued so no submitted job gets lost
+			while (pendingJobs.load() > 0) {
+				runOne(externalIndex());
+			}
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping = true;
+			}
+			sleepCondition.notify_all();
+			for (uint32_t i = 0; i < workerCount(); i++) {
+				workers[i]->thread.join();
+			}
+		}
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		static uint32_t defaultWorkerCount()
+		{
+			const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		/** @brief Number of threads owned by the job system */
+		uint32_t workerCount() const
+		{
+			return static_cast<uint32_t>(workers.size()) - 1;
+		}
+
+		/** @brief Index of the calling thread, in [0, workerCount()) for worker threads, workerCount() for all other threads. Can be used to index per-thread resources sized workerCount() + 1 */
+		uint32_t threadIndex() const
+		{
+			return (currentJobSystem == this) ? currentThreadIndex : externalIndex();
+		}
+
+		/**
+		* Submits a job
+		*
+		* @param function Callable to run, the captured state must fit into the inline task storage
+		* @param counter (Optional) Counter that's incremented now and decremented once the job has finished
+		* @param dependency (Optional) Counter that needs to reach zero before this job is started
+		*/
+		template<typename F>
+		void run(F&& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr)
+		{
+			if (counter) {
+				counter->value.fetch_add(1);
+			}
+			const uint32_t index = threadIndex();
+			Job* job = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(externalMutex, std::defer_lock);
+				if (index == externalIndex()) {
+					lock.lock();
+				}
+				job = allocate(*workers[index]);
+			}
+			if (!job) {
+				// The job pool of this thread is exhausted, run the job in place instead
+				if (dependency) {
+					wait(*dependency);
+				}
+				function();
+				if (counter) {
+					finish(counter);
+				}
+				return;
+			}
+			job->task.set(std::forward<F>(function));
+			job->counter = counter;
+			if (dependency) {
+				std::lock_guard<std::mutex> lock(dependency->dependentsMutex);
+				if (dependency->value.load() > 0) {
+					dependency->dependents.push_back(job);
+					return;
+				}
+			}
+			schedule(job);
+		}
+
+		/**
+		* Splits [0, count) into ranges that are distributed across all threads and waits for them to finish
+		*
+		* @param count Number of elements
+		* @param function Callable taking (uint32_t begin, uint32_t end) for a range of elements
+		* @param grainSize (Optional) Number of elements per job, if zero this is derived from the element and thread count
+		*/
+		template<typename F>
+		void parallelFor(uint32_t count, F&& function, uint32_t grainSize = 0)
+		{
+			if (count == 0) {
+				return;
+			}
+			if (grainSize == 0) {
+				// Aim for a few ranges per thread, so threads that finish early can steal from slower ones
+				const uint32_t rangeCount = (workerCount() + 1) * 4;
+				grainSize = std::max((count + rangeCount - 1) / rangeCount, 1u);
+			}
+			JobCounter counter;
+			auto* fn = &function;
+			for (uint32_t begin = 0; begin < count; begin += grainSize) {
+				const uint32_t end = std::min(begin + grainSize, count);
+				run([fn, begin, end] { (*fn)(begin, end); }, &counter);
+			}
+			wait(counter);
+		}
+
+		/** @brief Waits for the counter to reach zero, the calling thread executes pending jobs in the meantime */
+		void wait(const JobCounter& counter)
+		{
+			const uint32_t index = threadIndex();
+			while (!counter.done()) {
+				if (!runOne(index)) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+	private:
+		struct Worker
+		{
+			WorkStealingDeque<Job> deque{ dequeCapacity };
+			std::unique_ptr<Job[]> jobs{ new Job[jobPoolSize] };
+			uint32_t nextJob{ 0 };
+			std::thread thread;
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		// Serializes owner side access to the shared external slot
+		std::mutex externalMutex;
+		std::atomic<int32_t> pendingJobs{ 0 };
+		std::atomic<uint32_t> sleepingWorkers{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		bool stopping{ false };
+
+		inline static thread_local const JobSystem* currentJobSystem{ nullptr };
+		inline static thread_local uint32_t currentThreadIndex{ 0 };
+		inline static thread_local uint32_t stealSeed{ 0 };
+
+		uint32_t externalIndex() const
+		{
+			return workerCount();
+		}
+
+		// Only called by the owner of the pool, returns nullptr if the next slot is still in use
+		Job* allocate(Worker& worker)
+		{
+			Job& job = worker.jobs[worker.nextJob++ & (jobPoolSize - 1)];
+			if (job.inUse.load(std::memory_order_acquire)) {
+				return nullptr;
+			}
+			job.inUse.store(true, std::memory_order_relaxed);
+			return &job;
+		}
+
+		void schedule(Job* job)
+		{
+			pendingJobs.fetch_add(1);
+			const uint32_t index = threadIndex();
+			bool queued = false;
+			if (index == externalIndex()) {
+				std::lock_guard<std::mutex> lock(externalMutex);
+				queued = workers[index]->deque.push(job);
+			} else {
+				queued = workers[index]->deque.push(job);
+			}
+			if (!queued) {
+				pendingJobs.fetch_sub(1);
+				execute(job);
+				return;
+			}
+			if (sleepingWorkers.load() > 0) {
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				sleepCondition.notify_one();
+			}
+		}
+
+		void execute(Job* job)
+		{
+			job->task();
+			job->task.reset();
+			JobCounter* counter = job->counter;
+			job->counter = nullptr;
+			// The slot may be reused by its owner from here on
+			job->inUse.store(false, std::memory_order_release);
+			if (counter) {
+				finish(counter);
+			}
+		}
+
+		void finish(JobCounter* counter)
+		{
+			counter->finishing.fetch_add(1);
+			if (counter->value.fetch_sub(1) == 1) {
+				std::vector<Job*> ready;
+				{
+					std::lock_guard<std::mutex> lock(counter->dependentsMutex);
+					ready.swap(counter->dependents);
+				}
+				for (Job* job : ready) {
+					schedule(job);
+				}
+			}
+			// Last access to the counter, waiters may destroy it after this
+			counter->finishing.fetch_sub(1);
+		}
+
+		// Runs a single job from the thread's own deque or stolen from another thread, returns false if no job was found
+		bool runOne(uint32_t index)
+		{
+			Job* job = nullptr;
+			if (index == externalIndex()) {
+				std::lock_guard<std::mutex> lock(externalMutex);
+				job = workers[index]->deque.pop();
+			} else {
+				job = workers[index]->deque.pop();
+			}
+			if (!job) {
+				// Start at a random victim so thieves don't all contend on the same deque
+				stealSeed = stealSeed * 1664525u + 1013904223u + index;
+				const uint32_t victimCount = static_cast<uint32_t>(workers.size());
+				const uint32_t start = (stealSeed >> 16) % victimCount;
+				for (uint32_t i = 0; i < victimCount && !job; i++) {
+					const uint32_t victim = (start + i) % victimCount;
+					if (victim != index) {
+						job = workers[victim]->deque.steal();
+					}
+				}
+			}
+			if (!job) {
+				return false;
+			}
+			pendingJobs.fetch_sub(1);
+			execute(job);
+			return true;
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			currentJobSystem = this;
+			currentThreadIndex = index;
+			stealSeed = index;
+			while (true) {
+				if (runOne(index)) {
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				if (stopping) {
+					break;
+				}
+				sleepingWorkers.fetch_add(1);
+				sleepCondition.wait(lock, [this] { return (pendingJobs.load() > 0) || stopping; });
+				sleepingWorkers.fetch_sub(1);
+				if (stopping) {
+					break;
+				}
+			}
+		}
+	};
+}
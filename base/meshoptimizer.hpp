@@ -0,0 +1,744 @@
+/*
+* Mesh optimization functions for indexed triangle lists
+*
+* Vertex deduplication, post-transform vertex cache optimization, overdraw reduction, vertex fetch reordering and simplification
+* Cache and overdraw optimization are based on "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007)
+* Simplification is based on "Surface Simplification Using Quadric Error Metrics" (Garland, Heckbert 1997)
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_set>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	namespace meshopt
+	{
+		const uint32_t invalidIndex = ~0u;
+		// Size of the simulated FIFO post-transform cache, small enough to not be too optimistic for current GPUs
+		const uint32_t vertexCacheSize = 16;
+
+		/** @brief Post-transform vertex cache statistics, these can be summed up for several primitives */
+		struct VertexCacheStatistics
+		{
+			uint32_t triangleCount{ 0 };
+			uint32_t vertexCount{ 0 };
+			uint32_t transformedVertices{ 0 };
+
+			/** @brief Average cache miss ratio, vertex shader invocations per triangle (between 0.5 for large regular meshes and 3) */
+			float acmr() const { return triangleCount > 0 ? static_cast<float>(transformedVertices) / static_cast<float>(triangleCount) : 0.0f; }
+			/** @brief Average transform to vertex ratio, vertex shader invocations per vertex (1 is optimal) */
+			float atvr() const { return vertexCount > 0 ? static_cast<float>(transformedVertices) / static_cast<float>(vertexCount) : 0.0f; }
+
+			VertexCacheStatistics& operator+=(const VertexCacheStatistics& other)
+			{
+				triangleCount += other.triangleCount;
+				vertexCount += other.vertexCount;
+				transformedVertices += other.transformedVertices;
+				return *this;
+			}
+		};
+
+		/*
+			The FIFO cache is simulated with timestamps: Each transformed vertex gets the next timestamp, a vertex is still in the cache if less than cacheSize vertices have been transformed after it
+			Flushing the cache is done by advancing the timestamp by more than the cache size
+		*/
+		class VertexCache
+		{
+		public:
+			VertexCache(size_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+			/** @brief Returns true if the vertex had to be transformed */
+			bool access(uint32_t vertex)
+			{
+				if (time - timestamps[vertex] > cacheSize) {
+					timestamps[vertex] = time++;
+					return true;
+				}
+				return false;
+			}
+			/** @brief Number of vertices transformed since the vertex has been put into the cache */
+			uint32_t age(uint32_t vertex) const { return time - timestamps[vertex]; }
+			void flush() { time += cacheSize + 1; }
+
+		private:
+			std::vector<uint32_t> timestamps;
+			uint32_t cacheSize;
+			uint32_t time;
+		};
+
+		/** @brief Simulates a FIFO post-transform cache for a triangle list, vertexCount is the number of vertices in the vertex buffer and is used for the ATVR */
+		inline VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = vertexCacheSize)
+		{
+			VertexCacheStatistics statistics{};
+			statistics.triangleCount = static_cast<uint32_t>(indexCount / 3);
+			statistics.vertexCount = static_cast<uint32_t>(vertexCount);
+			VertexCache cache(vertexCount, cacheSize);
+			for (size_t i = 0; i < indexCount; i++) {
+				if (cache.access(indices[i])) {
+					statistics.transformedVertices++;
+				}
+			}
+			return statistics;
+		}
+
+		/**
+		* Builds a remap table that merges vertices with bitwise identical contents
+		*
+		* @param remap Receives the new index for each vertex, vertices are numbered in the order they are first referenced and unreferenced vertices are set to invalidIndex
+		* @param vertexSize Size of a single vertex in bytes
+		*
+		* @return Number of unique vertices
+		*/
+		inline size_t generateVertexRemap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+		{
+			remap.assign(vertexCount, invalidIndex);
+			const uint8_t* data = static_cast<const uint8_t*>(vertices);
+			// Open addressing hash table with the first vertex for each distinct vertex content, kept at least 20% empty so probing stays short
+			size_t tableSize = 1;
+			while (tableSize <= vertexCount + vertexCount / 4) {
+				tableSize *= 2;
+			}
+			std::vector<uint32_t> table(tableSize, invalidIndex);
+			auto hashVertex = [vertexSize](const uint8_t* vertex) {
+				// 32 bit FNV-1a on four bytes at a time
+				uint32_t hash = 2166136261u;
+				size_t i = 0;
+				for (; i + 4 <= vertexSize; i += 4) {
+					uint32_t word;
+					memcpy(&word, vertex + i, sizeof(word));
+					hash = (hash ^ word) * 16777619u;
+				}
+				for (; i < vertexSize; i++) {
+					hash = (hash ^ vertex[i]) * 16777619u;
+				}
+				return hash;
+			};
+			size_t uniqueCount = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				const uint32_t index = indices[i];
+				if (remap[index] != invalidIndex) {
+					continue;
+				}
+				const uint8_t* vertex = data + index * vertexSize;
+				size_t slot = hashVertex(vertex) & (tableSize - 1);
+				while ((table[slot] != invalidIndex) && (memcmp(data + table[slot] * vertexSize, vertex, vertexSize) != 0)) {
+					slot = (slot + 1) & (tableSize - 1);
+				}
+				if (table[slot] == invalidIndex) {
+					table[slot] = index;
+					remap[index] = static_cast<uint32_t>(uniqueCount++);
+				} else {
+					remap[index] = remap[table[slot]];
+				}
+			}
+			return uniqueCount;
+		}
+
+		/** @brief Builds a remap table that orders vertices by their first use in the index buffer, so vertex fetches access memory in a mostly linear order. Unreferenced vertices are dropped */
+		inline size_t generateVertexFetchRemap(std::vector<uint32_t>& remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			remap.assign(vertexCount, invalidIndex);
+			size_t uniqueCount = 0;
+			for (size_t i = 0; i < indexCount; i++) {
+				if (remap[indices[i]] == invalidIndex) {
+					remap[indices[i]] = static_cast<uint32_t>(uniqueCount++);
+				}
+			}
+			return uniqueCount;
+		}
+
+		/** @brief Applies a remap table to an index buffer, destination may be the same as indices */
+		inline void remapIndexBuffer(uint32_t* destination, const uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap)
+		{
+			for (size_t i = 0; i < indexCount; i++) {
+				destination[i] = remap[indices[i]];
+			}
+		}
+
+		/** @brief Applies a remap table to a vertex buffer, returns the uniqueCount remapped vertices */
+		template<typename T>
+		std::vector<T> remapVertexBuffer(const T* vertices, size_t vertexCount, size_t uniqueCount, const std::vector<uint32_t>& remap)
+		{
+			std::vector<T> result(uniqueCount);
+			for (size_t i = 0; i < vertexCount; i++) {
+				if (remap[i] != invalidIndex) {
+					result[remap[i]] = vertices[i];
+				}
+			}
+			return result;
+		}
+
+		/**
+		* Reorders triangles for post-transform vertex cache locality using Tipsify
+		* Triangles are emitted in fans around vertices that are still in the cache, the vertex order within each triangle is not changed so winding and provoking vertex are kept
+		*
+		* @param destination Receives the reordered indices, must not overlap with indices
+		* @param clusters (Optional) Receives the first triangle of each run of triangles that started after a dead end, these are the hard boundaries for optimizeOverdraw
+		*/
+		inline void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters = nullptr, uint32_t cacheSize = vertexCacheSize)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (clusters) {
+				clusters->clear();
+			}
+
+			// Triangles adjacent to each vertex, the live count is the number of adjacent triangles that haven't been emitted yet
+			std::vector<uint32_t> liveTriangles(vertexCount, 0);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				liveTriangles[indices[i]]++;
+			}
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t i = 0; i < vertexCount; i++) {
+				adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+			}
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			VertexCache cache(vertexCount, cacheSize);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> deadEnds;
+			std::vector<uint32_t> candidates;
+			size_t inputCursor = 0;
+			size_t outputTriangles = 0;
+
+			// Continues with the most recently used vertex that still has triangles left, or the next one in input order if there is none
+			auto skipDeadEnd = [&]() {
+				while (!deadEnds.empty()) {
+					const uint32_t vertex = deadEnds.back();
+					deadEnds.pop_back();
+					if (liveTriangles[vertex] > 0) {
+						return vertex;
+					}
+				}
+				for (; inputCursor < vertexCount; inputCursor++) {
+					if (liveTriangles[inputCursor] > 0) {
+						return static_cast<uint32_t>(inputCursor);
+					}
+				}
+				return invalidIndex;
+			};
+
+			uint32_t fanningVertex = skipDeadEnd();
+			if (clusters && (fanningVertex != invalidIndex)) {
+				clusters->push_back(0);
+			}
+			while (fanningVertex != invalidIndex) {
+				candidates.clear();
+				for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; i++) {
+					const uint32_t triangle = adjacency[i];
+					if (emitted[triangle]) {
+						continue;
+					}
+					for (uint32_t j = 0; j < 3; j++) {
+						const uint32_t vertex = indices[triangle * 3 + j];
+						destination[outputTriangles * 3 + j] = vertex;
+						deadEnds.push_back(vertex);
+						candidates.push_back(vertex);
+						liveTriangles[vertex]--;
+						cache.access(vertex);
+					}
+					emitted[triangle] = true;
+					outputTriangles++;
+				}
+				// The next fanning vertex is the candidate that has been in the cache the longest and is guaranteed to still be in there after emitting its remaining triangles
+				uint32_t next = invalidIndex;
+				int64_t bestPriority = -1;
+				for (uint32_t vertex : candidates) {
+					if (liveTriangles[vertex] == 0) {
+						continue;
+					}
+					int64_t priority = 0;
+					if (static_cast<int64_t>(cache.age(vertex)) + 2 * static_cast<int64_t>(liveTriangles[vertex]) <= static_cast<int64_t>(cacheSize)) {
+						priority = cache.age(vertex);
+					}
+					if (priority > bestPriority) {
+						bestPriority = priority;
+						next = vertex;
+					}
+				}
+				if (next == invalidIndex) {
+					next = skipDeadEnd();
+					if (clusters && (next != invalidIndex)) {
+						clusters->push_back(static_cast<uint32_t>(outputTriangles));
+					}
+				}
+				fanningVertex = next;
+			}
+		}
+
+		/**
+		* Reorders clusters of triangles so that clusters facing away from the mesh center are drawn first, which reduces overdraw with depth testing
+		* Clusters are split further as long as each part stays within threshold times the ACMR of the cluster, so most of the vertex cache locality is kept
+		*
+		* @param destination Receives the reordered indices, must not overlap with indices
+		* @param positions Pointer to the position of the first vertex, positions are three floats
+		* @param vertexStride Distance between two positions in bytes
+		* @param clusters First triangle of each cluster (e.g. from optimizeVertexCache), if empty the whole mesh is a single cluster
+		* @param threshold Allowed ACMR increase for splitting clusters, 1.05 allows for 5 percent more vertex shader invocations
+		*/
+		inline void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, const std::vector<uint32_t>& clusters, float threshold = 1.05f, uint32_t cacheSize = vertexCacheSize)
+		{
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount == 0) {
+				return;
+			}
+			auto position = [positions, vertexStride](uint32_t vertex) {
+				glm::vec3 result;
+				memcpy(&result, reinterpret_cast<const uint8_t*>(positions) + vertex * vertexStride, sizeof(result));
+				return result;
+			};
+
+			// Soft boundaries: Split each cluster as soon as the part up to the current triangle reaches the cluster's ACMR (with the cache flushed in between)
+			VertexCache cache(vertexCount, cacheSize);
+			auto transformTriangle = [&](size_t triangle) {
+				uint32_t misses = 0;
+				for (uint32_t j = 0; j < 3; j++) {
+					misses += cache.access(indices[triangle * 3 + j]) ? 1 : 0;
+				}
+				return misses;
+			};
+			std::vector<uint32_t> hardBoundaries = clusters.empty() ? std::vector<uint32_t>{ 0 } : clusters;
+			std::vector<uint32_t> starts;
+			for (size_t i = 0; i < hardBoundaries.size(); i++) {
+				const size_t begin = hardBoundaries[i];
+				const size_t end = (i + 1 < hardBoundaries.size()) ? hardBoundaries[i + 1] : triangleCount;
+				if (begin >= end) {
+					continue;
+				}
+				cache.flush();
+				uint32_t clusterMisses = 0;
+				for (size_t t = begin; t < end; t++) {
+					clusterMisses += transformTriangle(t);
+				}
+				const float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+				cache.flush();
+				starts.push_back(static_cast<uint32_t>(begin));
+				uint32_t misses = 0;
+				uint32_t count = 0;
+				for (size_t t = begin; t < end; t++) {
+					misses += transformTriangle(t);
+					count++;
+					if ((t + 1 < end) && (static_cast<float>(misses) <= clusterThreshold * static_cast<float>(count))) {
+						starts.push_back(static_cast<uint32_t>(t + 1));
+						cache.flush();
+						misses = 0;
+						count = 0;
+					}
+				}
+			}
+
+			glm::vec3 meshCentroid(0.0f);
+			for (size_t i = 0; i < triangleCount * 3; i++) {
+				meshCentroid += position(indices[i]);
+			}
+			meshCentroid /= static_cast<float>(triangleCount * 3);
+
+			// Sort key is the distance of the area weighted cluster centroid from the mesh centroid along the cluster's average normal
+			std::vector<float> sortKeys(starts.size());
+			for (size_t i = 0; i < starts.size(); i++) {
+				const size_t begin = starts[i];
+				const size_t end = (i + 1 < starts.size()) ? starts[i + 1] : triangleCount;
+				glm::vec3 centroid(0.0f);
+				glm::vec3 normal(0.0f);
+				float area = 0.0f;
+				for (size_t t = begin; t < end; t++) {
+					const glm::vec3 p0 = position(indices[t * 3 + 0]);
+					const glm::vec3 p1 = position(indices[t * 3 + 1]);
+					const glm::vec3 p2 = position(indices[t * 3 + 2]);
+					const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+					const float triangleArea = glm::length(n);
+					centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+					normal += n;
+					area += triangleArea;
+				}
+				const float normalLength = glm::length(normal);
+				if ((area > 0.0f) && (normalLength > 0.0f)) {
+					sortKeys[i] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+				} else {
+					sortKeys[i] = 0.0f;
+				}
+			}
+
+			std::vector<uint32_t> order(starts.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+			size_t offset = 0;
+			for (uint32_t cluster : order) {
+				const size_t begin = starts[cluster];
+				const size_t end = (cluster + 1 < starts.size()) ? starts[cluster + 1] : triangleCount;
+				memcpy(destination + offset, indices + begin * 3, (end - begin) * 3 * sizeof(uint32_t));
+				offset += (end - begin) * 3;
+			}
+		}
+
+		/** @brief Error quadric of a set of planes, the error of a point is the weighted sum of its squared distances to the planes */
+		struct Quadric
+		{
+			float a00{ 0.0f }, a11{ 0.0f }, a22{ 0.0f }, a01{ 0.0f }, a02{ 0.0f }, a12{ 0.0f };
+			float b0{ 0.0f }, b1{ 0.0f }, b2{ 0.0f };
+			float c{ 0.0f };
+			float weight{ 0.0f };
+
+			/** @brief Adds the plane dot(normal, p) + d = 0, normal needs to be normalized */
+			void addPlane(const glm::vec3& normal, float d, float planeWeight)
+			{
+				a00 += planeWeight * normal.x * normal.x;
+				a11 += planeWeight * normal.y * normal.y;
+				a22 += planeWeight * normal.z * normal.z;
+				a01 += planeWeight * normal.x * normal.y;
+				a02 += planeWeight * normal.x * normal.z;
+				a12 += planeWeight * normal.y * normal.z;
+				b0 += planeWeight * normal.x * d;
+				b1 += planeWeight * normal.y * d;
+				b2 += planeWeight * normal.z * d;
+				c += planeWeight * d * d;
+				weight += planeWeight;
+			}
+
+			Quadric& operator+=(const Quadric& other)
+			{
+				a00 += other.a00; a11 += other.a11; a22 += other.a22;
+				a01 += other.a01; a02 += other.a02; a12 += other.a12;
+				b0 += other.b0; b1 += other.b1; b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+				return *this;
+			}
+
+			/** @brief Root of the weighted mean squared distance of p to all planes */
+			float error(const glm::vec3& p) const
+			{
+				if (weight <= 0.0f) {
+					return 0.0f;
+				}
+				const float squared = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + 2.0f * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) + 2.0f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+				return sqrtf(std::max(squared / weight, 0.0f));
+			}
+		};
+
+		/**
+		* Simplifies a triangle list by collapsing edges into one of their vertices, ordered by their quadric error, so the result only references existing vertices
+		* Vertices on open borders and on attribute seams (vertices with the same position but different attributes) are only collapsed along the border or seam, so the mesh doesn't crack
+		* Indices of vertices with identical contents should be merged (e.g. with generateVertexRemap) before, as the connectivity is taken from the index buffer
+		*
+		* @param destination Receives the simplified indices, needs room for indexCount indices and must not overlap with indices
+		* @param positions Pointer to the position of the first vertex, positions are three floats
+		* @param vertexStride Distance between two positions in bytes
+		* @param targetIndexCount Simplification stops once the index count is at or below this
+		* @param targetError Collapses with a larger error than this aren't done, in the units of the positions
+		* @param resultError (Optional) Receives the largest error of all collapses that have been done
+		*
+		* @return Number of indices written to destination
+		*/
+		inline size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError, float* resultError = nullptr)
+		{
+			auto position = [positions, vertexStride](uint32_t vertex) {
+				glm::vec3 result;
+				memcpy(&result, reinterpret_cast<const uint8_t*>(positions) + vertex * vertexStride, sizeof(result));
+				return result;
+			};
+			size_t currentCount = indexCount - indexCount % 3;
+			memcpy(destination, indices, currentCount * sizeof(uint32_t));
+			if (resultError) {
+				*resultError = 0.0f;
+			}
+
+			// Referenced vertices with the same position are linked in a circular list (wedge) and share the quadric of the first one (canonical)
+			std::vector<uint32_t> canonical(vertexCount, invalidIndex);
+			std::vector<uint32_t> wedge(vertexCount, invalidIndex);
+			{
+				size_t tableSize = 1;
+				while (tableSize <= vertexCount + vertexCount / 4) {
+					tableSize *= 2;
+				}
+				std::vector<uint32_t> table(tableSize, invalidIndex);
+				for (size_t i = 0; i < currentCount; i++) {
+					const uint32_t vertex = destination[i];
+					if (canonical[vertex] != invalidIndex) {
+						continue;
+					}
+					const glm::vec3 p = position(vertex);
+					uint32_t hash = 2166136261u;
+					for (uint32_t j = 0; j < 3; j++) {
+						uint32_t word;
+						memcpy(&word, &p[j], sizeof(word));
+						hash = (hash ^ word) * 16777619u;
+					}
+					size_t slot = hash & (tableSize - 1);
+					while ((table[slot] != invalidIndex) && (position(table[slot]) != p)) {
+						slot = (slot + 1) & (tableSize - 1);
+					}
+					if (table[slot] == invalidIndex) {
+						table[slot] = vertex;
+						canonical[vertex] = vertex;
+						wedge[vertex] = vertex;
+					} else {
+						const uint32_t first = table[slot];
+						canonical[vertex] = first;
+						wedge[vertex] = wedge[first];
+						wedge[first] = vertex;
+					}
+				}
+			}
+
+			auto edgeKey = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(a) << 32) | b; };
+
+			// Face quadrics weighted by area and quadrics for planes perpendicular to open borders, so borders keep their shape
+			std::vector<Quadric> quadrics(vertexCount);
+			{
+				std::unordered_set<uint64_t> positionEdges;
+				positionEdges.reserve(currentCount);
+				for (size_t i = 0; i < currentCount; i++) {
+					const uint32_t a = canonical[destination[i]];
+					const uint32_t b = canonical[destination[i - i % 3 + (i + 1) % 3]];
+					positionEdges.insert(edgeKey(a, b));
+				}
+				for (size_t t = 0; t < currentCount / 3; t++) {
+					const uint32_t corners[3] = { canonical[destination[t * 3 + 0]], canonical[destination[t * 3 + 1]], canonical[destination[t * 3 + 2]] };
+					const glm::vec3 p0 = position(corners[0]);
+					const glm::vec3 p1 = position(corners[1]);
+					const glm::vec3 p2 = position(corners[2]);
+					glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+					const float length = glm::length(normal);
+					if (length <= 0.0f) {
+						continue;
+					}
+					normal /= length;
+					for (uint32_t j = 0; j < 3; j++) {
+						quadrics[corners[j]].addPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+					}
+					for (uint32_t j = 0; j < 3; j++) {
+						const uint32_t a = corners[j];
+						const uint32_t b = corners[(j + 1) % 3];
+						if (positionEdges.count(edgeKey(b, a)) == 0) {
+							const glm::vec3 edge = position(b) - position(a);
+							const float edgeLength = glm::length(edge);
+							if (edgeLength > 0.0f) {
+								const glm::vec3 borderNormal = glm::normalize(glm::cross(edge, normal));
+								const float borderWeight = edgeLength * edgeLength;
+								quadrics[a].addPlane(borderNormal, -glm::dot(borderNormal, position(a)), borderWeight);
+								quadrics[b].addPlane(borderNormal, -glm::dot(borderNormal, position(a)), borderWeight);
+							}
+						}
+					}
+				}
+			}
+
+			enum class Kind : uint8_t { Manifold, Border, Seam, Locked };
+			const uint32_t multipleEdges = invalidIndex - 1;
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+			std::vector<uint32_t> adjacency;
+			std::vector<uint32_t> openIn(vertexCount), openOut(vertexCount);
+			std::vector<Kind> kinds(vertexCount);
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<uint8_t> collapseLocked(vertexCount);
+			struct Collapse {
+				uint32_t source;
+				uint32_t target;
+				float error;
+			};
+			std::vector<Collapse> collapses;
+
+			while (currentCount > targetIndexCount) {
+				const size_t triangleCount = currentCount / 3;
+
+				// Vertex to triangle adjacency of the current mesh
+				std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+				for (size_t i = 0; i < currentCount; i++) {
+					adjacencyOffsets[destination[i] + 1]++;
+				}
+				for (size_t i = 0; i < vertexCount; i++) {
+					adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+				}
+				adjacency.resize(currentCount);
+				{
+					std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+					for (size_t i = 0; i < currentCount; i++) {
+						adjacency[fill[destination[i]]++] = static_cast<uint32_t>(i / 3);
+					}
+				}
+				auto hasEdge = [&](uint32_t a, uint32_t b) {
+					for (uint32_t i = adjacencyOffsets[a]; i < adjacencyOffsets[a + 1]; i++) {
+						const uint32_t* triangle = destination + adjacency[i] * 3;
+						for (uint32_t j = 0; j < 3; j++) {
+							if ((triangle[j] == a) && (triangle[(j + 1) % 3] == b)) {
+								return true;
+							}
+						}
+					}
+					return false;
+				};
+
+				// Open edges are edges without an opposite edge in the index buffer, each vertex may have at most one incoming and one outgoing open edge to be collapsible
+				std::fill(openIn.begin(), openIn.end(), invalidIndex);
+				std::fill(openOut.begin(), openOut.end(), invalidIndex);
+				for (size_t i = 0; i < currentCount; i++) {
+					const uint32_t a = destination[i];
+					const uint32_t b = destination[i - i % 3 + (i + 1) % 3];
+					if (!hasEdge(b, a)) {
+						openOut[a] = (openOut[a] == invalidIndex || openOut[a] == b) ? b : multipleEdges;
+						openIn[b] = (openIn[b] == invalidIndex || openIn[b] == a) ? a : multipleEdges;
+					}
+				}
+				auto single = [multipleEdges](uint32_t edge) { return edge != invalidIndex && edge != multipleEdges; };
+				for (size_t i = 0; i < currentCount; i++) {
+					const uint32_t v = destination[i];
+					const uint32_t w = wedge[v];
+					if (w == v) {
+						if (openIn[v] == invalidIndex && openOut[v] == invalidIndex) {
+							kinds[v] = Kind::Manifold;
+						} else if (single(openIn[v]) && single(openOut[v])) {
+							kinds[v] = Kind::Border;
+						} else {
+							kinds[v] = Kind::Locked;
+						}
+					} else if ((wedge[w] == v) && single(openIn[v]) && single(openOut[v]) && single(openIn[w]) && single(openOut[w])
+						&& (canonical[openOut[v]] == canonical[openIn[w]]) && (canonical[openIn[v]] == canonical[openOut[w]])) {
+						// Two vertices with the same position whose open edges run along each other in opposite directions
+						kinds[v] = Kind::Seam;
+					} else {
+						kinds[v] = Kind::Locked;
+					}
+				}
+
+				// Gather all allowed collapses: Manifold vertices can collapse into any neighbor, border and seam vertices only along their open edges
+				collapses.clear();
+				for (size_t i = 0; i < currentCount; i++) {
+					const uint32_t a = destination[i];
+					const uint32_t b = destination[i - i % 3 + (i + 1) % 3];
+					for (uint32_t direction = 0; direction < 2; direction++) {
+						const uint32_t source = direction == 0 ? a : b;
+						const uint32_t target = direction == 0 ? b : a;
+						if (canonical[source] == canonical[target]) {
+							continue;
+						}
+						const Kind kind = kinds[source];
+						const bool alongOpenEdge = (openOut[source] == target) || (openIn[source] == target);
+						if ((kind == Kind::Manifold) || ((kind == Kind::Border || kind == Kind::Seam) && (kinds[target] == kind) && alongOpenEdge)) {
+							collapses.push_back({ source, target, quadrics[canonical[source]].error(position(target)) });
+						}
+					}
+				}
+				if (collapses.empty()) {
+					break;
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+				// Rejects collapses that would flip or nearly flip the normal of a remaining triangle around the source vertex
+				auto flips = [&](uint32_t source, uint32_t target) {
+					const glm::vec3 targetPosition = position(target);
+					for (uint32_t i = adjacencyOffsets[source]; i < adjacencyOffsets[source + 1]; i++) {
+						const uint32_t* triangle = destination + adjacency[i] * 3;
+						glm::vec3 corners[3];
+						glm::vec3 moved[3];
+						bool removed = false;
+						for (uint32_t j = 0; j < 3; j++) {
+							removed |= canonical[triangle[j]] == canonical[target];
+							corners[j] = position(triangle[j]);
+							moved[j] = triangle[j] == source ? targetPosition : corners[j];
+						}
+						if (removed) {
+							continue;
+						}
+						const glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+						const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+						if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) {
+							return true;
+						}
+					}
+					return false;
+				};
+
+				// Locks all positions of the triangles around a vertex, so collapses done in the same pass don't touch the same triangles
+				auto lockNeighborhood = [&](uint32_t vertex) {
+					for (uint32_t i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; i++) {
+						const uint32_t* triangle = destination + adjacency[i] * 3;
+						for (uint32_t j = 0; j < 3; j++) {
+							collapseLocked[canonical[triangle[j]]] = 1;
+						}
+					}
+				};
+
+				// Greedily apply the cheapest independent collapses
+				for (size_t i = 0; i < vertexCount; i++) {
+					remap[i] = static_cast<uint32_t>(i);
+				}
+				std::fill(collapseLocked.begin(), collapseLocked.end(), 0);
+				// A collapse removes two triangles (one at borders), stop early to not overshoot the target
+				const size_t trianglesToRemove = (currentCount - targetIndexCount + 2) / 3;
+				size_t trianglesRemoved = 0;
+				size_t collapseCount = 0;
+				for (const Collapse& collapse : collapses) {
+					if (collapse.error > targetError) {
+						break;
+					}
+					const uint32_t sourcePosition = canonical[collapse.source];
+					const uint32_t targetPosition = canonical[collapse.target];
+					if (collapseLocked[sourcePosition] || collapseLocked[targetPosition]) {
+						continue;
+					}
+					if (kinds[collapse.source] == Kind::Seam) {
+						// The other side of the seam collapses along its own open edge into the target's wedge
+						const uint32_t other = wedge[collapse.source];
+						const uint32_t otherTarget = (openOut[collapse.source] == collapse.target) ? openIn[other] : openOut[other];
+						if ((canonical[otherTarget] != targetPosition) || flips(collapse.source, collapse.target) || flips(other, otherTarget)) {
+							continue;
+						}
+						remap[collapse.source] = collapse.target;
+						remap[other] = otherTarget;
+						lockNeighborhood(other);
+					} else {
+						if (flips(collapse.source, collapse.target)) {
+							continue;
+						}
+						remap[collapse.source] = collapse.target;
+					}
+					quadrics[targetPosition] += quadrics[sourcePosition];
+					lockNeighborhood(collapse.source);
+					if (resultError) {
+						*resultError = std::max(*resultError, collapse.error);
+					}
+					collapseCount++;
+					trianglesRemoved += kinds[collapse.source] == Kind::Border ? 1 : 2;
+					if (trianglesRemoved >= trianglesToRemove) {
+						break;
+					}
+				}
+				if (collapseCount == 0) {
+					break;
+				}
+
+				// Apply the collapses and remove triangles that became degenerate
+				size_t writeCount = 0;
+				for (size_t t = 0; t < triangleCount; t++) {
+					const uint32_t a = remap[destination[t * 3 + 0]];
+					const uint32_t b = remap[destination[t * 3 + 1]];
+					const uint32_t c = remap[destination[t * 3 + 2]];
+					if ((canonical[a] != canonical[b]) && (canonical[a] != canonical[c]) && (canonical[b] != canonical[c])) {
+						destination[writeCount++] = a;
+						destination[writeCount++] = b;
+						destination[writeCount++] = c;
+					}
+				}
+				currentCount = writeCount;
+			}
+			return currentCount;
+		}
+	}
+}
@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
 
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 #if (defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT))
@@ -212,22 +213,149 @@ std::string VulkanExampleBase::getShadersPath() const
 	return getShaderBasePath() + shaderDir + "/";
 }
 
+// Header prepended to the pipeline cache data stored on disk
+// The implementation's own cache header (VkPipelineCacheHeaderVersionOne) doesn't contain the driver version, so we store that alongside
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+};
+constexpr uint32_t pipelineCacheFileMagic{ 0x43505356 };
+
+// glTF models keep a slice of their node matrix buffer for each frame in flight
+static_assert(vkglTF::framesInFlight == maxConcurrentFrames);
+
+std::string VulkanExampleBase::getPipelineCacheFileName() const
+{
+	// Caches are stored per sample, so we derive the file name from the executable
+	std::string sampleName = name;
+	if (!args.empty() && args[0] != nullptr) {
+		sampleName = args[0];
+		const size_t pathPos = sampleName.find_last_of("/\\");
+		if (pathPos != std::string::npos) {
+			sampleName = sampleName.substr(pathPos + 1);
+		}
+		const size_t extPos = sampleName.find_last_of('.');
+		if (extPos != std::string::npos) {
+			sampleName = sampleName.substr(0, extPos);
+		}
+	}
+	// Falls back to the working directory if there is no writable cache directory
+	const std::string cacheDirectory = vks::tools::getCacheDirectory();
+	return cacheDirectory.empty() ? sampleName + ".pipelinecache" : cacheDirectory + "/" + sampleName + ".pipelinecache";
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+	std::vector<char> cacheData;
+	pipelineCacheWarm = false;
+	if (settings.persistentPipelineCache) {
+		// Try to initialize the cache with data from a previous run
+		// The data is only used if it has been created on the same device with the same driver, as implementations would reject (or worse, misinterpret) it otherwise
+		const std::string fileName = getPipelineCacheFileName();
+		std::ifstream is(fileName, std::ios::binary | std::ios::in);
+		if (is.is_open()) {
+			PipelineCacheFileHeader fileHeader{};
+			is.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+			bool valid = is.good()
+				&& (fileHeader.magic == pipelineCacheFileMagic)
+				&& (fileHeader.vendorID == deviceProperties.vendorID)
+				&& (fileHeader.deviceID == deviceProperties.deviceID)
+				&& (fileHeader.driverVersion == deviceProperties.driverVersion)
+				&& (memcmp(fileHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0)
+				&& (fileHeader.dataSize >= sizeof(VkPipelineCacheHeaderVersionOne));
+			if (valid) {
+				cacheData.resize(fileHeader.dataSize);
+				is.read(cacheData.data(), fileHeader.dataSize);
+				valid = is.gcount() == static_cast<std::streamsize>(fileHeader.dataSize);
+			}
+			if (valid) {
+				// Also validate the header written by the implementation itself
+				VkPipelineCacheHeaderVersionOne cacheHeader{};
+				memcpy(&cacheHeader, cacheData.data(), sizeof(cacheHeader));
+				valid = (cacheHeader.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne))
+					&& (cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+					&& (cacheHeader.vendorID == deviceProperties.vendorID)
+					&& (cacheHeader.deviceID == deviceProperties.deviceID)
+					&& (memcmp(cacheHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+			}
+			if (valid) {
+				pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+				pipelineCacheCreateInfo.pInitialData = cacheData.data();
+				pipelineCacheWarm = true;
+			} else {
+				std::cout << "Pipeline cache file \"" << fileName << "\" is invalid or was created on a different device or driver, ignoring it\n";
+			}
+		}
+	}
 	VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
 }
 
+void VulkanExampleBase::storePipelineCache()
+{
+	if (!settings.persistentPipelineCache || (pipelineCache == VK_NULL_HANDLE)) {
+		return;
+	}
+	size_t dataSize{ 0 };
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+	if (dataSize == 0) {
+		return;
+	}
+	std::vector<char> cacheData(dataSize);
+	VK_CHECK_RESULT(vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()));
+	PipelineCacheFileHeader fileHeader{
+		.magic = pipelineCacheFileMagic,
+		.vendorID = deviceProperties.vendorID,
+		.deviceID = deviceProperties.deviceID,
+		.driverVersion = deviceProperties.driverVersion,
+		.dataSize = dataSize
+	};
+	memcpy(fileHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	// Write to a temporary file first and then replace the old cache, so an interrupted write never leaves a truncated cache behind
+	const std::string fileName = getPipelineCacheFileName();
+	const std::string tempFileName = fileName + ".tmp";
+	{
+		std::ofstream os(tempFileName, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!os.is_open()) {
+			std::cerr << "Could not write pipeline cache to \"" << tempFileName << "\"\n";
+			return;
+		}
+		os.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+		os.write(cacheData.data(), dataSize);
+		if (!os.good()) {
+			os.close();
+			std::remove(tempFileName.c_str());
+			return;
+		}
+	}
+	std::error_code errorCode;
+	std::filesystem::rename(tempFileName, fileName, errorCode);
+	if (errorCode) {
+		std::cerr << "Could not replace pipeline cache file \"" << fileName << "\": " << errorCode.message() << "\n";
+		std::remove(tempFileName.c_str());
+	}
+}
+
 void VulkanExampleBase::prepare()
 {
+	tPrepareStart = std::chrono::high_resolution_clock::now();
 	createSurface();
 	createCommandPool();
 	createSwapChain();
 	createCommandBuffers();
 	createSynchronizationPrimitives();
+	uniformAllocator.create(vulkanDevice, maxConcurrentFrames);
+	if (benchmark.active) {
+		createBenchmarkTimestamps();
+	}
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
+	pipelineCompiler.create(device, pipelineCache, settings.serialPipelineCompilation);
 	setupFrameBuffer();
 	settings.overlay = settings.overlay && (!benchmark.active);
 	if (settings.overlay) {
@@ -250,11 +378,7 @@ VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileNa
 		.stage = stage,
 		.pName = "main"
 	};
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-	shaderStage.module = vks::tools::loadShader(androidApp->activity->assetManager, fileName.c_str(), device);
-#else
-	shaderStage.module = vks::tools::loadShader(fileName.c_str(), device);
-#endif
+	shaderStage.module = shaderCache.getModule(fileName);
 	assert(shaderStage.module != VK_NULL_HANDLE);
 	shaderModules.push_back(shaderStage.module);
 	return shaderStage;
@@ -301,6 +425,21 @@ void VulkanExampleBase::nextFrame()
 
 void VulkanExampleBase::renderLoop()
 {
+	// Uploads are submitted without waiting, make sure the ones done while preparing have finished before rendering starts
+	if (vulkanDevice) {
+		vulkanDevice->stagingRing.flush();
+		if (shaderCache.statistics.requested > 0) {
+			shaderCache.printStatistics(std::cout);
+		}
+		if (pipelineCompiler.statistics.requested > 0) {
+			pipelineCompiler.printStatistics(std::cout);
+		}
+		if (settings.memoryStatistics) {
+			vulkanDevice->memoryAllocator.printStatistics(std::cout);
+			vulkanDevice->descriptorAllocator.printStatistics(std::cout);
+		}
+	}
+
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT))
@@ -321,6 +460,20 @@ void VulkanExampleBase::renderLoop()
 		if (wl_display_dispatch_pending(display) == -1)
 			return;
 #endif
+		benchmark.prepareTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tPrepareStart).count();
+		if (settings.persistentPipelineCache) {
+			benchmark.pipelineCacheState = pipelineCacheWarm ? "warm" : "cold";
+		}
+		benchmark.pipelineCompilation = settings.serialPipelineCompilation ? "serial" : "parallel";
+		benchmark.pipelineBlockingTime = pipelineCompiler.statistics.blockingTimeUs / 1000.0;
+		benchmark.shaderFilesOpened = shaderCache.statistics.filesOpened;
+		benchmark.shaderKilobytesRead = shaderCache.statistics.bytesRead / 1024.0;
+		benchmark.shaderArchivesMapped = shaderCache.statistics.archivesMapped;
+		const vks::StagingRing::Statistics& uploadStatistics = vulkanDevice->stagingRing.statistics;
+		benchmark.uploadMegabytes = uploadStatistics.bytesUploaded / (1024.0 * 1024.0);
+		benchmark.uploadSubmits = uploadStatistics.submits;
+		benchmark.uploadStalls = uploadStatistics.stalls;
+		benchmark.sampleName = name;
 		benchmark.run([=, this] { render(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
 		if (!benchmark.filename.empty()) {
@@ -694,14 +847,24 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanExampleBase::prepareFrame(bool waitForFence)
 {
+	const auto tWaitStart = std::chrono::high_resolution_clock::now();
 	// Ensure command buffer execution has finished
 	if (waitForFence) {
 		VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
 		VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentBuffer]));
 	}
+	// The device is done with this frame's uniform data and transient descriptor sets (samples not using the fence wait on their own)
+	uniformAllocator.beginFrame(currentBuffer);
+	vulkanDevice->descriptorAllocator.beginFrame(currentBuffer);
+	if (benchmark.active) {
+		readBenchmarkTimestamps();
+	}
 	updateOverlay();
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(presentCompleteSemaphores[currentBuffer], currentImageIndex);
+	if (benchmark.active) {
+		benchmark.addFrameWaitTime(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tWaitStart).count());
+	}
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
@@ -717,15 +880,25 @@ void VulkanExampleBase::prepareFrame(bool waitForFence)
 
 void VulkanExampleBase::submitFrame(bool skipQueueSubmit)
 {
+	const auto tSubmitStart = std::chrono::high_resolution_clock::now();
 	if (!skipQueueSubmit) {
+		uniformAllocator.flush();
 		const VkPipelineStageFlags waitPipelineStage{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		std::array<VkCommandBuffer, 3> commandBuffers{ drawCmdBuffers[currentBuffer] };
+		uint32_t commandBufferCount{ 1 };
+		// In benchmark mode the draw command buffer is enclosed by the timestamp query command buffers
+		if (benchmarkTimestamps.queryPool != VK_NULL_HANDLE) {
+			commandBuffers = { benchmarkTimestamps.beginCommandBuffers[currentBuffer], drawCmdBuffers[currentBuffer], benchmarkTimestamps.endCommandBuffers[currentBuffer] };
+			commandBufferCount = 3;
+			benchmarkTimestamps.pending[currentBuffer] = true;
+		}
 		VkSubmitInfo submitInfo{
 			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
 			.waitSemaphoreCount = 1,
 			.pWaitSemaphores = &presentCompleteSemaphores[currentBuffer],
 			.pWaitDstStageMask = &waitPipelineStage,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &drawCmdBuffers[currentBuffer],
+			.commandBufferCount = commandBufferCount,
+			.pCommandBuffers = commandBuffers.data(),
 			.signalSemaphoreCount = 1,
 			.pSignalSemaphores = &renderCompleteSemaphores[currentImageIndex]
 		};
@@ -741,6 +914,9 @@ void VulkanExampleBase::submitFrame(bool skipQueueSubmit)
 		.pImageIndices = &currentImageIndex
 	};
 	VkResult result = vkQueuePresentKHR(queue, &presentInfo);
+	if (benchmark.active) {
+		benchmark.addFrameSubmitTime(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tSubmitStart).count());
+	}
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -771,9 +947,21 @@ VulkanExampleBase::VulkanExampleBase()
 	commandLineParser.add("benchmark", { "-b", "--benchmark" }, 0, "Run example in benchmark mode");
 	commandLineParser.add("benchmarkwarmup", { "-bw", "--benchwarmup" }, 1, "Set warmup time for benchmark mode in seconds");
 	commandLineParser.add("benchmarkruntime", { "-br", "--benchruntime" }, 1, "Set duration time for benchmark mode in seconds");
-	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
+	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results (.json for JSON output)");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("pipelinecache", { "-pc", "--pipelinecache" }, 0, "Load the pipeline cache from disk at startup and store it at exit");
+	commandLineParser.add("serialpipelines", { "-sp", "--serialpipelines" }, 0, "Compile pipelines on the main thread instead of worker threads in samples that use the pipeline compiler");
+	commandLineParser.add("noshaderarchives", { "-nsa", "--noshaderarchives" }, 0, "Load shaders from single SPIR-V files even if the shader directory has a shader archive");
+	commandLineParser.add("meshcache", { "-mc", "--meshcache" }, 0, "Load glTF models from cooked mesh caches, caches are written to the user's cache directory if missing or out of date");
+	commandLineParser.add("compactvertices", { "-cv", "--compactvertices" }, 0, "Store glTF model vertices in a quantized compact layout");
+	commandLineParser.add("optimizemeshes", { "-om", "--optimizemeshes" }, 0, "Optimize glTF meshes for vertex cache, overdraw and vertex fetch at load time");
+	commandLineParser.add("gpudriven", { "-gd", "--gpudriven" }, 0, "Use the GPU-driven indirect draw path for glTF models in samples that support it");
+	commandLineParser.add("computeskinning", { "-cs", "--computeskinning" }, 0, "Skin glTF meshes in a compute pre-pass in samples that support it");
+	commandLineParser.add("bindlessmaterials", { "-bm", "--bindlessmaterials" }, 0, "Bind all glTF materials once with descriptor indexing in samples that support it");
+	commandLineParser.add("texturecompression", { "-tc", "--texturecompression" }, 1, "Block compress uncompressed glTF textures on first load and cache them (bc7 or bc1)");
+	commandLineParser.add("texturereport", { "-tr", "--texturereport" }, 0, "Print the format, size, video memory and load time of all glTF textures after loading");
+	commandLineParser.add("memorystats", { "-ms", "--memorystats" }, 0, "Print device memory and descriptor allocation statistics after startup");
 #if (!(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT)))
 	commandLineParser.add("resourcepath", { "-rp", "--resourcepath" }, 1, "Set path for dir where assets and shaders folder is present");
 #endif
@@ -832,6 +1020,53 @@ VulkanExampleBase::VulkanExampleBase()
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("pipelinecache")) {
+		settings.persistentPipelineCache = true;
+	}
+	if (commandLineParser.isSet("serialpipelines")) {
+		settings.serialPipelineCompilation = true;
+	}
+	if (commandLineParser.isSet("noshaderarchives")) {
+		settings.shaderArchives = false;
+	}
+	if (commandLineParser.isSet("meshcache")) {
+		settings.meshCache = true;
+		vkglTF::meshCacheEnabled = true;
+	}
+	if (commandLineParser.isSet("compactvertices")) {
+		settings.compactVertices = true;
+		vkglTF::compactVertices = true;
+	}
+	if (commandLineParser.isSet("optimizemeshes")) {
+		settings.optimizeMeshes = true;
+		vkglTF::optimizeMeshes = true;
+	}
+	if (commandLineParser.isSet("gpudriven")) {
+		settings.gpuDriven = true;
+	}
+	if (commandLineParser.isSet("computeskinning")) {
+		settings.computeSkinning = true;
+	}
+	if (commandLineParser.isSet("bindlessmaterials")) {
+		settings.bindlessMaterials = true;
+	}
+	if (commandLineParser.isSet("texturecompression")) {
+		std::string value = commandLineParser.getValueAsString("texturecompression", "bc7");
+		if ((value != "bc7") && (value != "bc1")) {
+			std::cerr << "Texture compression must be one of 'bc7' or 'bc1'\n";
+		}
+		else {
+			settings.textureCompression = true;
+			vkglTF::textureCompression = (value == "bc1") ? vkglTF::TextureCompression::BC1 : vkglTF::TextureCompression::BC7;
+		}
+	}
+	if (commandLineParser.isSet("texturereport")) {
+		settings.textureReport = true;
+		vkglTF::textureReport = true;
+	}
+	if (commandLineParser.isSet("memorystats")) {
+		settings.memoryStatistics = true;
+	}
 #if (!(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT)))
 	if(commandLineParser.isSet("resourcepath")) {
 		vks::tools::resourcePath = commandLineParser.getValueAsString("resourcepath", "");
@@ -927,14 +1162,17 @@ VulkanExampleBase::~VulkanExampleBase()
 	for (auto& frameBuffer : frameBuffers) {
 		vkDestroyFramebuffer(device, frameBuffer, nullptr);
 	}
-	for (auto& shaderModule : shaderModules) {
-		vkDestroyShaderModule(device, shaderModule, nullptr);
-	}
+	shaderCache.destroy();
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
 	vkFreeMemory(device, depthStencil.memory, nullptr);
+	pipelineCompiler.destroy();
+	storePipelineCache();
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 	vkDestroyCommandPool(device, cmdPool, nullptr);
+	if (benchmarkTimestamps.queryPool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, benchmarkTimestamps.queryPool, nullptr);
+	}
 	for (auto& fence : waitFences) {
 		vkDestroyFence(device, fence, nullptr);
 	}
@@ -947,6 +1185,7 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (settings.overlay) {
 		ui.freeResources();
 	}
+	uniformAllocator.destroy();
 	delete vulkanDevice;
 	if (settings.validation) {
 		vks::debug::freeDebugCallback(instance);
@@ -1071,6 +1310,10 @@ bool VulkanExampleBase::initVulkan()
 
 	// Derived examples can override this to set actual features (based on above readings) to enable for logical device creation
 	getEnabledFeatures();
+	// glTF textures compressed by the texture compression cache are uploaded in BC formats
+	if (settings.textureCompression && deviceFeatures.textureCompressionBC) {
+		enabledFeatures.textureCompressionBC = VK_TRUE;
+	}
 
 	// Vulkan device creation
 	// This is handled by a separate class that gets a logical device representation
@@ -1086,6 +1329,10 @@ bool VulkanExampleBase::initVulkan()
 		return false;
 	}
 	device = vulkanDevice->logicalDevice;
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+	shaderCache.assetManager = androidApp->activity->assetManager;
+#endif
+	shaderCache.create(device, settings.shaderArchives);
 
 	// Get a graphics queue from the device
 	vkGetDeviceQueue(device, vulkanDevice->queueFamilyIndices.graphics, 0, &queue);
@@ -1906,6 +2153,7 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
+		benchmark.sampleName = name;
 		benchmark.run([=] { render(); }, vulkanDevice->properties);
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
@@ -2960,6 +3208,60 @@ void VulkanExampleBase::createSynchronizationPrimitives()
 	}
 }
 
+// Set up the timestamp queries used to measure GPU frame times in benchmark mode
+void VulkanExampleBase::createBenchmarkTimestamps()
+{
+	const uint32_t validBits = vulkanDevice->queueFamilyProperties[swapChain.queueNodeIndex].timestampValidBits;
+	if (validBits == 0) {
+		std::cout << "Timestamps are not supported by the graphics queue, GPU frame times won't be measured\n";
+		return;
+	}
+	benchmarkTimestamps.validBitsMask = (validBits >= 64) ? UINT64_MAX : ((1ull << validBits) - 1);
+	// Two queries (start and end of the frame) per frame in flight
+	VkQueryPoolCreateInfo queryPoolCI{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = maxConcurrentFrames * 2,
+	};
+	VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &benchmarkTimestamps.queryPool));
+	// The query commands are the same for every frame, so they're recorded once and submitted before and after each frame's draw command buffer
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = cmdPool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = maxConcurrentFrames,
+	};
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, benchmarkTimestamps.beginCommandBuffers.data()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, benchmarkTimestamps.endCommandBuffers.data()));
+	VkCommandBufferBeginInfo cmdBufInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	for (uint32_t i = 0; i < maxConcurrentFrames; i++) {
+		VK_CHECK_RESULT(vkBeginCommandBuffer(benchmarkTimestamps.beginCommandBuffers[i], &cmdBufInfo));
+		vkCmdResetQueryPool(benchmarkTimestamps.beginCommandBuffers[i], benchmarkTimestamps.queryPool, i * 2, 2);
+		vkCmdWriteTimestamp(benchmarkTimestamps.beginCommandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, benchmarkTimestamps.queryPool, i * 2);
+		VK_CHECK_RESULT(vkEndCommandBuffer(benchmarkTimestamps.beginCommandBuffers[i]));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(benchmarkTimestamps.endCommandBuffers[i], &cmdBufInfo));
+		vkCmdWriteTimestamp(benchmarkTimestamps.endCommandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, benchmarkTimestamps.queryPool, i * 2 + 1);
+		VK_CHECK_RESULT(vkEndCommandBuffer(benchmarkTimestamps.endCommandBuffers[i]));
+	}
+}
+
+// Pass the GPU time of the last frame that used the current frame slot to the benchmark
+// Must be called after the slot's fence has been waited on, if the sample doesn't wait on it the results may not be available and the frame is skipped
+void VulkanExampleBase::readBenchmarkTimestamps()
+{
+	if ((benchmarkTimestamps.queryPool == VK_NULL_HANDLE) || !benchmarkTimestamps.pending[currentBuffer]) {
+		return;
+	}
+	benchmarkTimestamps.pending[currentBuffer] = false;
+	std::array<uint64_t, 2> timestamps{};
+	VkResult result = vkGetQueryPoolResults(device, benchmarkTimestamps.queryPool, currentBuffer * 2, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS) {
+		return;
+	}
+	const uint64_t ticks = (timestamps[1] - timestamps[0]) & benchmarkTimestamps.validBitsMask;
+	benchmark.addGpuFrameTime((double)ticks * (double)deviceProperties.limits.timestampPeriod / 1000000.0);
+}
+
 void VulkanExampleBase::createCommandPool()
 {
 	VkCommandPoolCreateInfo cmdPoolInfo{
@@ -46,6 +46,8 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <fstream>
+#include <filesystem>
 #include <sys/stat.h>
 
 #define GLM_FORCE_RADIANS
@@ -68,6 +70,9 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanUniformAllocator.h"
+#include "VulkanPipelineCompiler.h"
+#include "VulkanShaderCache.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
@@ -86,13 +91,27 @@ private:
 	void nextFrame();
 	void updateOverlay();
 	void createPipelineCache();
+	void storePipelineCache();
+	std::string getPipelineCacheFileName() const;
 	void createCommandPool();
 	void createSynchronizationPrimitives();
 	void createSurface();
 	void createSwapChain();
 	void createCommandBuffers();
 	void destroyCommandBuffers();
+	void createBenchmarkTimestamps();
+	void readBenchmarkTimestamps();
 	std::string shaderDir = "glsl";
+	// Timestamp queries written before and after the draw command buffers in benchmark mode to measure GPU frame times
+	struct {
+		VkQueryPool queryPool{ VK_NULL_HANDLE };
+		// Small command buffers submitted along with the frame's draw command buffer, so samples don't have to record the queries themselves
+		std::array<VkCommandBuffer, maxConcurrentFrames> beginCommandBuffers{};
+		std::array<VkCommandBuffer, maxConcurrentFrames> endCommandBuffers{};
+		// Set if the queries for a frame slot have been submitted and not yet read back
+		std::array<bool, maxConcurrentFrames> pending{};
+		uint64_t validBitsMask{ 0 };
+	} benchmarkTimestamps;
 protected:
 	// Returns the path to the root of the glsl, hlsl or slang shader directory.
 	std::string getShadersPath() const;
@@ -138,10 +157,18 @@ protected:
 	std::vector<VkFramebuffer>frameBuffers;
 	// Descriptor set pool
 	VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
-	// List of shader modules created (stored for cleanup)
+	// List of shader modules loaded with loadShader (owned by the shader cache)
 	std::vector<VkShaderModule> shaderModules;
+	// Creates shader modules from shader archives or single SPIR-V files and shares modules for identical shaders, see vks::ShaderCache
+	vks::ShaderCache shaderCache;
 	// Pipeline cache object
 	VkPipelineCache pipelineCache{ VK_NULL_HANDLE };
+	// Set if the pipeline cache was initialized from a valid on-disk blob (warm start)
+	bool pipelineCacheWarm{ false };
+	// Compiles pipelines on worker threads against the pipeline cache, see vks::PipelineCompiler
+	vks::PipelineCompiler pipelineCompiler;
+	// Start of the prepare phase, used to report startup times (e.g. with and without a warm pipeline cache)
+	std::chrono::time_point<std::chrono::high_resolution_clock> tPrepareStart;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
 
@@ -171,6 +198,12 @@ public:
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice{};
 
+	/**
+	* @brief Transient allocator for per-frame uniform data, replaces per-frame uniform buffers owned by the samples
+	* @note Allocations of a frame are released in prepareFrame after waiting on the frame's fence, and flushed in submitFrame (samples submitting on their own need to call flush before submitting)
+	*/
+	vks::UniformAllocator uniformAllocator;
+
 	/** @brief Example settings that can be changed e.g. by command line arguments */
 	struct Settings {
 		/** @brief Activates validation layers (and message output) when set to true */
@@ -181,6 +214,30 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Load the pipeline cache from disk at startup and write it back at shutdown */
+		bool persistentPipelineCache = false;
+		/** @brief Compile pipelines requested through the pipeline compiler on the calling thread instead of worker threads */
+		bool serialPipelineCompilation = false;
+		/** @brief Load shaders from the shader archives of the sample's shader directories if present */
+		bool shaderArchives = true;
+		/** @brief Load glTF models from cooked mesh caches in the per-user cache directory, the caches are (re)written if missing or out of date */
+		bool meshCache = false;
+		/** @brief Store glTF model vertices in a quantized compact layout */
+		bool compactVertices = false;
+		/** @brief Load glTF models with vertex cache, overdraw and vertex fetch optimizations applied */
+		bool optimizeMeshes = false;
+		/** @brief Use the GPU-driven indirect draw path for glTF models in samples that support it */
+		bool gpuDriven = false;
+		/** @brief Skin glTF meshes in a compute pre-pass in samples that support it */
+		bool computeSkinning = false;
+		/** @brief Bind all glTF materials once with descriptor indexing in samples that support it */
+		bool bindlessMaterials = false;
+		/** @brief Block compress uncompressed glTF textures on first load and cache them, see vkglTF::textureCompression */
+		bool textureCompression = false;
+		/** @brief Print the format, size, video memory and load time of all glTF textures after loading */
+		bool textureReport = false;
+		/** @brief Print device memory statistics once the sample has been prepared */
+		bool memoryStatistics = false;
 	} settings;
 
 	/** @brief State of gamepad input (only used on Android) */
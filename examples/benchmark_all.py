@@ -0,0 +1,162 @@
+# Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+# This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+
+# Runs all samples in benchmark mode and combines their results into a single report, optionally compared against a baseline report
+
+# Usage: benchmark_all.py --bindir build/bin [--output benchmark] [--baseline benchmark/report.json] [--icd lvp_icd.x86_64.json]
+# The report is written as report.json (all results including raw frame times, can be used as the baseline for later runs) and report.md
+# Returns with exit code 1 if a sample regressed or failed while it succeeded in the baseline, or if no sample could be run at all
+
+# Note: For CI, build with USE_HEADLESS so the samples don't need a window system, and select a software implementation like lavapipe with --icd
+# Samples that require features the implementation doesn't support exit with an error and are listed as failed
+
+import argparse
+import glob
+import json
+import os
+import platform
+import subprocess
+import sys
+
+import benchmark_compare
+
+
+def find_samples(bindir, filters):
+    samples = []
+    for path in sorted(glob.glob(os.path.join(bindir, "*.exe" if platform.system() == "Windows" else "*"))):
+        if not os.path.isfile(path) or not os.access(path, os.X_OK):
+            continue
+        name = os.path.splitext(os.path.basename(path))[0]
+        # Skip headless samples, as they require a manual keypress and don't support benchmark mode
+        if "headless" in name:
+            continue
+        if filters and name not in filters:
+            continue
+        samples.append((name, os.path.abspath(path)))
+    return samples
+
+
+def run_sample(name, path, args, env):
+    result_file = os.path.join(args.output, name + ".json")
+    if os.path.exists(result_file):
+        os.remove(result_file)
+    command = [path, "-b", "-bw", str(args.warmup), "-br", str(args.runtime), "-bf", result_file]
+    if args.frames > 0:
+        command += ["-bfs", str(args.frames)]
+    if args.validation:
+        command += ["-v"]
+    command += args.extra
+    entry = {"status": "ok"}
+    try:
+        process = subprocess.run(command, cwd=args.output, env=env, capture_output=True, text=True, timeout=args.timeout)
+        if process.returncode != 0 or not os.path.exists(result_file):
+            entry["status"] = "failed"
+            entry["exitCode"] = process.returncode
+            entry["log"] = (process.stdout + process.stderr)[-2000:]
+            return entry
+    except subprocess.TimeoutExpired:
+        entry["status"] = "timeout"
+        return entry
+    entry["result"] = benchmark_compare.load(result_file)
+    return entry
+
+
+def format_stats(stats, key):
+    return "%.3f" % stats[key] if stats["count"] > 0 else "-"
+
+
+def write_markdown(filename, report, comparisons):
+    with open(filename, "w") as file:
+        file.write("# Benchmark report\n\n")
+        file.write("Device: %s\n\n" % report["device"])
+        file.write("| sample | status | fps | cpu p50 | cpu p90 | cpu p99 | cpu p99.9 | outliers | gpu p50 | gpu p99 | cpu delta | gpu delta |\n")
+        file.write("|---|---|---|---|---|---|---|---|---|---|---|---|\n")
+        for name, entry in report["samples"].items():
+            if entry["status"] != "ok":
+                file.write("| %s | %s | | | | | | | | | | |\n" % (name, entry["status"]))
+                continue
+            result = entry["result"]
+            cpu = result["statistics"]["cpu"]
+            gpu = result["statistics"]["gpu"]
+            deltas = {}
+            for metric, _, _, change, p, regression in comparisons.get(name, []):
+                deltas[metric] = "%+.2f%%%s" % (change, " **REGRESSION**" if regression else (" (p=%.2g)" % p))
+            file.write("| %s | %s | %.1f | %s | %s | %s | %s | %d | %s | %s | %s | %s |\n" % (
+                name, entry["status"], result["fps"],
+                format_stats(cpu, "p50"), format_stats(cpu, "p90"), format_stats(cpu, "p99"), format_stats(cpu, "p99.9"), cpu["outliers"],
+                format_stats(gpu, "p50"), format_stats(gpu, "p99"),
+                deltas.get("cpu", "-"), deltas.get("gpu", "-")))
+        failed = [name for name, entry in report["samples"].items() if entry["status"] != "ok"]
+        if failed:
+            file.write("\n## Failed samples\n\n")
+            for name in failed:
+                file.write("### %s\n\n```\n%s\n```\n\n" % (name, report["samples"][name].get("log", report["samples"][name]["status"])))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Run all samples in benchmark mode and create a consolidated report")
+    parser.add_argument("--bindir", default=".", help="Directory containing the sample binaries")
+    parser.add_argument("--output", default="benchmark", help="Directory for the per sample results and the report")
+    parser.add_argument("--baseline", help="Report of an earlier run to compare against")
+    parser.add_argument("--icd", help="Vulkan driver manifest to use (e.g. lavapipe's lvp_icd.x86_64.json)")
+    parser.add_argument("--samples", nargs="*", help="Only run the given samples")
+    parser.add_argument("--warmup", type=int, default=1, help="Warmup time per sample in seconds")
+    parser.add_argument("--runtime", type=int, default=5, help="Benchmark duration per sample in seconds")
+    parser.add_argument("--frames", type=int, default=0, help="Only render the given number of frames per sample (makes runs on slow software implementations predictable)")
+    parser.add_argument("--timeout", type=int, default=300, help="Time in seconds after which a sample is considered hung")
+    parser.add_argument("--threshold", type=float, default=2.0, help="Minimum slowdown of the median in percent to be reported as a regression")
+    parser.add_argument("--alpha", type=float, default=0.01, help="Significance level for regressions")
+    parser.add_argument("--validation", action="store_true", help="Enable validation layers")
+    parser.add_argument("extra", nargs=argparse.REMAINDER, help="Additional arguments passed to all samples (after --)")
+    args = parser.parse_args()
+    args.extra = [arg for arg in args.extra if arg != "--"]
+
+    os.makedirs(args.output, exist_ok=True)
+    args.output = os.path.abspath(args.output)
+    env = dict(os.environ)
+    if args.icd:
+        env["VK_DRIVER_FILES"] = os.path.abspath(args.icd)
+        env["VK_ICD_FILENAMES"] = os.path.abspath(args.icd)
+
+    samples = find_samples(args.bindir, args.samples)
+    if not samples:
+        print("No samples found in %s" % args.bindir)
+        sys.exit(1)
+
+    report = {"device": "", "samples": {}}
+    for index, (name, path) in enumerate(samples):
+        print("[%d/%d] %s" % (index + 1, len(samples), name), flush=True)
+        entry = run_sample(name, path, args, env)
+        if entry["status"] == "ok" and not report["device"]:
+            report["device"] = entry["result"]["device"]["name"]
+        report["samples"][name] = entry
+        if entry["status"] != "ok":
+            print("  %s" % entry["status"])
+
+    comparisons = {}
+    problems = []
+    if args.baseline:
+        baseline = benchmark_compare.load(args.baseline)
+        if baseline.get("device") and report["device"] and baseline["device"] != report["device"]:
+            print("Warning: baseline is from a different device (%s)" % baseline["device"])
+        for name, entry in report["samples"].items():
+            reference = baseline["samples"].get(name)
+            if reference is None or reference["status"] != "ok":
+                continue
+            if entry["status"] != "ok":
+                problems.append("%s: %s (succeeded in baseline)" % (name, entry["status"]))
+                continue
+            comparisons[name] = benchmark_compare.compare(reference["result"], entry["result"], args.threshold, args.alpha)
+            for metric, median_a, median_b, change, p, regression in comparisons[name]:
+                if regression:
+                    problems.append("%s: %s p50 %.3f ms -> %.3f ms (%+.2f%%, p=%.2g)" % (name, metric, median_a, median_b, change, p))
+
+    with open(os.path.join(args.output, "report.json"), "w") as file:
+        json.dump(report, file)
+    write_markdown(os.path.join(args.output, "report.md"), report, comparisons)
+
+    succeeded = sum(1 for entry in report["samples"].values() if entry["status"] == "ok")
+    print("%d of %d samples completed, report written to %s" % (succeeded, len(samples), os.path.join(args.output, "report.md")))
+    for problem in problems:
+        print("  %s" % problem)
+    sys.exit(1 if problems or succeeded == 0 else 0)
@@ -0,0 +1,107 @@
+# Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+# This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+
+# Compares two benchmark result files written with "-b -bf result.json" and flags statistically significant regressions
+
+# Usage: benchmark_compare.py baseline.json current.json [--threshold 2.0] [--alpha 0.01]
+# A metric is flagged if its median got slower by more than threshold percent and a Mann-Whitney U test on the raw frame times rejects
+# the hypothesis that both runs have the same distribution with a p-value below alpha
+# Returns with exit code 1 if a regression has been detected
+
+import argparse
+import json
+import math
+import sys
+
+METRICS = ["cpu", "record", "submit", "wait", "gpu"]
+
+
+def load(filename):
+    with open(filename) as file:
+        return json.load(file)
+
+
+def median(samples):
+    ordered = sorted(samples)
+    mid = len(ordered) // 2
+    if len(ordered) % 2 == 0:
+        return (ordered[mid - 1] + ordered[mid]) / 2.0
+    return ordered[mid]
+
+
+# Two sided Mann-Whitney U test using the normal approximation with tie correction
+# Frame times are not normally distributed (long tail of slow frames), so a rank based test is used instead of a t-test
+def mann_whitney_u(a, b):
+    n1 = len(a)
+    n2 = len(b)
+    if n1 == 0 or n2 == 0:
+        return 1.0
+    combined = sorted([(value, 0) for value in a] + [(value, 1) for value in b])
+    ranks = [0.0] * len(combined)
+    tie_term = 0.0
+    i = 0
+    while i < len(combined):
+        j = i
+        while j + 1 < len(combined) and combined[j + 1][0] == combined[i][0]:
+            j += 1
+        # Tied values get the average of their ranks
+        rank = (i + j) / 2.0 + 1.0
+        for k in range(i, j + 1):
+            ranks[k] = rank
+        ties = j - i + 1
+        tie_term += ties ** 3 - ties
+        i = j + 1
+    rank_sum = sum(rank for rank, (_, group) in zip(ranks, combined) if group == 0)
+    u = rank_sum - n1 * (n1 + 1) / 2.0
+    mean = n1 * n2 / 2.0
+    n = n1 + n2
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0.0:
+        return 1.0
+    z = (abs(u - mean) - 0.5) / math.sqrt(variance)
+    return math.erfc(max(z, 0.0) / math.sqrt(2.0))
+
+
+# Returns one entry per metric present in both results: (metric, baseline median, current median, change in percent, p-value, regression)
+def compare(baseline, current, threshold=2.0, alpha=0.01):
+    results = []
+    for metric in METRICS:
+        a = baseline.get("frameTimes", {}).get(metric, [])
+        b = current.get("frameTimes", {}).get(metric, [])
+        if not a or not b:
+            continue
+        median_a = median(a)
+        median_b = median(b)
+        change = (median_b - median_a) / median_a * 100.0 if median_a > 0.0 else 0.0
+        p = mann_whitney_u(a, b)
+        results.append((metric, median_a, median_b, change, p, p < alpha and change > threshold))
+    return results
+
+
+def print_report(baseline, current, results, alpha):
+    print("baseline: %s on %s (driver %s)" % (baseline.get("sample", ""), baseline["device"]["name"], baseline["device"]["driverVersion"]))
+    print("current : %s on %s (driver %s)" % (current.get("sample", ""), current["device"]["name"], current["device"]["driverVersion"]))
+    print("%-8s %12s %12s %9s %10s" % ("metric", "base p50", "curr p50", "change", "p-value"))
+    for metric, median_a, median_b, change, p, regression in results:
+        status = "REGRESSION" if regression else ("improved" if p < alpha and change < 0.0 else "")
+        print("%-8s %9.3f ms %9.3f ms %+8.2f%% %10.2e  %s" % (metric, median_a, median_b, change, p, status))
+    for key in ["p99", "p99.9"]:
+        a = baseline["statistics"]["cpu"][key]
+        b = current["statistics"]["cpu"][key]
+        print("cpu %-5s: %.3f ms -> %.3f ms" % (key, a, b))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Compare two benchmark result files")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=2.0, help="Minimum slowdown of the median in percent to be reported as a regression")
+    parser.add_argument("--alpha", type=float, default=0.01, help="Significance level")
+    args = parser.parse_args()
+    baseline = load(args.baseline)
+    current = load(args.current)
+    if baseline["device"]["name"] != current["device"]["name"]:
+        print("Warning: results are from different devices")
+    results = compare(baseline, current, args.threshold, args.alpha)
+    print_report(baseline, current, results, args.alpha)
+    sys.exit(1 if any(result[5] for result in results) else 0)
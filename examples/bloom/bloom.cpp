@@ -118,11 +118,6 @@ public:
 				vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
 			}
 			vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
-			vkDestroyPipeline(device, pipelines.blurHorz, nullptr);
-			vkDestroyPipeline(device, pipelines.blurVert, nullptr);
-			vkDestroyPipeline(device, pipelines.phongPass, nullptr);
-			vkDestroyPipeline(device, pipelines.glowPass, nullptr);
-			vkDestroyPipeline(device, pipelines.skyBox, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.blur, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.blur, nullptr);
@@ -419,6 +414,7 @@ public:
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.scene));
 
 		// Pipelines
+		// The pipelines are compiled in parallel by the base class' pipeline compiler, which copies the create info on each request and owns the pipelines
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
@@ -465,11 +461,11 @@ public:
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
 		// Vertical blur pipeline
 		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurVert));
+		pipelineCompiler.compile(pipelineCI, &pipelines.blurVert);
 		// Horizontal blur pipeline
 		blurdirection = 1;
 		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurHorz));
+		pipelineCompiler.compile(pipelineCI, &pipelines.blurHorz);
 
 		// Phong pass (3D model)
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
@@ -480,13 +476,13 @@ public:
 		depthStencilStateCI.depthWriteEnable = VK_TRUE;
 		rasterizationStateCI.cullMode = VK_CULL_MODE_BACK_BIT;
 		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.phongPass));
+		pipelineCompiler.compile(pipelineCI, &pipelines.phongPass);
 
 		// Color only pass (offscreen blur base)
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/colorpass.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "bloom/colorpass.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.glowPass));
+		pipelineCompiler.compile(pipelineCI, &pipelines.glowPass);
 
 		// Skybox (cubemap)
 		shaderStages[0] = loadShader(getShadersPath() + "bloom/skybox.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
@@ -494,7 +490,10 @@ public:
 		depthStencilStateCI.depthWriteEnable = VK_FALSE;
 		rasterizationStateCI.cullMode = VK_CULL_MODE_FRONT_BIT;
 		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skyBox));
+		pipelineCompiler.compile(pipelineCI, &pipelines.skyBox);
+
+		// Wait for all pipelines to finish compiling, this writes the handles to the pipeline variables
+		pipelineCompiler.wait();
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
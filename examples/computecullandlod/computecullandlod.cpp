@@ -19,21 +19,35 @@ constexpr auto OBJECT_COUNT = 32;
 constexpr auto OBJECT_COUNT = 64;
 #endif
 
+// Upper limit for the number of generated LODs, also sizes the statistics written by the compute shader
 constexpr auto MAX_LOD_LEVEL = 5;
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool fixedFrustum = false;
+	// Maximum screen space error of the selected LODs in pixels
+	float lodErrorThreshold = 1.0f;
 
-	// The model contains multiple versions of a single object with different levels of detail
+	// The LOD chain for the object is generated at load time, the model's hand made LODs are not used
 	vkglTF::Model lodModel;
+	vkglTF::Primitive* lodPrimitive{ nullptr };
+
+	// Shader storage buffer containing index offsets and counts for the LODs
+	struct LOD
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float distance;
+		float _pad0;
+	};
 
 	// Per-instance data block
 	struct InstanceData {
 		glm::vec3 pos{ 0.0f };
 		float scale{ 1.0f };
 	};
+	const float instanceScale = 2.0f;
 
 	// Contains the instanced data
 	vks::Buffer instanceBuffer;
@@ -141,8 +155,36 @@ public:
 
 	void loadAssets()
 	{
-		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY;
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::GenerateLods;
+		lodModel.lodSettings.levelCount = MAX_LOD_LEVEL + 1;
 		lodModel.loadFromFile(getAssetPath() + "models/suzanne_lods.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		// The first node contains the most detailed version of the object
+		lodPrimitive = lodModel.nodes[0]->mesh->primitives[0];
+	}
+
+	// Converts the geometric error of the LODs into the distances at which they are selected by the compute shader
+	// A LOD is used once its error, projected to the screen at that distance, is below the error threshold
+	void updateLodLevels()
+	{
+		// The vertical scale of the projection matrix is 1 / tan(fov / 2)
+		const float pixelsPerUnit = static_cast<float>(height) * 0.5f * fabsf(camera.matrices.perspective[1][1]);
+		std::vector<LOD> lodLevels(lodPrimitive->lods.size());
+		for (size_t i = 0; i < lodLevels.size(); i++) {
+			lodLevels[i].firstIndex = lodPrimitive->lods[i].firstIndex;
+			lodLevels[i].indexCount = lodPrimitive->lods[i].indexCount;
+			// Distance up to which this LOD is used, i.e. the distance at which the next one becomes precise enough
+			lodLevels[i].distance = (i + 1 < lodLevels.size()) ? lodPrimitive->lods[i + 1].error * instanceScale * pixelsPerUnit / lodErrorThreshold : FLT_MAX;
+		}
+
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			lodLevels.size() * sizeof(LOD),
+			lodLevels.data()));
+		vulkanDevice->copyBuffer(&stagingBuffer, &compute.lodLevelsBuffers, queue);
+		stagingBuffer.destroy();
 	}
 
 	void prepareDescriptorPool()
@@ -190,7 +232,7 @@ public:
 		// The instancing pipeline uses a vertex input state with two bindings
 		bindingDescriptions = {
 		    // Binding point 0: Mesh vertex layout description at per-vertex rate
-		    vks::initializers::vertexInputBindingDescription(0, sizeof(vkglTF::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+		    vkglTF::Vertex::inputBindingDescription(0),
 		    // Binding point 1: Instanced data at per-instance rate
 		    vks::initializers::vertexInputBindingDescription(1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE)
 		};
@@ -199,9 +241,9 @@ public:
 		attributeDescriptions = {
 		    // Per-vertex attributes
 		    // These are advanced for each vertex fetched by the vertex shader
-		    vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, pos)),	// Location 0: Position
-		    vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, normal)),	// Location 1: Normal
-		    vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, color)),	// Location 2: Texture coordinates
+		    vkglTF::Vertex::inputAttributeDescription(0, 0, vkglTF::VertexComponent::Position),	// Location 0: Position
+		    vkglTF::Vertex::inputAttributeDescription(0, 1, vkglTF::VertexComponent::Normal),	// Location 1: Normal
+		    vkglTF::Vertex::inputAttributeDescription(0, 2, vkglTF::VertexComponent::Color),		// Location 2: Texture coordinates
 		    // Per-Instance attributes
 		    // These are fetched for each instance rendered
 		    vks::initializers::vertexInputAttributeDescription(1, 3, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, pos)),	// Location 4: Position
@@ -320,7 +362,7 @@ public:
 				for (uint32_t z = 0; z < OBJECT_COUNT; z++) {
 					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
 					instanceData[index].pos = glm::vec3((float)x, (float)y, (float)z) - glm::vec3((float)OBJECT_COUNT / 2.0f);
-					instanceData[index].scale = 2.0f;
+					instanceData[index].scale = instanceScale;
 				}
 			}
 		}
@@ -356,42 +398,13 @@ public:
 		}
 
 
-		// Shader storage buffer containing index offsets and counts for the LODs
-		struct LOD
-		{
-			uint32_t firstIndex;
-			uint32_t indexCount;
-			float distance;
-			float _pad0;
-		};
-		std::vector<LOD> LODLevels;
-		uint32_t n = 0;
-		for (auto node : lodModel.nodes)
-		{
-			LOD lod{};
-			lod.firstIndex = node->mesh->primitives[0]->firstIndex;	// First index for this LOD
-			lod.indexCount = node->mesh->primitives[0]->indexCount;	// Index count for this LOD
-			lod.distance = 5.0f + n * 5.0f;							// Starting distance (to viewer) for this LOD
-			n++;
-			LODLevels.push_back(lod);
-		}
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			LODLevels.size() * sizeof(LOD),
-			LODLevels.data()));
-
+		// LOD ranges and selection distances
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&compute.lodLevelsBuffers,
-			stagingBuffer.size));
-
-		vulkanDevice->copyBuffer(&stagingBuffer, &compute.lodLevelsBuffers, queue);
-
-		stagingBuffer.destroy();
+			lodPrimitive->lods.size() * sizeof(LOD)));
+		updateLodLevels();
 
 		// Scene uniform buffer
 		for (auto& buffer : uniformBuffers) {
@@ -454,7 +467,7 @@ public:
 		specializationEntry.offset = 0;
 		specializationEntry.size = sizeof(uint32_t);
 
-		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		uint32_t specializationData = static_cast<uint32_t>(lodPrimitive->lods.size()) - 1;
 
 		VkSpecializationInfo specializationInfo{};
 		specializationInfo.mapEntryCount = 1;
@@ -777,15 +790,26 @@ public:
 		}
 	}
 
+	virtual void windowResized()
+	{
+		// The LOD distances depend on the vertical resolution
+		vkDeviceWaitIdle(device);
+		updateLodLevels();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Freeze frustum", &fixedFrustum);
+			if (overlay->sliderFloat("LOD error (pixels)", &lodErrorThreshold, 0.25f, 8.0f)) {
+				vkDeviceWaitIdle(device);
+				updateLodLevels();
+			}
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
-			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
-				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
+			for (uint32_t i = 0; i < static_cast<uint32_t>(lodPrimitive->lods.size()); i++) {
+				overlay->text("LOD %d: %d (%d triangles)", i, indirectStats.lodCount[i], lodPrimitive->lods[i].indexCount / 3);
 			}
 		}
 	}
@@ -71,11 +71,8 @@ public:
 	void renderNode(vkglTF::Node *node, VkCommandBuffer commandBuffer) {
 		if (node->mesh) {
 			for (vkglTF::Primitive * primitive : node->mesh->primitives) {
-				const std::vector<VkDescriptorSet> descriptorsets = {
-					descriptorSets[currentBuffer],
-					node->mesh->uniformBuffer.descriptorSet
-				};
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorsets.size()), descriptorsets.data(), 0, NULL);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
+				scene.bindNodeMatrices(commandBuffer, pipelineLayout, 1, node, currentBuffer);
 
 				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(primitive->material.baseColorFactor), &primitive->material.baseColorFactor);
 
@@ -8,9 +8,9 @@
 * Summary:
 * Demonstrates the use of dynamic uniform buffers.
 *
-* Instead of using one uniform buffer per-object, this example allocates one big uniform buffer
-* with respect to the alignment reported by the device via minUniformBufferOffsetAlignment that
-* contains all matrices for the objects in the scene.
+* Instead of using one uniform buffer per-object, this example allocates the matrices for all objects
+* in the scene from the base class' transient uniform allocator. It bumps allocations from one buffer per
+* frame in flight with respect to the alignment reported by the device via minUniformBufferOffsetAlignment.
 *
 * The used descriptor type VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC then allows to set a dynamic
 * offset used to pass data from the single uniform buffer to the connected shader binding point.
@@ -26,30 +26,6 @@ struct Vertex {
 	float color[3];
 };
 
-// Wrapper functions for aligned memory allocation
-// There is currently no standard for this in C++ that works across all platforms and vendors, so we abstract this
-void* alignedAlloc(size_t size, size_t alignment)
-{
-	void *data = nullptr;
-#if defined(_MSC_VER) || defined(__MINGW32__)
-	data = _aligned_malloc(size, alignment);
-#else
-	int res = posix_memalign(&data, alignment, size);
-	if (res != 0)
-		data = nullptr;
-#endif
-	return data;
-}
-
-void alignedFree(void* data)
-{
-#if	defined(_MSC_VER) || defined(__MINGW32__)
-	_aligned_free(data);
-#else
-	free(data);
-#endif
-}
-
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -57,13 +33,7 @@ public:
 	vks::Buffer indexBuffer;
 	uint32_t indexCount{ 0 };
 
-	struct UniformBuffers {
-		vks::Buffer view;
-		vks::Buffer dynamic;
-	};
-	std::array<UniformBuffers, maxConcurrentFrames> uniformBuffers;
-
-	struct {
+	struct UboView {
 		glm::mat4 projection;
 		glm::mat4 view;
 	} uboVS;
@@ -72,19 +42,15 @@ public:
 	glm::vec3 rotations[OBJECT_INSTANCES];
 	glm::vec3 rotationSpeeds[OBJECT_INSTANCES];
 
-	// One big uniform buffer that contains all matrices
-	// Note that we need to manually allocate the data to cope for GPU-specific uniform buffer offset alignments
-	struct UboDataDynamic {
-		glm::mat4* model{ nullptr };
-	} uboDataDynamic;
+	// Dynamic offsets of this frame's uniform data into the transient uniform allocator's buffer
+	uint32_t viewOffset{ 0 };
+	std::array<uint32_t, OBJECT_INSTANCES> modelOffsets{};
 
 	VkPipeline pipeline{ VK_NULL_HANDLE };
 	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
-	VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+	std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
 	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
 
-	size_t dynamicAlignment{ 0 };
-
 	VulkanExample() : VulkanExampleBase()
 	{
 		title = "Dynamic uniform buffers";
@@ -97,18 +63,11 @@ public:
 	~VulkanExample()
 	{
 		if (device) {
-			if (uboDataDynamic.model) {
-				alignedFree(uboDataDynamic.model);
-			}
 			vkDestroyPipeline(device, pipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 			vertexBuffer.destroy();
 			indexBuffer.destroy();
-			for (auto& buffer : uniformBuffers) {
-				buffer.view.destroy();
-				buffer.dynamic.destroy();
-			}
 		}
 	}
 
@@ -153,35 +112,35 @@ public:
 	{
 		// Pool
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames),
 			// Dynamic uniform buffers require a different descriptor type
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, maxConcurrentFrames)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, maxConcurrentFrames * 2)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 
 		// Layout
+		// Both uniform blocks are allocated from the transient uniform allocator every frame, so both are dynamic uniform buffers
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
-			// Dynamic uniform buffer
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 1)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
 
-		// Sets per frame, just like the buffers themselves
-		// Images do not need to be duplicated per frame, we reuse the same one for each frame
+		// Sets per frame, as the transient uniform allocator uses a separate buffer for each frame in flight
+		// The descriptor ranges cover a single uniform block, the actual position in the buffer is passed as a dynamic offset at bind time
 		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-		for (auto i = 0; i < uniformBuffers.size(); i++) {
-			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
-			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+		for (uint32_t i = 0; i < maxConcurrentFrames; i++) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+			VkDescriptorBufferInfo viewDescriptor = uniformAllocator.descriptor(i, sizeof(UboView));
+			VkDescriptorBufferInfo modelDescriptor = uniformAllocator.descriptor(i, sizeof(glm::mat4));
 			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
-				// Binding 0 : Projection/View matrix as uniform buffer
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[currentBuffer].view.descriptor),
-				// Binding 1 : Instance matrix as dynamic uniform buffer
-				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &uniformBuffers[currentBuffer].dynamic.descriptor),
+				// Binding 0 : Projection/View matrix
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0, &viewDescriptor),
+				// Binding 1 : Instance matrix
+				vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, &modelDescriptor),
 			};
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 		}
@@ -236,50 +195,8 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
-	// Prepare and initialize uniform buffer containing shader uniforms
-	void prepareUniformBuffers()
+	void prepareRotations()
 	{
-		// Allocate data for the dynamic uniform buffer object
-		// We allocate this manually as the alignment of the offset differs between GPUs
-
-		// Calculate required alignment based on minimum device offset alignment
-		size_t minUboAlignment = vulkanDevice->properties.limits.minUniformBufferOffsetAlignment;
-		dynamicAlignment = sizeof(glm::mat4);
-		if (minUboAlignment > 0) {
-			dynamicAlignment = (dynamicAlignment + minUboAlignment - 1) & ~(minUboAlignment - 1);
-		}
-
-		size_t bufferSize = OBJECT_INSTANCES * dynamicAlignment;
-
-		uboDataDynamic.model = (glm::mat4*)alignedAlloc(bufferSize, dynamicAlignment);
-		assert(uboDataDynamic.model);
-
-		std::cout << "minUniformBufferOffsetAlignment = " << minUboAlignment << std::endl;
-		std::cout << "dynamicAlignment = " << dynamicAlignment << std::endl;
-
-		for (auto& buffer : uniformBuffers) {
-			// Static shared uniform buffer object with projection and view matrix
-			VK_CHECK_RESULT(vulkanDevice->createBuffer(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&buffer.view,
-				sizeof(uboVS)));
-
-			// Uniform buffer object with per-object matrices
-			VK_CHECK_RESULT(vulkanDevice->createBuffer(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&buffer.dynamic,
-				bufferSize));
-
-			// Override descriptor range to [base, base + dynamicAlignment]
-			buffer.dynamic.descriptor.range = dynamicAlignment;
-
-			// Map persistent
-			VK_CHECK_RESULT(buffer.view.map());
-			VK_CHECK_RESULT(buffer.dynamic.map());
-		}
-
 		// Prepare per-object matrices with offsets and random rotations
 		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
 		std::normal_distribution<float> rndDist(-1.0f, 1.0f);
@@ -291,15 +208,16 @@ public:
 
 	void updateUniformBuffers()
 	{
-		// Fixed ubo with projection and view matrices
+		// Projection and view matrices shared by all objects
 		uboVS.projection = camera.matrices.perspective;
 		uboVS.view = camera.matrices.view;
-		memcpy(uniformBuffers[currentBuffer].view.mapped, &uboVS, sizeof(uboVS));
+		viewOffset = uniformAllocator.upload(uboVS).offset;
 	}
 
 	void updateDynamicUniformBuffer()
 	{
-		// Dynamic ubo with per-object model matrices indexed by offsets in the command buffer
+		// Per-object model matrices, each one is a separate allocation that's selected with its dynamic offset in the command buffer
+		// The allocator takes care of the GPU-specific uniform buffer offset alignment
 		uint32_t dim = static_cast<uint32_t>(pow(OBJECT_INSTANCES, (1.0f / 3.0f)));
 		glm::vec3 offset(5.0f);
 		for (uint32_t x = 0; x < dim; x++) {
@@ -307,8 +225,9 @@ public:
 				for (uint32_t z = 0; z < dim; z++) {
 					const uint32_t index = x * dim * dim + y * dim + z;
 
-					// Aligned offset
-					glm::mat4* modelMat = (glm::mat4*)(((uint64_t)uboDataDynamic.model + (index * dynamicAlignment)));
+					vks::UniformAllocator::Allocation allocation = uniformAllocator.allocate(sizeof(glm::mat4));
+					modelOffsets[index] = allocation.offset;
+					glm::mat4* modelMat = static_cast<glm::mat4*>(allocation.data);
 
 					// Update rotations
 					rotations[index] += frameTimer * rotationSpeeds[index];
@@ -322,19 +241,14 @@ public:
 				}
 			}
 		}
-		memcpy(uniformBuffers[currentBuffer].dynamic.mapped, uboDataDynamic.model, uniformBuffers[currentBuffer].dynamic.size);
-		// Flush to make changes visible to the host
-		VkMappedMemoryRange memoryRange = vks::initializers::mappedMemoryRange();
-		memoryRange.memory = uniformBuffers[currentBuffer].dynamic.memory;
-		memoryRange.size = uniformBuffers[currentBuffer].dynamic.size;
-		vkFlushMappedMemoryRanges(device, 1, &memoryRange);
+		// Non-coherent memory is flushed by the base class in submitFrame
 	}
 
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
 		generateCube();
-		prepareUniformBuffers();
+		prepareRotations();
 		setupDescriptors();
 		preparePipelines();
 		prepared = true;
@@ -378,10 +292,10 @@ public:
 
 		// Render multiple objects using different model matrices by dynamically offsetting into one uniform buffer
 		for (uint32_t j = 0; j < OBJECT_INSTANCES; j++) {
-			// One dynamic offset per dynamic descriptor to offset into the ubo containing all model matrices
-			uint32_t dynamicOffset = j * static_cast<uint32_t>(dynamicAlignment);
-			// Bind the descriptor set for rendering a mesh using the dynamic offset
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
+			// One dynamic offset per dynamic descriptor in binding order
+			const std::array<uint32_t, 2> dynamicOffsets = { viewOffset, modelOffsets[j] };
+			// Bind the descriptor set for rendering a mesh using the dynamic offsets
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
 
 			vkCmdDrawIndexed(cmdBuffer, indexCount, 1, 0, 0, 0);
 		}
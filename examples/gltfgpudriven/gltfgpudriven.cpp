@@ -0,0 +1,359 @@
+/*
+* Vulkan Example - GPU-driven glTF rendering
+*
+* Renders a glTF scene with the indirect draw path of the glTF model class
+* All primitives of the model are flattened into a buffer of indirect draw commands at load time, along with per-draw data (transform and material index)
+* Each frame, a compute shader culls the draws against the view frustum and compacts the visible ones, and the whole scene is drawn with one indirect draw per alpha mode
+* For comparison, the scene can also be drawn the classic way with one draw per primitive, binding the node's descriptor set and the material for each draw
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "frustum.hpp"
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	vkglTF::Model scene;
+
+	// Draw the scene with the GPU-driven path instead of one draw per primitive
+	bool gpuDriven{ false };
+	bool frustumCulling{ true };
+	bool fixedFrustum{ false };
+	// Set if vkCmdDrawIndexedIndirectCount is available, visible draws are compacted then
+	bool drawIndirectCount{ false };
+	// Number of draw commands recorded in the last frame
+	uint32_t recordedDraws{ 0 };
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 model;
+	} uniformData;
+	std::array<vks::Buffer, maxConcurrentFrames> uniformBuffers;
+
+	// Base color of each material, indexed with the material index of the per-draw data
+	vks::Buffer materialsBuffer;
+
+	struct {
+		VkPipeline classic{ VK_NULL_HANDLE };
+		VkPipeline gpuDriven{ VK_NULL_HANDLE };
+	} pipelines;
+	struct {
+		VkPipelineLayout classic{ VK_NULL_HANDLE };
+		VkPipelineLayout gpuDriven{ VK_NULL_HANDLE };
+	} pipelineLayouts;
+	struct {
+		VkDescriptorSetLayout scene{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout gpuDriven{ VK_NULL_HANDLE };
+	} descriptorSetLayouts;
+	std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
+	VkDescriptorSet gpuDrivenDescriptorSet{ VK_NULL_HANDLE };
+
+	vks::Frustum frustum;
+
+	VulkanExample() : VulkanExampleBase()
+	{
+		title = "GPU-driven glTF rendering";
+		camera.type = Camera::CameraType::lookat;
+		camera.setPerspective(45.0f, (float)width / (float)height, 0.1f, 512.0f);
+		camera.setRotation(glm::vec3(-2.25f, -52.0f, 0.0f));
+		camera.setTranslation(glm::vec3(1.9f, -2.05f, -18.0f));
+		camera.rotationSpeed *= 0.25f;
+		// The path can be selected on the command line, so both can be benchmarked
+		gpuDriven = settings.gpuDriven;
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipelines.classic, nullptr);
+			vkDestroyPipeline(device, pipelines.gpuDriven, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.classic, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayouts.gpuDriven, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.scene, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gpuDriven, nullptr);
+			for (auto& buffer : uniformBuffers) {
+				buffer.destroy();
+			}
+			materialsBuffer.destroy();
+		}
+	}
+
+	virtual void getEnabledFeatures()
+	{
+		// Without multi draw indirect, the model class issues one indirect draw per command
+		if (deviceFeatures.multiDrawIndirect) {
+			enabledFeatures.multiDrawIndirect = VK_TRUE;
+		}
+		// The draw index is passed to the shaders as the first instance
+		if (deviceFeatures.drawIndirectFirstInstance) {
+			enabledFeatures.drawIndirectFirstInstance = VK_TRUE;
+		} else {
+			vks::tools::exitFatal("Selected GPU does not support drawIndirectFirstInstance!", VK_ERROR_FEATURE_NOT_PRESENT);
+		}
+	}
+
+	virtual void getEnabledExtensions()
+	{
+		// Draw indirect count is optional, without it culled draws are kept with an instance count of zero
+		if (vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+			enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			drawIndirectCount = true;
+		}
+	}
+
+	// Classic path: one draw per primitive with the node's matrix selected by dynamic offset and the material passed as a push constant
+	void drawNode(vkglTF::Node* node, VkCommandBuffer commandBuffer)
+	{
+		if (node->mesh) {
+			scene.bindNodeMatrices(commandBuffer, pipelineLayouts.classic, 1, node, currentBuffer);
+			for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+				vkCmdPushConstants(commandBuffer, pipelineLayouts.classic, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec4), &primitive->material.baseColorFactor);
+				vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+				recordedDraws++;
+			}
+		}
+		for (auto child : node->children) {
+			drawNode(child, commandBuffer);
+		}
+	}
+
+	void loadAssets()
+	{
+		// Flattens the primitives into indirect draw commands at load time
+		scene.loadFromFile(getAssetPath() + "models/gltf/glTF-Embedded/Buggy.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::PrepareIndirectDraws);
+	}
+
+	void prepareMaterials()
+	{
+		std::vector<glm::vec4> baseColorFactors(scene.materials.size());
+		for (size_t i = 0; i < scene.materials.size(); i++) {
+			baseColorFactors[i] = scene.materials[i].baseColorFactor;
+		}
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &materialsBuffer, baseColorFactors.size() * sizeof(glm::vec4), baseColorFactors.data()));
+	}
+
+	void setupDescriptors()
+	{
+		// Pool
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames + 1);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorPool));
+
+		// Layouts
+		// Scene matrices
+		VkDescriptorSetLayoutBinding setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.scene));
+		// Per-draw data, node matrices and materials of the GPU-driven path
+		// The node matrices are selected per frame with a dynamic offset
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 2),
+		};
+		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutCI, nullptr, &descriptorSetLayouts.gpuDriven));
+
+		// Sets per frame, just like the buffers themselves
+		for (size_t i = 0; i < uniformBuffers.size(); i++) {
+			VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.scene, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSets[i]));
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[i].descriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+
+		// The buffers of the GPU-driven path are owned by the model
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.gpuDriven, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &gpuDrivenDescriptorSet));
+		VkDescriptorBufferInfo nodeMatricesDescriptor{ scene.nodeMatrices.buffer.buffer, 0, scene.nodeMatrices.frameSize };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(gpuDrivenDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &scene.indirect.drawData.descriptor),
+			vks::initializers::writeDescriptorSet(gpuDrivenDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, &nodeMatricesDescriptor),
+			vks::initializers::writeDescriptorSet(gpuDrivenDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &materialsBuffer.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void preparePipelines()
+	{
+		// Layouts
+		// Classic path: Scene matrices, node matrix from the model's per-mesh uniform buffer and base color as a push constant
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayouts.scene, vkglTF::descriptorSetLayoutUbo };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::vec4), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.classic));
+		// GPU-driven path: Scene matrices and the storage buffers that are indexed per draw
+		setLayouts = { descriptorSetLayouts.scene, descriptorSetLayouts.gpuDriven };
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayouts.gpuDriven));
+
+		// Pipelines
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables, 0);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.classic, renderPass, 0);
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineCI.pStages = shaderStages.data();
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal });
+
+		shaderStages[0] = loadShader(getShadersPath() + "gltfgpudriven/classic.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "gltfgpudriven/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.classic));
+
+		pipelineCI.layout = pipelineLayouts.gpuDriven;
+		shaderStages[0] = loadShader(getShadersPath() + "gltfgpudriven/gpudriven.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.gpuDriven));
+
+		// The culling pipeline is created by the model, the shader is shared by all samples using the GPU-driven path
+		scene.prepareIndirectCulling(loadShader(getShadersPath() + "base/gltfcull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT), pipelineCache, drawIndirectCount);
+	}
+
+	void prepareUniformBuffers()
+	{
+		for (auto& buffer : uniformBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(UniformData)));
+			VK_CHECK_RESULT(buffer.map());
+		}
+	}
+
+	void updateUniformBuffers()
+	{
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = glm::scale(camera.matrices.view, glm::vec3(0.1f, -0.1f, 0.1f));
+		uniformData.model = glm::translate(glm::mat4(1.0f), scene.dimensions.min);
+		// The model's transforms map to model space, so the frustum planes need to be in model space too
+		if (!fixedFrustum) {
+			frustum.update(uniformData.projection * uniformData.view * uniformData.model);
+		}
+		memcpy(uniformBuffers[currentBuffer].mapped, &uniformData, sizeof(UniformData));
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareMaterials();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		prepared = true;
+	}
+
+	void buildCommandBuffer()
+	{
+		VkCommandBuffer cmdBuffer = drawCmdBuffers[currentBuffer];
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2]{};
+		clearValues[0].color = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentImageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+		// The culling pass has to be recorded outside of the render pass
+		if (gpuDriven && frustumCulling) {
+			scene.cullIndirectDraws(cmdBuffer, frustum.planes, currentBuffer);
+		}
+
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		recordedDraws = 0;
+		scene.bindBuffers(cmdBuffer);
+		if (gpuDriven) {
+			// The whole scene is drawn with one indirect draw per alpha mode
+			const std::array<VkDescriptorSet, 2> sets = { descriptorSets[currentBuffer], gpuDrivenDescriptorSet };
+			const uint32_t nodeMatricesOffset = static_cast<uint32_t>(scene.nodeMatrices.frameOffset(currentBuffer));
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.gpuDriven, 0, static_cast<uint32_t>(sets.size()), sets.data(), 1, &nodeMatricesOffset);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.gpuDriven);
+			scene.drawIndirect(cmdBuffer, 0, frustumCulling);
+			for (auto& range : scene.indirect.ranges) {
+				recordedDraws += (range.count > 0) ? 1 : 0;
+			}
+		} else {
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.classic, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.classic);
+			for (auto node : scene.nodes) {
+				drawNode(node, cmdBuffer);
+			}
+		}
+
+		drawUI(cmdBuffer);
+		vkCmdEndRenderPass(cmdBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		VulkanExampleBase::prepareFrame();
+		updateUniformBuffers();
+		// Only writes the frame's node matrices if they changed
+		scene.updateNodeBuffer(currentBuffer);
+		buildCommandBuffer();
+		VulkanExampleBase::submitFrame();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("GPU-driven", &gpuDriven);
+			if (gpuDriven) {
+				overlay->checkBox("Frustum culling", &frustumCulling);
+				overlay->checkBox("Freeze frustum", &fixedFrustum);
+			}
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Primitives: %d", scene.indirect.drawCount);
+			overlay->text("Draw commands: %d", recordedDraws);
+			if (gpuDriven) {
+				overlay->text(drawIndirectCount ? "Visible draws compacted" : "Culled draws with zero instances");
+			}
+		}
+	}
+
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -0,0 +1,329 @@
+/*
+* Vulkan Example - Compute shader skinning for glTF models
+*
+* Renders many animated glTF models over several passes (depth passes as used for shadows or a depth prepass, followed by the main pass)
+* With vertex shader skinning, every pass that draws a model repeats the skinning work for each of its vertices
+* With compute shader skinning, the glTF model class skins all vertices once per frame in a compute pre-pass, and all passes draw the pre-skinned vertices with the same shaders as static meshes
+*
+* Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+
+class VulkanExample : public VulkanExampleBase
+{
+public:
+	// Each instance is a separate model, so each can have its own animation state and skinned vertices
+	static constexpr uint32_t maxInstanceCount{ 64 };
+	std::vector<std::unique_ptr<vkglTF::Model>> instances;
+	int32_t instanceCount{ maxInstanceCount };
+	// Number of depth-only passes over all instances before the main pass
+	int32_t depthPassCount{ 2 };
+	bool computeSkinning{ true };
+	bool animate{ true };
+	float animationTime{ 0.0f };
+
+	struct UniformData {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::vec4 lightPos{ 5.0f, -10.0f, 5.0f, 1.0f };
+	} uniformData;
+	std::array<vks::Buffer, maxConcurrentFrames> uniformBuffers;
+
+	// Per-instance data, passed as push constants
+	struct PushConstants {
+		glm::vec4 offset;
+		glm::vec4 color;
+		uint32_t jointMatrixIndex;
+	};
+
+	struct Pipelines {
+		// Draw pre-skinned (or static) vertices
+		VkPipeline depth{ VK_NULL_HANDLE };
+		VkPipeline scene{ VK_NULL_HANDLE };
+		// Skin in the vertex shader
+		VkPipeline depthSkinned{ VK_NULL_HANDLE };
+		VkPipeline sceneSkinned{ VK_NULL_HANDLE };
+	} pipelines;
+	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
+	std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
+
+	VulkanExample() : VulkanExampleBase()
+	{
+		title = "Compute shader skinning";
+		camera.type = Camera::CameraType::lookat;
+		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
+		camera.setRotation(glm::vec3(-25.0f, 15.0f, 0.0f));
+		camera.setTranslation(glm::vec3(0.0f, 1.0f, -16.0f));
+		computeSkinning = settings.computeSkinning;
+		// The skinning pass reads the model's vertex buffers, which also keeps the default vertex layout
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	}
+
+	~VulkanExample()
+	{
+		if (device) {
+			vkDestroyPipeline(device, pipelines.depth, nullptr);
+			vkDestroyPipeline(device, pipelines.scene, nullptr);
+			vkDestroyPipeline(device, pipelines.depthSkinned, nullptr);
+			vkDestroyPipeline(device, pipelines.sceneSkinned, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+			for (auto& buffer : uniformBuffers) {
+				buffer.destroy();
+			}
+			instances.clear();
+		}
+	}
+
+	void loadAssets()
+	{
+		// All instances are loaded in parallel
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PrepareGpuSkinning | vkglTF::FileLoadingFlags::DontLoadImages | vkglTF::FileLoadingFlags::FlipY;
+		for (uint32_t i = 0; i < maxInstanceCount; i++) {
+			instances.push_back(std::make_unique<vkglTF::Model>());
+			instances.back()->loadFromFileAsync(getAssetPath() + "models/CesiumMan/glTF/CesiumMan.gltf", vulkanDevice, queue, glTFLoadingFlags);
+		}
+		for (auto& instance : instances) {
+			instance->updateLoading(true);
+		}
+	}
+
+	void setupDescriptors()
+	{
+		// Pool
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+		// Layout
+		VkDescriptorSetLayoutBinding setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+		// Sets per frame, just like the buffers themselves
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+		for (size_t i = 0; i < uniformBuffers.size(); i++) {
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets[i]));
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[i].descriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+	}
+
+	void preparePipelines()
+	{
+		// Layout
+		// Set 0: Scene matrices, set 1: Node and joint matrices of the glTF model
+		std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, vkglTF::descriptorSetLayoutUbo };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstants), 0);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+		// Pipelines
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+		VkPipelineRasterizationStateCreateInfo rasterizationStateCI = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+		VkPipelineColorBlendStateCreateInfo colorBlendStateCI = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+		VkPipelineDepthStencilStateCreateInfo depthStencilStateCI = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+		VkPipelineViewportStateCreateInfo viewportStateCI = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+		VkPipelineMultisampleStateCreateInfo multisampleStateCI = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+		const std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables, 0);
+		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPass, 0);
+		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
+		pipelineCI.pRasterizationState = &rasterizationStateCI;
+		pipelineCI.pColorBlendState = &colorBlendStateCI;
+		pipelineCI.pMultisampleState = &multisampleStateCI;
+		pipelineCI.pViewportState = &viewportStateCI;
+		pipelineCI.pDepthStencilState = &depthStencilStateCI;
+		pipelineCI.pDynamicState = &dynamicStateCI;
+		pipelineCI.pStages = shaderStages.data();
+
+		// Pre-skinned vertices only need position and normal
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal });
+		shaderStages[0] = loadShader(getShadersPath() + "gltfgpuskinning/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "gltfgpuskinning/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		pipelineCI.stageCount = 2;
+		blendAttachmentState.colorWriteMask = 0xf;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.scene));
+		// Depth passes only run the vertex shader
+		pipelineCI.stageCount = 1;
+		blendAttachmentState.colorWriteMask = 0;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.depth));
+
+		// Skinning in the vertex shader also needs the joints and weights
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Joint0, vkglTF::VertexComponent::Weight0 });
+		shaderStages[0] = loadShader(getShadersPath() + "gltfgpuskinning/skinned.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		pipelineCI.stageCount = 2;
+		blendAttachmentState.colorWriteMask = 0xf;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.sceneSkinned));
+		pipelineCI.stageCount = 1;
+		blendAttachmentState.colorWriteMask = 0;
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.depthSkinned));
+
+		// The skinning pass is created by the model, the shader is shared by all samples using compute skinning
+		VkPipelineShaderStageCreateInfo skinningShaderStage = loadShader(getShadersPath() + "base/gltfskinning.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		for (auto& instance : instances) {
+			instance->prepareSkinning(skinningShaderStage, pipelineCache);
+		}
+	}
+
+	void prepareUniformBuffers()
+	{
+		for (auto& buffer : uniformBuffers) {
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, sizeof(UniformData)));
+			VK_CHECK_RESULT(buffer.map());
+		}
+	}
+
+	void updateUniformBuffers()
+	{
+		uniformData.projection = camera.matrices.perspective;
+		uniformData.view = camera.matrices.view;
+		memcpy(uniformBuffers[currentBuffer].mapped, &uniformData, sizeof(UniformData));
+	}
+
+	void updateAnimations()
+	{
+		if (animate && !paused) {
+			animationTime += frameTimer;
+		}
+		for (int32_t i = 0; i < instanceCount; i++) {
+			vkglTF::Model& model = *instances[i];
+			if (!model.animations.empty()) {
+				// Offset each instance's animation, so they don't all move in sync
+				const vkglTF::Animation& animation = model.animations[0];
+				const float duration = std::max(animation.end - animation.start, 0.001f);
+				model.updateAnimation(0, animation.start + fmod(animationTime + i * 0.137f, duration));
+			}
+			model.updateNodeBuffer(currentBuffer);
+		}
+	}
+
+	void prepare()
+	{
+		VulkanExampleBase::prepare();
+		loadAssets();
+		prepareUniformBuffers();
+		setupDescriptors();
+		preparePipelines();
+		prepared = true;
+	}
+
+	// Draws all instances once, the skinned mesh's vertices are either read pre-skinned or skinned by the vertex shader
+	void drawInstances(VkCommandBuffer commandBuffer)
+	{
+		const int32_t gridSize = static_cast<int32_t>(ceil(sqrt(static_cast<float>(instanceCount))));
+		for (int32_t i = 0; i < instanceCount; i++) {
+			vkglTF::Model& model = *instances[i];
+			model.bindBuffers(commandBuffer);
+			PushConstants pushConstants{};
+			pushConstants.offset = glm::vec4((i % gridSize - (gridSize - 1) * 0.5f) * 1.5f, 0.0f, (i / gridSize - (gridSize - 1) * 0.5f) * 1.5f, 0.0f);
+			pushConstants.color = glm::vec4(0.5f + 0.5f * sin(i * 1.3f), 0.5f + 0.5f * sin(i * 2.1f + 1.0f), 0.5f + 0.5f * sin(i * 0.7f + 2.0f), 1.0f);
+			for (uint32_t nodeIndex : model.nodeHierarchy.meshNodes) {
+				vkglTF::Node* node = model.nodeHierarchy.nodes[nodeIndex];
+				const bool preSkinned = computeSkinning && node->mesh->gpuSkinned;
+				model.bindNodeMatrices(commandBuffer, pipelineLayout, 1, node, currentBuffer);
+				pushConstants.jointMatrixIndex = node->mesh->jointMatrixIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstants), &pushConstants);
+				if (preSkinned) {
+					model.bindSkinnedVertices(commandBuffer, currentBuffer);
+				}
+				for (vkglTF::Primitive* primitive : node->mesh->primitives) {
+					vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, preSkinned ? node->mesh->skinnedVertexOffset : 0, 0);
+				}
+				if (preSkinned) {
+					model.bindBuffers(commandBuffer);
+				}
+			}
+		}
+	}
+
+	void buildCommandBuffer()
+	{
+		VkCommandBuffer cmdBuffer = drawCmdBuffers[currentBuffer];
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		VkClearValue clearValues[2]{};
+		clearValues[0].color = defaultClearColor;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.offset.x = 0;
+		renderPassBeginInfo.renderArea.offset.y = 0;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+		renderPassBeginInfo.framebuffer = frameBuffers[currentImageIndex];
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+
+		// Skin all instances once, this has to be recorded outside of the render pass
+		if (computeSkinning) {
+			for (int32_t i = 0; i < instanceCount; i++) {
+				instances[i]->skinVertices(cmdBuffer, currentBuffer);
+			}
+		}
+
+		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
+
+		// Depth passes stand in for shadow map or depth prepasses, which would draw the same skinned meshes
+		for (int32_t pass = 0; pass < depthPassCount; pass++) {
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, computeSkinning ? pipelines.depth : pipelines.depthSkinned);
+			drawInstances(cmdBuffer);
+		}
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, computeSkinning ? pipelines.scene : pipelines.sceneSkinned);
+		drawInstances(cmdBuffer);
+
+		drawUI(cmdBuffer);
+		vkCmdEndRenderPass(cmdBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+	}
+
+	virtual void render()
+	{
+		if (!prepared)
+			return;
+		VulkanExampleBase::prepareFrame();
+		updateUniformBuffers();
+		updateAnimations();
+		buildCommandBuffer();
+		VulkanExampleBase::submitFrame();
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->checkBox("Compute shader skinning", &computeSkinning);
+			overlay->checkBox("Animate", &animate);
+			overlay->sliderInt("Instances", &instanceCount, 1, maxInstanceCount);
+			overlay->sliderInt("Depth passes", &depthPassCount, 0, 4);
+		}
+		if (overlay->header("Statistics")) {
+			uint32_t skinnedVertices = 0;
+			for (int32_t i = 0; i < instanceCount; i++) {
+				skinnedVertices += instances[i]->skinning.vertexCount;
+			}
+			// Vertex shader skinning repeats the work in every pass (ignoring post-transform cache hits)
+			overlay->text("Skinned vertices: %d", computeSkinning ? skinnedVertices : skinnedVertices * (depthPassCount + 1));
+		}
+	}
+};
+
+VULKAN_EXAMPLE_MAIN()
@@ -199,7 +199,7 @@ public:
 		// The instancing pipeline uses a vertex input state with two bindings
 		bindingDescriptions = {
 			// Binding point 0: Mesh vertex layout description at per-vertex rate
-			vks::initializers::vertexInputBindingDescription(0, sizeof(vkglTF::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+			vkglTF::Vertex::inputBindingDescription(0),
 			// Binding point 1: Instanced data at per-instance rate
 			vks::initializers::vertexInputBindingDescription(1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE)
 		};
@@ -213,10 +213,10 @@ public:
 		attributeDescriptions = {
 			// Per-vertex attributes
 			// These are advanced for each vertex fetched by the vertex shader
-			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),					// Location 0: Position
-			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 3),	// Location 1: Normal
-			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 6),		// Location 2: Texture coordinates
-			vks::initializers::vertexInputAttributeDescription(0, 3, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * 8),	// Location 3: Color
+			vkglTF::Vertex::inputAttributeDescription(0, 0, vkglTF::VertexComponent::Position),	// Location 0: Position
+			vkglTF::Vertex::inputAttributeDescription(0, 1, vkglTF::VertexComponent::Normal),	// Location 1: Normal
+			vkglTF::Vertex::inputAttributeDescription(0, 2, vkglTF::VertexComponent::UV),		// Location 2: Texture coordinates
+			vkglTF::Vertex::inputAttributeDescription(0, 3, vkglTF::VertexComponent::Color),	// Location 3: Color
 			// Per-Instance attributes
 			// These are advanced for each instance rendered
 			vks::initializers::vertexInputAttributeDescription(1, 4, VK_FORMAT_R32G32B32_SFLOAT, 0),					// Location 4: Position
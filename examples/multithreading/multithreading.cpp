@@ -8,7 +8,7 @@
 
 #include "vulkanexamplebase.h"
 
-#include "threadpool.hpp"
+#include "jobsystem.hpp"
 #include "frustum.hpp"
 
 #include "VulkanglTFModel.h"
@@ -44,12 +44,23 @@ public:
 
 	// Number of animated objects to be renderer
 	// by using threads and secondary command buffers
-	uint32_t numObjectsPerThread{ 0 };
+	static constexpr uint32_t numObjects{ 512 };
 
 	// Multi threaded stuff
-	// Max. number of concurrent threads
+	// Number of threads recording command buffers (the job system's workers plus the main thread, which helps while waiting)
 	uint32_t numThreads{ 0 };
 
+	// How the objects are distributed across the threads
+	enum class Scheduling : int32_t {
+		// Objects are split into small ranges, idle threads steal ranges from busy ones
+		WorkStealing = 0,
+		// One fixed range of objects per thread, like the former thread pool with pre-partitioned per-thread queues
+		StaticPartition = 1,
+	};
+	int32_t scheduling{ static_cast<int32_t>(Scheduling::WorkStealing) };
+	// CPU time spent recording the object command buffers, averaged over the last frames for comparing the scheduling modes
+	float recordTime{ 0.0f };
+
 	// Use push constants to update shader
 	// parameters on a per-thread base
 	struct ThreadPushConstantBlock {
@@ -69,21 +80,37 @@ public:
 		bool visible = true;
 	};
 
+	// Objects can be recorded by any thread, so command pools and buffers are owned by threads instead of objects
 	struct ThreadData {
-		VkCommandPool commandPool{ VK_NULL_HANDLE };
-		// One command buffer per render object per max. frames in flight
+		// Command pools need to be per thread and per max. frames in flight, so they can be reset once the frame's fence has been signalled
+		std::array<VkCommandPool, maxConcurrentFrames> commandPool{};
+		// Secondary command buffers allocated from the above pools, these are reused in later frames
 		std::array<std::vector<VkCommandBuffer>, maxConcurrentFrames> commandBuffer;
-		// One push constant block per render object
-		std::vector<ThreadPushConstantBlock> pushConstBlock;
-		// Per object information (position, rotation, etc.)
-		std::vector<ObjectData> objectData;
+		// Number of command buffers handed out in the current frame
+		std::array<uint32_t, maxConcurrentFrames> usedCommandBuffers{};
 	};
 	std::vector<ThreadData> threadData;
 
-	vks::ThreadPool threadPool;
+	// One push constant block per render object
+	std::vector<ThreadPushConstantBlock> pushConstBlock;
+	// Per object information (position, rotation, etc.)
+	std::vector<ObjectData> objectData;
+	// Secondary command buffer recorded for each object per max. frames in flight
+	std::array<std::vector<VkCommandBuffer>, maxConcurrentFrames> objectCommandBuffers;
+
+	vks::JobSystem jobSystem;
 
 	// View frustum for culling invisible objects
 	vks::Frustum frustum;
+	// Bounding spheres of all objects, these are culled in one batch before the command buffers are recorded
+	vks::Frustum::SphereList objectBounds;
+	// One visibility bit per object
+	std::vector<uint32_t> objectVisibility;
+	// Culling throughput for different object counts, measured on request from the UI
+	std::vector<std::string> cullingBenchmarkResults;
+	// Animated model for the animation benchmark, only loaded when the benchmark is run
+	std::unique_ptr<vkglTF::Model> animatedModel;
+	std::vector<std::string> animationBenchmarkResults;
 
 	std::default_random_engine rndEngine;
 
@@ -95,16 +122,13 @@ public:
 		camera.setRotation(glm::vec3(0.0f));
 		camera.setRotationSpeed(0.5f);
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
-		// Get number of max. concurrent threads
-		numThreads = std::thread::hardware_concurrency();
-		assert(numThreads > 0);
+		// The job system uses one worker less than the number of hardware threads, the main thread helps executing jobs while it waits
+		numThreads = jobSystem.workerCount() + 1;
 #if defined(__ANDROID__)
 		LOGD("numThreads = %d", numThreads);
 #else
 		std::cout << "numThreads = " << numThreads << std::endl;
 #endif
-		threadPool.setThreadCount(numThreads);
-		numObjectsPerThread = 512 / numThreads;
 		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
 	}
 
@@ -115,10 +139,12 @@ public:
 			vkDestroyPipeline(device, pipelines.starsphere, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			for (auto& thread : threadData) {
-				for (auto& cmdBuffers : thread.commandBuffer) {
-					vkFreeCommandBuffers(device, thread.commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+				for (uint32_t i = 0; i < maxConcurrentFrames; i++) {
+					if (!thread.commandBuffer[i].empty()) {
+						vkFreeCommandBuffers(device, thread.commandPool[i], static_cast<uint32_t>(thread.commandBuffer[i].size()), thread.commandBuffer[i].data());
+					}
+					vkDestroyCommandPool(device, thread.commandPool[i], nullptr);
 				}
-				vkDestroyCommandPool(device, thread.commandPool, nullptr);
 			}
 		}
 	}
@@ -129,7 +155,7 @@ public:
 		return rndDist(rndEngine);
 	}
 
-	// Create all threads and initialize shader push constants
+	// Create per-thread command pools and initialize shader push constants
 	void prepareMultiThreadedRenderer()
 	{
 		// The actual commands are issued in secondary command buffers, this also applies to the background and the user interface
@@ -139,51 +165,61 @@ public:
 			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers[i].ui));
 		}
 
+		// Command pools are only accessed by the thread they belong to, which is identified by the job system's thread index
 		threadData.resize(numThreads);
 
-		for (uint32_t i = 0; i < numThreads; i++) {
-			ThreadData *thread = &threadData[i];
-
-			// Command pools need to be per thread
+		for (auto& thread : threadData) {
 			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
 			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
-			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &thread->commandPool));
-
-			// One secondary command buffer per object that is updated by this thread
-			// We also duplicate the command buffers per max. frames in flight
-			for (auto& commandBuffers : thread->commandBuffer) {
-				commandBuffers.resize(numObjectsPerThread);
-				// Generate secondary command buffers for each thread
-				VkCommandBufferAllocateInfo secondaryCmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(thread->commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, static_cast<uint32_t>(commandBuffers.size()));
-				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &secondaryCmdBufAllocateInfo, commandBuffers.data()));
+			for (auto& commandPool : thread.commandPool) {
+				VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
 			}
+		}
 
-			thread->pushConstBlock.resize(numObjectsPerThread);
-			thread->objectData.resize(numObjectsPerThread);
-
-			for (uint32_t j = 0; j < numObjectsPerThread; j++) {
-				float theta = 2.0f * float(M_PI) * rnd(1.0f);
-				float phi = acos(1.0f - 2.0f * rnd(1.0f));
-				thread->objectData[j].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
-				thread->objectData[j].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
-				thread->objectData[j].deltaT = rnd(1.0f);
-				thread->objectData[j].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
-				thread->objectData[j].rotationSpeed = (2.0f + rnd(4.0f)) * thread->objectData[j].rotationDir;
-				thread->objectData[j].scale = 0.75f + rnd(0.5f);
-				thread->pushConstBlock[j].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
-			}
+		pushConstBlock.resize(numObjects);
+		objectData.resize(numObjects);
+		for (auto& commandBuffers : objectCommandBuffers) {
+			commandBuffers.resize(numObjects, VK_NULL_HANDLE);
+		}
+
+		for (uint32_t i = 0; i < numObjects; i++) {
+			float theta = 2.0f * float(M_PI) * rnd(1.0f);
+			float phi = acos(1.0f - 2.0f * rnd(1.0f));
+			objectData[i].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * 35.0f;
+			objectData[i].rotation = glm::vec3(0.0f, rnd(360.0f), 0.0f);
+			objectData[i].deltaT = rnd(1.0f);
+			objectData[i].rotationDir = (rnd(100.0f) < 50.0f) ? 1.0f : -1.0f;
+			objectData[i].rotationSpeed = (2.0f + rnd(4.0f)) * objectData[i].rotationDir;
+			objectData[i].scale = 0.75f + rnd(0.5f);
+			pushConstBlock[i].color = glm::vec3(rnd(1.0f), rnd(1.0f), rnd(1.0f));
+			// Simple sphere check based on the radius of the mesh
+			objectBounds.add(objectData[i].pos, models.ufo.dimensions.radius * 0.5f);
+		}
+	}
+
+	// Returns an unused secondary command buffer from the calling thread's pool for the current frame
+	VkCommandBuffer getThreadCommandBuffer()
+	{
+		ThreadData& thread = threadData[jobSystem.threadIndex()];
+		std::vector<VkCommandBuffer>& commandBuffers = thread.commandBuffer[currentBuffer];
+		uint32_t& used = thread.usedCommandBuffers[currentBuffer];
+		if (used == commandBuffers.size()) {
+			VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(thread.commandPool[currentBuffer], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &commandBuffer));
+			commandBuffers.push_back(commandBuffer);
 		}
+		return commandBuffers[used++];
 	}
 
-	// Builds the secondary command buffer for each thread
-	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	// Builds the secondary command buffer for a single object, called from any of the job system's threads
+	void renderObject(uint32_t objectIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo)
 	{
-		ThreadData *thread = &threadData[threadIndex];
-		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
+		ObjectData *objectData = &this->objectData[objectIndex];
+		objectCommandBuffers[currentBuffer][objectIndex] = VK_NULL_HANDLE;
 
-		// Check visibility against view frustum using a simple sphere check based on the radius of the mesh
-		objectData->visible = frustum.checkSphere(objectData->pos, models.ufo.dimensions.radius * 0.5f);
+		// Visibility has been determined for all objects at once before recording started
+		objectData->visible = (objectVisibility[objectIndex / 32] >> (objectIndex % 32)) & 1;
 
 		if (!objectData->visible)
 		{
@@ -194,7 +230,8 @@ public:
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
 		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		VkCommandBuffer cmdBuffer = thread->commandBuffer[currentBuffer][cmdBufferIndex];
+		VkCommandBuffer cmdBuffer = getThreadCommandBuffer();
+		objectCommandBuffers[currentBuffer][objectIndex] = cmdBuffer;
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &commandBufferBeginInfo));
 
@@ -216,6 +253,7 @@ public:
 			if (objectData->deltaT > 1.0f)
 				objectData->deltaT -= 1.0f;
 			objectData->pos.y = sin(glm::radians(objectData->deltaT * 360.0f)) * 2.5f;
+			objectBounds.y[objectIndex] = objectData->pos.y;
 		}
 
 		objectData->model = glm::translate(glm::mat4(1.0f), objectData->pos);
@@ -224,7 +262,7 @@ public:
 		objectData->model = glm::rotate(objectData->model, glm::radians(objectData->deltaT * 360.0f), glm::vec3(0.0f, objectData->rotationDir, 0.0f));
 		objectData->model = glm::scale(objectData->model, glm::vec3(objectData->scale));
 
-		thread->pushConstBlock[cmdBufferIndex].mvp = matrices.projection * matrices.view * objectData->model;
+		pushConstBlock[objectIndex].mvp = matrices.projection * matrices.view * objectData->model;
 
 		// Update shader push constant block
 		// Contains model view matrix
@@ -234,7 +272,7 @@ public:
 			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(ThreadPushConstantBlock),
-			&thread->pushConstBlock[cmdBufferIndex]);
+			&pushConstBlock[objectIndex]);
 
 		VkDeviceSize offsets[1] = { 0 };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &models.ufo.vertices.buffer, offsets);
@@ -372,7 +410,7 @@ public:
 		prepared = true;
 	}
 
-	// Updates the secondary command buffers using a thread pool
+	// Updates the secondary command buffers using the job system
 	// and puts them into the primary command buffer that's
 	// lat submitted to the queue for rendering
 	void updateCommandBuffer()
@@ -417,21 +455,45 @@ public:
 			commandBuffers.push_back(secondaryCommandBuffers[currentBuffer].background);
 		}
 
-		// Add a job to the thread's queue for each object to be rendered
-		for (uint32_t t = 0; t < numThreads; t++) {
-			for (uint32_t i = 0; i < numObjectsPerThread; i++) {
-				threadPool.threads[t]->addJob([=, this] { threadRenderCode(t, i, inheritanceInfo); });
+		// The frame's fence has been waited on, so all command buffers allocated from this frame's pools can be reused
+		for (auto& thread : threadData) {
+			VK_CHECK_RESULT(vkResetCommandPool(device, thread.commandPool[currentBuffer], 0));
+			thread.usedCommandBuffers[currentBuffer] = 0;
+		}
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		// Check visibility of all objects against the view frustum
+		frustum.checkSpheres(objectBounds, objectVisibility);
+
+		auto renderObjects = [this, &inheritanceInfo](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				renderObject(i, inheritanceInfo);
+			}
+		};
+		if (static_cast<Scheduling>(scheduling) == Scheduling::WorkStealing) {
+			// Let the job system pick the range size, threads that run out of work steal ranges from other threads
+			jobSystem.parallelFor(numObjects, renderObjects);
+		} else {
+			// Fixed partitioning with one range per thread, a thread with more expensive objects holds up the whole frame
+			vks::JobCounter counter;
+			const uint32_t objectsPerThread = (numObjects + numThreads - 1) / numThreads;
+			for (uint32_t t = 0; t < numThreads; t++) {
+				const uint32_t begin = std::min(t * objectsPerThread, numObjects);
+				const uint32_t end = std::min(begin + objectsPerThread, numObjects);
+				jobSystem.run([&renderObjects, begin, end] { renderObjects(begin, end); }, &counter);
 			}
+			jobSystem.wait(counter);
 		}
 
-		threadPool.wait();
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		const float tDiff = std::chrono::duration<float, std::milli>(tEnd - tStart).count();
+		recordTime = (recordTime == 0.0f) ? tDiff : glm::mix(recordTime, tDiff, 0.05f);
 
 		// Only submit if object is within the current view frustum
-		for (uint32_t t = 0; t < numThreads; t++) {
-			for (uint32_t i = 0; i < numObjectsPerThread; i++) {
-				if (threadData[t].objectData[i].visible) {
-					commandBuffers.push_back(threadData[t].commandBuffer[currentBuffer][i]);
-				}
+		for (uint32_t i = 0; i < numObjects; i++) {
+			if (objectData[i].visible) {
+				commandBuffers.push_back(objectCommandBuffers[currentBuffer][i]);
 			}
 		}
 
@@ -459,13 +521,132 @@ public:
 		VulkanExampleBase::submitFrame();
 	}
 
+	// Compares the throughput of testing spheres one by one with the batched (SIMD) test for increasing object counts
+	void runCullingBenchmark()
+	{
+		cullingBenchmarkResults.clear();
+		for (size_t count : { 10000, 100000, 1000000 }) {
+			vks::Frustum::SphereList spheres;
+			for (size_t i = 0; i < count; i++) {
+				spheres.add(glm::vec3(rnd(200.0f) - 100.0f, rnd(200.0f) - 100.0f, rnd(200.0f) - 100.0f), rnd(2.5f));
+			}
+			std::vector<uint32_t> visibility;
+			uint32_t visibleCount{ 0 };
+			// Best of several runs to reduce noise
+			double tScalar{ std::numeric_limits<double>::max() };
+			double tBatched{ std::numeric_limits<double>::max() };
+			for (uint32_t run = 0; run < 5; run++) {
+				auto tStart = std::chrono::high_resolution_clock::now();
+				visibleCount = 0;
+				for (size_t i = 0; i < count; i++) {
+					visibleCount += frustum.checkSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]) ? 1 : 0;
+				}
+				tScalar = std::min(tScalar, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+				tStart = std::chrono::high_resolution_clock::now();
+				frustum.checkSpheres(spheres, visibility);
+				tBatched = std::min(tBatched, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+			}
+			char result[128];
+			snprintf(result, sizeof(result), "%zu: %.1f / %.1f M/s (%u visible)", count, count / tScalar / 1000.0, count / tBatched / 1000.0, visibleCount);
+			cullingBenchmarkResults.push_back(result);
+			std::cout << "Culling " << result << "\n";
+		}
+	}
+
+	// Compares playing back, seeking and playing back in parallel for increasing numbers of animated instances sharing one model
+	void runAnimationBenchmark()
+	{
+		if (!animatedModel) {
+			animatedModel = std::make_unique<vkglTF::Model>();
+			animatedModel->loadFromFile(getAssetPath() + "models/CesiumMan/glTF/CesiumMan.gltf", vulkanDevice, queue, vkglTF::FileLoadingFlags::DontLoadImages);
+		}
+		animationBenchmarkResults.clear();
+		if (animatedModel->animations.empty()) {
+			return;
+		}
+		const vkglTF::Animation& animation = animatedModel->animations[0];
+		const float duration = std::max(animation.end - animation.start, 0.001f);
+		auto wrapTime = [&](float time) {
+			return animation.start + fmod(time - animation.start, duration);
+		};
+		auto timeSince = [](std::chrono::high_resolution_clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		};
+		for (size_t count : { 1000, 4000, 16000 }) {
+			std::vector<vkglTF::AnimationState> states(count);
+			for (auto& state : states) {
+				animatedModel->initAnimationState(state);
+				// Two layers of the same clip at different times, so blending is part of the measurement
+				const float time = animation.start + rnd(duration);
+				state.layers = { { 0, time, 0.7f }, { 0, wrapTime(time + duration * 0.5f), 0.3f } };
+			}
+			auto advance = [&]() {
+				for (auto& state : states) {
+					for (auto& layer : state.layers) {
+						layer.time = wrapTime(layer.time + 1.0f / 60.0f);
+					}
+				}
+			};
+			// Best of several runs to reduce noise
+			double tPlayback{ std::numeric_limits<double>::max() };
+			double tSeek{ std::numeric_limits<double>::max() };
+			double tParallel{ std::numeric_limits<double>::max() };
+			for (uint32_t run = 0; run < 5; run++) {
+				advance();
+				auto tStart = std::chrono::high_resolution_clock::now();
+				for (auto& state : states) {
+					animatedModel->evaluateAnimation(state);
+				}
+				tPlayback = std::min(tPlayback, timeSince(tStart));
+				for (auto& state : states) {
+					for (auto& layer : state.layers) {
+						layer.time = animation.start + rnd(duration);
+					}
+				}
+				tStart = std::chrono::high_resolution_clock::now();
+				for (auto& state : states) {
+					animatedModel->evaluateAnimation(state);
+				}
+				tSeek = std::min(tSeek, timeSince(tStart));
+				advance();
+				tStart = std::chrono::high_resolution_clock::now();
+				animatedModel->evaluateAnimations(states);
+				tParallel = std::min(tParallel, timeSince(tStart));
+			}
+			char result[128];
+			snprintf(result, sizeof(result), "%zu: %.2f / %.2f / %.2f ms", count, tPlayback, tSeek, tParallel);
+			animationBenchmarkResults.push_back(result);
+			std::cout << "Animation " << result << "\n";
+		}
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Statistics")) {
 			overlay->text("Active threads: %d", numThreads);
+			overlay->text("Record time: %.3f ms", recordTime);
 		}
 		if (overlay->header("Settings")) {
 			overlay->checkBox("Stars", &displayStarSphere);
+			overlay->comboBox("Scheduling", &scheduling, { "Work stealing", "Static partition" });
+		}
+		if (overlay->header("Culling benchmark")) {
+			overlay->text("Scalar / %s spheres per second", vks::Frustum::instructionSet());
+			if (overlay->button("Run##culling")) {
+				runCullingBenchmark();
+			}
+			for (const std::string& result : cullingBenchmarkResults) {
+				overlay->text("%s", result.c_str());
+			}
+		}
+		if (overlay->header("Animation benchmark")) {
+			overlay->text("Playback / seek / parallel per update");
+			if (overlay->button("Run##animation")) {
+				runAnimationBenchmark();
+			}
+			for (const std::string& result : animationBenchmarkResults) {
+				overlay->text("%s", result.c_str());
+			}
 		}
 
 	}
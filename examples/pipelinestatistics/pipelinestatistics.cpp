@@ -34,11 +34,22 @@ public:
 	bool wireframe{ false };
 	bool tessellation{ false };
 
+	// Pipelines for the different settings are compiled in the background by the base class' pipeline compiler, which also owns them
+	// The current pipeline is used for rendering until the variant for the selected settings is ready
 	VkPipeline pipeline{ VK_NULL_HANDLE };
+	vks::PipelineCompiler::Handle pipelineVariant;
 	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
 	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
 	std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
 
+	// Shaders are only loaded once, so requests for the same settings use the same modules and are deduplicated by the pipeline compiler
+	struct Shaders {
+		VkPipelineShaderStageCreateInfo vertex{};
+		VkPipelineShaderStageCreateInfo fragment{};
+		VkPipelineShaderStageCreateInfo tessellationControl{};
+		VkPipelineShaderStageCreateInfo tessellationEvaluation{};
+	} shaders;
+
 	VkQueryPool queryPool{ VK_NULL_HANDLE };
 
 	// Vector for storing pipeline statistics results
@@ -60,7 +71,6 @@ public:
 	~VulkanExample()
 	{
 		if (device) {
-			vkDestroyPipeline(device, pipeline, nullptr);
 			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 			vkDestroyQueryPool(device, queryPool, nullptr);
@@ -194,9 +204,13 @@ public:
 		}
 
 		// Pipeline
-		if (pipeline != VK_NULL_HANDLE) {
-			// Destroy old pipeline if we're going to recreate it
-			vkDestroyPipeline(device, pipeline, nullptr);
+		if (shaders.vertex.module == VK_NULL_HANDLE) {
+			shaders.vertex = loadShader(getShadersPath() + "pipelinestatistics/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			shaders.fragment = loadShader(getShadersPath() + "pipelinestatistics/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			if (deviceFeatures.tessellationShader) {
+				shaders.tessellationControl = loadShader(getShadersPath() + "pipelinestatistics/scene.tesc.spv", VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT);
+				shaders.tessellationEvaluation = loadShader(getShadersPath() + "pipelinestatistics/scene.tese.spv", VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT);
+			}
 		}
 
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
@@ -241,22 +255,27 @@ public:
 		}
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages{};
-		shaderStages.push_back(loadShader(getShadersPath() + "pipelinestatistics/scene.vert.spv", VK_SHADER_STAGE_VERTEX_BIT));
+		shaderStages.push_back(shaders.vertex);
 		if (!discard) {
 			// When discard is enabled a pipeline must not contain a fragment shader
-			shaderStages.push_back(loadShader(getShadersPath() + "pipelinestatistics/scene.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT));
+			shaderStages.push_back(shaders.fragment);
 		}
 
 		if (tessellation) {
 			inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
 			pipelineCI.pTessellationState = &tessellationState;
-			shaderStages.push_back(loadShader(getShadersPath() + "pipelinestatistics/scene.tesc.spv", VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT));
-			shaderStages.push_back(loadShader(getShadersPath() + "pipelinestatistics/scene.tese.spv", VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT));
+			shaderStages.push_back(shaders.tessellationControl);
+			shaderStages.push_back(shaders.tessellationEvaluation);
 		}
 
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+		// The create info is copied by the compiler, so it doesn't need to outlive this function
+		pipelineVariant = pipelineCompiler.compile(pipelineCI);
+		if (pipeline == VK_NULL_HANDLE) {
+			// There is nothing to fall back to for the first pipeline
+			pipeline = pipelineCompiler.wait(pipelineVariant);
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -352,6 +371,8 @@ public:
 		if (!prepared)
 			return;
 		VulkanExampleBase::prepareFrame();
+		// Switch to the pipeline for the selected settings once it has been compiled, until then the previous one is used
+		pipeline = pipelineCompiler.get(pipelineVariant, pipeline);
 		updateUniformBuffers();
 		buildCommandBuffer();
 		VulkanExampleBase::submitFrame();
@@ -367,7 +388,7 @@ public:
 				updateUniformBuffers();
 			}
 			overlay->sliderInt("Grid size", &gridSize, 1, 10);
-			// To avoid having to create pipelines for all the settings up front, we recreate a single pipelin with different settings instead
+			// To avoid having to create pipelines for all the settings up front, the pipeline for the selected settings is compiled in the background when they change
 			bool recreatePipeline{ false };
 			std::vector<std::string> cullModeNames = { "None", "Front", "Back", "Back and front" };
 			recreatePipeline |= overlay->comboBox("Cull mode", &cullMode, cullModeNames);
@@ -383,6 +404,9 @@ public:
 			if (recreatePipeline) {
 				preparePipelines();
 			}
+			if (pipelineCompiler.get(pipelineVariant, VK_NULL_HANDLE) == VK_NULL_HANDLE) {
+				overlay->text("Compiling pipeline...");
+			}
 		}
 		if (!pipelineStats.empty()) {
 			if (overlay->header("Pipeline statistics")) {
@@ -416,14 +416,14 @@ public:
 		vertexInputBinding.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT;
 		vertexInputBinding.binding = 0;
 		vertexInputBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		vertexInputBinding.stride = sizeof(vkglTF::Vertex);
+		vertexInputBinding.stride = vkglTF::Vertex::inputBindingDescription(0).stride;
 		vertexInputBinding.divisor = 1;
 
-		std::vector<VkVertexInputAttributeDescription2EXT> vertexAttributes = {
-			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, pos) },
-			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vkglTF::Vertex, normal) },
-			{ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, 2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(vkglTF::Vertex, color) }
-		};
+		// Formats and offsets depend on the vertex layout used by the glTF loader
+		std::vector<VkVertexInputAttributeDescription2EXT> vertexAttributes;
+		for (VkVertexInputAttributeDescription attribute : vkglTF::Vertex::inputAttributeDescriptions(0, { vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::Color })) {
+			vertexAttributes.push_back({ VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT, nullptr, attribute.location, attribute.binding, attribute.format, attribute.offset });
+		}
 
 		vkCmdSetVertexInputEXT(cmdBuffer, 1, &vertexInputBinding, 3, vertexAttributes.data());
 
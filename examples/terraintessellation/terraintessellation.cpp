@@ -345,7 +345,9 @@ public:
 
 		// Upload vertices and indices to device
 
-		uint32_t vertexBufferSize = vertexCount * sizeof(vkglTF::Vertex);
+		// Convert to the layout used by the glTF loader, which the vertex input state is set up for
+		std::vector<uint8_t> vertexData = vkglTF::Vertex::pack(vertices, vertexCount);
+		uint32_t vertexBufferSize = static_cast<uint32_t>(vertexData.size());
 		uint32_t indexBufferSize = terrain.indexCount * sizeof(uint32_t);
 
 		vks::Buffer vertexStaging, indexStaging;
@@ -357,7 +359,7 @@ public:
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&vertexStaging,
 			vertexBufferSize,
-			vertices));
+			vertexData.data()));
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
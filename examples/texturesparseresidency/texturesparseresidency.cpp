@@ -10,6 +10,14 @@
 * Important note : This sample is work-in-progress and works basically, but it's not finished
 */
 
+/*
+* Feedback streaming:
+* The fragment shader counts the pixels requesting each page in a feedback buffer that is read back once the frame's fence has been signaled
+* Missing pages are loaded asynchronously from a tiled file (coarser mip levels and pages with a larger screen coverage first) and mapped to a fixed size pool of physical pages that's managed in least recently used order
+* The shader reads residency from a page table and falls back to coarser mip levels for pages that are not resident yet
+* Without sparse residency (e.g. on lavapipe), the texture is fully allocated and residency is only tracked in that page table
+*/
+
 #include "texturesparseresidency.h"
 
 /*
@@ -143,6 +151,216 @@ void VirtualTexture::destroy()
 	}
 }
 
+/*
+	Tile file
+	Stores the content of the virtual texture as separately readable tiles
+ */
+
+size_t TileFile::tileSize() const
+{
+	return static_cast<size_t>(header.pageWidth) * header.pageHeight * 4;
+}
+
+size_t TileFile::mipTailOffset() const
+{
+	return sizeof(Header) + tileSize() * header.pageCount;
+}
+
+glm::uvec2 TileFile::mipExtent(uint32_t mipLevel) const
+{
+	return glm::uvec2(std::max(header.width >> mipLevel, 1u), std::max(header.height >> mipLevel, 1u));
+}
+
+// Opens an existing tile file, fails if there is none or if it was written for a different texture or page size
+bool TileFile::open(const std::string& filename, const Header& expected, uint32_t threadCount)
+{
+	header = expected;
+	this->filename = filename;
+	fromFile = false;
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return false;
+	}
+	size_t expectedSize = mipTailOffset();
+	for (uint32_t i = header.mipTailStart; i < header.mipLevels; i++) {
+		const glm::uvec2 extent = mipExtent(i);
+		expectedSize += static_cast<size_t>(extent.x) * extent.y * 4;
+	}
+	if (static_cast<size_t>(file.tellg()) != expectedSize) {
+		return false;
+	}
+	Header fileHeader{};
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&fileHeader), sizeof(Header));
+	if (!file || (memcmp(&fileHeader, &expected, sizeof(Header)) != 0)) {
+		return false;
+	}
+	streams.clear();
+	streams.resize(threadCount);
+	fromFile = true;
+	return true;
+}
+
+// Writes a new tile file with procedural content, tiles are generated in parallel in batches to limit memory usage
+bool TileFile::generate(const std::string& filename, const Header& expected, const std::vector<VirtualTexturePage>& pages, vks::JobSystem& jobSystem)
+{
+	header = expected;
+	const std::string tempFilename = filename + ".tmp";
+	std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+	const uint32_t batchSize = 64;
+	std::vector<uint8_t> batch(tileSize() * batchSize);
+	for (uint32_t first = 0; first < header.pageCount; first += batchSize) {
+		const uint32_t count = std::min(batchSize, header.pageCount - first);
+		std::fill(batch.begin(), batch.end(), 0);
+		jobSystem.parallelFor(count, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				const VirtualTexturePage& page = pages[first + i];
+				generateTexels(page.mipLevel, page.offset, page.extent, &batch[i * tileSize()]);
+			}
+		}, 1);
+		file.write(reinterpret_cast<const char*>(batch.data()), tileSize() * count);
+	}
+
+	for (uint32_t i = header.mipTailStart; i < header.mipLevels; i++) {
+		const glm::uvec2 extent = mipExtent(i);
+		std::vector<uint8_t> level(static_cast<size_t>(extent.x) * extent.y * 4);
+		generateTexels(i, { 0, 0, 0 }, { extent.x, extent.y, 1 }, level.data());
+		file.write(reinterpret_cast<const char*>(level.data()), level.size());
+	}
+
+	file.close();
+	if (!file) {
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+	// Write to a temporary file first, so an interrupted run doesn't leave a partial tile file behind
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+		std::remove(tempFilename.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Procedural content: a checkerboard with darkened page borders that is tinted by mip level, so it's easy to see which pages and mip levels are resident
+void TileFile::generateTexels(uint32_t mipLevel, VkOffset3D offset, VkExtent3D extent, uint8_t* data) const
+{
+	const std::array<glm::vec3, 8> mipColors = {
+		glm::vec3(1.0f, 0.35f, 0.35f), glm::vec3(1.0f, 0.7f, 0.3f), glm::vec3(1.0f, 1.0f, 0.35f), glm::vec3(0.4f, 1.0f, 0.4f),
+		glm::vec3(0.35f, 1.0f, 1.0f), glm::vec3(0.4f, 0.55f, 1.0f), glm::vec3(0.8f, 0.45f, 1.0f), glm::vec3(1.0f, 1.0f, 1.0f)
+	};
+	const glm::uvec2 size = mipExtent(mipLevel);
+	const glm::vec3 tint = mipColors[std::min(mipLevel, static_cast<uint32_t>(mipColors.size()) - 1)];
+	for (uint32_t y = 0; y < extent.height; y++) {
+		for (uint32_t x = 0; x < extent.width; x++) {
+			const glm::uvec2 texel(offset.x + x, offset.y + y);
+			const glm::vec2 uv = (glm::vec2(texel) + 0.5f) / glm::vec2(size);
+			const bool checker = ((static_cast<uint32_t>(uv.x * 32.0f) + static_cast<uint32_t>(uv.y * 32.0f)) & 1) != 0;
+			const float rings = 0.5f + 0.5f * cos(glm::length(uv - 0.5f) * 200.0f);
+			float intensity = (checker ? 0.85f : 0.55f) * (0.8f + 0.2f * rings);
+			if (((texel.x % header.pageWidth) < 2) || ((texel.y % header.pageHeight) < 2)) {
+				intensity *= 0.25f;
+			}
+			const glm::vec3 color = tint * intensity;
+			*data++ = static_cast<uint8_t>(color.r * 255.0f);
+			*data++ = static_cast<uint8_t>(color.g * 255.0f);
+			*data++ = static_cast<uint8_t>(color.b * 255.0f);
+			*data++ = 255;
+		}
+	}
+}
+
+// Reads the texels of a page, called from the streaming jobs with the index of the job system thread they run on
+void TileFile::readTile(const VirtualTexturePage& page, uint32_t threadIndex, uint8_t* data)
+{
+	const size_t size = static_cast<size_t>(page.extent.width) * page.extent.height * 4;
+	if (!fromFile) {
+		generateTexels(page.mipLevel, page.offset, page.extent, data);
+		return;
+	}
+	std::ifstream& stream = streams[threadIndex];
+	if (!stream.is_open()) {
+		stream.open(filename, std::ios::binary);
+	}
+	stream.clear();
+	stream.seekg(sizeof(Header) + tileSize() * page.index);
+	stream.read(reinterpret_cast<char*>(data), size);
+}
+
+void TileFile::readMipLevel(uint32_t mipLevel, uint32_t threadIndex, uint8_t* data)
+{
+	const glm::uvec2 extent = mipExtent(mipLevel);
+	if (!fromFile) {
+		generateTexels(mipLevel, { 0, 0, 0 }, { extent.x, extent.y, 1 }, data);
+		return;
+	}
+	size_t offset = mipTailOffset();
+	for (uint32_t i = header.mipTailStart; i < mipLevel; i++) {
+		const glm::uvec2 levelExtent = mipExtent(i);
+		offset += static_cast<size_t>(levelExtent.x) * levelExtent.y * 4;
+	}
+	std::ifstream& stream = streams[threadIndex];
+	if (!stream.is_open()) {
+		stream.open(filename, std::ios::binary);
+	}
+	stream.clear();
+	stream.seekg(offset);
+	stream.read(reinterpret_cast<char*>(data), static_cast<size_t>(extent.x) * extent.y * 4);
+}
+
+/*
+	Page pool
+	Fixed number of physical page slots with least recently used replacement
+ */
+
+void PagePool::create(uint32_t slotCount)
+{
+	lru.clear();
+	slotPages.assign(slotCount, invalid);
+	lastUsed.assign(slotCount, 0);
+	lruEntries.assign(slotCount, lru.end());
+	freeSlots.resize(slotCount);
+	for (uint32_t i = 0; i < slotCount; i++) {
+		freeSlots[i] = slotCount - 1 - i;
+	}
+}
+
+// Marks the slot as used in the given frame by moving it to the back of the LRU list
+void PagePool::touch(uint32_t slot, uint64_t frame)
+{
+	lastUsed[slot] = frame;
+	lru.splice(lru.end(), lru, lruEntries[slot]);
+}
+
+// Returns a free slot for the page, or the least recently used one if there are no free slots left
+// Slots that have been used in the current frame are never replaced, as that would only trade one page fault for another
+// Returns invalid if the pool is exhausted, if an occupied slot was reused evictedPage contains the page that was stored in it
+uint32_t PagePool::acquire(uint32_t page, uint64_t frame, uint32_t& evictedPage)
+{
+	evictedPage = invalid;
+	uint32_t slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	} else {
+		if (lru.empty() || (lastUsed[lru.front()] >= frame)) {
+			return invalid;
+		}
+		slot = lru.front();
+		lru.pop_front();
+		evictedPage = slotPages[slot];
+	}
+	slotPages[slot] = page;
+	lastUsed[slot] = frame;
+	lruEntries[slot] = lru.insert(lru.end(), slot);
+	return slot;
+}
+
 /*
 	Vulkan Example class
 */
@@ -159,9 +377,19 @@ VulkanExample::VulkanExample() : VulkanExampleBase()
 VulkanExample::~VulkanExample()
 {
 	if (device) {
+		if (streaming.jobSystem) {
+			streaming.jobSystem->wait(streaming.loadCounter);
+		}
 		destroyTextureImage(texture);
+		vkFreeMemory(device, streaming.pool.memory, nullptr);
+		for (uint32_t i = 0; i < maxConcurrentFrames; i++) {
+			streaming.feedbackBuffers[i].destroy();
+			streaming.pageTableBuffers[i].destroy();
+			streaming.uniformBuffers[i].destroy();
+		}
 		vkDestroySemaphore(device, bindSparseSemaphore, nullptr);
 		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, streamingPipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 		for (auto& buffer : uniformBuffers) {
@@ -178,7 +406,11 @@ void VulkanExample::getEnabledFeatures()
 		enabledFeatures.sparseResidencyImage2D = VK_TRUE;
 	}
 	else {
-		std::cout << "Sparse binding not supported" << std::endl;
+		std::cout << "Sparse residency not supported, falling back to a software page table" << std::endl;
+	}
+	// The streaming feedback is written from the fragment shader
+	if (deviceFeatures.fragmentStoresAndAtomics) {
+		enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
 	}
 }
 
@@ -250,7 +482,8 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VK_CHECK_RESULT(vkCreateImage(device, &sparseImageCreateInfo, nullptr, &texture.image));
 
 	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange);
+	// The image stays in the general layout, so streamed pages can be copied while other pages are sampled
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, texture.subRange);
 	vulkanDevice->flushCommandBuffer(copyCmd, queue);
 
 	// Get memory requirements
@@ -291,8 +524,6 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 		std::cout << "\t Mip tail size: " << reqs.imageMipTailSize << std::endl;
 		std::cout << "\t Mip tail offset: " << reqs.imageMipTailOffset << std::endl;
 		std::cout << "\t Mip tail stride: " << reqs.imageMipTailStride << std::endl;
-		//todo:multiple reqs
-		texture.mipTailStart = reqs.imageMipTailFirstLod;
 	}
 
 	// Get sparse image requirements for the color aspect
@@ -326,58 +557,11 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	texture.mipTailInfo.alingedMipSize = sparseMemoryReq.formatProperties.flags & VK_SPARSE_IMAGE_FORMAT_ALIGNED_MIP_SIZE_BIT;
 
 	// Sparse bindings for each mip level of all layers outside of the mip tail
+	texture.mipTailStart = sparseMemoryReq.imageMipTailFirstLod;
+	addPages(sparseMemoryReq.formatProperties.imageGranularity, sparseImageMemoryReqs.alignment);
+
 	for (uint32_t layer = 0; layer < texture.layerCount; layer++)
 	{
-		// sparseMemoryReq.imageMipTailFirstLod is the first mip level that's stored inside the mip tail
-		for (uint32_t mipLevel = 0; mipLevel < sparseMemoryReq.imageMipTailFirstLod; mipLevel++)
-		{
-			VkExtent3D extent;
-			extent.width = std::max(sparseImageCreateInfo.extent.width >> mipLevel, 1u);
-			extent.height = std::max(sparseImageCreateInfo.extent.height >> mipLevel, 1u);
-			extent.depth = std::max(sparseImageCreateInfo.extent.depth >> mipLevel, 1u);
-
-			VkImageSubresource subResource{};
-			subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			subResource.mipLevel = mipLevel;
-			subResource.arrayLayer = layer;
-
-			// Aligned sizes by image granularity
-			VkExtent3D imageGranularity = sparseMemoryReq.formatProperties.imageGranularity;
-			glm::uvec3 sparseBindCounts = alignedDivision(extent, imageGranularity);
-			glm::uvec3 lastBlockExtent;
-			lastBlockExtent.x = (extent.width % imageGranularity.width) ? extent.width % imageGranularity.width : imageGranularity.width;
-			lastBlockExtent.y = (extent.height % imageGranularity.height) ? extent.height % imageGranularity.height : imageGranularity.height;
-			lastBlockExtent.z = (extent.depth % imageGranularity.depth) ? extent.depth % imageGranularity.depth : imageGranularity.depth;
-
-			// @todo: Comment
-			uint32_t index = 0;
-			for (uint32_t z = 0; z < sparseBindCounts.z; z++)
-			{
-				for (uint32_t y = 0; y < sparseBindCounts.y; y++)
-				{
-					for (uint32_t x = 0; x < sparseBindCounts.x; x++)
-					{
-						// Offset
-						VkOffset3D offset;
-						offset.x = x * imageGranularity.width;
-						offset.y = y * imageGranularity.height;
-						offset.z = z * imageGranularity.depth;
-						// Size of the page
-						VkExtent3D extent;
-						extent.width = (x == sparseBindCounts.x - 1) ? lastBlockExtent.x : imageGranularity.width;
-						extent.height = (y == sparseBindCounts.y - 1) ? lastBlockExtent.y : imageGranularity.height;
-						extent.depth = (z == sparseBindCounts.z - 1) ? lastBlockExtent.z : imageGranularity.depth;
-
-						// Add new virtual page
-						VirtualTexturePage* newPage = texture.addPage(offset, extent, sparseImageMemoryReqs.alignment, mipLevel, layer);
-						newPage->imageMemoryBind.subresource = subResource;
-
-						index++;
-					}
-				}
-			}
-		}
-
 		// @todo: proper comment
 		// @todo: store in mip tail and properly release
 		// @todo: Only one block for single mip tail
@@ -399,7 +583,7 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 
 			texture.opaqueMemoryBinds.push_back(sparseMemoryBind);
 		}
-	} // end layers and mips
+	} // end layers
 
 	std::cout << "Texture info:" << std::endl;
 	std::cout << "\tDim: " << texture.width << " x " << texture.height << std::endl;
@@ -438,6 +622,118 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	//todo: use sparse bind semaphore
 	vkQueueWaitIdle(queue);
 
+	createSampler();
+}
+
+// Adds virtual pages for all mip levels outside of the mip tail, pages are ordered by mip level, row and column
+void VulkanExample::addPages(VkExtent3D granularity, VkDeviceSize pageSize)
+{
+	for (uint32_t layer = 0; layer < texture.layerCount; layer++)
+	{
+		for (uint32_t mipLevel = 0; mipLevel < texture.mipTailStart; mipLevel++)
+		{
+			VkExtent3D extent;
+			extent.width = std::max(texture.width >> mipLevel, 1u);
+			extent.height = std::max(texture.height >> mipLevel, 1u);
+			extent.depth = 1;
+
+			VkImageSubresource subResource{};
+			subResource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			subResource.mipLevel = mipLevel;
+			subResource.arrayLayer = layer;
+
+			// Aligned sizes by image granularity
+			glm::uvec3 sparseBindCounts = alignedDivision(extent, granularity);
+			glm::uvec3 lastBlockExtent;
+			lastBlockExtent.x = (extent.width % granularity.width) ? extent.width % granularity.width : granularity.width;
+			lastBlockExtent.y = (extent.height % granularity.height) ? extent.height % granularity.height : granularity.height;
+			lastBlockExtent.z = (extent.depth % granularity.depth) ? extent.depth % granularity.depth : granularity.depth;
+
+			for (uint32_t z = 0; z < sparseBindCounts.z; z++)
+			{
+				for (uint32_t y = 0; y < sparseBindCounts.y; y++)
+				{
+					for (uint32_t x = 0; x < sparseBindCounts.x; x++)
+					{
+						// Offset
+						VkOffset3D offset;
+						offset.x = x * granularity.width;
+						offset.y = y * granularity.height;
+						offset.z = z * granularity.depth;
+						// Size of the page
+						VkExtent3D extent;
+						extent.width = (x == sparseBindCounts.x - 1) ? lastBlockExtent.x : granularity.width;
+						extent.height = (y == sparseBindCounts.y - 1) ? lastBlockExtent.y : granularity.height;
+						extent.depth = (z == sparseBindCounts.z - 1) ? lastBlockExtent.z : granularity.depth;
+
+						// Add new virtual page
+						VirtualTexturePage* newPage = texture.addPage(offset, extent, pageSize, mipLevel, layer);
+						newPage->imageMemoryBind.subresource = subResource;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Software page table path for devices without sparse residency (e.g. lavapipe)
+// The texture is fully allocated and pages use the same layout as with sparse residency, but residency is only tracked in the page table that's read by the shader
+void VulkanExample::prepareTexture(uint32_t width, uint32_t height, VkFormat format)
+{
+	texture.device = vulkanDevice->logicalDevice;
+	texture.width = width;
+	texture.height = height;
+	texture.mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1);
+	texture.layerCount = 1;
+	texture.format = format;
+	texture.subRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 };
+
+	VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = texture.format;
+	imageCreateInfo.mipLevels = texture.mipLevels;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.extent = { texture.width, texture.height, 1 };
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &texture.image));
+
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, texture.image, &memReqs);
+	VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+	memAllocInfo.allocationSize = memReqs.size;
+	memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &texture.deviceMemory));
+	VK_CHECK_RESULT(vkBindImageMemory(device, texture.image, texture.deviceMemory, 0));
+
+	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, texture.subRange);
+	vulkanDevice->flushCommandBuffer(copyCmd, queue);
+
+	// Use the page size most implementations have for sparse images with 32 bit formats, levels smaller than a page form the mip tail
+	const VkExtent3D pageExtent = { 128, 128, 1 };
+	texture.mipTailStart = texture.mipLevels;
+	for (uint32_t i = 0; i < texture.mipLevels; i++) {
+		if (((texture.width >> i) < pageExtent.width) || ((texture.height >> i) < pageExtent.height)) {
+			texture.mipTailStart = i;
+			break;
+		}
+	}
+	addPages(pageExtent, pageExtent.width * pageExtent.height * 4);
+
+	std::cout << "Texture info:" << std::endl;
+	std::cout << "\tDim: " << texture.width << " x " << texture.height << std::endl;
+	std::cout << "\tVirtual pages: " << texture.pages.size() << std::endl;
+
+	createSampler();
+}
+
+// Sampler and image view are shared by the sparse and the software page table path
+void VulkanExample::createSampler()
+{
 	// Create sampler
 	VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
 	sampler.magFilter = VK_FILTER_LINEAR;
@@ -459,7 +755,7 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VkImageViewCreateInfo view = vks::initializers::imageViewCreateInfo();
 	view.image = VK_NULL_HANDLE;
 	view.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	view.format = format;
+	view.format = texture.format;
 	view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	view.subresourceRange.baseMipLevel = 0;
 	view.subresourceRange.baseArrayLayer = 0;
@@ -469,7 +765,7 @@ void VulkanExample::prepareSparseTexture(uint32_t width, uint32_t height, uint32
 	VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &texture.view));
 
 	// Fill image descriptor image info that can be used during the descriptor set setup
-	texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 	texture.descriptor.imageView = texture.view;
 	texture.descriptor.sampler = texture.sampler;
 }
@@ -480,6 +776,7 @@ void VulkanExample::destroyTextureImage(SparseTexture texture)
 	vkDestroyImageView(device, texture.view, nullptr);
 	vkDestroyImage(device, texture.image, nullptr);
 	vkDestroySampler(device, texture.sampler, nullptr);
+	vkFreeMemory(device, texture.deviceMemory, nullptr);
 	texture.destroy();
 }
 
@@ -493,8 +790,9 @@ void VulkanExample::setupDescriptors()
 {
 	// Pool
 	std::vector<VkDescriptorPoolSize> poolSizes = {
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames),
-		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames)
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxConcurrentFrames * 2),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxConcurrentFrames),
+		vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxConcurrentFrames * 2)
 	};
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, maxConcurrentFrames);
 	VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -504,7 +802,13 @@ void VulkanExample::setupDescriptors()
 		// Binding 0 : Vertex shader uniform buffer
 		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
 		// Binding 1 : Fragment shader image sampler
-		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+		// Binding 2 : Fragment shader streaming page layout
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+		// Binding 3 : Fragment shader page table
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
+		// Binding 4 : Fragment shader page request feedback
+		vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4)
 	};
 	VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
@@ -517,6 +821,9 @@ void VulkanExample::setupDescriptors()
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers[i].descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &texture.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &streaming.uniformBuffers[i].descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &streaming.pageTableBuffers[i].descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &streaming.feedbackBuffers[i].descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
@@ -553,8 +860,16 @@ void VulkanExample::preparePipelines()
 	pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
 
 	shaderStages[0] = loadShader(getShadersPath() + "texturesparseresidency/sparseresidency.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-	shaderStages[1] = loadShader(getShadersPath() + "texturesparseresidency/sparseresidency.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	// Manual page control, checks residency with sparse residency shader functions
+	if (streaming.sparse) {
+		shaderStages[1] = loadShader(getShadersPath() + "texturesparseresidency/sparseresidency.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	}
+	// Feedback streaming, checks residency with the page table
+	if (streaming.supported) {
+		shaderStages[1] = loadShader(getShadersPath() + "texturesparseresidency/streaming.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &streamingPipeline));
+	}
 }
 
 // Prepare and initialize uniform buffer containing shader uniforms
@@ -577,14 +892,22 @@ void VulkanExample::updateUniformBuffers()
 void VulkanExample::prepare()
 {
 	VulkanExampleBase::prepare();
-	// Check if the GPU supports sparse residency for 2D images
-	if (!vulkanDevice->features.sparseResidencyImage2D) {
-		vks::tools::exitFatal("Device does not support sparse residency for 2D images!", VK_ERROR_FEATURE_NOT_PRESENT);
+	// Without sparse residency for 2D images (e.g. on lavapipe) the texture is fully allocated and only streaming with the software page table is available
+	streaming.sparse = deviceFeatures.sparseBinding && deviceFeatures.sparseResidencyImage2D;
+	streaming.supported = deviceFeatures.fragmentStoresAndAtomics;
+	if (!streaming.sparse && !streaming.supported) {
+		vks::tools::exitFatal("Device supports neither sparse residency for 2D images nor fragment shader stores and atomics!", VK_ERROR_FEATURE_NOT_PRESENT);
 	}
+	streaming.enabled = streaming.supported;
 	loadAssets();
 	prepareUniformBuffers();
-	// Create a virtual texture with max. possible dimension (does not take up any VRAM yet)
-	prepareSparseTexture(4096, 4096, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	if (streaming.sparse) {
+		// Create a virtual texture with max. possible dimension (does not take up any VRAM yet)
+		prepareSparseTexture(4096, 4096, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	} else {
+		prepareTexture(4096, 4096, VK_FORMAT_R8G8B8A8_UNORM);
+	}
+	prepareStreaming();
 	setupDescriptors();
 	preparePipelines();
 	prepared = true;
@@ -612,6 +935,15 @@ void VulkanExample::buildCommandBuffer()
 
 	VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
 
+	// Clear the page requests of this frame's feedback buffer before the fragment shader writes to it
+	if (streaming.enabled) {
+		vkCmdFillBuffer(cmdBuffer, streaming.feedbackBuffers[currentBuffer].buffer, 0, VK_WHOLE_SIZE, 0);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
 	vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 	VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -621,13 +953,21 @@ void VulkanExample::buildCommandBuffer()
 	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
 	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentBuffer], 0, nullptr);
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, streaming.enabled ? streamingPipeline : pipeline);
 	plane.draw(cmdBuffer);
 
 	drawUI(cmdBuffer);
 
 	vkCmdEndRenderPass(cmdBuffer);
 
+	// Make the page requests visible to the host, they're read once the frame's fence has been signaled
+	if (streaming.enabled) {
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
 	VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
 }
 
@@ -636,6 +976,9 @@ void VulkanExample::render()
 	if (!prepared)
 		return;
 	VulkanExampleBase::prepareFrame();
+	if (streaming.enabled) {
+		updateStreaming();
+	}
 	updateUniformBuffers();
 	buildCommandBuffer();
 	VulkanExampleBase::submitFrame();
@@ -680,7 +1023,7 @@ void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
 	randomPattern(data, page.extent.height, page.extent.width);
 
 	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 	VkBufferImageCopy region{};
 	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	region.imageSubresource.layerCount = 1;
@@ -688,7 +1031,7 @@ void VulkanExample::uploadContent(VirtualTexturePage page, VkImage image)
 	region.imageOffset = page.offset;
 	region.imageExtent = page.extent;
 	vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 	vulkanDevice->flushCommandBuffer(copyCmd, queue);
 
 	imageBuffer.destroy();
@@ -775,7 +1118,7 @@ void VulkanExample::fillMipTail()
 		randomPattern(data, width, height);
 
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 		VkBufferImageCopy region{};
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		region.imageSubresource.layerCount = 1;
@@ -783,7 +1126,7 @@ void VulkanExample::fillMipTail()
 		region.imageOffset = {};
 		region.imageExtent = { width, height, 1 };
 		vkCmdCopyBufferToImage(copyCmd, imageBuffer.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, texture.subRange, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 		vulkanDevice->flushCommandBuffer(copyCmd, queue);
 
 		imageBuffer.destroy();
@@ -827,26 +1170,378 @@ void VulkanExample::flushRandomPages()
 	}
 }
 
+/*
+	Feedback streaming
+*/
+
+void VulkanExample::prepareStreaming()
+{
+	const uint32_t pageCount = static_cast<uint32_t>(texture.pages.size());
+	const VkExtent3D pageExtent = texture.pages.empty() ? VkExtent3D{ 1, 1, 1 } : texture.pages[0].extent;
+
+	// Page layout of the mip levels outside of the mip tail, used by the shader to calculate page indices
+	assert(texture.mipTailStart <= 16);
+	streaming.shaderData.pageSize = glm::uvec2(pageExtent.width, pageExtent.height);
+	streaming.shaderData.mipTailStart = texture.mipTailStart;
+	streaming.shaderData.mipLevels = texture.mipLevels;
+	uint32_t firstPage = 0;
+	for (uint32_t i = 0; i < texture.mipTailStart; i++) {
+		const glm::uvec3 pages = alignedDivision({ std::max(texture.width >> i, 1u), std::max(texture.height >> i, 1u), 1 }, pageExtent);
+		streaming.shaderData.mips[i] = glm::uvec4(firstPage, pages.x, pages.y, 0);
+		firstPage += pages.x * pages.y;
+	}
+
+	streaming.pageStates.assign(pageCount, Streaming::NonResident);
+	streaming.pageSlots.assign(pageCount, PagePool::invalid);
+	streaming.pageCoverage.assign(pageCount, 0);
+	streaming.requestTimes.assign(pageCount, {});
+
+	// Tiles are loaded by a few dedicated threads, so slow reads don't block other work
+	streaming.jobSystem = std::make_unique<vks::JobSystem>(2);
+	const uint32_t threadCount = streaming.jobSystem->workerCount() + 1;
+	TileFile::Header header{ TileFile::magicValue, TileFile::versionValue, texture.width, texture.height, texture.mipLevels, texture.mipTailStart, pageExtent.width, pageExtent.height, pageCount };
+#if defined(__ANDROID__)
+	// Assets are read-only on Android, so tiles are generated on the fly
+	streaming.tileFile.header = header;
+#else
+	const std::string filename = getAssetPath() + "textures/texturesparseresidency_tiles.bin";
+	if (!streaming.tileFile.open(filename, header, threadCount)) {
+		std::cout << "Generating tile file " << filename << std::endl;
+		if (!streaming.tileFile.generate(filename, header, texture.pages, *streaming.jobSystem) || !streaming.tileFile.open(filename, header, threadCount)) {
+			std::cout << "Could not write the tile file, tiles are generated on the fly" << std::endl;
+		}
+	}
+#endif
+
+	// The physical page budget is fixed, with sparse residency all pages are backed by a single allocation
+	streaming.pageBudget = std::min(streaming.pageBudget, pageCount);
+	streaming.pool.create(streaming.pageBudget);
+	if (streaming.sparse && (pageCount > 0)) {
+		streaming.pool.pageSize = texture.pages[0].size;
+		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
+		allocInfo.allocationSize = streaming.pool.pageSize * streaming.pageBudget;
+		allocInfo.memoryTypeIndex = texture.memoryTypeIndex;
+		VK_CHECK_RESULT(vkAllocateMemory(device, &allocInfo, nullptr, &streaming.pool.memory));
+	}
+	std::cout << "Streaming: " << streaming.pageBudget << " physical pages for " << pageCount << " virtual pages (" << (streaming.sparse ? "sparse residency" : "software page table") << ")" << std::endl;
+
+	// Feedback and page table are accessed by the host and the device, so there is one of each per frame in flight
+	for (uint32_t i = 0; i < maxConcurrentFrames; i++) {
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &streaming.feedbackBuffers[i], std::max(pageCount, 1u) * sizeof(uint32_t)));
+		VK_CHECK_RESULT(streaming.feedbackBuffers[i].map());
+		memset(streaming.feedbackBuffers[i].mapped, 0, streaming.feedbackBuffers[i].size);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &streaming.pageTableBuffers[i], std::max(pageCount, 1u) * sizeof(uint32_t)));
+		VK_CHECK_RESULT(streaming.pageTableBuffers[i].map());
+		memset(streaming.pageTableBuffers[i].mapped, 0, streaming.pageTableBuffers[i].size);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &streaming.uniformBuffers[i], sizeof(Streaming::ShaderData), &streaming.shaderData));
+		VK_CHECK_RESULT(streaming.uniformBuffers[i].map());
+	}
+
+	if (streaming.enabled) {
+		uploadMipTail();
+	}
+}
+
+// Switches between feedback streaming and the manual page controls, both modes need exclusive control over the sparse bindings
+void VulkanExample::setStreaming(bool enabled)
+{
+	vkDeviceWaitIdle(device);
+	streaming.jobSystem->wait(streaming.loadCounter);
+	streaming.loadedTiles.clear();
+	if (enabled) {
+		// Release pages bound by the manual controls
+		std::vector<VirtualTexturePage> residentPages;
+		for (auto& page : texture.pages) {
+			if (page.resident()) {
+				residentPages.push_back(page);
+			}
+		}
+		if (!residentPages.empty()) {
+			texture.updateSparseBindInfo(residentPages, true);
+			VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &texture.bindSparseInfo, VK_NULL_HANDLE));
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+			for (auto& page : texture.pages) {
+				page.release(device);
+			}
+		}
+		// The manual controls may have overwritten the mip tail
+		uploadMipTail();
+	} else if (streaming.sparse) {
+		// Unbind all streamed pages
+		std::vector<uint32_t> residentPages;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(texture.pages.size()); i++) {
+			if (streaming.pageStates[i] == Streaming::Resident) {
+				residentPages.push_back(i);
+			}
+		}
+		bindPages(residentPages, {});
+	}
+	std::fill(streaming.pageStates.begin(), streaming.pageStates.end(), Streaming::NonResident);
+	std::fill(streaming.pageSlots.begin(), streaming.pageSlots.end(), PagePool::invalid);
+	std::fill(streaming.requestTimes.begin(), streaming.requestTimes.end(), std::chrono::high_resolution_clock::time_point{});
+	streaming.pool.create(streaming.pool.slotCount());
+	streaming.statistics = {};
+	streaming.enabled = enabled;
+}
+
+// Levels in the mip tail can't be bound separately, they are always resident and uploaded once
+void VulkanExample::uploadMipTail()
+{
+	vks::StagingRing& stagingRing = vulkanDevice->stagingRing;
+	stagingRing.begin(queue);
+	for (uint32_t i = texture.mipTailStart; i < texture.mipLevels; i++) {
+		const glm::uvec2 extent = streaming.tileFile.mipExtent(i);
+		vks::StagingRing::Allocation staging = stagingRing.allocate(static_cast<VkDeviceSize>(extent.x) * extent.y * 4);
+		streaming.tileFile.readMipLevel(i, streaming.jobSystem->threadIndex(), static_cast<uint8_t*>(staging.data));
+		VkBufferImageCopy region{};
+		region.bufferOffset = staging.offset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+		region.imageExtent = { extent.x, extent.y, 1 };
+		vkCmdCopyBufferToImage(stagingRing.commandBuffer(), staging.buffer, texture.image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+	}
+	VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(stagingRing.commandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	stagingRing.wait(stagingRing.end());
+}
+
+// Unbinds evicted pages and binds new pages to their pool slots in a single sparse binding operation
+void VulkanExample::bindPages(const std::vector<uint32_t>& evictedPages, const std::vector<uint32_t>& newPages)
+{
+	if (evictedPages.empty() && newPages.empty()) {
+		return;
+	}
+	const auto tStart = std::chrono::high_resolution_clock::now();
+	std::vector<VkSparseImageMemoryBind> binds;
+	binds.reserve(evictedPages.size() + newPages.size());
+	for (uint32_t page : evictedPages) {
+		VkSparseImageMemoryBind bind = texture.pages[page].imageMemoryBind;
+		bind.memory = VK_NULL_HANDLE;
+		bind.memoryOffset = 0;
+		binds.push_back(bind);
+	}
+	for (uint32_t page : newPages) {
+		VkSparseImageMemoryBind bind = texture.pages[page].imageMemoryBind;
+		bind.memory = streaming.pool.memory;
+		bind.memoryOffset = streaming.pageSlots[page] * streaming.pool.pageSize;
+		binds.push_back(bind);
+	}
+	VkSparseImageMemoryBindInfo imageMemoryBindInfo{};
+	imageMemoryBindInfo.image = texture.image;
+	imageMemoryBindInfo.bindCount = static_cast<uint32_t>(binds.size());
+	imageMemoryBindInfo.pBinds = binds.data();
+	VkBindSparseInfo bindSparseInfo = vks::initializers::bindSparseInfo();
+	bindSparseInfo.imageBindCount = 1;
+	bindSparseInfo.pImageBinds = &imageMemoryBindInfo;
+
+	// Sparse binding is not ordered against earlier submissions, and the frame that's still in flight may sample evicted pages
+	if (!evictedPages.empty()) {
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	}
+	// Uploads to the new pages are submitted afterwards, so wait for the binding to finish
+	VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+	VkFence fence;
+	VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+	VK_CHECK_RESULT(vkQueueBindSparse(queue, 1, &bindSparseInfo, fence));
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+	vkDestroyFence(device, fence, nullptr);
+	streaming.statistics.bindTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+}
+
+// Reads back the page requests of the frame that last used the current frame's resources, starts loading missing pages and makes loaded pages resident
+void VulkanExample::updateStreaming()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	const uint32_t pageCount = static_cast<uint32_t>(texture.pages.size());
+	const uint64_t frame = ++streaming.frame;
+	Streaming::Statistics& statistics = streaming.statistics;
+	statistics = {};
+
+	// Index of the page covering the same area in the next coarser mip level, invalid if that level is part of the mip tail
+	auto parentPage = [this](uint32_t index) {
+		const VirtualTexturePage& page = texture.pages[index];
+		const uint32_t mipLevel = page.mipLevel + 1;
+		if (mipLevel >= texture.mipTailStart) {
+			return PagePool::invalid;
+		}
+		const glm::uvec4& mip = streaming.shaderData.mips[mipLevel];
+		const uint32_t x = (page.offset.x / 2) / streaming.shaderData.pageSize.x;
+		const uint32_t y = (page.offset.y / 2) / streaming.shaderData.pageSize.y;
+		return mip.x + y * mip.y + x;
+	};
+
+	/* Feedback */
+
+	// The shader counts the pixels requesting a page, which is used as the page's screen coverage
+	// A page that isn't resident falls back to the next coarser resident page, so all missing pages in that chain are requested and the resident one is marked as used
+	const uint32_t* feedback = static_cast<const uint32_t*>(streaming.feedbackBuffers[currentBuffer].mapped);
+	std::fill(streaming.pageCoverage.begin(), streaming.pageCoverage.end(), 0);
+	const Clock::time_point now = Clock::now();
+	for (uint32_t i = 0; i < pageCount; i++) {
+		if (feedback[i] == 0) {
+			continue;
+		}
+		statistics.requestedPages++;
+		if (streaming.pageStates[i] != Streaming::Resident) {
+			statistics.pageFaults++;
+		}
+		for (uint32_t page = i; page != PagePool::invalid; page = parentPage(page)) {
+			if (streaming.pageStates[page] == Streaming::Resident) {
+				streaming.pool.touch(streaming.pageSlots[page], frame);
+				break;
+			}
+			if (streaming.requestTimes[page] == Clock::time_point{}) {
+				streaming.requestTimes[page] = now;
+			}
+			streaming.pageCoverage[page] += feedback[i];
+		}
+	}
+
+	/* Requests */
+
+	// Coarser mip levels first, as they replace the largest number of missing pages, then by screen coverage
+	std::vector<uint32_t> requests;
+	for (uint32_t i = 0; i < pageCount; i++) {
+		if ((streaming.pageCoverage[i] > 0) && (streaming.pageStates[i] == Streaming::NonResident)) {
+			requests.push_back(i);
+		}
+	}
+	std::sort(requests.begin(), requests.end(), [this](uint32_t a, uint32_t b) {
+		if (texture.pages[a].mipLevel != texture.pages[b].mipLevel) {
+			return texture.pages[a].mipLevel > texture.pages[b].mipLevel;
+		}
+		return streaming.pageCoverage[a] > streaming.pageCoverage[b];
+	});
+	// Requests that don't fit into the pending load limit are repeated by the feedback of later frames
+	const uint32_t pendingLoads = streaming.loadCounter.pending();
+	const uint32_t loadCount = std::min(static_cast<uint32_t>(requests.size()), (streaming.maxPendingLoads > pendingLoads) ? streaming.maxPendingLoads - pendingLoads : 0);
+	for (uint32_t i = 0; i < loadCount; i++) {
+		const uint32_t page = requests[i];
+		streaming.pageStates[page] = Streaming::Loading;
+		streaming.jobSystem->run([this, page]() {
+			const VirtualTexturePage& virtualPage = texture.pages[page];
+			Streaming::LoadedTile tile{ page, std::vector<uint8_t>(static_cast<size_t>(virtualPage.extent.width) * virtualPage.extent.height * 4) };
+			streaming.tileFile.readTile(virtualPage, streaming.jobSystem->threadIndex(), tile.data.data());
+			std::lock_guard<std::mutex> lock(streaming.loadedMutex);
+			streaming.loadedTiles.push_back(std::move(tile));
+		}, &streaming.loadCounter);
+	}
+
+	/* Residency */
+
+	std::vector<Streaming::LoadedTile> tiles;
+	{
+		std::lock_guard<std::mutex> lock(streaming.loadedMutex);
+		const size_t count = std::min(streaming.loadedTiles.size(), static_cast<size_t>(streaming.maxUploadsPerFrame));
+		tiles.assign(std::make_move_iterator(streaming.loadedTiles.begin()), std::make_move_iterator(streaming.loadedTiles.begin() + count));
+		streaming.loadedTiles.erase(streaming.loadedTiles.begin(), streaming.loadedTiles.begin() + count);
+	}
+	std::vector<uint32_t> evictedPages;
+	std::vector<uint32_t> newPages;
+	std::vector<const Streaming::LoadedTile*> uploads;
+	for (const auto& tile : tiles) {
+		uint32_t evictedPage;
+		const uint32_t slot = streaming.pool.acquire(tile.page, frame, evictedPage);
+		if (slot == PagePool::invalid) {
+			// All physical pages are used by the current frame, the page will be requested again
+			streaming.pageStates[tile.page] = Streaming::NonResident;
+			continue;
+		}
+		if (evictedPage != PagePool::invalid) {
+			streaming.pageStates[evictedPage] = Streaming::NonResident;
+			streaming.pageSlots[evictedPage] = PagePool::invalid;
+			evictedPages.push_back(evictedPage);
+		}
+		streaming.pageSlots[tile.page] = slot;
+		newPages.push_back(tile.page);
+		uploads.push_back(&tile);
+	}
+	if (streaming.sparse) {
+		bindPages(evictedPages, newPages);
+	}
+	if (!uploads.empty()) {
+		vks::StagingRing& stagingRing = vulkanDevice->stagingRing;
+		stagingRing.begin(queue);
+		for (const Streaming::LoadedTile* tile : uploads) {
+			const VirtualTexturePage& page = texture.pages[tile->page];
+			vks::StagingRing::Allocation staging = stagingRing.upload(tile->data.data(), tile->data.size());
+			VkBufferImageCopy region{};
+			region.bufferOffset = staging.offset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, page.mipLevel, page.layer, 1 };
+			region.imageOffset = page.offset;
+			region.imageExtent = page.extent;
+			vkCmdCopyBufferToImage(stagingRing.commandBuffer(), staging.buffer, texture.image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+		}
+		// The frame's command buffer is submitted to the same queue after the upload
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(stagingRing.commandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		stagingRing.end();
+	}
+	const Clock::time_point residentTime = Clock::now();
+	for (uint32_t page : newPages) {
+		streaming.pageStates[page] = Streaming::Resident;
+		const float latency = std::chrono::duration<float, std::milli>(residentTime - streaming.requestTimes[page]).count();
+		statistics.averageLatency += latency / static_cast<float>(newPages.size());
+		statistics.maxLatency = std::max(statistics.maxLatency, latency);
+		streaming.requestTimes[page] = {};
+	}
+	statistics.pagesLoaded = static_cast<uint32_t>(newPages.size());
+	statistics.pagesEvicted = static_cast<uint32_t>(evictedPages.size());
+	statistics.pendingLoads = streaming.loadCounter.pending();
+
+	// Page table and feedback sampling pattern for this frame
+	uint32_t* pageTable = static_cast<uint32_t*>(streaming.pageTableBuffers[currentBuffer].mapped);
+	for (uint32_t i = 0; i < pageCount; i++) {
+		pageTable[i] = (streaming.pageStates[i] == Streaming::Resident) ? 1 : 0;
+	}
+	streaming.shaderData.frame = static_cast<uint32_t>(frame);
+	memcpy(streaming.uniformBuffers[currentBuffer].mapped, &streaming.shaderData, sizeof(Streaming::ShaderData));
+}
+
 void VulkanExample::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 {
 	if (overlay->header("Settings")) {
 		if (overlay->sliderFloat("LOD bias", &uniformData.lodBias, -(float)texture.mipLevels, (float)texture.mipLevels)) {
 			updateUniformBuffers();
 		}
-		if (overlay->button("Fill random pages")) {
-			fillRandomPages();
-		}
-		if (overlay->button("Flush random pages")) {
-			flushRandomPages();
+		if (streaming.supported && streaming.sparse) {
+			bool enabled = streaming.enabled;
+			if (overlay->checkBox("Feedback streaming", &enabled)) {
+				setStreaming(enabled);
+			}
 		}
-		if (overlay->button("Fill mip tail")) {
-			fillMipTail();
+		if (!streaming.enabled) {
+			if (overlay->button("Fill random pages")) {
+				fillRandomPages();
+			}
+			if (overlay->button("Flush random pages")) {
+				flushRandomPages();
+			}
+			if (overlay->button("Fill mip tail")) {
+				fillMipTail();
+			}
 		}
 	}
 	if (overlay->header("Statistics")) {
-		uint32_t respages = 0;
-		std::for_each(texture.pages.begin(), texture.pages.end(), [&respages](VirtualTexturePage page) { respages += (page.resident()) ? 1 : 0; });
-		overlay->text("Resident pages: %d of %d", respages, static_cast<uint32_t>(texture.pages.size()));
+		if (streaming.enabled) {
+			const Streaming::Statistics& statistics = streaming.statistics;
+			overlay->text("Residency: %s", streaming.sparse ? "sparse binding" : "software page table");
+			overlay->text("Physical pages: %d of %d", streaming.pool.usedSlots(), streaming.pool.slotCount());
+			overlay->text("Requested pages: %d", statistics.requestedPages);
+			overlay->text("Page faults: %d (%.1f %%)", statistics.pageFaults, statistics.requestedPages > 0 ? 100.0f * statistics.pageFaults / statistics.requestedPages : 0.0f);
+			overlay->text("Loaded: %d evicted: %d pending: %d", statistics.pagesLoaded, statistics.pagesEvicted, statistics.pendingLoads);
+			overlay->text("Bind latency: %.2f ms (max %.2f ms)", statistics.averageLatency, statistics.maxLatency);
+			if (streaming.sparse) {
+				overlay->text("Sparse bind time: %.2f ms", statistics.bindTime);
+			}
+		} else {
+			uint32_t respages = 0;
+			std::for_each(texture.pages.begin(), texture.pages.end(), [&respages](VirtualTexturePage page) { respages += (page.resident()) ? 1 : 0; });
+			overlay->text("Resident pages: %d of %d", respages, static_cast<uint32_t>(texture.pages.size()));
+		}
 		overlay->text("Mip tail starts at: %d", texture.mipTailStart);
 	}
 
@@ -10,8 +10,14 @@
 * Important note : This sample is work-in-progress and works basically, but it's not finished
 */
 
+#include <list>
+#include <mutex>
+#include <fstream>
+#include <memory>
+
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "jobsystem.hpp"
 
 // Virtual texture page as a part of the partially resident texture
 // Contains memory bindings, offsets and status information
@@ -61,6 +67,64 @@ struct VirtualTexture
 	void destroy();
 };
 
+// Tiled storage of the virtual texture's content
+// Every page outside of the mip tail is stored as a separate tile that can be read on its own, followed by the mip tail levels
+// The tile order matches the virtual page order (mip level, row, column), so a page index is also a tile index
+struct TileFile
+{
+	struct Header {
+		uint32_t magic{ 0 };
+		uint32_t version{ 0 };
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+		uint32_t mipLevels{ 0 };
+		uint32_t mipTailStart{ 0 };
+		uint32_t pageWidth{ 0 };
+		uint32_t pageHeight{ 0 };
+		uint32_t pageCount{ 0 };
+	} header;
+	std::string filename;
+	// Tiles are read from disk if true, otherwise they are generated on the fly (e.g. if the file could not be written)
+	bool fromFile{ false };
+	// One stream per job system thread, so tiles can be read concurrently
+	std::vector<std::ifstream> streams;
+
+	static constexpr uint32_t magicValue = 0x46545456; // "VTTF"
+	static constexpr uint32_t versionValue = 1;
+
+	size_t tileSize() const;
+	size_t mipTailOffset() const;
+	glm::uvec2 mipExtent(uint32_t mipLevel) const;
+	bool open(const std::string& filename, const Header& expected, uint32_t threadCount);
+	bool generate(const std::string& filename, const Header& expected, const std::vector<VirtualTexturePage>& pages, vks::JobSystem& jobSystem);
+	void generateTexels(uint32_t mipLevel, VkOffset3D offset, VkExtent3D extent, uint8_t* data) const;
+	void readTile(const VirtualTexturePage& page, uint32_t threadIndex, uint8_t* data);
+	void readMipLevel(uint32_t mipLevel, uint32_t threadIndex, uint8_t* data);
+};
+
+// Fixed number of physical pages that virtual pages are mapped to, replaced in least recently used order
+struct PagePool
+{
+	static constexpr uint32_t invalid = ~0u;
+	// Single allocation backing all slots, slot i starts at i * pageSize (sparse path only)
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+	VkDeviceSize pageSize{ 0 };
+	// Virtual page currently stored in each slot
+	std::vector<uint32_t> slotPages;
+	// Frame a slot was last requested by the feedback in
+	std::vector<uint64_t> lastUsed;
+	// Occupied slots, least recently used at the front
+	std::list<uint32_t> lru;
+	std::vector<std::list<uint32_t>::iterator> lruEntries;
+	std::vector<uint32_t> freeSlots;
+
+	void create(uint32_t slotCount);
+	void touch(uint32_t slot, uint64_t frame);
+	uint32_t acquire(uint32_t page, uint64_t frame, uint32_t& evictedPage);
+	uint32_t slotCount() const { return static_cast<uint32_t>(slotPages.size()); }
+	uint32_t usedSlots() const { return static_cast<uint32_t>(lru.size()); }
+};
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -75,6 +139,8 @@ public:
 		uint32_t mipLevels;
 		uint32_t layerCount;
         VkImageSubresourceRange subRange;
+		// Backing memory of the fully allocated image on the software page table path
+		VkDeviceMemory deviceMemory{ VK_NULL_HANDLE };
 	} texture;
 
 	vkglTF::Model plane;
@@ -92,6 +158,64 @@ public:
 	VkDescriptorSetLayout descriptorSetLayout{ VK_NULL_HANDLE };
 	std::array<VkDescriptorSet, maxConcurrentFrames> descriptorSets{};
 
+	// Feedback driven streaming of the virtual texture's pages
+	// The fragment shader writes the pages it would like to sample to a feedback buffer, the streamer loads these from a tiled file and maps them to an LRU managed pool of physical pages
+	// If the device doesn't support sparse residency, the texture is fully allocated and residency is only tracked in the page table (software path)
+	struct Streaming {
+		enum PageState : uint8_t { NonResident, Loading, Resident };
+		struct LoadedTile {
+			uint32_t page;
+			std::vector<uint8_t> data;
+		};
+		// Per mip level page layout, passed to the fragment shader
+		struct ShaderData {
+			// x = index of the first page of the mip level, y = pages in x, z = pages in y
+			glm::uvec4 mips[16];
+			glm::uvec2 pageSize;
+			uint32_t mipTailStart;
+			uint32_t mipLevels;
+			uint32_t frame;
+			// Only one pixel per feedbackSpacing x feedbackSpacing block writes feedback per frame (rotating)
+			uint32_t feedbackSpacing{ 4 };
+		} shaderData;
+		struct Statistics {
+			uint32_t requestedPages{ 0 };
+			uint32_t pageFaults{ 0 };
+			uint32_t pagesLoaded{ 0 };
+			uint32_t pagesEvicted{ 0 };
+			uint32_t pendingLoads{ 0 };
+			// Request to residency latency of the pages made resident this frame
+			float averageLatency{ 0.0f };
+			float maxLatency{ 0.0f };
+			// Time spent binding sparse memory this frame
+			float bindTime{ 0.0f };
+		} statistics;
+		// Requires fragment shader stores and atomics for the feedback
+		bool supported{ false };
+		bool enabled{ true };
+		bool sparse{ false };
+		// Physical page budget, fixed at startup
+		uint32_t pageBudget{ 256 };
+		// Limits to spread streaming over several frames
+		uint32_t maxPendingLoads{ 64 };
+		uint32_t maxUploadsPerFrame{ 32 };
+		uint64_t frame{ 0 };
+		std::vector<PageState> pageStates;
+		std::vector<uint32_t> pageSlots;
+		std::vector<uint32_t> pageCoverage;
+		std::vector<std::chrono::high_resolution_clock::time_point> requestTimes;
+		PagePool pool;
+		TileFile tileFile;
+		std::unique_ptr<vks::JobSystem> jobSystem;
+		vks::JobCounter loadCounter;
+		std::mutex loadedMutex;
+		std::vector<LoadedTile> loadedTiles;
+		std::array<vks::Buffer, maxConcurrentFrames> feedbackBuffers;
+		std::array<vks::Buffer, maxConcurrentFrames> pageTableBuffers;
+		std::array<vks::Buffer, maxConcurrentFrames> uniformBuffers;
+	} streaming;
+	VkPipeline streamingPipeline{ VK_NULL_HANDLE };
+
 	//todo: comment
 	VkSemaphore bindSparseSemaphore{ VK_NULL_HANDLE };
 
@@ -101,6 +225,14 @@ public:
 	glm::uvec3 alignedDivision(const VkExtent3D& extent, const VkExtent3D& granularity);
 	void randomPattern(uint8_t* buffer, uint32_t width, uint32_t height);
 	void prepareSparseTexture(uint32_t width, uint32_t height, uint32_t layerCount, VkFormat format);
+	void prepareTexture(uint32_t width, uint32_t height, VkFormat format);
+	void addPages(VkExtent3D granularity, VkDeviceSize pageSize);
+	void createSampler();
+	void prepareStreaming();
+	void setStreaming(bool enabled);
+	void uploadMipTail();
+	void bindPages(const std::vector<uint32_t>& evictedPages, const std::vector<uint32_t>& newPages);
+	void updateStreaming();
 	// @todo: move to dtor of texture
 	void destroyTextureImage(SparseTexture texture);
 	void buildCommandBuffer();
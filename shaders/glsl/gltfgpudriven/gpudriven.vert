@@ -0,0 +1,58 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+
+layout (set = 0, binding = 0) uniform UBO {
+	mat4 projection;
+	mat4 view;
+	mat4 model;
+} ubo;
+
+// Same layout as vkglTF::IndirectDrawData
+struct DrawData {
+	vec4 boundingSphere;
+	uint transformIndex;
+	uint materialIndex;
+	uint range;
+	uint rangeFirst;
+};
+
+layout (set = 1, binding = 0, std430) readonly buffer Draws {
+	DrawData draws[];
+};
+
+layout (set = 1, binding = 1, std430) readonly buffer Transforms {
+	mat4 transforms[];
+};
+
+layout (set = 1, binding = 2, std430) readonly buffer Materials {
+	vec4 baseColorFactors[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	// The first instance of each indirect draw command is the index of the draw
+	DrawData draw = draws[gl_InstanceIndex];
+	mat4 nodeMatrix = transforms[draw.transformIndex];
+	outColor = baseColorFactors[draw.materialIndex].rgb;
+	vec4 pos = vec4(inPos, 1.0);
+	gl_Position = ubo.projection * ubo.view * ubo.model * nodeMatrix * pos;
+
+	outNormal = mat3(ubo.view * ubo.model * nodeMatrix) * inNormal;
+
+	vec4 localpos = ubo.view * ubo.model * nodeMatrix * pos;
+	vec3 lightPos = vec3(10.0f, -10.0f, 10.0f);
+	outLightVec = lightPos.xyz - localpos.xyz;
+	outViewVec = -localpos.xyz;		
+}
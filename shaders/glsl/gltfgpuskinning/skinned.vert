@@ -0,0 +1,58 @@
+#version 450
+
+// Skins the vertices in every pass that draws them
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec4 inJointIndices;
+layout (location = 3) in vec4 inJointWeights;
+
+layout (set = 0, binding = 0) uniform UBO {
+	mat4 projection;
+	mat4 view;
+	vec4 lightPos;
+} ubo;
+
+layout (set = 1, binding = 0) uniform Node {
+	mat4 matrix;
+} node;
+
+// Node and joint matrices of the model for the current frame
+layout (set = 1, binding = 1, std430) readonly buffer Matrices {
+	mat4 matrices[];
+};
+
+layout(push_constant) uniform PushConsts {
+	vec4 offset;
+	vec4 color;
+	uint jointMatrixIndex;
+} pushConsts;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	mat4 skinMat = 
+		inJointWeights.x * matrices[pushConsts.jointMatrixIndex + int(inJointIndices.x)] +
+		inJointWeights.y * matrices[pushConsts.jointMatrixIndex + int(inJointIndices.y)] +
+		inJointWeights.z * matrices[pushConsts.jointMatrixIndex + int(inJointIndices.z)] +
+		inJointWeights.w * matrices[pushConsts.jointMatrixIndex + int(inJointIndices.w)];
+
+	outColor = pushConsts.color.rgb;
+	vec4 pos = node.matrix * skinMat * vec4(inPos, 1.0) + vec4(pushConsts.offset.xyz, 0.0);
+	gl_Position = ubo.projection * ubo.view * pos;
+
+	outNormal = mat3(ubo.view) * mat3(node.matrix) * normalize(mat3(skinMat) * inNormal);
+
+	vec4 localpos = ubo.view * pos;
+	outLightVec = (ubo.view * ubo.lightPos).xyz - localpos.xyz;
+	outViewVec = -localpos.xyz;
+}
@@ -0,0 +1,60 @@
+#version 450
+
+layout (binding = 1) uniform sampler2D samplerColor;
+
+layout (binding = 2) uniform StreamingInfo
+{
+	// x = index of the first page of the mip level, y = pages in x, z = pages in y
+	uvec4 mips[16];
+	uvec2 pageSize;
+	uint mipTailStart;
+	uint mipLevels;
+	uint frame;
+	uint feedbackSpacing;
+} streaming;
+
+layout (binding = 3) readonly buffer PageTable
+{
+	uint resident[];
+} pageTable;
+
+layout (binding = 4) buffer Feedback
+{
+	uint requests[];
+} feedback;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in float inLodBias;
+
+layout (location = 0) out vec4 outFragColor;
+
+uint pageIndex(uint mip, vec2 uv)
+{
+	uvec2 texel = uvec2(uv * vec2(textureSize(samplerColor, int(mip))));
+	uvec2 page = min(texel / streaming.pageSize, streaming.mips[mip].yz - 1);
+	return streaming.mips[mip].x + page.y * streaming.mips[mip].y + page.x;
+}
+
+void main() 
+{
+	vec2 uv = clamp(inUV, 0.0, 1.0);
+
+	// Mip level the sampler would select (nearest mip mode)
+	float lod = clamp(textureQueryLod(samplerColor, uv).y + inLodBias, 0.0, float(streaming.mipLevels - 1));
+	uint requestedMip = uint(lod + 0.5);
+
+	// Request the page, only one pixel per block writes feedback in each frame to keep the number of atomics low
+	uvec2 pixel = uvec2(gl_FragCoord.xy) % streaming.feedbackSpacing;
+	uint feedbackPixel = streaming.frame % (streaming.feedbackSpacing * streaming.feedbackSpacing);
+	if ((requestedMip < streaming.mipTailStart) && (pixel.y * streaming.feedbackSpacing + pixel.x == feedbackPixel)) {
+		atomicAdd(feedback.requests[pageIndex(requestedMip, uv)], 1);
+	}
+
+	// Fall back to coarser mip levels until a resident page is found, the mip tail is always resident
+	uint mip = requestedMip;
+	while ((mip < streaming.mipTailStart) && (pageTable.resident[pageIndex(mip, uv)] == 0)) {
+		mip++;
+	}
+
+	outFragColor = textureLod(samplerColor, uv, float(mip));
+}
@@ -0,0 +1,72 @@
+// Copyright 2025 Sascha Willems
+// Non-uniform access is enabled at compile time via SPV_EXT_descriptor_indexing (see compileshaders.py)
+
+// Same layout as vkglTF::MaterialData
+struct Material
+{
+	float4 baseColorFactor;
+	uint baseColorTextureIndex;
+	uint normalTextureIndex;
+	uint metallicRoughnessTextureIndex;
+	uint occlusionTextureIndex;
+	uint emissiveTextureIndex;
+	float metallicFactor;
+	float roughnessFactor;
+	float alphaCutoff;
+	uint alphaMode;
+};
+
+#define ALPHAMODE_MASK 1
+
+// All materials and textures of the model
+StructuredBuffer<Material> materials : register(t0, space1);
+Texture2D textures[] : register(t1, space1);
+SamplerState samplers[] : register(s1, space1);
+
+struct PushConsts
+{
+	uint materialIndex;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct VSOutput
+{
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float2 UV : TEXCOORD0;
+[[vk::location(3)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(4)]] float3 LightVec : TEXCOORD2;
+[[vk::location(5)]] float4 Tangent : TEXCOORD3;
+};
+
+float4 sampleTexture(uint index, float2 uv)
+{
+	return textures[NonUniformResourceIndex(index)].Sample(samplers[NonUniformResourceIndex(index)], uv);
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	Material material = materials[pushConsts.materialIndex];
+
+	float4 color = sampleTexture(material.baseColorTextureIndex, input.UV) * float4(input.Color, 1.0);
+
+	if (material.alphaMode == ALPHAMODE_MASK) {
+		if (color.a < material.alphaCutoff) {
+			discard;
+		}
+	}
+
+	float3 N = normalize(input.Normal);
+	float3 T = normalize(input.Tangent.xyz);
+	float3 B = cross(input.Normal, input.Tangent.xyz) * input.Tangent.w;
+	float3x3 TBN = float3x3(T, B, N);
+	N = mul(normalize(sampleTexture(material.normalTextureIndex, input.UV).xyz * 2.0 - float3(1.0, 1.0, 1.0)), TBN);
+
+	const float ambient = 0.25;
+	float3 L = normalize(input.LightVec);
+	float3 V = normalize(input.ViewVec);
+	float3 R = reflect(-L, N);
+	float3 diffuse = max(dot(N, L), ambient).rrr;
+	float specular = pow(max(dot(R, V), 0.0), 32.0);
+	return float4(diffuse * color.rgb + specular, color.a);
+}
@@ -0,0 +1,54 @@
+// Copyright 2025 Sascha Willems
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 model;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct Node
+{
+	float4x4 matrix;
+};
+
+cbuffer node : register(b0, space1) { Node node; }
+
+struct PushBlock
+{
+	float4 baseColorFactor;
+};
+[[vk::push_constant]] PushBlock material;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	output.Color = material.baseColorFactor.rgb;
+	float4x4 modelView = mul(ubo.view, mul(ubo.model, node.matrix));
+	output.Pos = mul(ubo.projection, mul(modelView, float4(input.Pos, 1.0)));
+
+	output.Normal = mul((float3x3)modelView, input.Normal);
+
+	float4 localpos = mul(modelView, float4(input.Pos, 1.0));
+	float3 lightPos = float3(10.0f, -10.0f, 10.0f);
+	output.LightVec = lightPos.xyz - localpos.xyz;
+	output.ViewVec = -localpos.xyz;
+	return output;
+}
@@ -0,0 +1,59 @@
+// Copyright 2025 Sascha Willems
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 model;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Same layout as vkglTF::IndirectDrawData
+struct DrawData
+{
+	float4 boundingSphere;
+	uint transformIndex;
+	uint materialIndex;
+	uint range;
+	uint rangeFirst;
+};
+
+StructuredBuffer<DrawData> draws : register(t0, space1);
+StructuredBuffer<float4x4> transforms : register(t1, space1);
+StructuredBuffer<float4> baseColorFactors : register(t2, space1);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
+};
+
+// SV_InstanceID includes the first instance of the draw command, as DXC maps it to InstanceIndex unless -fvk-support-nonzero-base-instance is passed
+VSOutput main(VSInput input, uint InstanceIndex : SV_InstanceID)
+{
+	VSOutput output = (VSOutput)0;
+	// The first instance of each indirect draw command is the index of the draw
+	DrawData draw = draws[InstanceIndex];
+	float4x4 nodeMatrix = transforms[draw.transformIndex];
+	output.Color = baseColorFactors[draw.materialIndex].rgb;
+	float4x4 modelView = mul(ubo.view, mul(ubo.model, nodeMatrix));
+	output.Pos = mul(ubo.projection, mul(modelView, float4(input.Pos, 1.0)));
+
+	output.Normal = mul((float3x3)modelView, input.Normal);
+
+	float4 localpos = mul(modelView, float4(input.Pos, 1.0));
+	float3 lightPos = float3(10.0f, -10.0f, 10.0f);
+	output.LightVec = lightPos.xyz - localpos.xyz;
+	output.ViewVec = -localpos.xyz;
+	return output;
+}
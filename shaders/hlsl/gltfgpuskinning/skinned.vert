@@ -0,0 +1,68 @@
+// Copyright 2025 Sascha Willems
+
+// Skins the vertices in every pass that draws them
+
+struct VSInput
+{
+[[vk::location(0)]] float3 Pos : POSITION0;
+[[vk::location(1)]] float3 Normal : NORMAL0;
+[[vk::location(2)]] float4 JointIndices : TEXCOORD1;
+[[vk::location(3)]] float4 JointWeights : TEXCOORD2;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4 lightPos;
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+struct Node
+{
+	float4x4 matrix;
+};
+
+cbuffer node : register(b0, space1) { Node node; }
+
+// Node and joint matrices of the model for the current frame
+StructuredBuffer<float4x4> matrices : register(t1, space1);
+
+struct PushConsts
+{
+	float4 offset;
+	float4 color;
+	uint jointMatrixIndex;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float3 Normal : NORMAL0;
+[[vk::location(1)]] float3 Color : COLOR0;
+[[vk::location(2)]] float3 ViewVec : TEXCOORD1;
+[[vk::location(3)]] float3 LightVec : TEXCOORD2;
+};
+
+VSOutput main(VSInput input)
+{
+	VSOutput output = (VSOutput)0;
+	float4x4 skinMat =
+		input.JointWeights.x * matrices[pushConsts.jointMatrixIndex + int(input.JointIndices.x)] +
+		input.JointWeights.y * matrices[pushConsts.jointMatrixIndex + int(input.JointIndices.y)] +
+		input.JointWeights.z * matrices[pushConsts.jointMatrixIndex + int(input.JointIndices.z)] +
+		input.JointWeights.w * matrices[pushConsts.jointMatrixIndex + int(input.JointIndices.w)];
+
+	output.Color = pushConsts.color.rgb;
+	float4 pos = mul(node.matrix, mul(skinMat, float4(input.Pos, 1.0))) + float4(pushConsts.offset.xyz, 0.0);
+	output.Pos = mul(ubo.projection, mul(ubo.view, pos));
+
+	output.Normal = mul((float3x3)ubo.view, mul((float3x3)node.matrix, normalize(mul((float3x3)skinMat, input.Normal))));
+
+	float4 localpos = mul(ubo.view, pos);
+	output.LightVec = mul(ubo.view, ubo.lightPos).xyz - localpos.xyz;
+	output.ViewVec = -localpos.xyz;
+	return output;
+}
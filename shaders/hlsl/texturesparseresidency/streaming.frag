@@ -0,0 +1,60 @@
+// Copyright 2025 Sascha Willems
+
+Texture2D textureColor : register(t1);
+SamplerState samplerColor : register(s1);
+
+struct StreamingInfo
+{
+	// x = index of the first page of the mip level, y = pages in x, z = pages in y
+	uint4 mips[16];
+	uint2 pageSize;
+	uint mipTailStart;
+	uint mipLevels;
+	uint frame;
+	uint feedbackSpacing;
+};
+
+cbuffer streaming : register(b2) { StreamingInfo streaming; }
+
+StructuredBuffer<uint> pageTable : register(t3);
+RWStructuredBuffer<uint> feedback : register(u4);
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float2 UV : TEXCOORD0;
+[[vk::location(1)]] float LodBias : TEXCOORD3;
+};
+
+uint pageIndex(uint mip, float2 uv)
+{
+	uint2 mipSize;
+	uint levels;
+	textureColor.GetDimensions(mip, mipSize.x, mipSize.y, levels);
+	uint2 page = min(uint2(uv * float2(mipSize)) / streaming.pageSize, streaming.mips[mip].yz - 1);
+	return streaming.mips[mip].x + page.y * streaming.mips[mip].y + page.x;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	float2 uv = saturate(input.UV);
+
+	// Mip level the sampler would select (nearest mip mode)
+	float lod = clamp(textureColor.CalculateLevelOfDetailUnclamped(samplerColor, uv) + input.LodBias, 0.0, float(streaming.mipLevels - 1));
+	uint requestedMip = uint(lod + 0.5);
+
+	// Request the page, only one pixel per block writes feedback in each frame to keep the number of atomics low
+	uint2 pixel = uint2(input.Pos.xy) % streaming.feedbackSpacing;
+	uint feedbackPixel = streaming.frame % (streaming.feedbackSpacing * streaming.feedbackSpacing);
+	if ((requestedMip < streaming.mipTailStart) && (pixel.y * streaming.feedbackSpacing + pixel.x == feedbackPixel)) {
+		InterlockedAdd(feedback[pageIndex(requestedMip, uv)], 1);
+	}
+
+	// Fall back to coarser mip levels until a resident page is found, the mip tail is always resident
+	uint mip = requestedMip;
+	while ((mip < streaming.mipTailStart) && (pageTable[pageIndex(mip, uv)] == 0)) {
+		mip++;
+	}
+
+	return textureColor.SampleLevel(samplerColor, uv, float(mip));
+}
@@ -0,0 +1,84 @@
+# Copyright (C) 2025 by Sascha Willems - www.saschawillems.de
+# This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+
+# Packs the compiled SPIR-V files of each sample's shader directory into a single shaders.spva archive
+# The archive is memory mapped by vks::ShaderCache at runtime, see base/VulkanShaderCache.cpp for the layout
+
+import argparse
+import os
+import struct
+import sys
+
+parser = argparse.ArgumentParser(description='Pack compiled SPIR-V shaders into per-sample shader archives')
+parser.add_argument('--language', type=str, choices=['glsl', 'hlsl', 'slang'], help='only pack shaders for the given shading language')
+parser.add_argument('--sample', type=str, help='can be used to pack shaders for a single sample only')
+parser.add_argument('--clean', action='store_true', help='remove existing shader archives instead of creating them')
+args = parser.parse_args()
+
+ARCHIVE_NAME = "shaders.spva"
+ARCHIVE_MAGIC = b"SPVA"
+ARCHIVE_VERSION = 1
+HEADER_SIZE = 16
+ENTRY_SIZE = 24
+
+def fnv1a64(data):
+    hash = 14695981039346656037
+    for byte in data:
+        hash ^= byte
+        hash = (hash * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return hash
+
+def align(value, alignment):
+    return (value + alignment - 1) & ~(alignment - 1)
+
+def packDirectory(directory):
+    files = sorted(file for file in os.listdir(directory) if file.endswith(".spv"))
+    if len(files) == 0:
+        return False
+    names = [file.encode("utf-8") for file in files]
+    blobs = []
+    for file in files:
+        with open(os.path.join(directory, file), "rb") as f:
+            data = f.read()
+        if len(data) == 0 or len(data) % 4 != 0:
+            sys.exit("ERROR: %s is not a valid SPIR-V file" % os.path.join(directory, file))
+        blobs.append(data)
+
+    name_offset = HEADER_SIZE + ENTRY_SIZE * len(files)
+    data_offset = align(name_offset + sum(len(name) for name in names), 4)
+    header = struct.pack("<4sIII", ARCHIVE_MAGIC, ARCHIVE_VERSION, len(files), 0)
+    table = b""
+    name_data = b""
+    for name, data in zip(names, blobs):
+        table += struct.pack("<QIIII", fnv1a64(data), name_offset + len(name_data), len(name), data_offset, len(data))
+        name_data += name
+        data_offset += len(data)
+
+    with open(os.path.join(directory, ARCHIVE_NAME), "wb") as f:
+        f.write(header)
+        f.write(table)
+        f.write(name_data)
+        f.write(b"\0" * (align(f.tell(), 4) - f.tell()))
+        for data in blobs:
+            f.write(data)
+    return True
+
+dir_path = os.path.dirname(os.path.realpath(__file__))
+languages = [args.language] if args.language != None else ["glsl", "hlsl", "slang"]
+for language in languages:
+    language_path = os.path.join(dir_path, language)
+    if not os.path.isdir(language_path):
+        continue
+    for root, dirs, files in os.walk(language_path):
+        if root == language_path:
+            continue
+        folder_name = os.path.basename(root)
+        if (args.sample != None and folder_name != args.sample):
+            continue
+        archive_file = os.path.join(root, ARCHIVE_NAME)
+        if args.clean:
+            if os.path.isfile(archive_file):
+                os.remove(archive_file)
+            continue
+        if packDirectory(root):
+            print("Packed %s" % archive_file)